@@ -0,0 +1,250 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Runtime.InteropServices;
+
+///---------------------------------------------------------------------
+///   Class:        RigTable.cs
+///   Description:  Phoneme, diphone and emotion mappings of a character
+///                 read from the binary table compiled by rig_compiler
+///                 (native lipsync library, see
+///                 StreamingAssets/LipSync/lipsync_rigtab.h). Each
+///                 table is loaded once and shared by every instance of
+///                 the character
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Character startup
+///---------------------------------------------------------------------
+
+public class RigTable
+{
+    const int maxShapes = 64;
+
+    static Dictionary<string, RigTable> tables = new Dictionary<string, RigTable>();
+
+    // phoneme blendshapes, flat: shapes of phoneme p are [first[p], first[p] + count[p]), count -1 if unmapped
+    int[] first;
+    int[] count;
+    int[] indices;
+    float[] weights;
+    List<Emotion> emotions;
+    List<int> emotionFirst;
+    List<int> emotionCount;
+    Dictionary<Phoneme, List<Phoneme>> diphones;
+
+    [DllImport("lipsync")]
+    static extern IntPtr ls_rigtab_open(string path);
+
+    [DllImport("lipsync")]
+    static extern void ls_rigtab_close(IntPtr table);
+
+    [DllImport("lipsync")]
+    static extern uint ls_rigtab_sources(IntPtr table);
+
+    [DllImport("lipsync")]
+    static extern int ls_rigtab_viseme(IntPtr table, int phoneme, int[] indices, float[] weights, int max);
+
+    [DllImport("lipsync")]
+    static extern int ls_rigtab_diphone(IntPtr table, int phoneme, int[] phonemes);
+
+    [DllImport("lipsync")]
+    static extern int ls_rigtab_emotions(IntPtr table);
+
+    [DllImport("lipsync")]
+    static extern IntPtr ls_rigtab_emotion_name(IntPtr table, int emotion);
+
+    [DllImport("lipsync")]
+    static extern int ls_rigtab_emotion(IntPtr table, int emotion, int[] indices, float[] weights, int max);
+
+    /// <summary>
+    /// Table compiled from the mappings of the character, e.g. "Adam" for XML/Adam.rig.
+    /// Returns null if the native library or the table is not available, the table is not
+    /// valid or was compiled from other XML than the sources; the caller then parses the XML
+    /// </summary>
+    /// <param name="name"></param>
+    /// <param name="sources">XML mappings the table was compiled from, in rig_compiler's order
+    /// (phoneme, diphone, emotion mapping); missing ones are skipped</param>
+    /// <returns></returns>
+    public static RigTable Get(string name, params string[] sources)
+    {
+        RigTable table;
+        lock (tables)
+        {
+            if (!tables.TryGetValue(name, out table))
+            {
+                table = Load(PathManager.GetXMLDataPath(name + ".rig"), sources);
+                tables.Add(name, table);
+            }
+        }
+        return table;
+    }
+
+    static RigTable Load(string path, string[] sources)
+    {
+        if (!File.Exists(path))
+        {
+            return null;
+        }
+
+        IntPtr handle;
+        try
+        {
+            handle = ls_rigtab_open(path);
+        }
+        catch (DllNotFoundException)
+        {
+            return null;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return null;
+        }
+        if (handle == IntPtr.Zero)
+        {
+            UnityEngine.Debug.Log("Unable to read rig table " + path);
+            return null;
+        }
+        if (ls_rigtab_sources(handle) != SourcesHash(sources))
+        {
+            UnityEngine.Debug.Log("Rig table " + path + " was compiled from other mappings, run rig_compiler again");
+            ls_rigtab_close(handle);
+            return null;
+        }
+
+        RigTable table = new RigTable(handle);
+        ls_rigtab_close(handle);
+        return table;
+    }
+
+    /// <summary>
+    /// FNV-1a hash of the bytes of the sources, as rig_compiler stores it in the table
+    /// </summary>
+    /// <param name="sources"></param>
+    /// <returns></returns>
+    static uint SourcesHash(string[] sources)
+    {
+        uint hash = 2166136261;
+        foreach (string source in sources)
+        {
+            if (!File.Exists(source))
+            {
+                continue;
+            }
+            foreach (byte b in File.ReadAllBytes(source))
+            {
+                hash = unchecked((hash ^ b) * 16777619);
+            }
+        }
+        return hash;
+    }
+
+    RigTable(IntPtr handle)
+    {
+        int phonemes = Enum.GetValues(typeof(Phoneme)).Length;
+        int[] shapeIndices = new int[maxShapes];
+        float[] shapeWeights = new float[maxShapes];
+        List<int> allIndices = new List<int>();
+        List<float> allWeights = new List<float>();
+        int[] pair = new int[2];
+
+        first = new int[phonemes];
+        count = new int[phonemes];
+        diphones = new Dictionary<Phoneme, List<Phoneme>>();
+        for (int p = 0; p < phonemes; p++)
+        {
+            first[p] = allIndices.Count;
+            count[p] = ls_rigtab_viseme(handle, p, shapeIndices, shapeWeights, maxShapes);
+            for (int i = 0; i < Math.Min(count[p], maxShapes); i++)
+            {
+                allIndices.Add(shapeIndices[i]);
+                allWeights.Add(shapeWeights[i]);
+            }
+            count[p] = Math.Min(count[p], maxShapes);
+
+            if (ls_rigtab_diphone(handle, p, pair) == 2)
+            {
+                diphones.Add((Phoneme)p, new List<Phoneme> { (Phoneme)pair[0], (Phoneme)pair[1] });
+            }
+        }
+
+        emotions = new List<Emotion>();
+        emotionFirst = new List<int>();
+        emotionCount = new List<int>();
+        for (int e = 0; e < ls_rigtab_emotions(handle); e++)
+        {
+            string emotionName = Marshal.PtrToStringAnsi(ls_rigtab_emotion_name(handle, e));
+            if (!Enum.IsDefined(typeof(Emotion), emotionName))
+            {
+                continue;
+            }
+            int n = Math.Min(ls_rigtab_emotion(handle, e, shapeIndices, shapeWeights, maxShapes), maxShapes);
+            emotions.Add((Emotion)Enum.Parse(typeof(Emotion), emotionName));
+            emotionFirst.Add(allIndices.Count);
+            emotionCount.Add(n);
+            for (int i = 0; i < n; i++)
+            {
+                allIndices.Add(shapeIndices[i]);
+                allWeights.Add(shapeWeights[i]);
+            }
+        }
+
+        indices = allIndices.ToArray();
+        weights = allWeights.ToArray();
+    }
+
+    /// <summary>
+    /// Diphone to phonemes mapping, shared by all users of the table: do not modify
+    /// </summary>
+    public Dictionary<Phoneme, List<Phoneme>> Diphones
+    {
+        get { return diphones; }
+    }
+
+    /// <summary>
+    /// New phoneme to blendshapes mapping for one instance of the character, as
+    /// MyLipSync.PhonemeBlendShapeMapping builds it from the XML
+    /// </summary>
+    /// <param name="blendShapes">blendshapes of the character mesh</param>
+    /// <returns></returns>
+    public Dictionary<Phoneme, List<BlendShape>> PhonemeBlendShapes(List<BlendShape> blendShapes)
+    {
+        Dictionary<Phoneme, List<BlendShape>> mapping = new Dictionary<Phoneme, List<BlendShape>>();
+        for (int p = 0; p < count.Length; p++)
+        {
+            if (count[p] >= 0)
+            {
+                mapping.Add((Phoneme)p, NewBlendShapes(first[p], count[p], blendShapes));
+            }
+        }
+        return mapping;
+    }
+
+    /// <summary>
+    /// New emotion to blendshapes mapping for one instance of the character
+    /// </summary>
+    /// <param name="blendShapes">blendshapes of the character mesh</param>
+    /// <returns></returns>
+    public Dictionary<Emotion, List<BlendShape>> EmotionBlendShapes(List<BlendShape> blendShapes)
+    {
+        Dictionary<Emotion, List<BlendShape>> mapping = new Dictionary<Emotion, List<BlendShape>>();
+        for (int e = 0; e < emotions.Count; e++)
+        {
+            mapping[emotions[e]] = NewBlendShapes(emotionFirst[e], emotionCount[e], blendShapes);
+        }
+        return mapping;
+    }
+
+    // The weights animated by MyLipSync live in the BlendShape objects, so every instance gets its own
+    List<BlendShape> NewBlendShapes(int start, int n, List<BlendShape> blendShapes)
+    {
+        List<BlendShape> list = new List<BlendShape>(n);
+        for (int i = start; i < start + n; i++)
+        {
+            BlendShape bs = new BlendShape();
+            bs.index = indices[i];
+            bs.setBlendShapeWeight(weights[i]);
+            bs.name = blendShapes[indices[i]].name;
+            list.Add(bs);
+        }
+        return list;
+    }
+}
@@ -0,0 +1,140 @@
+﻿using System;
+using System.Collections;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+using UnityEngine;
+
+///-----------------------------------------------------------------
+///   Class:        VisemeTrack.cs
+///   Description:  Baked viseme animation written by viseme_baker
+///                 (see viseme_track.h). Holds one keyframe curve
+///                 per blendshape and applies it to the character
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Baked lip sync playback
+///-----------------------------------------------------------------
+
+public class VisemeTrack
+{
+    const int HeaderSize = 32;
+    const int EntrySize = 12;
+    const int Version = 1;
+
+    int[] blendShapes;
+    int[] firstKey;
+    int[] keyCount;
+    int[] cursor; // last key used per track, playback moves forward
+    float[] times;
+    float[] weights;
+
+    public float Duration { get; private set; } // length of the baked audio
+    public float Interval { get; private set; } // bake step
+
+    /// <summary>
+    /// Reads a track file written by viseme_baker
+    /// </summary>
+    /// <param name="file"></param>
+    public VisemeTrack(string file)
+    {
+        byte[] data = File.ReadAllBytes(file);
+
+        if (data.Length < HeaderSize || Encoding.ASCII.GetString(data, 0, 4) != "CPVT" || BitConverter.ToUInt16(data, 4) != Version)
+        {
+            throw new InvalidDataException("Not a viseme track file: " + file);
+        }
+
+        int trackCount = (int)BitConverter.ToUInt32(data, 8);
+        int keyTotal = (int)BitConverter.ToUInt32(data, 12);
+        Duration = BitConverter.ToSingle(data, 16);
+        Interval = BitConverter.ToSingle(data, 20);
+        if (HeaderSize + trackCount * EntrySize + keyTotal * 8 > data.Length)
+        {
+            throw new InvalidDataException("Truncated viseme track file: " + file);
+        }
+
+        blendShapes = new int[trackCount];
+        firstKey = new int[trackCount];
+        keyCount = new int[trackCount];
+        cursor = new int[trackCount];
+        for (int i = 0; i < trackCount; i++)
+        {
+            int offset = HeaderSize + i * EntrySize;
+            blendShapes[i] = (int)BitConverter.ToUInt32(data, offset);
+            firstKey[i] = (int)BitConverter.ToUInt32(data, offset + 4);
+            keyCount[i] = (int)BitConverter.ToUInt32(data, offset + 8);
+            if (firstKey[i] + keyCount[i] > keyTotal)
+            {
+                throw new InvalidDataException("Corrupt viseme track file: " + file);
+            }
+        }
+
+        times = new float[keyTotal];
+        weights = new float[keyTotal];
+        int keysOffset = HeaderSize + trackCount * EntrySize;
+        for (int k = 0; k < keyTotal; k++)
+        {
+            times[k] = BitConverter.ToSingle(data, keysOffset + k * 8);
+            weights[k] = BitConverter.ToSingle(data, keysOffset + k * 8 + 4);
+        }
+    }
+
+    /// <summary>
+    /// Rewinds playback to the start of the tracks
+    /// </summary>
+    public void Reset()
+    {
+        for (int i = 0; i < cursor.Length; i++)
+        {
+            cursor[i] = 0;
+        }
+    }
+
+    /// <summary>
+    /// Sets every baked blendshape of the mesh to its weight at timeStamp
+    /// </summary>
+    /// <param name="characterMesh"></param>
+    /// <param name="timeStamp"></param>
+    public void Apply(SkinnedMeshRenderer characterMesh, float timeStamp)
+    {
+        for (int i = 0; i < blendShapes.Length; i++)
+        {
+            characterMesh.SetBlendShapeWeight(blendShapes[i], Sample(i, timeStamp));
+        }
+    }
+
+    /// <summary>
+    /// Weight of a track at timeStamp, linearly interpolated between keys
+    /// </summary>
+    /// <param name="track"></param>
+    /// <param name="timeStamp"></param>
+    /// <returns></returns>
+    float Sample(int track, float timeStamp)
+    {
+        int first = firstKey[track];
+        int last = first + keyCount[track] - 1;
+        if (last < first)
+        {
+            return 0;
+        }
+
+        // time normally only moves forward, so the search starts at the previous key
+        int k = first + cursor[track];
+        if (times[k] > timeStamp)
+        {
+            k = first;
+        }
+        while (k < last && times[k + 1] <= timeStamp)
+        {
+            k++;
+        }
+        cursor[track] = k - first;
+
+        if (k == last || timeStamp <= times[k])
+        {
+            return weights[k];
+        }
+
+        float t = (timeStamp - times[k]) / (times[k + 1] - times[k]);
+        return weights[k] + (weights[k + 1] - weights[k]) * t;
+    }
+}
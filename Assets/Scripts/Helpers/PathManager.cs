@@ -82,4 +82,9 @@ public static class PathManager
     {
         return Application.streamingAssetsPath + "/Emotions/" + file;
     }
+
+    public static string GetCachePath(string file)
+    {
+        return Application.persistentDataPath + "/Cache/" + file;
+    }
 }
@@ -18,7 +18,7 @@ public class RuvdessParser : MonoBehaviour {
     public Dropdown audioDropDown;
     public Text soundInfo;
     int currentIndex;
-    bool generateTranscripts = false;
+    bool generateTranscripts = false; // ravdess_ingest (StreamingAssets/LipSync) writes them with the alignments and prosody of the whole corpus
     UnityEngine.Object[] clips;
     List<string> clipInfo;
     string vocalContext;
@@ -0,0 +1,256 @@
+﻿using System;
+using System.Collections;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using UnityEngine;
+
+///---------------------------------------------------------------------
+///   Class:        LiveLipSync.cs
+///   Description:  Animates a character from a live voice, with the
+///                 visemes estimated from the microphone as it speaks
+///                 (native lipsync library, see
+///                 StreamingAssets/LipSync/lipsync_live.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Goes on its own GameObject, whose AudioSource plays
+///                 the microphone; the character's MyLipSync keeps the
+///                 mesh while it plays a clip
+///---------------------------------------------------------------------
+
+[RequireComponent(typeof(AudioSource))]
+public class LiveLipSync : MonoBehaviour
+{
+    public MyLipSync character;
+    [Tooltip("Capture device, empty for the default one")]
+    public string device = "";
+    [Tooltip("10 ms frames classified ahead of each one, more is steadier but later")]
+    [Range(0, 6)]
+    public int lookahead = 2;
+    [Tooltip("Keep the captured voice off the speakers")]
+    public bool muteOutput = true;
+
+    IntPtr live = IntPtr.Zero;
+    readonly object liveLock = new object(); // the audio thread pushes while the component is destroyed
+    new AudioSource audio;
+    float[] weights;
+    int[] slotShapes; // mesh blendshape of each slot
+    List<KeyValuePair<int, float>>[] phonemeSlots; // slot and target weight of each blendshape of a phoneme
+    float[] values;
+    float[] uploaded;
+
+    [DllImport("lipsync")]
+    static extern IntPtr ls_live_new(int sampleRate, int lookahead);
+
+    [DllImport("lipsync")]
+    static extern void ls_live_delete(IntPtr live);
+
+    [DllImport("lipsync")]
+    static extern int ls_live_push(IntPtr live, float[] samples, int frames, int channels);
+
+    [DllImport("lipsync")]
+    static extern int ls_live_weights(IntPtr live, float[] weights);
+
+    [DllImport("lipsync")]
+    static extern float ls_live_latency(IntPtr live);
+
+    [DllImport("lipsync")]
+    static extern int ls_live_overruns(IntPtr live);
+
+    /// <summary>
+    /// Starts the native estimator and the microphone
+    /// </summary>
+    void Start()
+    {
+        audio = GetComponent<AudioSource>();
+        if (Microphone.devices.Length == 0)
+        {
+            Debug.Log("No microphone, live lip sync disabled");
+            return;
+        }
+
+        try
+        {
+            live = ls_live_new(AudioSettings.outputSampleRate, lookahead);
+        }
+        catch (DllNotFoundException)
+        {
+            Debug.Log("lipsync library not found, live lip sync disabled");
+            return;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            Debug.Log("lipsync library has no live estimator, live lip sync disabled");
+            return;
+        }
+        if (live == IntPtr.Zero)
+        {
+            return;
+        }
+
+        weights = new float[Enum.GetValues(typeof(Phoneme)).Length];
+        Debug.Log("Live lip sync latency " + (ls_live_latency(live) * 1000).ToString("0") + " ms plus the audio buffer");
+        StartCoroutine(StartMicrophone());
+    }
+
+    /// <summary>
+    /// Plays the microphone through the AudioSource as soon as it records, so that OnAudioFilterRead receives it
+    /// </summary>
+    /// <returns></returns>
+    IEnumerator StartMicrophone()
+    {
+        string name = string.IsNullOrEmpty(device) ? null : device;
+        AudioClip clip = Microphone.Start(name, true, 1, AudioSettings.outputSampleRate);
+        while (Microphone.GetPosition(name) <= 0)
+        {
+            yield return null;
+        }
+
+        audio.clip = clip;
+        audio.loop = true;
+        audio.Play();
+    }
+
+    /// <summary>
+    /// Maps the phonemes of the character to slots of its blendshapes, once MyLipSync has loaded them
+    /// </summary>
+    /// <returns></returns>
+    bool MapBlendShapes()
+    {
+        if (character.phonemeBlendShapes == null)
+        {
+            return false;
+        }
+
+        List<int> shapes = new List<int>();
+        phonemeSlots = new List<KeyValuePair<int, float>>[weights.Length];
+        for (int p = 0; p < weights.Length; p++)
+        {
+            phonemeSlots[p] = new List<KeyValuePair<int, float>>();
+            List<BlendShape> blendShapes;
+            if (!character.phonemeBlendShapes.TryGetValue((Phoneme)p, out blendShapes))
+            {
+                continue;
+            }
+
+            foreach (BlendShape bs in blendShapes)
+            {
+                int slot = shapes.IndexOf(bs.index);
+                if (slot < 0)
+                {
+                    slot = shapes.Count;
+                    shapes.Add(bs.index);
+                }
+                phonemeSlots[p].Add(new KeyValuePair<int, float>(slot, bs.weight));
+            }
+        }
+
+        slotShapes = shapes.ToArray();
+        values = new float[slotShapes.Length];
+        uploaded = new float[slotShapes.Length];
+        for (int s = 0; s < uploaded.Length; s++)
+        {
+            uploaded[s] = float.NaN;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Captured audio, on the audio thread
+    /// </summary>
+    /// <param name="data"></param>
+    /// <param name="channels"></param>
+    void OnAudioFilterRead(float[] data, int channels)
+    {
+        lock (liveLock)
+        {
+            if (live != IntPtr.Zero)
+            {
+                ls_live_push(live, data, data.Length / channels, channels);
+            }
+        }
+
+        if (muteOutput)
+        {
+            Array.Clear(data, 0, data.Length);
+        }
+    }
+
+    /// <summary>
+    /// Sets the latest weights on the mesh, every rendered frame so that they show as early as possible
+    /// </summary>
+    void Update()
+    {
+        if (live == IntPtr.Zero || character == null)
+        {
+            return;
+        }
+        if (character.Speaking)
+        {
+            // the clip animation moves the blendshapes, all are set again afterwards
+            if (uploaded != null)
+            {
+                for (int s = 0; s < uploaded.Length; s++)
+                {
+                    uploaded[s] = float.NaN;
+                }
+            }
+            return;
+        }
+        if (slotShapes == null && !MapBlendShapes())
+        {
+            return;
+        }
+        if (ls_live_weights(live, weights) == 0)
+        {
+            return;
+        }
+
+        Array.Clear(values, 0, values.Length);
+        for (int p = 0; p < weights.Length; p++)
+        {
+            if (weights[p] <= 0)
+            {
+                continue;
+            }
+
+            foreach (KeyValuePair<int, float> slot in phonemeSlots[p])
+            {
+                values[slot.Key] += weights[p] * slot.Value;
+            }
+        }
+
+        for (int s = 0; s < slotShapes.Length; s++)
+        {
+            float value = Mathf.Min(values[s], 100.0f);
+            if (value != uploaded[s])
+            {
+                character.characterMesh.SetBlendShapeWeight(slotShapes[s], value);
+                uploaded[s] = value;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Stops the microphone and releases the native estimator
+    /// </summary>
+    void OnDestroy()
+    {
+        if (Microphone.IsRecording(string.IsNullOrEmpty(device) ? null : device))
+        {
+            Microphone.End(string.IsNullOrEmpty(device) ? null : device);
+        }
+
+        lock (liveLock)
+        {
+            if (live != IntPtr.Zero)
+            {
+                int overruns = ls_live_overruns(live);
+                if (overruns > 0)
+                {
+                    Debug.Log("Live lip sync dropped " + overruns + " samples");
+                }
+                ls_live_delete(live);
+                live = IntPtr.Zero;
+            }
+        }
+    }
+}
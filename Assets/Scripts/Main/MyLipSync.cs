@@ -106,6 +106,7 @@ public class MyLipSync : MonoBehaviour {
     [Header("Animation Parameters")]
     public CurveMode curve;
     public bool considerFrequency;
+    public bool dominanceCoarticulation; // dominance-function blending of neighbouring visemes, needs a VisemeSolver
     [Range(0.0f, 1.0f)]
     public float vowelOverVowel;
     [Range(0.0f, 1.0f)]
@@ -116,6 +117,13 @@ public class MyLipSync : MonoBehaviour {
     public float consonantOverVowel;
     public float onsetThreshold = 0.05f;
 
+    [Header("Baked Animation")]
+    public bool useBakedTrack; // play <Character>-<clip>.track written by viseme_baker
+    VisemeTrack bakedTrack;
+    VisemeSolver visemeSolver; // batched animation of all characters, if present in the scene
+    int solverId = -1;
+    float solverTime = -1;
+
     // Curve Information
     public List<PhonemeInformation> indexInformation;
     public List<GraphInfo> graphInformation;
@@ -146,9 +154,24 @@ public class MyLipSync : MonoBehaviour {
         // check readMode
         if (readMode.Equals(ReadMode.XML))
         {
-            PhonemeBlendShapeMapping();
-            DiphoneMapping();
-            //EmotionBlendShapeMapping();
+            // compiled mappings, shared by all instances of the character
+            string character = characterMesh.transform.root.name;
+            RigTable rig = RigTable.Get(character,
+                PathManager.GetXMLDataPath(character + "-phonemeMapping.xml"),
+                PathManager.GetXMLDataPath(character + "-diphoneMapping.xml"),
+                PathManager.GetXMLDataPath(character + "-emotionMapping.xml"));
+            if (rig != null)
+            {
+                phonemeBlendShapes = rig.PhonemeBlendShapes(blendShapes);
+                diphonePhonemes = rig.Diphones;
+                //emotionBlendShapes = rig.EmotionBlendShapes(blendShapes);
+            }
+            else
+            {
+                PhonemeBlendShapeMapping();
+                DiphoneMapping();
+                //EmotionBlendShapeMapping();
+            }
         }
         else
         {
@@ -196,6 +219,22 @@ public class MyLipSync : MonoBehaviour {
         currentAlveorals = new List<PhonemeInformation>();
         SetCurrentAlveoral(new PhonemeInformation(0, 0, Phoneme.Rest));
 
+        // batched animation
+        visemeSolver = (VisemeSolver)FindObjectOfType(typeof(VisemeSolver));
+        if (visemeSolver != null)
+        {
+            solverId = visemeSolver.Register(this);
+            if (solverId >= 0)
+            {
+                visemeSolver.SetCurve(solverId, curve);
+                visemeSolver.SetDominance(solverId, dominanceCoarticulation);
+            }
+            else if (dominanceCoarticulation)
+            {
+                Debug.Log("Dominance coarticulation needs the native viseme solver, animating with rise and decay");
+            }
+        }
+
         // testing
         indexInformation = new List<PhonemeInformation>();
         graphInformation = new List<GraphInfo>();
@@ -223,6 +262,12 @@ public class MyLipSync : MonoBehaviour {
 
         if (audioMode.Equals(AudioMode.CereVoice))
         {
+            // received through shared memory, nothing to load
+            if (TextToSpeechProcess.synthesizedClip != null)
+            {
+                PlayClip(TextToSpeechProcess.synthesizedClip);
+                return;
+            }
             audioUrl = PathManager.GetAudioPath("audio.wav");
         }
         else
@@ -249,7 +294,16 @@ public class MyLipSync : MonoBehaviour {
             yield break;
         }
 
-        audio.clip = audioRequest.GetAudioClip(false, false, AudioType.WAV);
+        PlayClip(audioRequest.GetAudioClip(false, false, AudioType.WAV));
+    }
+
+    /// <summary>
+    /// Plays a loaded clip with the baked and solver tracks of the character
+    /// </summary>
+    /// <param name="clip"></param>
+    void PlayClip(AudioClip clip)
+    {
+        audio.clip = clip;
 
         // change source to speaker
         if (String.IsNullOrEmpty(audio.clip.name))
@@ -261,49 +315,165 @@ public class MyLipSync : MonoBehaviour {
             audioSource = Source.Listener;
         }
 
+        LoadBakedTrack();
+        LoadSolverTracks();
         audio.PlayScheduled(0);
     }
 
+    /// <summary>
+    /// Loads the baked viseme tracks of the character for the playing clip, if enabled and present.
+    /// Tracks are named after the clip, <Character>-visemes.track for the synthesized one
+    /// </summary>
+    void LoadBakedTrack()
+    {
+        bakedTrack = null;
+        if (!useBakedTrack)
+        {
+            return;
+        }
+
+        string clipName = String.IsNullOrEmpty(audio.clip.name) ? "visemes" : audio.clip.name;
+        string trackUrl = PathManager.GetDataPath(characterMesh.transform.root.name + "-" + clipName + ".track");
+        if (!File.Exists(trackUrl))
+        {
+            Debug.Log("No baked track is present for " + characterMesh.transform.root.name + " and " + clipName + ", animating at runtime");
+            return;
+        }
+
+        try
+        {
+            bakedTrack = new VisemeTrack(trackUrl);
+        }
+        catch (Exception e)
+        {
+            Debug.Log(e);
+            return;
+        }
+
+        // a track baked from another utterance would animate the wrong phonemes
+        if (Mathf.Abs(bakedTrack.Duration - audio.clip.length) > Mathf.Max(bakedTrack.Interval, 0.02f))
+        {
+            Debug.Log("Baked track " + trackUrl + " lasts " + bakedTrack.Duration + " s, the clip " + audio.clip.length + " s, animating at runtime");
+            bakedTrack = null;
+        }
+    }
+
+    /// <summary>
+    /// Hands the phoneme timings and the pitch and intensity statistics to the VisemeSolver,
+    /// if the character is registered with one
+    /// </summary>
+    void LoadSolverTracks()
+    {
+        if (solverId < 0)
+        {
+            return;
+        }
+
+        if (considerFrequency)
+        {
+            List<float>[] series = { vowelPitchPerWindow, consonantPitchPerWindow, vowelIntensityPerWindow, consonantIntensityPerWindow };
+            int count = 0;
+            foreach (List<float> windows in series)
+            {
+                if (windows != null)
+                {
+                    count = Math.Max(count, windows.Count);
+                }
+            }
+
+            float[] means = new float[series.Length * count];
+            for (int k = 0; k < series.Length; k++)
+            {
+                if (series[k] != null)
+                {
+                    series[k].CopyTo(means, k * count);
+                }
+            }
+
+            float[] ranges =
+            {
+                minVowelPitch, meanVowelPitch, maxVowelPitch,
+                minConsonantPitch, meanConsonantPitch, maxConsonantPitch,
+                minVowelIntensity, meanVowelIntensity, maxVowelIntensity,
+                minConsonantIntensity, meanConsonantIntensity, maxConsonantIntensity
+            };
+            visemeSolver.SetProsody(solverId, slidingWindow, ranges, vowelPitchRatio, consonantPitchRatio, means, count);
+        }
+
+        visemeSolver.SetTracks(solverId, phonemeInformation, alveoralInformation, considerFrequency);
+    }
+
+    /// <summary>
+    /// Playback time the VisemeSolver evaluates the character at, negative when it is not animated by the solver
+    /// </summary>
+    public float SolverTime
+    {
+        get { return solverTime; }
+    }
+
+    /// <summary>
+    /// True while the character plays a clip, LiveLipSync leaves the mesh to it meanwhile
+    /// </summary>
+    public bool Speaking
+    {
+        get { return audioSource.Equals(Source.Speaker); }
+    }
+
     /// <summary>
     /// Fixed Update function which animates the character as long as the audio is playing
     /// </summary>
     void FixedUpdate()
     {
+        solverTime = -1;
         if (audio.clip != null && audioSource.Equals(Source.Speaker))
         {
             if (audio.isPlaying)
             {
                 // Audio timer
                 audioElapsedTimer += Time.fixedDeltaTime;
-                AnimatePhoneme(audioElapsedTimer);
-                AnimateAlveoral(audioElapsedTimer);
 
-                foreach (PhonemeInformation pi in currentPhonemes)
+                if (bakedTrack != null)
                 {
-                    if (!pi.apex)
-                    {
-                        PhonemeRise(pi, audioElapsedTimer);
-                    }
-                    else
-                    {
-                        PhonemeDecay(pi, audioElapsedTimer);
-                    }
+                    // baked animation, only the tracks are sampled
+                    bakedTrack.Apply(characterMesh, audioElapsedTimer);
                 }
-
-                // Alveorals animation process 
-                foreach (PhonemeInformation pi in currentAlveorals)
+                else if (solverId >= 0)
+                {
+                    // evaluated with the other characters by the VisemeSolver, which runs after this update
+                    solverTime = audioElapsedTimer;
+                }
+                else
                 {
-                    if (!pi.apex)
+                    AnimatePhoneme(audioElapsedTimer);
+                    AnimateAlveoral(audioElapsedTimer);
+
+                    foreach (PhonemeInformation pi in currentPhonemes)
                     {
-                        PhonemeRise(pi, audioElapsedTimer);
+                        if (!pi.apex)
+                        {
+                            PhonemeRise(pi, audioElapsedTimer);
+                        }
+                        else
+                        {
+                            PhonemeDecay(pi, audioElapsedTimer);
+                        }
                     }
-                    else
+
+                    // Alveorals animation process 
+                    foreach (PhonemeInformation pi in currentAlveorals)
                     {
-                        PhonemeDecay(pi, audioElapsedTimer);
+                        if (!pi.apex)
+                        {
+                            PhonemeRise(pi, audioElapsedTimer);
+                        }
+                        else
+                        {
+                            PhonemeDecay(pi, audioElapsedTimer);
+                        }
                     }
-                }
 
-                RefreshCurrentPhonemes();
+                    RefreshCurrentPhonemes();
+                }
                 //RefreshGraphInformation();
 
                 // Pitch and Intensity
@@ -332,6 +502,16 @@ public class MyLipSync : MonoBehaviour {
                     pi.animationEnded = false;
                 }
 
+                if (bakedTrack != null)
+                {
+                    bakedTrack.Reset();
+                }
+
+                if (solverId >= 0)
+                {
+                    visemeSolver.Reset(solverId);
+                }
+
                 // change source to listener
                 audioSource = Source.Listener;
 
@@ -689,6 +869,50 @@ public class MyLipSync : MonoBehaviour {
         AddCurveInformation();
     }
 
+    /// <summary>
+    /// Receives the phonemes of a newly synthesized spurt from PhonemeAnalyzer.
+    /// Phonemes before index are already present and only have their ending time
+    /// updated, so the state of a phoneme being animated is kept. The solver tracks are
+    /// uploaded once the utterance is complete, by SetPhonemeProsody and PlayClip
+    /// </summary>
+    /// <param name="phonemes">phonemes from index onwards</param>
+    /// <param name="index">index of the first phoneme in phonemeInformation</param>
+    public void AppendPhonemeTimings(List<PhonemeInformation> phonemes, int index)
+    {
+        for (int i = 0; i < phonemes.Count; i++)
+        {
+            if (index + i < phonemeInformation.Count)
+            {
+                phonemeInformation[index + i].endingInterval = phonemes[i].endingInterval;
+            }
+            else
+            {
+                phonemeInformation.Add(phonemes[i]);
+            }
+        }
+
+        if (currentPhoneme == null && phonemeInformation.Count > 0)
+        {
+            currentPhoneme = phonemeInformation[0];
+        }
+    }
+
+    /// <summary>
+    /// Copies the mean pitch and intensity of each phoneme, computed once the whole
+    /// utterance has been received, and reloads the solver tracks with them
+    /// </summary>
+    /// <param name="phonemes">same order as phonemeInformation</param>
+    public void SetPhonemeProsody(List<PhonemeInformation> phonemes)
+    {
+        for (int i = 0; i < phonemes.Count && i < phonemeInformation.Count; i++)
+        {
+            phonemeInformation[i].meanPitch = phonemes[i].meanPitch;
+            phonemeInformation[i].meanIntensity = phonemes[i].meanIntensity;
+        }
+
+        LoadSolverTracks();
+    }
+
     /// <summary>
     /// Used for debugging
     /// </summary>
@@ -717,6 +941,11 @@ public class MyLipSync : MonoBehaviour {
         {
             curve = CurveMode.Exponential;
         }
+
+        if (solverId >= 0)
+        {
+            visemeSolver.SetCurve(solverId, curve);
+        }
     }
 
     /// <summary>
@@ -728,6 +957,7 @@ public class MyLipSync : MonoBehaviour {
     public void SetFrequencyToggle(bool toggle)
     {
         considerFrequency = toggle;
+        LoadSolverTracks();
     }
 
     /// <summary>
@@ -0,0 +1,281 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using UnityEngine;
+
+///---------------------------------------------------------------------
+///   Class:        VisemeSolver.cs
+///   Description:  Evaluates the visemes of every registered character in
+///                 one native call per tick (native lipsync library, see
+///                 StreamingAssets/LipSync/lipsync_solver.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Runs after the MyLipSync components have advanced
+///                 their audio timers
+///---------------------------------------------------------------------
+
+[DefaultExecutionOrder(100)]
+public class VisemeSolver : MonoBehaviour
+{
+    [Tooltip("Threads evaluating a tick, 0 for one per processor")]
+    public int threads = 0;
+
+    IntPtr solver = IntPtr.Zero;
+    List<MyLipSync> characters = new List<MyLipSync>();
+    List<int[]> slotShapes = new List<int[]>(); // mesh blendshape of each slot, per character
+    List<int> slotOffsets = new List<int>();
+    float[] times = new float[0];
+    float[] weights = new float[0];
+    float[] uploaded = new float[0]; // weights last set on the meshes
+
+    [DllImport("lipsync")]
+    static extern IntPtr ls_solver_new(int threads);
+
+    [DllImport("lipsync")]
+    static extern void ls_solver_delete(IntPtr solver);
+
+    [DllImport("lipsync")]
+    static extern int ls_solver_add_character(IntPtr solver, int[] counts, int[] shapes, float[] weights);
+
+    [DllImport("lipsync")]
+    static extern int ls_solver_slots(IntPtr solver, int character, int[] shapes);
+
+    [DllImport("lipsync")]
+    static extern int ls_solver_slot_offset(IntPtr solver, int character);
+
+    [DllImport("lipsync")]
+    static extern int ls_solver_weight_count(IntPtr solver);
+
+    [DllImport("lipsync")]
+    static extern void ls_solver_set_curve(IntPtr solver, int character, int quadratic);
+
+    [DllImport("lipsync")]
+    static extern void ls_solver_set_model(IntPtr solver, int character, int model);
+
+    [DllImport("lipsync")]
+    static extern void ls_solver_set_prosody(IntPtr solver, int character, float windowMs, float[] ranges,
+                                             float vowelPitchRatio, float consonantPitchRatio, float[] windows, int count);
+
+    [DllImport("lipsync")]
+    static extern void ls_solver_set_track(IntPtr solver, int character, int track, int[] phonemes, float[] start, float[] end,
+                                           float[] meanPitch, float[] meanIntensity, int count, int weighted);
+
+    [DllImport("lipsync")]
+    static extern void ls_solver_reset(IntPtr solver, int character);
+
+    [DllImport("lipsync")]
+    static extern int ls_solver_step(IntPtr solver, float[] times, float[] weights);
+
+    /// <summary>
+    /// Creates the native solver, the characters animate themselves if the library is not available
+    /// </summary>
+    void Awake()
+    {
+        try
+        {
+            solver = ls_solver_new(threads);
+        }
+        catch (DllNotFoundException)
+        {
+            Debug.Log("lipsync library not found, characters are animated individually");
+        }
+        catch (EntryPointNotFoundException)
+        {
+            Debug.Log("lipsync library has no viseme solver, characters are animated individually");
+        }
+    }
+
+    /// <summary>
+    /// Adds a character with its phoneme to blendshape mapping.
+    /// Returns its id, or -1 if the solver is not available
+    /// </summary>
+    /// <param name="character"></param>
+    /// <returns></returns>
+    public int Register(MyLipSync character)
+    {
+        if (solver == IntPtr.Zero || character.phonemeBlendShapes == null)
+        {
+            return -1;
+        }
+
+        int phonemeCount = Enum.GetValues(typeof(Phoneme)).Length;
+        int[] counts = new int[phonemeCount];
+        List<int> shapes = new List<int>();
+        List<float> targets = new List<float>();
+        for (int p = 0; p < phonemeCount; p++)
+        {
+            List<BlendShape> blendShapes;
+            if (!character.phonemeBlendShapes.TryGetValue((Phoneme)p, out blendShapes))
+            {
+                counts[p] = -1;
+                continue;
+            }
+
+            counts[p] = blendShapes.Count;
+            foreach (BlendShape bs in blendShapes)
+            {
+                shapes.Add(bs.index);
+                targets.Add(bs.weight);
+            }
+        }
+
+        int id = ls_solver_add_character(solver, counts, shapes.ToArray(), targets.ToArray());
+        int[] slots = new int[ls_solver_slots(solver, id, null)];
+        ls_solver_slots(solver, id, slots);
+        characters.Add(character);
+        slotShapes.Add(slots);
+        slotOffsets.Add(ls_solver_slot_offset(solver, id));
+
+        times = new float[characters.Count];
+        weights = new float[ls_solver_weight_count(solver)];
+        float[] previous = uploaded;
+        uploaded = new float[weights.Length];
+        Array.Copy(previous, uploaded, previous.Length);
+        for (int i = previous.Length; i < uploaded.Length; i++)
+        {
+            uploaded[i] = float.NaN; // first weights of the character are always set
+        }
+
+        return id;
+    }
+
+    /// <summary>
+    /// Loads the phonemes and alveorals of a character. The playback position is kept,
+    /// so phonemes appended while the audio plays are picked up
+    /// </summary>
+    /// <param name="id"></param>
+    /// <param name="phonemes"></param>
+    /// <param name="alveorals"></param>
+    /// <param name="weighted">scale the targets with pitch and intensity, as considerFrequency</param>
+    public void SetTracks(int id, List<PhonemeInformation> phonemes, List<PhonemeInformation> alveorals, bool weighted)
+    {
+        SetTrack(id, 0, phonemes, weighted);
+        SetTrack(id, 1, alveorals, weighted);
+    }
+
+    /// <summary>
+    /// Loads one track of a character
+    /// </summary>
+    /// <param name="id"></param>
+    /// <param name="track"></param>
+    /// <param name="phonemes"></param>
+    /// <param name="weighted"></param>
+    void SetTrack(int id, int track, List<PhonemeInformation> phonemes, bool weighted)
+    {
+        int count = phonemes != null ? phonemes.Count : 0;
+        int[] text = new int[count];
+        float[] start = new float[count];
+        float[] end = new float[count];
+        float[] meanPitch = new float[count];
+        float[] meanIntensity = new float[count];
+        for (int i = 0; i < count; i++)
+        {
+            PhonemeInformation pi = phonemes[i];
+            text[i] = (int)(pi.text ?? Phoneme.Rest);
+            start[i] = pi.startingInterval;
+            end[i] = pi.endingInterval;
+            meanPitch[i] = pi.meanPitch;
+            meanIntensity[i] = pi.meanIntensity;
+        }
+
+        ls_solver_set_track(solver, id, track, text, start, end, meanPitch, meanIntensity, count, weighted ? 1 : 0);
+    }
+
+    /// <summary>
+    /// Sets the pitch and intensity statistics the targets of the next loaded tracks are scaled with
+    /// </summary>
+    /// <param name="id"></param>
+    /// <param name="windowMs"></param>
+    /// <param name="ranges">min, mean and max of vowel pitch, consonant pitch, vowel intensity and consonant intensity</param>
+    /// <param name="vowelPitchRatio"></param>
+    /// <param name="consonantPitchRatio"></param>
+    /// <param name="windows">window means of the four series, count each</param>
+    /// <param name="count"></param>
+    public void SetProsody(int id, float windowMs, float[] ranges, float vowelPitchRatio, float consonantPitchRatio, float[] windows, int count)
+    {
+        ls_solver_set_prosody(solver, id, windowMs, ranges, vowelPitchRatio, consonantPitchRatio, windows, count);
+    }
+
+    /// <summary>
+    /// Sets the easing of a character, as MyLipSync.CurveMode
+    /// </summary>
+    /// <param name="id"></param>
+    /// <param name="curve"></param>
+    public void SetCurve(int id, MyLipSync.CurveMode curve)
+    {
+        ls_solver_set_curve(solver, id, curve == MyLipSync.CurveMode.Quadratic ? 1 : 0);
+    }
+
+    /// <summary>
+    /// Blends the visemes of a character with dominance functions (see lipsync_coartic.h)
+    /// instead of the rise and decay of MyLipSync
+    /// </summary>
+    /// <param name="id"></param>
+    /// <param name="dominance"></param>
+    public void SetDominance(int id, bool dominance)
+    {
+        ls_solver_set_model(solver, id, dominance ? 1 : 0);
+    }
+
+    /// <summary>
+    /// Rewinds a character to the start of its tracks
+    /// </summary>
+    /// <param name="id"></param>
+    public void Reset(int id)
+    {
+        ls_solver_reset(solver, id);
+    }
+
+    /// <summary>
+    /// Evaluates every playing character and sets the weights that changed on the meshes
+    /// </summary>
+    void FixedUpdate()
+    {
+        if (solver == IntPtr.Zero || characters.Count == 0)
+        {
+            return;
+        }
+
+        for (int c = 0; c < characters.Count; c++)
+        {
+            times[c] = characters[c] != null ? characters[c].SolverTime : -1;
+        }
+
+        if (ls_solver_step(solver, times, weights) == 0)
+        {
+            return;
+        }
+
+        for (int c = 0; c < characters.Count; c++)
+        {
+            if (times[c] < 0)
+            {
+                continue;
+            }
+
+            SkinnedMeshRenderer characterMesh = characters[c].characterMesh;
+            int[] slots = slotShapes[c];
+            int offset = slotOffsets[c];
+            for (int s = 0; s < slots.Length; s++)
+            {
+                // Unity has no call for several blendshapes, the unchanged ones are skipped instead
+                if (weights[offset + s] != uploaded[offset + s])
+                {
+                    characterMesh.SetBlendShapeWeight(slots[s], weights[offset + s]);
+                    uploaded[offset + s] = weights[offset + s];
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Releases the native solver
+    /// </summary>
+    void OnDestroy()
+    {
+        if (solver != IntPtr.Zero)
+        {
+            ls_solver_delete(solver);
+            solver = IntPtr.Zero;
+        }
+    }
+}
@@ -27,12 +27,15 @@ public class PhonemeAnalyzer
     public static List<WordInformation> words;
     public List<WordInformation> generatedWords;
     public AudioMode audioMode;
-    Dictionary<Phoneme, List<Phoneme>> diphonePhonemes;
+    static Dictionary<Phoneme, List<Phoneme>> diphonePhonemes; // read once, see DiphoneMapping
     ReadMode readMode;
     private MyLipSync[] lipSyncComponents;
     CoarticulationEnhancement coarticulation;
     PhonemeReader phonemeReader;
     AudioClip currentClip;
+    List<PhonemeInformation> streamedPhonemes; // merged phonemes of the utterance being synthesized
+    Dictionary<float, float> streamedFrequencies; // F0 and loudness frames of the utterance, keyed as the openSMILE csv
+    Dictionary<float, float> streamedDecibels;
 
     /// <summary>
     /// Constructor
@@ -58,12 +61,158 @@ public class PhonemeAnalyzer
     /// <param name="isPraat"></param>
     /// <param name="currentRecording"></param>
     public void ManagePhonemeTimings(bool isPraat, string currentRecording)
+    {
+        List<PhonemeInformation> phonemeInformation;
+        string timelinePath = PathManager.GetDataPath("phonemes.tl");
+
+        if (File.Exists(timelinePath))
+        {
+            // binary timeline, timings are absolute and sample-accurate
+            TimelineReader timeline = new TimelineReader(timelinePath);
+            phonemeInformation = timeline.ReadPhonemeTimings();
+            words = timeline.ReadWordTimings();
+        }
+        else
+        {
+            phonemeInformation = ReadPhonemeOutput(PathManager.GetDataPath("phonemes.txt"));
+        }
+
+        DiphoneMapping();
+        
+        if (audioMode.Equals(AudioMode.Natural))
+        {
+            if (isPraat)
+            {
+                generatedWords = ReadWordTimingsPraat(currentRecording);
+            }
+            else
+            {
+                generatedWords = ReadWordTimingsWatson(currentRecording);
+            }
+
+            AdjustPhonemeTimings(phonemeInformation);
+
+        }
+
+        phonemeInformation = coarticulation.AddDiphoneVisemes(phonemeInformation, diphonePhonemes);
+        phonemeInformation = coarticulation.RemoveDuplicates(phonemeInformation);
+
+        foreach (MyLipSync mls in lipSyncComponents)
+        {
+            mls.wordInfo = words;
+            mls.generatedWordInfo = generatedWords;
+            Debug.Log(mls.generatedWordInfo);
+
+            // each component animates its own copy of the phonemes
+            mls.phonemeInformation = phonemeReader.CopyPhonemeTimings(phonemeInformation);
+
+            if (phonemeInformation.Count > 0)
+            {
+                mls.currentPhoneme = phonemeInformation[0];
+            }
+            else
+            {
+                mls.currentPhoneme = null;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Starts the incremental analysis of a synthesized utterance. The lip sync
+    /// components are cleared and then receive each spurt through AppendPhonemeTimings
+    /// </summary>
+    public void BeginUtterance()
+    {
+        DiphoneMapping();
+        streamedPhonemes = new List<PhonemeInformation>();
+        streamedFrequencies = new Dictionary<float, float>();
+        streamedDecibels = new Dictionary<float, float>();
+        words = new List<WordInformation>();
+
+        foreach (MyLipSync mls in lipSyncComponents)
+        {
+            mls.wordInfo = words;
+            mls.generatedWordInfo = generatedWords;
+            mls.phonemeInformation = new List<PhonemeInformation>();
+            mls.currentPhoneme = null;
+        }
+    }
+
+    /// <summary>
+    /// Analyzes one synthesized spurt. Timings must already be offset to the start
+    /// of the utterance; only the new phonemes and the boundary with the previous
+    /// spurt are processed
+    /// </summary>
+    /// <param name="phonemes"></param>
+    /// <param name="spurtWords"></param>
+    public void AppendPhonemeTimings(List<PhonemeInformation> phonemes, List<WordInformation> spurtWords)
+    {
+        words.AddRange(spurtWords);
+
+        phonemes = coarticulation.AddDiphoneVisemes(phonemes, diphonePhonemes);
+        int firstChanged = coarticulation.AppendDistinct(streamedPhonemes, phonemes);
+        if (firstChanged == streamedPhonemes.Count)
+        {
+            return;
+        }
+
+        List<PhonemeInformation> changed = streamedPhonemes.GetRange(firstChanged, streamedPhonemes.Count - firstChanged);
+        foreach (MyLipSync mls in lipSyncComponents)
+        {
+            // each component animates its own copy of the phonemes
+            mls.AppendPhonemeTimings(phonemeReader.CopyPhonemeTimings(changed), firstChanged);
+        }
+    }
+
+    /// <summary>
+    /// Collects the F0 and loudness frames of one synthesized spurt
+    /// </summary>
+    /// <param name="frames"></param>
+    public void AppendEnvelope(List<ProsodyComponent> frames)
+    {
+        foreach (ProsodyComponent frame in frames)
+        {
+            float timestamp = (float)Math.Round(frame.timestamp, 2);
+            if (!streamedFrequencies.ContainsKey(timestamp))
+            {
+                streamedFrequencies.Add(timestamp, frame.F0);
+                streamedDecibels.Add(timestamp, frame.loudness);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Ends the utterance: the pitch and intensity weighting of the lip sync components
+    /// is computed from the frames collected with AppendEnvelope, without analyzing the
+    /// audio again. Nothing is done if tts_callback sent no frames
+    /// </summary>
+    /// <param name="slidingWindow">milliseconds</param>
+    public void EndUtterance(float slidingWindow)
+    {
+        if (streamedFrequencies.Count == 0)
+        {
+            return;
+        }
+
+        new SpeechAnalysis("", streamedPhonemes, slidingWindow).AnalyzeEnvelope(streamedFrequencies, streamedDecibels);
+        foreach (MyLipSync mls in lipSyncComponents)
+        {
+            mls.SetPhonemeProsody(streamedPhonemes);
+        }
+    }
+
+    /// <summary>
+    /// Parse the text output of tts_callback, used when no timeline was written
+    /// </summary>
+    /// <param name="file"></param>
+    /// <returns></returns>
+    List<PhonemeInformation> ReadPhonemeOutput(string file)
     {
         List<PhonemeInformation> phonemeInformation = new List<PhonemeInformation>();
         words = new List<WordInformation>();
         float partAudioDuration = 0;
-        
-        using (StreamReader sr = new StreamReader(PathManager.GetDataPath("phonemes.txt")))
+
+        using (StreamReader sr = new StreamReader(file))
         {
             string line;
             int audioParts = 0;
@@ -126,53 +275,7 @@ public class PhonemeAnalyzer
             sr.Close();
         }
 
-        DiphoneMapping();
-        
-        if (audioMode.Equals(AudioMode.Natural))
-        {
-            if (isPraat)
-            {
-                generatedWords = ReadWordTimingsPraat(currentRecording);
-            }
-            else
-            {
-                generatedWords = ReadWordTimingsWatson(currentRecording);
-            }
-
-            AdjustPhonemeTimings(phonemeInformation);
-
-        }
-
-        phonemeInformation = coarticulation.AddDiphoneVisemes(phonemeInformation, diphonePhonemes);
-        phonemeInformation = coarticulation.RemoveDuplicates(phonemeInformation);
-
-        using (StreamWriter sw = new StreamWriter(PathManager.GetDataPath("phonemesParsed.txt")))
-        {
-            foreach (PhonemeInformation pi in phonemeInformation)
-            {
-                sw.WriteLine(pi.text + " " + pi.startingInterval + " " + pi.endingInterval + " " + pi.apex + " " + pi.influence);
-            }
-
-            sw.Close();
-        }
-
-        foreach (MyLipSync mls in lipSyncComponents)
-        {
-            mls.wordInfo = words;
-            mls.generatedWordInfo = generatedWords;
-            Debug.Log(mls.generatedWordInfo);
-
-            mls.phonemeInformation = phonemeReader.ReadPhonemeTimings(PathManager.GetDataPath("phonemesParsed.txt"));
-
-            if (phonemeInformation.Count > 0)
-            {
-                mls.currentPhoneme = phonemeInformation[0];
-            }
-            else
-            {
-                mls.currentPhoneme = null;
-            }
-        }
+        return phonemeInformation;
     }
 
     /// <summary>
@@ -320,7 +423,18 @@ public class PhonemeAnalyzer
     /// </summary>
     void DiphoneMapping()
     {
-        diphonePhonemes = new Dictionary<Phoneme, List<Phoneme>>();
+        if (diphonePhonemes != null)
+        {
+            return;
+        }
+        RigTable rig = RigTable.Get("diphoneMapping", PathManager.GetXMLDataPath("diphoneMapping.xml"));
+        if (rig != null)
+        {
+            diphonePhonemes = rig.Diphones;
+            return;
+        }
+
+        Dictionary<Phoneme, List<Phoneme>> mapping = new Dictionary<Phoneme, List<Phoneme>>();
         Phoneme diphone;
 
         // read the XML configuration file
@@ -329,14 +443,15 @@ public class PhonemeAnalyzer
         foreach (var attr in attributes)
         {
             diphone = (Phoneme)Enum.Parse(typeof(Phoneme), attr.Element("Diphone").Value);
-            diphonePhonemes.Add(diphone, new List<Phoneme>());
+            mapping.Add(diphone, new List<Phoneme>());
 
             var phonemes = attr.Elements("Phoneme");
             foreach (var p in phonemes)
             {
-                diphonePhonemes[diphone].Add((Phoneme)Enum.Parse(typeof(Phoneme), p.Element("Type").Value));
+                mapping[diphone].Add((Phoneme)Enum.Parse(typeof(Phoneme), p.Element("Type").Value));
             }
         }
+        diphonePhonemes = mapping;
     }
 
     /// <summary>
@@ -38,5 +38,30 @@ public class PhonemeReader
         return phonemeInfo;
     }
 
+    /// <summary>
+    /// Copy phoneme timings in memory, keeping what ReadPhonemeTimings reads back
+    /// </summary>
+    /// <param name="phonemes"></param>
+    /// <returns></returns>
+    public List<PhonemeInformation> CopyPhonemeTimings(List<PhonemeInformation> phonemes)
+    {
+        List<PhonemeInformation> phonemeInfo = new List<PhonemeInformation>(phonemes.Count);
+
+        foreach (PhonemeInformation source in phonemes)
+        {
+            PhonemeInformation pi = new PhonemeInformation(source.startingInterval, source.endingInterval, source.text.GetValueOrDefault(Phoneme.Rest))
+            {
+                startingInterval = source.startingInterval,
+                endingInterval = source.endingInterval,
+                text = source.text,
+                apex = source.apex,
+                influence = source.influence
+            };
+            phonemeInfo.Add(pi);
+        }
+
+        return phonemeInfo;
+    }
+
 
 }
@@ -0,0 +1,187 @@
+﻿using System;
+using System.Collections;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+using UnityEngine;
+
+///-----------------------------------------------------------------
+///   Class:        TimelineReader.cs
+///   Description:  Reads the binary phoneme/word timeline written
+///                 by tts_callback -t (see tts_timeline.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Timeline Reader
+///-----------------------------------------------------------------
+
+public class TimelineReader
+{
+    public const int PhoneRecord = 0;
+    public const int WordRecord = 1;
+    public const int MarkRecord = 2;
+
+    const int HeaderSize = 32;
+    const int RecordSize = 12;
+    const int Version = 1;
+
+    byte[] data;
+    int recordsOffset;
+    string[] symbols;
+    Phoneme?[] symbolPhonemes;
+
+    public int SampleRate { get; private set; }
+    public int RecordCount { get; private set; }
+    public uint TotalSamples { get; private set; }
+
+    /// <summary>
+    /// Reads the whole timeline file in a single read and validates its header
+    /// </summary>
+    /// <param name="file"></param>
+    public TimelineReader(string file)
+    {
+        // .NET 3.5 has no memory-mapped files; one bulk read is the closest
+        data = File.ReadAllBytes(file);
+
+        if (data.Length < HeaderSize || Encoding.ASCII.GetString(data, 0, 4) != "CPTL")
+        {
+            throw new InvalidDataException("Not a timeline file: " + file);
+        }
+        if (BitConverter.ToUInt16(data, 4) != Version || BitConverter.ToUInt16(data, 6) != RecordSize)
+        {
+            throw new InvalidDataException("Unsupported timeline version: " + file);
+        }
+
+        SampleRate = (int)BitConverter.ToUInt32(data, 8);
+        uint recordCount = BitConverter.ToUInt32(data, 12);
+        uint symbolCount = BitConverter.ToUInt32(data, 16);
+        uint stringsSize = BitConverter.ToUInt32(data, 20);
+        TotalSamples = BitConverter.ToUInt32(data, 24);
+
+        // the same checks as tts_timeline_map, in long so a bad count cannot wrap
+        long offsetsOffset = HeaderSize + (long)recordCount * RecordSize;
+        long stringsOffset = offsetsOffset + (long)symbolCount * 4;
+        if (SampleRate == 0 || stringsOffset + stringsSize > data.Length)
+        {
+            throw new InvalidDataException("Truncated timeline file: " + file);
+        }
+        recordsOffset = HeaderSize;
+        RecordCount = (int)recordCount;
+
+        // names are interned, so each one is decoded and mapped only once
+        int stringsEnd = (int)(stringsOffset + stringsSize);
+        symbols = new string[symbolCount];
+        symbolPhonemes = new Phoneme?[symbolCount];
+        for (int i = 0; i < symbolCount; i++)
+        {
+            uint offset = BitConverter.ToUInt32(data, (int)offsetsOffset + i * 4);
+            if (offset >= stringsSize)
+            {
+                throw new InvalidDataException("Symbol " + i + " outside the strings of timeline file: " + file);
+            }
+            int start = (int)stringsOffset + (int)offset;
+            int end = start;
+            while (end < stringsEnd && data[end] != 0)
+            {
+                end++;
+            }
+            if (end == stringsEnd)
+            {
+                throw new InvalidDataException("Unterminated symbol " + i + " in timeline file: " + file);
+            }
+            symbols[i] = Encoding.UTF8.GetString(data, start, end - start);
+            symbolPhonemes[i] = PhonemeInformation.MapPhoneme(symbols[i]);
+        }
+
+        // GetName and ReadPhonemeTimings index the symbols without checking
+        for (int i = 0; i < RecordCount; i++)
+        {
+            if (BitConverter.ToUInt16(data, recordsOffset + i * RecordSize + 2) >= symbolCount)
+            {
+                throw new InvalidDataException("Bad symbol index in record " + i + " of timeline file: " + file);
+            }
+        }
+    }
+
+    public int GetRecordType(int record)
+    {
+        return data[recordsOffset + record * RecordSize];
+    }
+
+    public string GetName(int record)
+    {
+        return symbols[BitConverter.ToUInt16(data, recordsOffset + record * RecordSize + 2)];
+    }
+
+    public uint GetStartSample(int record)
+    {
+        return BitConverter.ToUInt32(data, recordsOffset + record * RecordSize + 4);
+    }
+
+    public uint GetEndSample(int record)
+    {
+        return BitConverter.ToUInt32(data, recordsOffset + record * RecordSize + 8);
+    }
+
+    public float GetStart(int record)
+    {
+        return (float)((double)GetStartSample(record) / SampleRate);
+    }
+
+    public float GetEnd(int record)
+    {
+        return (float)((double)GetEndSample(record) / SampleRate);
+    }
+
+    /// <summary>
+    /// Phoneme records of the timeline, in order, with exact timings
+    /// </summary>
+    /// <returns></returns>
+    public List<PhonemeInformation> ReadPhonemeTimings()
+    {
+        List<PhonemeInformation> phonemeInfo = new List<PhonemeInformation>();
+
+        for (int i = 0; i < RecordCount; i++)
+        {
+            if (GetRecordType(i) != PhoneRecord)
+            {
+                continue;
+            }
+
+            int symbol = BitConverter.ToUInt16(data, recordsOffset + i * RecordSize + 2);
+            PhonemeInformation pi;
+            if (symbolPhonemes[symbol].HasValue)
+            {
+                pi = new PhonemeInformation(0, 0, symbolPhonemes[symbol].Value);
+            }
+            else
+            {
+                pi = new PhonemeInformation(0, 0, symbols[symbol]);
+            }
+
+            // the constructors round to 2 decimals, keep the sample-accurate times
+            pi.startingInterval = GetStart(i);
+            pi.endingInterval = GetEnd(i);
+            phonemeInfo.Add(pi);
+        }
+
+        return phonemeInfo;
+    }
+
+    /// <summary>
+    /// Word records of the timeline, in order
+    /// </summary>
+    /// <returns></returns>
+    public List<WordInformation> ReadWordTimings()
+    {
+        List<WordInformation> words = new List<WordInformation>();
+
+        for (int i = 0; i < RecordCount; i++)
+        {
+            if (GetRecordType(i) == WordRecord)
+            {
+                words.Add(new WordInformation(GetStart(i), GetEnd(i), GetName(i)));
+            }
+        }
+
+        return words;
+    }
+}
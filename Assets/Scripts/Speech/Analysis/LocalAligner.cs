@@ -0,0 +1,113 @@
+﻿using System;
+using System.Diagnostics;
+using System.IO;
+using System.Runtime.InteropServices;
+
+///---------------------------------------------------------------------
+///   Class:        LocalAligner.cs
+///   Description:  Offline forced alignment of a clip to synthesized
+///                 speech of its transcript (native lipsync library, see
+///                 StreamingAssets/LipSync/lipsync_align.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Writes the same TextGrid tiers as MAUSService
+///---------------------------------------------------------------------
+
+public static class LocalAligner
+{
+    const string VoiceFile = "cerevoice_heather_3.2.0_48k.voice";
+
+    [DllImport("lipsync")]
+    static extern int ls_align_textgrid(string referenceWav, string referenceTimeline, string wavPath, string textgridPath, float band);
+
+    /// <summary>
+    /// Aligns the clip to its transcript and writes the TextGrid.
+    /// Returns false if the native library is not available or the reference cannot be synthesized,
+    /// in which case the caller falls back to MAUSService
+    /// </summary>
+    /// <param name="wavPath"></param>
+    /// <param name="transcriptPath"></param>
+    /// <param name="textgridPath"></param>
+    /// <returns></returns>
+    public static bool Align(string wavPath, string transcriptPath, string textgridPath)
+    {
+        string name = Path.GetFileNameWithoutExtension(wavPath);
+        string referenceWav = PathManager.GetCachePath("Alignment/" + name + ".wav");
+        string referenceTimeline = PathManager.GetCachePath("Alignment/" + name + ".tl");
+
+        if (!SynthesizeReference(transcriptPath, referenceWav, referenceTimeline))
+        {
+            return false;
+        }
+
+        int phones;
+        try
+        {
+            phones = ls_align_textgrid(referenceWav, referenceTimeline, wavPath, textgridPath, 0);
+        }
+        catch (DllNotFoundException)
+        {
+            return false;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return false;
+        }
+
+        return phones > 0;
+    }
+
+    /// <summary>
+    /// Synthesizes the transcript with tts_callback, unless the reference is newer than the transcript
+    /// </summary>
+    /// <param name="transcriptPath"></param>
+    /// <param name="referenceWav"></param>
+    /// <param name="referenceTimeline"></param>
+    /// <returns></returns>
+    static bool SynthesizeReference(string transcriptPath, string referenceWav, string referenceTimeline)
+    {
+        if (File.Exists(referenceWav) && File.Exists(referenceTimeline) &&
+            File.GetLastWriteTimeUtc(referenceTimeline) >= File.GetLastWriteTimeUtc(transcriptPath))
+        {
+            return true;
+        }
+
+        Directory.CreateDirectory(Path.GetDirectoryName(referenceWav));
+        string arguments = "-o \"" + referenceWav + "\" -t \"" + referenceTimeline + "\"" +
+                           " -c \"" + PathManager.GetCachePath("Synthesis") + "\"" +
+                           " \"" + PathManager.GetCereVoicePath(VoiceFile) + "\"" +
+                           " \"" + PathManager.GetCereVoicePath("license.lic") + "\"" +
+                           " \"" + transcriptPath + "\"";
+
+        try
+        {
+            var tts_callback = new Process
+            {
+                StartInfo = new ProcessStartInfo
+                {
+                    FileName = PathManager.GetCereVoicePath("tts_callback.exe"),
+                    Arguments = arguments,
+                    UseShellExecute = false,
+                    RedirectStandardOutput = true,
+                    CreateNoWindow = true,
+                    WindowStyle = ProcessWindowStyle.Hidden
+                }
+            };
+
+            tts_callback.Start();
+            // the timeline is written by tts_callback itself, only drain the remaining output
+            tts_callback.StandardOutput.ReadToEnd();
+            tts_callback.WaitForExit();
+            if (tts_callback.ExitCode != 0)
+            {
+                return false;
+            }
+        }
+        catch (Exception e)
+        {
+            UnityEngine.Debug.Log(e);
+            return false;
+        }
+
+        return File.Exists(referenceWav) && File.Exists(referenceTimeline);
+    }
+}
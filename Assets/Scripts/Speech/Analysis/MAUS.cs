@@ -43,10 +43,19 @@ public class MAUS : MonoBehaviour
         }
 
         // check if corresponding textgrid exists
-        // if not use MAUSService to generate the textgrid file
+        // if not align the audio locally, or use MAUSService to generate the textgrid file
         textgridName = plainName + ".TextGrid";
+        string scenePath = SceneManager.GetActiveScene().name + "/";
 
-        if (!File.Exists(PathManager.GetAudioResourcesPath(SceneManager.GetActiveScene().name + "/" + textgridName)))
+        if (!File.Exists(PathManager.GetAudioResourcesPath(scenePath + textgridName)) &&
+            LocalAligner.Align(PathManager.GetAudioResourcesPath(scenePath + plainName + ".wav"),
+                               PathManager.GetAudioResourcesPath(scenePath + transcriptName),
+                               PathManager.GetAudioResourcesPath(scenePath + textgridName)))
+        {
+            Debug.Log("Aligned " + audioName + " to synthesized speech of its transcript");
+        }
+
+        if (!File.Exists(PathManager.GetAudioResourcesPath(scenePath + textgridName)))
         {
             service = new MAUSService();
             service.AnalyzeAudio(plainName, language);
@@ -0,0 +1,157 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+///---------------------------------------------------------------------
+///   Class:        ProsodyAggregator.cs
+///   Description:  Per phoneme and per sliding window prosody statistics
+///                 (native lipsync library, see lipsync_aggregate.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Audio analysis
+///---------------------------------------------------------------------
+
+public enum ProsodySeries
+{
+    VowelPitch,
+    ConsonantPitch,
+    VowelIntensity,
+    ConsonantIntensity
+}
+
+public class ProsodyAggregator : IDisposable
+{
+    // LS_CLASS_VOWEL, LS_CLASS_PLOSIVE
+    const uint VowelClass = 0x01;
+    const uint PlosiveFricativeClass = 0x02;
+
+    IntPtr handle;
+
+    [DllImport("lipsync")]
+    static extern IntPtr ls_aggregate_new(float[] time, float[] f0, float[] loudness, int frames,
+        float[] start, float[] end, uint[] classes, int n, float[] meanPitch, float[] meanIntensity);
+
+    [DllImport("lipsync")]
+    static extern void ls_aggregate_delete(IntPtr aggregate);
+
+    [DllImport("lipsync")]
+    static extern void ls_aggregate_range(IntPtr aggregate, int series, out float min, out float max);
+
+    [DllImport("lipsync")]
+    static extern int ls_aggregate_window_count(IntPtr aggregate, float windowMs);
+
+    [DllImport("lipsync")]
+    static extern void ls_aggregate_windows(IntPtr aggregate, int series, float windowMs, float[] means, int windows);
+
+    ProsodyAggregator(IntPtr handle)
+    {
+        this.handle = handle;
+    }
+
+    /// <summary>
+    /// Analyzes the prosody tables against the phoneme timings in one pass and sets the
+    /// mean pitch and intensity of the vowels and plosives/fricatives.
+    /// Returns null if the native library is not available
+    /// </summary>
+    /// <param name="frequencies"></param>
+    /// <param name="decibels"></param>
+    /// <param name="phonemeTimings"></param>
+    /// <returns></returns>
+    public static ProsodyAggregator Create(Dictionary<float, float> frequencies, Dictionary<float, float> decibels, List<PhonemeInformation> phonemeTimings)
+    {
+        // frames as sorted arrays, the tables share their timestamps
+        float[] time = new float[frequencies.Count];
+        float[] f0 = new float[frequencies.Count];
+        float[] loudness = new float[frequencies.Count];
+        frequencies.Keys.CopyTo(time, 0);
+        Array.Sort(time);
+        for (int i = 0; i < time.Length; i++)
+        {
+            f0[i] = frequencies[time[i]];
+            decibels.TryGetValue(time[i], out loudness[i]);
+        }
+
+        int n = phonemeTimings.Count;
+        float[] start = new float[n];
+        float[] end = new float[n];
+        uint[] classes = new uint[n];
+        float[] meanPitch = new float[n];
+        float[] meanIntensity = new float[n];
+        for (int i = 0; i < n; i++)
+        {
+            PhonemeInformation pi = phonemeTimings[i];
+            start[i] = pi.startingInterval;
+            end[i] = pi.endingInterval;
+            if (Enum.IsDefined(typeof(Vowel), pi.text.ToString()))
+            {
+                classes[i] = VowelClass;
+            }
+            else if (Enum.IsDefined(typeof(PlosiveFricative), pi.text.ToString()))
+            {
+                classes[i] = PlosiveFricativeClass;
+            }
+        }
+
+        IntPtr handle;
+        try
+        {
+            handle = ls_aggregate_new(time, f0, loudness, time.Length, start, end, classes, n, meanPitch, meanIntensity);
+        }
+        catch (DllNotFoundException)
+        {
+            return null;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return null;
+        }
+
+        // as SpeechAnalysis, phonemes without voiced frames keep their previous means
+        for (int i = 0; i < n; i++)
+        {
+            if (meanPitch[i] > 0)
+            {
+                phonemeTimings[i].meanPitch = meanPitch[i];
+            }
+            if (meanIntensity[i] > 0)
+            {
+                phonemeTimings[i].meanIntensity = meanIntensity[i];
+            }
+        }
+
+        return new ProsodyAggregator(handle);
+    }
+
+    /// <summary>
+    /// Smallest and largest value of the series over all phonemes of its class
+    /// </summary>
+    /// <param name="series"></param>
+    /// <param name="min"></param>
+    /// <param name="max"></param>
+    public void GetRange(ProsodySeries series, out float min, out float max)
+    {
+        ls_aggregate_range(handle, (int)series, out min, out max);
+    }
+
+    /// <summary>
+    /// Mean of the series per sliding window. Any window length can be asked for
+    /// without analyzing the frames again
+    /// </summary>
+    /// <param name="series"></param>
+    /// <param name="slidingWindow">milliseconds</param>
+    /// <returns></returns>
+    public List<float> GetWindowMeans(ProsodySeries series, float slidingWindow)
+    {
+        float[] means = new float[ls_aggregate_window_count(handle, slidingWindow)];
+        ls_aggregate_windows(handle, (int)series, slidingWindow, means, means.Length);
+        return new List<float>(means);
+    }
+
+    public void Dispose()
+    {
+        if (handle != IntPtr.Zero)
+        {
+            ls_aggregate_delete(handle);
+            handle = IntPtr.Zero;
+        }
+    }
+}
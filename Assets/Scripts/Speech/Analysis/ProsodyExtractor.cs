@@ -0,0 +1,86 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+///---------------------------------------------------------------------
+///   Class:        ProsodyExtractor.cs
+///   Description:  In-process F0 and loudness extraction (native lipsync
+///                 library, see StreamingAssets/LipSync/lipsync_pitch.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Audio analysis
+///---------------------------------------------------------------------
+
+public static class ProsodyExtractor
+{
+    // frame step of the prosodyAcf configuration
+    public const float DefaultHop = 10f;
+
+    [DllImport("lipsync")]
+    static extern int ls_extract_prosody(string wavPath, float hopMs, out IntPtr time, out IntPtr f0, out IntPtr loudness);
+
+    [DllImport("lipsync")]
+    static extern void ls_free_prosody(IntPtr time, IntPtr f0, IntPtr loudness);
+
+    /// <summary>
+    /// Fills timestamp -> F0 and timestamp -> loudness, keyed the same way as the openSMILE csv.
+    /// Returns false if the native library is not available or the file cannot be read
+    /// </summary>
+    /// <param name="wavPath"></param>
+    /// <param name="frequencies"></param>
+    /// <param name="decibels"></param>
+    /// <param name="hopMs"></param>
+    /// <returns></returns>
+    public static bool Extract(string wavPath, Dictionary<float, float> frequencies, Dictionary<float, float> decibels, float hopMs)
+    {
+        IntPtr timePtr, f0Ptr, loudnessPtr;
+        int count;
+
+        try
+        {
+            count = ls_extract_prosody(wavPath, hopMs, out timePtr, out f0Ptr, out loudnessPtr);
+        }
+        catch (DllNotFoundException)
+        {
+            return false;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return false;
+        }
+
+        if (count < 0)
+        {
+            return false;
+        }
+
+        float[] time = new float[count];
+        float[] f0 = new float[count];
+        float[] loudness = new float[count];
+        if (count > 0)
+        {
+            Marshal.Copy(timePtr, time, 0, count);
+            Marshal.Copy(f0Ptr, f0, 0, count);
+            Marshal.Copy(loudnessPtr, loudness, 0, count);
+        }
+        ls_free_prosody(timePtr, f0Ptr, loudnessPtr);
+
+        for (int i = 0; i < count; i++)
+        {
+            float timestamp = (float)Math.Round(time[i], 2);
+
+            // first value wins, as with the csv
+            if (!frequencies.ContainsKey(timestamp))
+            {
+                frequencies.Add(timestamp, f0[i]);
+                decibels.Add(timestamp, loudness[i]);
+            }
+        }
+
+        return true;
+    }
+
+    public static bool Extract(string wavPath, Dictionary<float, float> frequencies, Dictionary<float, float> decibels)
+    {
+        return Extract(wavPath, frequencies, decibels, DefaultHop);
+    }
+}
@@ -76,12 +76,24 @@ public class SpeechAnalysis
     }
 
     /// <summary>
-    /// analyzes audio using OpenSmile process (SMILExtract_Release.exe), and produces prosodic features
+    /// analyzes audio with the native extractor (lipsync library), falling back to the
+    /// OpenSmile process (SMILExtract_Release.exe) when the library is not available
     /// </summary>
     /// <param name="args"></param>
     public void AnalyzeAudio()
     {
         audioName = currentClipName.Replace(".wav", "");
+
+        Initialize();
+        if (ProsodyExtractor.Extract(PathManager.GetAudioResourcesPath(SceneManager.GetActiveScene().name + "/" + audioName + ".wav"), frequencies, decibels))
+        {
+            MyLipSync.frequencies = frequencies;
+            MyLipSync.decibels = decibels;
+            MyLipSync.slidingWindow = slidingWindow;
+            AnalyzeProsodicFeatures();
+            return;
+        }
+
         inputFileUrl = PathManager.GetAudioResourcesPath(SceneManager.GetActiveScene().name + "/" + "prosody_" + audioName + ".csv");
         List<string> args = ConfigureArguments();
         
@@ -129,8 +141,35 @@ public class SpeechAnalysis
     {
         Initialize();
         CalculateProsodicFeatures();
-        GetIndividualFrequencies();
-        GetIndividualDecibels();
+        AnalyzeProsodicFeatures();
+    }
+
+    /// <summary>
+    /// Per phoneme features from the F0 and loudness frames tts_callback computed during
+    /// synthesis (-e), in place of a second pass over the audio. The phoneme timings are
+    /// left to the caller, which already has them
+    /// </summary>
+    /// <param name="frequencies">timestamp rounded to 2 decimals -> F0</param>
+    /// <param name="decibels">timestamp rounded to 2 decimals -> loudness</param>
+    public void AnalyzeEnvelope(Dictionary<float, float> frequencies, Dictionary<float, float> decibels)
+    {
+        this.frequencies = frequencies;
+        this.decibels = decibels;
+        MyLipSync.frequencies = frequencies;
+        MyLipSync.decibels = decibels;
+        MyLipSync.slidingWindow = slidingWindow;
+        if (frequencies.Count > 0)
+        {
+            CalculatePhonemeFeatures();
+        }
+    }
+
+    /// <summary>
+    /// Per phoneme features and phoneme timings, once frequencies and decibels are filled
+    /// </summary>
+    void AnalyzeProsodicFeatures()
+    {
+        CalculatePhonemeFeatures();
         SetPhonemeTimings();
         foreach (MyLipSync mls in lipSyncComponents)
         {
@@ -138,6 +177,24 @@ public class SpeechAnalysis
         }
     }
 
+    /// <summary>
+    /// Mean pitch and intensity of each phoneme and their statistics
+    /// </summary>
+    void CalculatePhonemeFeatures()
+    {
+        ProsodyAggregator aggregator = ProsodyAggregator.Create(frequencies, decibels, phonemeTimings);
+        if (aggregator != null)
+        {
+            AggregateProsodicFeatures(aggregator);
+            aggregator.Dispose();
+        }
+        else
+        {
+            GetIndividualFrequencies();
+            GetIndividualDecibels();
+        }
+    }
+
     /// <summary>
     /// Calculate prosodic features (frequency, intensity) from OpenSmile output file
     /// </summary>
@@ -191,6 +248,33 @@ public class SpeechAnalysis
         
     }
 
+    /// <summary>
+    /// Pitch and intensity statistics from the native aggregation, which has already set
+    /// the mean pitch and intensity of each phoneme. Same results as GetIndividualFrequencies
+    /// and GetIndividualDecibels, without the per phoneme debug dump
+    /// </summary>
+    /// <param name="aggregator"></param>
+    void AggregateProsodicFeatures(ProsodyAggregator aggregator)
+    {
+        float min, max;
+
+        MyLipSync.SetMeanPitches(aggregator.GetWindowMeans(ProsodySeries.VowelPitch, slidingWindow), aggregator.GetWindowMeans(ProsodySeries.ConsonantPitch, slidingWindow));
+        aggregator.GetRange(ProsodySeries.VowelPitch, out min, out max);
+        MyLipSync.SetVowelPitches(min, GetMeanValues(phonemeTimings, true, AudioFeature.Pitch), max);
+        aggregator.GetRange(ProsodySeries.ConsonantPitch, out min, out max);
+        MyLipSync.SetConsonantPitches(min, GetMeanValues(phonemeTimings, false, AudioFeature.Pitch), max);
+
+        MyLipSync.SetMeanIntensities(aggregator.GetWindowMeans(ProsodySeries.VowelIntensity, slidingWindow), aggregator.GetWindowMeans(ProsodySeries.ConsonantIntensity, slidingWindow));
+        aggregator.GetRange(ProsodySeries.VowelIntensity, out min, out max);
+        MyLipSync.setVowelIntensities(min, GetMeanValues(phonemeTimings, true, AudioFeature.Intensity), max);
+        aggregator.GetRange(ProsodySeries.ConsonantIntensity, out min, out max);
+        MyLipSync.SetConsonantIntensities(min, GetMeanValues(phonemeTimings, false, AudioFeature.Intensity), max);
+
+        // Debug purposes
+        PrintToFile(AudioFeature.Pitch);
+        PrintToFile(AudioFeature.Intensity);
+    }
+
     /// <summary>
     /// Get Individual mean frequency values for each phoneme
     /// </summary>
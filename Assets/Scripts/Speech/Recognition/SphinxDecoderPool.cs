@@ -0,0 +1,334 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.Runtime.InteropServices;
+using System.Text;
+
+///---------------------------------------------------------------------
+///   Class:        SphinxDecoderPool.cs
+///   Description:  PocketSphinx decoders kept loaded on worker threads
+///                 for the word and phone timings (native asr_tools
+///                 library, see StreamingAssets/Sphinx/asr_pool.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Speech recognition
+///---------------------------------------------------------------------
+
+public class SphinxDecoderPool : IDisposable
+{
+    const int ResultSize = 24;
+    const int SegmentSize = 16;
+
+    /// <summary>
+    /// A phone or word of the best path, times in seconds from the start of the clip
+    /// </summary>
+    public class Segment
+    {
+        public string text;
+        public float start;
+        public float end;
+        public float probability;      // posterior, 0 for partial results
+    }
+
+    /// <summary>
+    /// A hypothesis of a clip, copied out of the native result
+    /// </summary>
+    public class Result
+    {
+        public int clip;
+        public bool final;             // else a partial hypothesis, more will follow
+        public bool failed;            // the clip could not be read or decoded
+        public float time;             // seconds of the clip decoded
+        public bool phones;            // segments are phones, else words
+        public string hypothesis;
+        public List<Segment> segments;
+
+        /// <summary>
+        /// The segments as ps_run -time prints them, "text start end probability" per line
+        /// </summary>
+        /// <returns></returns>
+        public string Times()
+        {
+            StringBuilder sb = new StringBuilder();
+            foreach (Segment segment in segments)
+            {
+                sb.AppendFormat(CultureInfo.InvariantCulture, "{0} {1:F3} {2:F3} {3:F6}\n",
+                                segment.text, segment.start, segment.end, segment.probability);
+            }
+            return sb.ToString();
+        }
+    }
+
+    [DllImport("asr_tools")]
+    static extern IntPtr asr_pool_new(int argc, string[] argv, int workers, float partial);
+
+    [DllImport("asr_tools")]
+    static extern void asr_pool_delete(IntPtr pool);
+
+    [DllImport("asr_tools")]
+    static extern int asr_pool_workers(IntPtr pool);
+
+    [DllImport("asr_tools")]
+    static extern int asr_pool_sample_rate(IntPtr pool);
+
+    [DllImport("asr_tools")]
+    static extern int asr_pool_submit(IntPtr pool, short[] samples, int n);
+
+    [DllImport("asr_tools")]
+    static extern int asr_pool_submit_file(IntPtr pool, string path);
+
+    [DllImport("asr_tools")]
+    static extern int asr_pool_pending(IntPtr pool);
+
+    [DllImport("asr_tools")]
+    static extern IntPtr asr_pool_read(IntPtr pool, int timeoutMs);
+
+    [DllImport("asr_tools")]
+    static extern void asr_pool_release(IntPtr pool);
+
+    // pools shared by model arguments, see Shared
+    static Dictionary<string, SphinxDecoderPool> shared = new Dictionary<string, SphinxDecoderPool>();
+    static bool unloadHooked;
+
+    IntPtr pool;
+    byte[] nameBuffer = new byte[256];
+
+    SphinxDecoderPool(IntPtr pool)
+    {
+        this.pool = pool;
+    }
+
+    /// <summary>
+    /// Loads the models of the decoder arguments into one decoder per worker.
+    /// The arguments are those of ps_run without -infile and -time.
+    /// Returns null if the native library is not available or the models cannot be loaded
+    /// </summary>
+    /// <param name="args"></param>
+    /// <param name="workers">0 for one per core</param>
+    /// <param name="partialInterval">seconds of audio between partial hypotheses, 0 for none</param>
+    /// <returns></returns>
+    public static SphinxDecoderPool Create(string[] args, int workers, float partialInterval)
+    {
+        IntPtr pool;
+
+        try
+        {
+            pool = asr_pool_new(args.Length, args, workers, partialInterval);
+        }
+        catch (DllNotFoundException)
+        {
+            return null;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return null;
+        }
+
+        return pool == IntPtr.Zero ? null : new SphinxDecoderPool(pool);
+    }
+
+    /// <summary>
+    /// The pool of a ps_run argument list, created on first use and kept until the domain unloads,
+    /// so the models are loaded once per set of arguments. -infile and -time are left out.
+    /// Returns null as Create does
+    /// </summary>
+    /// <param name="args"></param>
+    /// <returns></returns>
+    public static SphinxDecoderPool Shared(string[] args)
+    {
+        List<string> modelArgs = new List<string>();
+        for (int i = 0; i < args.Length; i++)
+        {
+            if ((args[i] == "-infile" || args[i] == "-time") && i + 1 < args.Length)
+            {
+                i++;
+                continue;
+            }
+            modelArgs.Add(args[i]);
+        }
+        string key = String.Join("\n", modelArgs.ToArray());
+
+        lock (shared)
+        {
+            SphinxDecoderPool pool;
+            if (!shared.TryGetValue(key, out pool))
+            {
+                pool = Create(modelArgs.ToArray(), 0, 0);
+                shared[key] = pool;
+                if (!unloadHooked)
+                {
+                    // the native pools would outlive a script reload in the editor
+                    AppDomain.CurrentDomain.DomainUnload += (sender, e) => DisposeShared();
+                    unloadHooked = true;
+                }
+            }
+            return pool;
+        }
+    }
+
+    static void DisposeShared()
+    {
+        lock (shared)
+        {
+            foreach (SphinxDecoderPool pool in shared.Values)
+            {
+                if (pool != null)
+                {
+                    pool.Dispose();
+                }
+            }
+            shared.Clear();
+        }
+    }
+
+    public int Workers
+    {
+        get { return asr_pool_workers(pool); }
+    }
+
+    /// <summary>
+    /// Rate the clips must have, -samprate of the arguments
+    /// </summary>
+    public int SampleRate
+    {
+        get { return asr_pool_sample_rate(pool); }
+    }
+
+    /// <summary>
+    /// Clips queued or being decoded
+    /// </summary>
+    public int Pending
+    {
+        get { return asr_pool_pending(pool); }
+    }
+
+    /// <summary>
+    /// Queues a clip at SampleRate, returns its id
+    /// </summary>
+    /// <param name="samples"></param>
+    /// <returns></returns>
+    public int Submit(short[] samples)
+    {
+        return asr_pool_submit(pool, samples, samples.Length);
+    }
+
+    /// <summary>
+    /// Queues a clip of AudioClip style samples in [-1, 1] at SampleRate, returns its id
+    /// </summary>
+    /// <param name="samples"></param>
+    /// <returns></returns>
+    public int Submit(float[] samples)
+    {
+        short[] pcm = new short[samples.Length];
+        for (int i = 0; i < samples.Length; i++)
+        {
+            pcm[i] = (short)(Math.Max(-1.0f, Math.Min(samples[i], 32767.0f / 32768.0f)) * 32768.0f);
+        }
+        return Submit(pcm);
+    }
+
+    /// <summary>
+    /// Queues a WAV file at SampleRate, read on the worker, returns its id
+    /// </summary>
+    /// <param name="path"></param>
+    /// <returns></returns>
+    public int SubmitFile(string path)
+    {
+        return asr_pool_submit_file(pool, path);
+    }
+
+    /// <summary>
+    /// Waits at most timeoutMs (-1 for ever) for the next result of any clip, null on timeout.
+    /// The results of a clip come in order, the final one last
+    /// </summary>
+    /// <param name="timeoutMs"></param>
+    /// <returns></returns>
+    public Result Read(int timeoutMs)
+    {
+        lock (this)
+        {
+            IntPtr res = asr_pool_read(pool, timeoutMs);
+            if (res == IntPtr.Zero)
+            {
+                return null;
+            }
+
+            try
+            {
+                Result result = new Result();
+                result.clip = Marshal.ReadInt32(res, 0);
+                result.final = Marshal.ReadInt32(res, 4) != 0;
+                result.failed = Marshal.ReadInt32(res, 8) != 0;
+                int segmentCount = Marshal.ReadInt32(res, 16);
+                result.phones = Marshal.ReadInt32(res, 20) != 0;
+                result.segments = new List<Segment>(segmentCount);
+
+                float[] values = new float[3];
+                Marshal.Copy(new IntPtr(res.ToInt64() + 12), values, 0, 1);
+                result.time = values[0];
+
+                int stringsOffset = ResultSize + segmentCount * SegmentSize;
+                result.hypothesis = ReadName(res, stringsOffset);
+                for (int i = 0; i < segmentCount; i++)
+                {
+                    int segment = ResultSize + i * SegmentSize;
+                    Marshal.Copy(new IntPtr(res.ToInt64() + segment), values, 0, 3);
+                    Segment s = new Segment();
+                    s.start = values[0];
+                    s.end = values[1];
+                    s.probability = values[2];
+                    s.text = ReadName(res, stringsOffset + Marshal.ReadInt32(res, segment + 12));
+                    result.segments.Add(s);
+                }
+                return result;
+            }
+            finally
+            {
+                asr_pool_release(pool);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Decodes one WAV file and waits for its final result, null if it failed.
+    /// Results of other clips read meanwhile are dropped, so this is for a pool with one user at a time
+    /// </summary>
+    /// <param name="path"></param>
+    /// <returns></returns>
+    public Result RecognizeFile(string path)
+    {
+        int clip = SubmitFile(path);
+        for (;;)
+        {
+            Result result = Read(-1);
+            if (result != null && result.clip == clip && result.final)
+            {
+                return result.failed ? null : result;
+            }
+        }
+    }
+
+    // NUL-terminated UTF-8 name of a result
+    string ReadName(IntPtr res, int offset)
+    {
+        int length = 0;
+        byte b;
+        while ((b = Marshal.ReadByte(res, offset + length)) != 0)
+        {
+            if (length == nameBuffer.Length)
+            {
+                Array.Resize(ref nameBuffer, nameBuffer.Length * 2);
+            }
+            nameBuffer[length++] = b;
+        }
+        return Encoding.UTF8.GetString(nameBuffer, 0, length);
+    }
+
+    public void Dispose()
+    {
+        if (pool != IntPtr.Zero)
+        {
+            asr_pool_delete(pool);
+            pool = IntPtr.Zero;
+        }
+    }
+}
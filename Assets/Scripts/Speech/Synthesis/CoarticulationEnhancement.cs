@@ -15,11 +15,14 @@ using UnityEngine;
 
 public class CoarticulationEnhancement
 {
-    // TODO 
+    // TODO (rise/decay animation of MyLipSync)
     // check for pauses
     // check for lexically stressed words - Schwa
     // lip-heavy visemes
     // neighboring visemes influence each other (tongue-only visemes)
+    // Only the native viseme solver covers these, with the dominance model of
+    // StreamingAssets/LipSync/lipsync_coartic.h (MyLipSync.dominanceCoarticulation);
+    // the managed path still uses the fixed per-category PhonemeInformation.influence
     
     /// <summary>
     /// Converts diphones (dynamic visemes) into their corresponding phonemes 
@@ -82,6 +85,21 @@ public class CoarticulationEnhancement
     {
         List<PhonemeInformation> distinctPhonemes = new List<PhonemeInformation>();
 
+        AppendDistinct(distinctPhonemes, phonemes);
+
+        return distinctPhonemes;
+    }
+
+    /// <summary>
+    /// appends phonemes to an already merged list, merging duplicates as RemoveDuplicates.
+    /// Only the last phoneme of the list can be affected by the new ones
+    /// </summary>
+    /// <param name="distinctPhonemes">list without duplicated phonemes, extended in place</param>
+    /// <param name="phonemes">phonemes to append</param>
+    /// <returns>index of the first phoneme of distinctPhonemes that was added or extended</returns>
+    public int AppendDistinct(List<PhonemeInformation> distinctPhonemes, List<PhonemeInformation> phonemes)
+    {
+        int firstChanged = distinctPhonemes.Count;
         float threshold = 1f;
 
         foreach (PhonemeInformation p in phonemes)
@@ -101,12 +119,13 @@ public class CoarticulationEnhancement
                 {
                     // replace duplicated phoneme bu adjusting its ending time
                     distinctPhonemes[distinctPhonemes.Count - 1].endingInterval = p.endingInterval;
+                    firstChanged = Math.Min(firstChanged, distinctPhonemes.Count - 1);
                 }
                 
             }
         }
 
-        return distinctPhonemes;
+        return firstChanged;
     }
 
     public Phoneme GetPhonemeText(float duration, string text)
@@ -0,0 +1,205 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using System.Text;
+
+///---------------------------------------------------------------------
+///   Class:        SpeechRing.cs
+///   Description:  Consumer side of the shared memory ring tts_callback
+///                 writes its spurts to with -m (native tts_tools
+///                 library, see StreamingAssets/CereVoice/tts_ring.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Text to speech transport
+///---------------------------------------------------------------------
+
+public class SpeechRing : IDisposable
+{
+    // tts_ring_msg types
+    const int SpurtMessage = 1;
+    const int DoneMessage = 2;
+
+    const int MessageSize = 32;
+    const int TransSize = 16;
+    const int FrameSize = 12;
+
+    /// <summary>
+    /// One message of the ring, copied out of the shared memory
+    /// </summary>
+    public class Spurt
+    {
+        public bool done;              // end of the utterance, offset is its length in samples
+        public int offset;             // samples of the utterance before the spurt
+        public short[] samples;
+        public List<PhonemeInformation> phonemes;
+        public List<WordInformation> words;
+        public List<ProsodyComponent> frames;   // F0 and loudness every 10 ms, with tts_callback -e
+    }
+
+    [DllImport("tts_tools")]
+    static extern IntPtr tts_ring_create(string name, uint size);
+
+    [DllImport("tts_tools")]
+    static extern IntPtr tts_ring_read(IntPtr ring, int timeoutMs);
+
+    [DllImport("tts_tools")]
+    static extern void tts_ring_release(IntPtr ring);
+
+    [DllImport("tts_tools")]
+    static extern uint tts_ring_sample_rate(IntPtr ring);
+
+    [DllImport("tts_tools")]
+    static extern void tts_ring_close(IntPtr ring);
+
+    IntPtr ring;
+    string name;
+    byte[] nameBuffer = new byte[256];
+
+    SpeechRing(IntPtr ring, string name)
+    {
+        this.ring = ring;
+        this.name = name;
+    }
+
+    /// <summary>
+    /// Creates a ring for one tts_callback process.
+    /// Returns null if the native library is not available or the ring cannot be created
+    /// </summary>
+    /// <param name="name">passed to tts_callback -m</param>
+    /// <returns></returns>
+    public static SpeechRing Create(string name)
+    {
+        IntPtr ring;
+
+        try
+        {
+            ring = tts_ring_create(name, 0);
+        }
+        catch (DllNotFoundException)
+        {
+            return null;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return null;
+        }
+
+        return ring == IntPtr.Zero ? null : new SpeechRing(ring, name);
+    }
+
+    public string Name
+    {
+        get { return name; }
+    }
+
+    /// <summary>
+    /// Sample rate of the voice, 0 until the producer has opened the ring
+    /// </summary>
+    public int SampleRate
+    {
+        get { return (int)tts_ring_sample_rate(ring); }
+    }
+
+    /// <summary>
+    /// Waits at most timeoutMs for the next spurt, null on timeout.
+    /// Timings are in seconds from the start of the utterance
+    /// </summary>
+    /// <param name="timeoutMs"></param>
+    /// <returns></returns>
+    public Spurt Read(int timeoutMs)
+    {
+        IntPtr msg = tts_ring_read(ring, timeoutMs);
+        if (msg == IntPtr.Zero)
+        {
+            return null;
+        }
+
+        try
+        {
+            Spurt spurt = new Spurt();
+            int type = Marshal.ReadInt32(msg, 4);
+            spurt.offset = Marshal.ReadInt32(msg, 12);
+            spurt.done = type == DoneMessage;
+            spurt.phonemes = new List<PhonemeInformation>();
+            spurt.words = new List<WordInformation>();
+            spurt.frames = new List<ProsodyComponent>();
+            if (type != SpurtMessage)
+            {
+                spurt.samples = new short[0];
+                return spurt;
+            }
+
+            int sampleCount = Marshal.ReadInt32(msg, 16);
+            int transCount = Marshal.ReadInt32(msg, 20);
+            int frameCount = Marshal.ReadInt32(msg, 24);
+            int framesOffset = MessageSize + transCount * TransSize;
+            int samplesOffset = framesOffset + frameCount * FrameSize;
+            int stringsOffset = samplesOffset + ((sampleCount + 1) & ~1) * sizeof(short);
+            double rate = SampleRate;
+
+            spurt.samples = new short[sampleCount];
+            Marshal.Copy(new IntPtr(msg.ToInt64() + samplesOffset), spurt.samples, 0, sampleCount);
+
+            for (int i = 0; i < transCount; i++)
+            {
+                int record = MessageSize + i * TransSize;
+                int recordType = Marshal.ReadInt32(msg, record);
+                float start = (float)((uint)Marshal.ReadInt32(msg, record + 4) / rate);
+                float end = (float)((uint)Marshal.ReadInt32(msg, record + 8) / rate);
+                string text = ReadName(msg, stringsOffset + Marshal.ReadInt32(msg, record + 12));
+
+                if (recordType == TimelineReader.PhoneRecord)
+                {
+                    Phoneme? phoneme = PhonemeInformation.MapPhoneme(text);
+                    PhonemeInformation pi = phoneme.HasValue ? new PhonemeInformation(0, 0, phoneme.Value) : new PhonemeInformation(0, 0, text);
+                    // the constructors round to 2 decimals, keep the sample-accurate times
+                    pi.startingInterval = start;
+                    pi.endingInterval = end;
+                    spurt.phonemes.Add(pi);
+                }
+                else if (recordType == TimelineReader.WordRecord)
+                {
+                    spurt.words.Add(new WordInformation(start, end, text));
+                }
+            }
+
+            float[] values = new float[2];
+            for (int i = 0; i < frameCount; i++)
+            {
+                int frame = framesOffset + i * FrameSize;
+                float time = (float)((uint)Marshal.ReadInt32(msg, frame) / rate);
+                Marshal.Copy(new IntPtr(msg.ToInt64() + frame + 4), values, 0, 2);
+                spurt.frames.Add(new ProsodyComponent(time, values[0] > 0 ? 1 : 0, values[0], values[1]));
+            }
+            return spurt;
+        }
+        finally
+        {
+            tts_ring_release(ring);
+        }
+    }
+
+    // NUL-terminated UTF-8 name of a message
+    string ReadName(IntPtr msg, int offset)
+    {
+        int length = 0;
+        byte b;
+        while ((b = Marshal.ReadByte(msg, offset + length)) != 0)
+        {
+            if (length == nameBuffer.Length)
+            {
+                Array.Resize(ref nameBuffer, nameBuffer.Length * 2);
+            }
+            nameBuffer[length++] = b;
+        }
+        return Encoding.UTF8.GetString(nameBuffer, 0, length);
+    }
+
+    public void Dispose()
+    {
+        if (ring != IntPtr.Zero)
+        {
+            tts_ring_close(ring);
+            ring = IntPtr.Zero;
+        }
+    }
+}
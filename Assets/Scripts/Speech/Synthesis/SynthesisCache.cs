@@ -0,0 +1,229 @@
+﻿using System;
+using System.IO;
+using System.Runtime.InteropServices;
+using System.Text;
+
+///---------------------------------------------------------------------
+///   Class:        SynthesisCache.cs
+///   Description:  Content-addressed cache of synthesized utterances
+///                 (native tts_tools library, see
+///                 StreamingAssets/CereVoice/tts_cache.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Text to speech cache
+///---------------------------------------------------------------------
+
+public class SynthesisCache : IDisposable
+{
+    [StructLayout(LayoutKind.Sequential)]
+    struct Key
+    {
+        public ulong h0;
+        public ulong h1;
+    }
+
+    [DllImport("tts_tools")]
+    static extern int tts_cache_key_config(out Key key, string voiceFile, string lexiconFile, int maxp);
+
+    [DllImport("tts_tools")]
+    static extern void tts_cache_key_text(out Key key, ref Key config, byte[] text, int textlen);
+
+    [DllImport("tts_tools")]
+    static extern IntPtr tts_cache_open(string dir, int memoryMb, int diskMb);
+
+    [DllImport("tts_tools")]
+    static extern void tts_cache_close(IntPtr cache);
+
+    [DllImport("tts_tools")]
+    static extern IntPtr tts_cache_get(IntPtr cache, ref Key key);
+
+    [DllImport("tts_tools")]
+    static extern void tts_cache_release(IntPtr cache, IntPtr entry);
+
+    [DllImport("tts_tools")]
+    static extern int tts_cache_entry_save(IntPtr entry, string wavPath, string timelinePath);
+
+    [DllImport("tts_tools")]
+    static extern IntPtr tts_cache_writer_open(IntPtr cache, ref Key key, int sampleRate);
+
+    [DllImport("tts_tools")]
+    static extern void tts_cache_writer_add(IntPtr writer, int type, uint start, uint end, string name);
+
+    [DllImport("tts_tools")]
+    static extern void tts_cache_writer_add_audio(IntPtr writer, IntPtr samples, int n);
+
+    [DllImport("tts_tools")]
+    static extern int tts_cache_writer_commit(IntPtr writer);
+
+    [DllImport("tts_tools")]
+    static extern void tts_cache_writer_abort(IntPtr writer);
+
+    IntPtr cache;
+    Key config;
+
+    // synthesis being recorded
+    IntPtr writer;
+    int sampleRate;
+    long recorded;
+
+    SynthesisCache(IntPtr cache, Key config)
+    {
+        this.cache = cache;
+        this.config = config;
+    }
+
+    /// <summary>
+    /// Opens the cache directory for a voice, lexicon and phone pipeline limit (0 if not set).
+    /// Returns null if the native library is not available or the directory cannot be used
+    /// </summary>
+    /// <param name="directory"></param>
+    /// <param name="voiceFile"></param>
+    /// <param name="lexiconFile"></param>
+    /// <param name="maxPhones"></param>
+    /// <returns></returns>
+    public static SynthesisCache Open(string directory, string voiceFile, string lexiconFile, int maxPhones)
+    {
+        Key config;
+        IntPtr cache;
+
+        try
+        {
+            if (tts_cache_key_config(out config, voiceFile, lexiconFile, maxPhones) != 0)
+            {
+                return null;
+            }
+            cache = tts_cache_open(directory, 0, 0);
+        }
+        catch (DllNotFoundException)
+        {
+            return null;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return null;
+        }
+
+        return cache == IntPtr.Zero ? null : new SynthesisCache(cache, config);
+    }
+
+    Key TextKey(string text)
+    {
+        Key key;
+        byte[] bytes = Encoding.UTF8.GetBytes(text);
+        tts_cache_key_text(out key, ref config, bytes, bytes.Length);
+        return key;
+    }
+
+    /// <summary>
+    /// Writes the cached audio and timeline of text to the given paths.
+    /// Returns false on a miss
+    /// </summary>
+    /// <param name="text"></param>
+    /// <param name="wavPath"></param>
+    /// <param name="timelinePath"></param>
+    /// <returns></returns>
+    public bool Restore(string text, string wavPath, string timelinePath)
+    {
+        Key key = TextKey(text);
+        IntPtr entry = tts_cache_get(cache, ref key);
+        if (entry == IntPtr.Zero)
+        {
+            return false;
+        }
+
+        int res = tts_cache_entry_save(entry, wavPath, timelinePath);
+        tts_cache_release(cache, entry);
+        return res == 0;
+    }
+
+    /// <summary>
+    /// Starts recording the synthesis of text, spurts are added with RecordSpurt
+    /// </summary>
+    /// <param name="text"></param>
+    /// <param name="rate"></param>
+    public void BeginRecording(string text, int rate)
+    {
+        AbortRecording();
+        Key key = TextKey(text);
+        writer = tts_cache_writer_open(cache, ref key, rate);
+        sampleRate = rate;
+        recorded = 0;
+    }
+
+    /// <summary>
+    /// Adds the transcription and audio of a spurt returned by the engine
+    /// </summary>
+    /// <param name="abuf"></param>
+    public void RecordSpurt(SWIGTYPE_p_CPRC_abuf abuf)
+    {
+        if (writer == IntPtr.Zero)
+        {
+            return;
+        }
+
+        int count;
+        IntPtr samples = WavSink.SpurtAudio(abuf, out count);
+
+        // transcription times are relative to the start of the buffer, the cache keeps absolute samples
+        long offset = recorded - Math.Max(cerevoice_eng.CPRC_abuf_wav_mk(abuf), 0);
+        for (int i = 0; i < cerevoice_eng.CPRC_abuf_trans_sz(abuf); i++)
+        {
+            SWIGTYPE_p_CPRC_abuf_trans trans = cerevoice_eng.CPRC_abuf_get_trans(abuf, i);
+            int type;
+            switch (cerevoice_eng.CPRC_abuf_trans_type(trans))
+            {
+                case CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_PHONE: type = TimelineReader.PhoneRecord; break;
+                case CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_WORD: type = TimelineReader.WordRecord; break;
+                case CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_MARK: type = TimelineReader.MarkRecord; break;
+                default: continue;
+            }
+            long start = Math.Max(offset + (long)Math.Round(cerevoice_eng.CPRC_abuf_trans_start(trans) * sampleRate), 0);
+            long end = Math.Max(offset + (long)Math.Round(cerevoice_eng.CPRC_abuf_trans_end(trans) * sampleRate), 0);
+            tts_cache_writer_add(writer, type, (uint)start, (uint)end, cerevoice_eng.CPRC_abuf_trans_name(trans));
+        }
+
+        if (count > 0)
+        {
+            // samples are passed straight from the engine buffer
+            tts_cache_writer_add_audio(writer, samples, count);
+            recorded += count;
+        }
+    }
+
+    /// <summary>
+    /// Stores the recorded synthesis, returns false if it could not be written
+    /// </summary>
+    /// <returns></returns>
+    public bool CommitRecording()
+    {
+        if (writer == IntPtr.Zero)
+        {
+            return false;
+        }
+
+        int res = tts_cache_writer_commit(writer);
+        writer = IntPtr.Zero;
+        return res == 0;
+    }
+
+    /// <summary>
+    /// Drops the synthesis being recorded, if any
+    /// </summary>
+    public void AbortRecording()
+    {
+        if (writer != IntPtr.Zero)
+        {
+            tts_cache_writer_abort(writer);
+            writer = IntPtr.Zero;
+        }
+    }
+
+    public void Dispose()
+    {
+        AbortRecording();
+        if (cache != IntPtr.Zero)
+        {
+            tts_cache_close(cache);
+            cache = IntPtr.Zero;
+        }
+    }
+}
@@ -72,6 +72,12 @@ public class TextToSpeechAPI : MonoBehaviour
             File.Delete(output_phonemes_path);
         }
 
+        // this path writes text output, a timeline left by tts_callback would shadow it
+        if (File.Exists(PathManager.GetDataPath("phonemes.tl")))
+        {
+            File.Delete(PathManager.GetDataPath("phonemes.tl"));
+        }
+
         int chan, ret;
         CPRC_VOICE_LOAD_TYPE load_mode;
         string license_file = PathManager.GetCereVoicePath("license.lic");
@@ -23,6 +23,17 @@ public class TextToSpeechAPIv2
     public static int audioLength;
     public static string currentRecording = "";
     public static AudioMode audioMode;
+    static SWIGTYPE_p_CPRCEN_engine eng;
+    static int chan;
+    static PhonemeAnalyzer analyzer; // analyzes each spurt as it is synthesized
+    static SynthesisCache cache;
+    static bool cacheOpened;
+    static int sampleRate;
+    static WavSink audioSink; // one open output stream per utterance
+    static StreamWriter phonemesWriter;
+    static bool unloadHooked;
+
+    const string VoiceFile = "cerevoice_heather_3.2.0_48k.voice";
 
     /// <summary>
     /// generates input file in SSML format according to the input text
@@ -73,114 +84,285 @@ public class TextToSpeechAPIv2
             File.Delete(output_phonemes_path);
         }
 
-        int chan, ret;
+        // a clip received by tts_callback through shared memory would shadow audio.wav
+        TextToSpeechProcess.synthesizedClip = null;
+
+        // this path writes text output, a timeline left by tts_callback would shadow it
+        string timelinePath = PathManager.GetDataPath("phonemes.tl");
+        if (File.Exists(timelinePath))
+        {
+            File.Delete(timelinePath);
+        }
+
+        // repeated lines are restored from the cache without the engine
+        string input = File.ReadAllText(PathManager.GetDataPath(inputFileName));
+        OpenCache();
+        if (cache != null && cache.Restore(input, output_audio_path, timelinePath))
+        {
+            RestoreTimings(timelinePath);
+            return;
+        }
+
+        // the engine is kept warm between calls, only synthesis is paid per utterance
+        if (!LoadEngine())
+        {
+            return;
+        }
+
+        audioLength = 0;
+        if (audioMode.Equals(AudioMode.CereVoice))
+        {
+            analyzer = new PhonemeAnalyzer(AudioMode.CereVoice, null);
+            analyzer.BeginUtterance();
+        }
+        else
+        {
+            analyzer = null;
+        }
+
+        cerevoice_eng.SetChannelCallback(eng, chan, CallbackHandler);
+        if (cache != null)
+        {
+            cache.BeginRecording(input, sampleRate);
+        }
+
+        // the outputs stay open for the whole utterance instead of being reopened per spurt
+        audioSink = WavSink.Open(output_audio_path, sampleRate);
+        phonemesWriter = new StreamWriter(output_phonemes_path, false);
+        try
+        {
+            // synthesis
+            foreach (string l in File.ReadAllLines(PathManager.GetDataPath(inputFileName)))
+            {
+                cerevoice_eng.CPRCEN_engine_channel_speak(eng, chan, l, l.Length, 0);
+            }
+            cerevoice_eng.CPRCEN_engine_channel_speak(eng, chan, "", 0, 1);
+        }
+        finally
+        {
+            phonemesWriter.Close();
+            phonemesWriter = null;
+            if (audioSink != null)
+            {
+                audioSink.Close();
+                audioSink = null;
+            }
+        }
+
+        if (cache != null)
+        {
+            cache.CommitRecording();
+        }
+
+        // natural speech timings are adjusted against the whole utterance
+        if (analyzer == null)
+        {
+            new PhonemeAnalyzer(AudioMode.Natural, null).ManagePhonemeTimings(false, currentRecording);
+        }
+
+        // reset the channel for the next utterance instead of deleting the engine
+        cerevoice_eng.CPRCEN_engine_channel_reset(eng, chan);
+    }
+
+    /// <summary>
+    /// Analyzes the timeline of an utterance restored from the cache, as the callback would have
+    /// </summary>
+    /// <param name="timelinePath"></param>
+    void RestoreTimings(string timelinePath)
+    {
+        TimelineReader timeline = new TimelineReader(timelinePath);
+        audioLength = (int)timeline.TotalSamples;
+
+        if (audioMode.Equals(AudioMode.CereVoice))
+        {
+            analyzer = new PhonemeAnalyzer(AudioMode.CereVoice, null);
+            analyzer.BeginUtterance();
+            analyzer.AppendPhonemeTimings(timeline.ReadPhonemeTimings(), timeline.ReadWordTimings());
+        }
+        else
+        {
+            analyzer = null;
+            new PhonemeAnalyzer(AudioMode.Natural, null).ManagePhonemeTimings(false, currentRecording);
+        }
+    }
+
+    /// <summary>
+    /// Opens the synthesis cache on the first call. Without the native library synthesis is not cached
+    /// </summary>
+    static void OpenCache()
+    {
+        if (cacheOpened)
+        {
+            return;
+        }
+        cacheOpened = true;
+        HookUnload();
+
+        // keyed by the same voice and lexicon LoadEngine uses
+        string directory = PathManager.GetCachePath("Synthesis");
+        Directory.CreateDirectory(directory);
+        cache = SynthesisCache.Open(directory, PathManager.GetCereVoicePath(VoiceFile),
+            PathManager.GetCereVoicePath("lexicon.lex"), 0);
+    }
+
+    /// <summary>
+    /// Creates the TTS engine, loads the voice and the user lexicon and opens a channel.
+    /// This is only done on the first call, later calls reuse the loaded engine
+    /// </summary>
+    /// <returns>true if the engine is ready for synthesis</returns>
+    static bool LoadEngine()
+    {
+        if (eng != null)
+        {
+            return true;
+        }
+
+        int ret;
         CPRC_VOICE_LOAD_TYPE load_mode;
         string license_file = PathManager.GetCereVoicePath("license.lic");
-        string voice_file = PathManager.GetCereVoicePath("cerevoice_heather_3.2.0_48k.voice");
+        string voice_file = PathManager.GetCereVoicePath(VoiceFile);
 
         // create the TTS engine
-        SWIGTYPE_p_CPRCEN_engine eng = cerevoice_eng.CPRCEN_engine_new();
+        SWIGTYPE_p_CPRCEN_engine engine = cerevoice_eng.CPRCEN_engine_new();
 
         // load voice
         load_mode = CPRC_VOICE_LOAD_TYPE.CPRC_VOICE_LOAD_EMB_AUDIO;
-        ret = cerevoice_eng.CPRCEN_engine_load_voice(eng, license_file, "", voice_file, load_mode);
+        ret = cerevoice_eng.CPRCEN_engine_load_voice(engine, license_file, "", voice_file, load_mode);
         if (ret == 0)
         {
             Console.WriteLine("ERROR: could not load voice " + voice_file + " with license file " + license_file);
-            Environment.Exit(0);
+            cerevoice_eng.CPRCEN_engine_delete(engine);
+            return false;
         }
 
         // load user custom lexicon
-        cerevoice_eng.CPRCEN_engine_load_user_lexicon(eng, 0, PathManager.GetCereVoicePath("lexicon.lex"));
+        cerevoice_eng.CPRCEN_engine_load_user_lexicon(engine, 0, PathManager.GetCereVoicePath("lexicon.lex"));
 
         // open channel
-        chan = cerevoice_eng.CPRCEN_engine_open_channel(eng, "", "", "", "");
+        chan = cerevoice_eng.CPRCEN_engine_open_channel(engine, "", "", "", "");
         if (chan == 0)
         {
-            Console.WriteLine("ERROR: failed to open channel, exiting");
-            Environment.Exit(0);
+            Console.WriteLine("ERROR: failed to open channel");
+            cerevoice_eng.CPRCEN_engine_delete(engine);
+            return false;
         }
 
         // voice and channel information
-        Console.WriteLine("INFO: using voice " + cerevoice_eng.CPRCEN_channel_get_voice_info(eng, chan, "VOICE_NAME") +
-            " with sampling rate " +
-            cerevoice_eng.CPRCEN_channel_get_voice_info(eng, chan, "SAMPLE_RATE"));
+        sampleRate = int.Parse(cerevoice_eng.CPRCEN_channel_get_voice_info(engine, chan, "SAMPLE_RATE"));
+        Console.WriteLine("INFO: using voice " + cerevoice_eng.CPRCEN_channel_get_voice_info(engine, chan, "VOICE_NAME") +
+            " with sampling rate " + sampleRate);
 
-        cerevoice_eng.SetChannelCallback(eng, chan, CallbackHandler);
+        eng = engine;
+        HookUnload();
+        return true;
+    }
 
-        // synthesis
-        foreach (string l in File.ReadAllLines(PathManager.GetDataPath(inputFileName)))
+    /// <summary>
+    /// The engine and the cache are static, they would outlive a script reload in the editor
+    /// and the play session that loaded them
+    /// </summary>
+    static void HookUnload()
+    {
+        if (!unloadHooked)
         {
-            cerevoice_eng.CPRCEN_engine_channel_speak(eng, chan, l, l.Length, 0);
+            AppDomain.CurrentDomain.DomainUnload += (sender, e) => UnloadEngine();
+            unloadHooked = true;
         }
-        cerevoice_eng.CPRCEN_engine_channel_speak(eng, chan, "", 0, 1);
+    }
 
-        // clean
-        cerevoice_eng.CPRCEN_engine_delete(eng);
+    /// <summary>
+    /// Deletes the TTS engine together with its voice and channel
+    /// </summary>
+    public static void UnloadEngine()
+    {
+        if (eng != null)
+        {
+            cerevoice_eng.CPRCEN_engine_delete(eng);
+            eng = null;
+            chan = 0;
+        }
+        if (cache != null)
+        {
+            cache.Dispose();
+            cache = null;
+            cacheOpened = false;
+        }
     }
 
     static void CallbackHandler(IntPtr abufp, IntPtr userdatap)
     {
         try
         {
-            // write phoneme information output to file
-            using (StreamWriter sw = new StreamWriter(output_phonemes_path, true))
-            {
-                SWIGTYPE_p_CPRC_abuf_trans trans;
-                string name;
-                float start, end;
+            List<PhonemeInformation> phonemes = new List<PhonemeInformation>();
+            List<WordInformation> words = new List<WordInformation>();
 
-                // convert abuf pointer into a C# audio buffer
-                SWIGTYPE_p_CPRC_abuf abuf = new SWIGTYPE_p_CPRC_abuf(abufp, false);
+            // spurt timings are relative, offset them by the audio synthesized so far
+            float offset = AudioInfo.getExactDuration(audioLength);
 
-                // audio duration for each part
-                sw.WriteLine(String.Format("INFO: wav_mk {0}, wav_done {1}", cerevoice_eng.CPRC_abuf_wav_mk(abuf), cerevoice_eng.CPRC_abuf_wav_done(abuf)));
-                audioLength += cerevoice_eng.CPRC_abuf_wav_done(abuf);
+            // phoneme information goes to the utterance's open writer
+            StreamWriter sw = phonemesWriter;
+            SWIGTYPE_p_CPRC_abuf_trans trans;
+            string name;
+            float start, end;
 
-                foreach (int i in Enumerable.Range(0, cerevoice_eng.CPRC_abuf_trans_sz(abuf)))
-                {
-                    trans = cerevoice_eng.CPRC_abuf_get_trans(abuf, i);
-                    name = cerevoice_eng.CPRC_abuf_trans_name(trans);
-                    start = (float)Math.Round(cerevoice_eng.CPRC_abuf_trans_start(trans), 3);
-                    end = (float)Math.Round(cerevoice_eng.CPRC_abuf_trans_end(trans), 3);
-
-                    if (cerevoice_eng.CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_PHONE)
-                    {
-                        sw.WriteLine(String.Format("INFO: phoneme: {0} {1} {2}", start, end, name));
-                    }
-                    else if (cerevoice_eng.CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_WORD)
-                    {
-                        sw.WriteLine(String.Format("INFO: word: {0} {1} {2}", start, end, name));
-                    }
-                    else if (cerevoice_eng.CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_MARK)
-                    {
-                        sw.WriteLine(String.Format("INFO: marker: {0} {1} {2}", start, end, name));
-                    }
-                    else
-                    {
-                        sw.WriteLine(String.Format("WARNING: transcription type: '{0}' not known", cerevoice_eng.CPRC_abuf_trans_type(trans)));
-                    }
-                }
+            // convert abuf pointer into a C# audio buffer
+            SWIGTYPE_p_CPRC_abuf abuf = new SWIGTYPE_p_CPRC_abuf(abufp, false);
 
-                // Append generated audio to output file
-                cerevoice_eng.CPRC_riff_append(abuf, output_audio_path);
+            // audio duration for each part
+            sw.WriteLine(String.Format("INFO: wav_mk {0}, wav_done {1}", cerevoice_eng.CPRC_abuf_wav_mk(abuf), cerevoice_eng.CPRC_abuf_wav_done(abuf)));
+            audioLength += cerevoice_eng.CPRC_abuf_wav_done(abuf);
 
-                sw.Close();
-                
-            }
+            foreach (int i in Enumerable.Range(0, cerevoice_eng.CPRC_abuf_trans_sz(abuf)))
+            {
+                trans = cerevoice_eng.CPRC_abuf_get_trans(abuf, i);
+                name = cerevoice_eng.CPRC_abuf_trans_name(trans);
+                start = cerevoice_eng.CPRC_abuf_trans_start(trans);
+                end = cerevoice_eng.CPRC_abuf_trans_end(trans);
 
-            PhonemeAnalyzer analyzer;
+                if (cerevoice_eng.CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_PHONE)
+                {
+                    sw.WriteLine(String.Format("INFO: phoneme: {0} {1} {2}", Math.Round(start, 3), Math.Round(end, 3), name));
+                    // the constructor rounds to 2 decimals, the analyzer gets the exact times as on a cache hit
+                    PhonemeInformation pi = new PhonemeInformation(0, 0, name);
+                    pi.startingInterval = start + offset;
+                    pi.endingInterval = end + offset;
+                    phonemes.Add(pi);
+                }
+                else if (cerevoice_eng.CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_WORD)
+                {
+                    sw.WriteLine(String.Format("INFO: word: {0} {1} {2}", Math.Round(start, 3), Math.Round(end, 3), name));
+                    words.Add(new WordInformation(start + offset, end + offset, name));
+                }
+                else if (cerevoice_eng.CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_TYPE.CPRC_ABUF_TRANS_MARK)
+                {
+                    sw.WriteLine(String.Format("INFO: marker: {0} {1} {2}", Math.Round(start, 3), Math.Round(end, 3), name));
+                }
+                else
+                {
+                    sw.WriteLine(String.Format("WARNING: transcription type: '{0}' not known", cerevoice_eng.CPRC_abuf_trans_type(trans)));
+                }
+            }
 
-            if (audioMode.Equals(AudioMode.CereVoice))
+            // Append generated audio to output file, riff_append reopens the file and is only the fallback
+            if (audioSink != null)
             {
-                analyzer = new PhonemeAnalyzer(AudioMode.CereVoice, null);
+                audioSink.Append(abuf);
             }
             else
             {
-                analyzer = new PhonemeAnalyzer(AudioMode.Natural, null);
+                cerevoice_eng.CPRC_riff_append(abuf, output_audio_path);
+            }
+
+            if (cache != null)
+            {
+                cache.RecordSpurt(abuf);
             }
 
-            analyzer.ManagePhonemeTimings(false, currentRecording);
+            // only the new spurt is analyzed and appended to the lip sync components
+            if (analyzer != null)
+            {
+                analyzer.AppendPhonemeTimings(phonemes, words);
+            }
 
         }
         catch (Exception e)
@@ -19,7 +19,69 @@ public class TextToSpeechProcess : MonoBehaviour {
     string output_file_path;
     public InputField inputText;
     public string inputFileName = "textToSpeak.xml";
+    public bool sharedMemory = true; // receive the spurts through a SpeechRing instead of audio.wav and phonemes.tl
+    public int outputRate = 0; // sample rate of the synthesized audio, 0 for the voice's (48 kHz)
+    public float targetLoudness = 0; // RMS level of the synthesized speech in dBFS, 0 to leave it as synthesized
+    public float slidingWindow = 500; // milliseconds, pitch and intensity weighting from the envelope of tts_callback
     SSMLGenerator ssml;
+    SpeechRing ring;
+
+    /// <summary>
+    /// Audio of the last utterance received through the ring, played by MyLipSync
+    /// instead of audio.wav. Null when the utterance was written to disk
+    /// </summary>
+    public static AudioClip synthesizedClip;
+
+    // options of the tts_callback.exe on disk, read from its usage on first use
+    static List<string> callbackOptions;
+
+    /// <summary>
+    /// Options tts_callback.exe understands, as listed by its usage. An executable built
+    /// before the timeline, cache, ring and post-processing options only knows -o and -p
+    /// and takes any other option for the voice file, so only listed options are passed
+    /// </summary>
+    /// <returns></returns>
+    static List<string> CallbackOptions()
+    {
+        if (callbackOptions != null)
+        {
+            return callbackOptions;
+        }
+
+        callbackOptions = new List<string>();
+        try
+        {
+            var probe = new Process
+            {
+                StartInfo = new ProcessStartInfo
+                {
+                    FileName = PathManager.GetCereVoicePath("tts_callback.exe"),
+                    Arguments = "-h",
+                    UseShellExecute = false,
+                    RedirectStandardError = true,
+                    CreateNoWindow = true,
+                    WindowStyle = ProcessWindowStyle.Hidden
+                }
+            };
+            probe.Start();
+
+            // option lines of the usage are " -x ..."
+            string line;
+            while ((line = probe.StandardError.ReadLine()) != null)
+            {
+                if (line.Length > 2 && line[0] == ' ' && line[1] == '-')
+                {
+                    callbackOptions.Add(line.Substring(1, 2));
+                }
+            }
+            probe.WaitForExit();
+        }
+        catch (Exception e)
+        {
+            print(e);
+        }
+        return callbackOptions;
+    }
 
     /// <summary>
     /// Configure arguments for ttscallback process
@@ -27,11 +89,44 @@ public class TextToSpeechProcess : MonoBehaviour {
     List<string> ConfigureArguments()
     {
         List<string> cmd_arguments = new List<string>();
+        List<string> options = CallbackOptions();
 
         // add command arguments for tts_callback proces
         cmd_arguments = new List<string>();
-        cmd_arguments.Add("-o"); // optional argument to write audio to fill
-        cmd_arguments.Add(PathManager.GetAudioPath("audio.wav")); // output audio path
+        if (ring != null)
+        {
+            cmd_arguments.Add("-m"); // audio and timeline of every spurt through shared memory
+            cmd_arguments.Add(ring.Name); // ring created by this process
+        }
+        else
+        {
+            cmd_arguments.Add("-o"); // optional argument to write audio to fill
+            cmd_arguments.Add(PathManager.GetAudioPath("audio.wav")); // output audio path
+            if (options.Contains("-t"))
+            {
+                cmd_arguments.Add("-t"); // binary phoneme/word timeline instead of printed transcription
+                cmd_arguments.Add(PathManager.GetDataPath("phonemes.tl")); // output timeline path
+            }
+        }
+        if (options.Contains("-e"))
+        {
+            cmd_arguments.Add("-e"); // F0 and loudness envelope, computed during synthesis
+        }
+        if (outputRate > 0 && options.Contains("-r"))
+        {
+            cmd_arguments.Add("-r"); // resampled during synthesis
+            cmd_arguments.Add(outputRate.ToString());
+        }
+        if (targetLoudness != 0 && options.Contains("-L"))
+        {
+            cmd_arguments.Add("-L"); // normalised during synthesis
+            cmd_arguments.Add(targetLoudness.ToString(System.Globalization.CultureInfo.InvariantCulture));
+        }
+        if (options.Contains("-c"))
+        {
+            cmd_arguments.Add("-c"); // repeated input is answered from the synthesis cache
+            cmd_arguments.Add(PathManager.GetCachePath("Synthesis")); // cache directory
+        }
         cmd_arguments.Add(PathManager.GetCereVoicePath("cerevoice_heather_3.2.0_48k.voice")); // voice path
         cmd_arguments.Add(PathManager.GetCereVoicePath("license.lic")); // license path
         cmd_arguments.Add(PathManager.GetDataPath(inputFileName)); // input text path
@@ -75,7 +170,21 @@ public class TextToSpeechProcess : MonoBehaviour {
     public void GenerateAudio()
     {
         GenerateInputFile();
+
+        synthesizedClip = null;
+        if (sharedMemory && CallbackOptions().Contains("-m"))
+        {
+            ring = SpeechRing.Create("unity_" + Process.GetCurrentProcess().Id);
+        }
+
+        // an old timeline would shadow the ring and phonemes.txt, with -t it is written again
+        string timelinePath = PathManager.GetDataPath("phonemes.tl");
+        if (File.Exists(timelinePath))
+        {
+            File.Delete(timelinePath);
+        }
         List<string> args = ConfigureArguments();
+        bool writesTimeline = ring == null && CallbackOptions().Contains("-t");
 
         // build input arguments into a single string
         string arguments = "";
@@ -110,16 +219,32 @@ public class TextToSpeechProcess : MonoBehaviour {
                     File.Delete(output_file_path);
                 }
 
-                // write phoneme information output to file
-                using (FileStream file_stream = File.Create(output_file_path))
+                if (ring != null)
+                {
+                    // the output is drained on its own so that tts_callback never blocks on it
+                    tts_callback.OutputDataReceived += (sender, e) => { };
+                    tts_callback.BeginOutputReadLine();
+                    ReceiveUtterance(tts_callback);
+                }
+                else if (writesTimeline)
+                {
+                    // the timeline is written by tts_callback itself, only drain the remaining output
+                    tts_callback.StandardOutput.ReadToEnd();
+                }
+                else
                 {
-                    while (!tts_callback.StandardOutput.EndOfStream)
+                    // write phoneme information output to file
+                    using (FileStream file_stream = File.Create(output_file_path))
                     {
-                        string cmd_line = tts_callback.StandardOutput.ReadLine();
-                        Byte[] line = new UTF8Encoding(true).GetBytes(cmd_line + "\n");
-                        file_stream.Write(line, 0, line.Length);
+                        while (!tts_callback.StandardOutput.EndOfStream)
+                        {
+                            string cmd_line = tts_callback.StandardOutput.ReadLine();
+                            Byte[] line = new UTF8Encoding(true).GetBytes(cmd_line + "\n");
+                            file_stream.Write(line, 0, line.Length);
+                        }
                     }
                 }
+                tts_callback.WaitForExit();
             }
             catch (Exception e)
             {
@@ -130,6 +255,62 @@ public class TextToSpeechProcess : MonoBehaviour {
         {
             print(e);
         }
+        finally
+        {
+            if (ring != null)
+            {
+                ring.Dispose();
+                ring = null;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Reads the spurts of tts_callback from the ring as they are synthesized. Each spurt
+    /// is analyzed and appended to the lip sync components on arrival; the audio is
+    /// collected into synthesizedClip when the utterance is done
+    /// </summary>
+    /// <param name="tts_callback"></param>
+    void ReceiveUtterance(Process tts_callback)
+    {
+        PhonemeAnalyzer analyzer = new PhonemeAnalyzer(AudioMode.CereVoice, null);
+        List<float> samples = new List<float>();
+        bool exited = false;
+
+        analyzer.BeginUtterance();
+        while (true)
+        {
+            SpeechRing.Spurt spurt = ring.Read(100);
+            if (spurt == null)
+            {
+                // once tts_callback has exited, whatever it wrote has been read
+                if (exited)
+                {
+                    print("ERROR: tts_callback exited before the end of the utterance");
+                    return;
+                }
+                exited = tts_callback.HasExited;
+                continue;
+            }
+            if (spurt.done)
+            {
+                break;
+            }
+
+            for (int i = 0; i < spurt.samples.Length; i++)
+            {
+                samples.Add(spurt.samples[i] / 32768.0f);
+            }
+            analyzer.AppendPhonemeTimings(spurt.phonemes, spurt.words);
+            analyzer.AppendEnvelope(spurt.frames);
+        }
+        analyzer.EndUtterance(slidingWindow);
+
+        if (samples.Count > 0)
+        {
+            synthesizedClip = AudioClip.Create("", samples.Count, 1, ring.SampleRate, false);
+            synthesizedClip.SetData(samples.ToArray(), 0);
+        }
     }
 
     
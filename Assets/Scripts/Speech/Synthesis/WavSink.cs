@@ -0,0 +1,108 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+///---------------------------------------------------------------------
+///   Class:        WavSink.cs
+///   Description:  Streaming WAV output of a synthesized utterance
+///                 (native tts_tools library, see
+///                 StreamingAssets/CereVoice/tts_wav.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Text to speech audio output
+///---------------------------------------------------------------------
+
+public class WavSink : IDisposable
+{
+    [DllImport("tts_tools")]
+    static extern IntPtr tts_wav_open(string path, int sampleRate, uint expectedSamples);
+
+    [DllImport("tts_tools")]
+    static extern int tts_wav_write(IntPtr writer, IntPtr samples, int n);
+
+    [DllImport("tts_tools")]
+    static extern int tts_wav_close(IntPtr writer);
+
+    IntPtr writer;
+
+    WavSink(IntPtr writer)
+    {
+        this.writer = writer;
+    }
+
+    /// <summary>
+    /// Creates the output file, kept open until Close.
+    /// Returns null if the native library is not available or the file cannot be created
+    /// </summary>
+    /// <param name="path"></param>
+    /// <param name="sampleRate"></param>
+    /// <returns></returns>
+    public static WavSink Open(string path, int sampleRate)
+    {
+        IntPtr writer;
+
+        try
+        {
+            writer = tts_wav_open(path, sampleRate, 0);
+        }
+        catch (DllNotFoundException)
+        {
+            return null;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return null;
+        }
+
+        return writer == IntPtr.Zero ? null : new WavSink(writer);
+    }
+
+    /// <summary>
+    /// Audio of a spurt as cued by the drivers (wav_mk to wav_done), in the engine buffer
+    /// </summary>
+    /// <param name="abuf"></param>
+    /// <param name="count"></param>
+    /// <returns></returns>
+    public static IntPtr SpurtAudio(SWIGTYPE_p_CPRC_abuf abuf, out int count)
+    {
+        int wavMark = Math.Max(cerevoice_eng.CPRC_abuf_wav_mk(abuf), 0);
+        int wavDone = Math.Max(cerevoice_eng.CPRC_abuf_wav_done(abuf), 0);
+        IntPtr data = SWIGTYPE_p_short.getCPtr(cerevoice_eng.CPRC_abuf_wav_data(abuf)).Handle;
+
+        count = Math.Max(wavDone - wavMark, 0);
+        return new IntPtr(data.ToInt64() + wavMark * sizeof(short));
+    }
+
+    /// <summary>
+    /// Appends the audio of a spurt, straight from the engine buffer
+    /// </summary>
+    /// <param name="abuf"></param>
+    public void Append(SWIGTYPE_p_CPRC_abuf abuf)
+    {
+        int count;
+        IntPtr samples = SpurtAudio(abuf, out count);
+        if (count > 0)
+        {
+            tts_wav_write(writer, samples, count);
+        }
+    }
+
+    /// <summary>
+    /// Writes the header sizes and closes the file, returns false if any audio was lost
+    /// </summary>
+    /// <returns></returns>
+    public bool Close()
+    {
+        if (writer == IntPtr.Zero)
+        {
+            return false;
+        }
+
+        int res = tts_wav_close(writer);
+        writer = IntPtr.Zero;
+        return res == 0;
+    }
+
+    public void Dispose()
+    {
+        Close();
+    }
+}
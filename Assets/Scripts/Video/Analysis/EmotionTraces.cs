@@ -0,0 +1,158 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+///---------------------------------------------------------------------
+///   Class:        EmotionTraces.cs
+///   Description:  Arousal/valence annotation traces sampled with linear
+///                 interpolation, and nearest emotion lookup in the
+///                 circumplex plane (native lipsync library, see
+///                 StreamingAssets/LipSync/lipsync_trace.h)
+///   Author:       Constantinos Charalambous     Date: 17/10/2026
+///   Notes:        Video emotion playback
+///---------------------------------------------------------------------
+
+public class EmotionTraces : IDisposable
+{
+    IntPtr traces;
+    IntPtr circumplex;
+    float[] values;
+
+    [DllImport("lipsync")]
+    static extern IntPtr ls_traces_new();
+
+    [DllImport("lipsync")]
+    static extern void ls_traces_delete(IntPtr traces);
+
+    [DllImport("lipsync")]
+    static extern int ls_traces_load(IntPtr traces, string path);
+
+    [DllImport("lipsync")]
+    static extern void ls_traces_sample(IntPtr traces, float time, float[] values);
+
+    [DllImport("lipsync")]
+    static extern IntPtr ls_circumplex_new(float[] arousal, float[] valence, int count, float maxDistance);
+
+    [DllImport("lipsync")]
+    static extern void ls_circumplex_delete(IntPtr circumplex);
+
+    [DllImport("lipsync")]
+    static extern int ls_circumplex_classify(IntPtr circumplex, float arousal, float valence, out float intensity);
+
+    EmotionTraces(IntPtr traces, int count)
+    {
+        this.traces = traces;
+        values = new float[count];
+    }
+
+    /// <summary>
+    /// Loads the traces of the given files, in order.
+    /// Returns null if the native library is not available or a file cannot be read
+    /// </summary>
+    /// <param name="files"></param>
+    /// <returns></returns>
+    public static EmotionTraces Load(string[] files)
+    {
+        IntPtr traces;
+        try
+        {
+            traces = ls_traces_new();
+        }
+        catch (DllNotFoundException)
+        {
+            return null;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return null;
+        }
+
+        foreach (string file in files)
+        {
+            if (ls_traces_load(traces, file) < 0)
+            {
+                UnityEngine.Debug.Log("Unable to read annotation trace " + file);
+                ls_traces_delete(traces);
+                return null;
+            }
+        }
+
+        return new EmotionTraces(traces, files.Length);
+    }
+
+    /// <summary>
+    /// Number of traces
+    /// </summary>
+    public int Count
+    {
+        get { return values.Length; }
+    }
+
+    /// <summary>
+    /// Values of all traces at time, in load order. The array is reused by the next call
+    /// </summary>
+    /// <param name="time">seconds</param>
+    /// <returns></returns>
+    public float[] Sample(float time)
+    {
+        ls_traces_sample(traces, time, values);
+        return values;
+    }
+
+    /// <summary>
+    /// Tabulates the nearest emotion over the arousal/valence plane
+    /// </summary>
+    /// <param name="emotions"></param>
+    /// <param name="maxDistance">points further from every emotion are not classified</param>
+    public void SetEmotions(List<BaseEmotion> emotions, float maxDistance)
+    {
+        float[] arousal = new float[emotions.Count];
+        float[] valence = new float[emotions.Count];
+        for (int i = 0; i < emotions.Count; i++)
+        {
+            arousal[i] = emotions[i].arousal;
+            valence[i] = emotions[i].valence;
+        }
+
+        if (circumplex != IntPtr.Zero)
+        {
+            ls_circumplex_delete(circumplex);
+        }
+        circumplex = ls_circumplex_new(arousal, valence, emotions.Count, maxDistance);
+    }
+
+    /// <summary>
+    /// Index of the emotion nearest to the point in the list given to SetEmotions, -1 for none
+    /// </summary>
+    /// <param name="arousal"></param>
+    /// <param name="valence"></param>
+    /// <param name="intensity">distance from the centre relative to the emotion's, at most 1</param>
+    /// <returns></returns>
+    public int Classify(float arousal, float valence, out float intensity)
+    {
+        if (circumplex == IntPtr.Zero)
+        {
+            intensity = 0;
+            return -1;
+        }
+
+        return ls_circumplex_classify(circumplex, arousal, valence, out intensity);
+    }
+
+    /// <summary>
+    /// Releases the native store
+    /// </summary>
+    public void Dispose()
+    {
+        if (circumplex != IntPtr.Zero)
+        {
+            ls_circumplex_delete(circumplex);
+            circumplex = IntPtr.Zero;
+        }
+        if (traces != IntPtr.Zero)
+        {
+            ls_traces_delete(traces);
+            traces = IntPtr.Zero;
+        }
+    }
+}
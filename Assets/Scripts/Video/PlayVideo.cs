@@ -19,8 +19,9 @@ public class PlayVideo : MonoBehaviour {
 
      // file urls
     string videoUrl = "2008.12.05.16.03.15_Operator_AV_lowQ_Poppy.avi";
-    string arousalFile = "R5S1TUCPoDA.txt";
-    string valenceFile = "R5S1TUCPoDV.txt";
+    // one arousal and one valence trace per annotator, played together
+    string[] arousalFiles = { "R5S1TUCPoDA.txt" };
+    string[] valenceFiles = { "R5S1TUCPoDV.txt" };
 
     private bool firstRun = true;
     private bool isPaused = false;
@@ -28,24 +29,49 @@ public class PlayVideo : MonoBehaviour {
     List<BaseEmotion> emotionDimensions;
 
     // emotion dimensions
-    Dictionary<float, float> arousal;
+    EmotionTraces traces; // arousal traces then valence traces
+    Dictionary<float, float> arousal; // first annotator, without the native library
     Dictionary<float, float> valence;
     float currentArousal;
     float currentValence;
 
     GameObject emotion;
+    GameObject[] emotionMarkers; // circumplex placeholder of each emotion
 
     private void Start()
     {
         videoElapsedTimer = 0.0f;
 
         // get arousal and valence values
-        arousal = ArousalValence.GetArousal(PathManager.GetSEMAINPath(arousalFile));
-        valence = ArousalValence.GetValence(PathManager.GetSEMAINPath(valenceFile));
+        string[] files = new string[arousalFiles.Length + valenceFiles.Length];
+        for (int i = 0; i < arousalFiles.Length; i++)
+        {
+            files[i] = PathManager.GetSEMAINPath(arousalFiles[i]);
+        }
+        for (int i = 0; i < valenceFiles.Length; i++)
+        {
+            files[arousalFiles.Length + i] = PathManager.GetSEMAINPath(valenceFiles[i]);
+        }
+
+        traces = EmotionTraces.Load(files);
+        if (traces == null)
+        {
+            arousal = ArousalValence.GetArousal(files[0]);
+            valence = ArousalValence.GetValence(files[arousalFiles.Length]);
+        }
         currentArousal = 0.0f;
         currentValence = 0.0f;
 
         emotionDimensions = CircumplexModel.GetEmotionDimensions();
+        emotionMarkers = new GameObject[emotionDimensions.Count];
+        for (int i = 0; i < emotionDimensions.Count; i++)
+        {
+            emotionMarkers[i] = GameObject.Find(emotionDimensions[i].name);
+        }
+        if (traces != null)
+        {
+            traces.SetEmotions(emotionDimensions, 1);
+        }
 
         // spawn emotion to be classified
         emotion = (GameObject)Instantiate(Resources.Load("DimensionPlaceholder"));
@@ -126,16 +152,34 @@ public class PlayVideo : MonoBehaviour {
                 TextMesh timerText = (TextMesh)videoTimerIndicator.GetComponent(typeof(TextMesh));
                 timerText.text = videoElapsedTimer.ToString("0.000");
 
-                float timeStamp = (float)Math.Truncate(videoElapsedTimer * 100) / 100;
-
-                if (arousal.ContainsKey(timeStamp))
+                if (traces != null)
                 {
-                    currentArousal = arousal[timeStamp];
+                    // mean of the annotators
+                    float[] values = traces.Sample(videoElapsedTimer);
+                    currentArousal = 0;
+                    currentValence = 0;
+                    for (int i = 0; i < arousalFiles.Length; i++)
+                    {
+                        currentArousal += values[i] / arousalFiles.Length;
+                    }
+                    for (int i = 0; i < valenceFiles.Length; i++)
+                    {
+                        currentValence += values[arousalFiles.Length + i] / valenceFiles.Length;
+                    }
                 }
-
-                if (valence.ContainsKey(timeStamp))
+                else
                 {
-                    currentValence = valence[timeStamp];
+                    float timeStamp = (float)Math.Truncate(videoElapsedTimer * 100) / 100;
+
+                    if (arousal.ContainsKey(timeStamp))
+                    {
+                        currentArousal = arousal[timeStamp];
+                    }
+
+                    if (valence.ContainsKey(timeStamp))
+                    {
+                        currentValence = valence[timeStamp];
+                    }
                 }
 
                 ClassifyEmotion(currentArousal, currentValence);
@@ -148,37 +192,65 @@ public class PlayVideo : MonoBehaviour {
 
     public void ClassifyEmotion(float arousal, float valence)
     {
-        float minDistance = 1;
-        string emotionClass = "NONE";
-        Vector2 dimensions = new Vector2(0,0);
+        int emotionIndex = -1;
+        float intensity;
 
-        foreach (BaseEmotion be in emotionDimensions)
+        if (traces != null)
+        {
+            // tabulated over the plane
+            emotionIndex = traces.Classify(arousal, valence, out intensity);
+        }
+        else
         {
-            float distance = (Mathf.Sqrt((arousal - be.arousal) * (arousal - be.arousal) + (valence - be.valence) * (valence - be.valence)));
-            if (distance < minDistance)
+            float minDistance = 1;
+            for (int i = 0; i < emotionDimensions.Count; i++)
             {
-                minDistance = distance;
-                emotionClass = be.name;
-                dimensions.x = be.arousal;
-                dimensions.y = be.valence;
+                BaseEmotion be = emotionDimensions[i];
+                float distance = (Mathf.Sqrt((arousal - be.arousal) * (arousal - be.arousal) + (valence - be.valence) * (valence - be.valence)));
+                if (distance < minDistance)
+                {
+                    minDistance = distance;
+                    emotionIndex = i;
+                }
             }
-        }
 
-        float classifiedDistance = (Mathf.Sqrt((arousal * arousal) + (valence * valence)));
-        float baseDistance = (Mathf.Sqrt((dimensions.x * dimensions.x) + (dimensions.y * dimensions.y)));
-        float intensity = classifiedDistance / baseDistance;
-        if (intensity > 1)
-        {
-            intensity = 1;
+            Vector2 dimensions = new Vector2(0, 0);
+            if (emotionIndex >= 0)
+            {
+                dimensions.x = emotionDimensions[emotionIndex].arousal;
+                dimensions.y = emotionDimensions[emotionIndex].valence;
+            }
+
+            float classifiedDistance = (Mathf.Sqrt((arousal * arousal) + (valence * valence)));
+            float baseDistance = (Mathf.Sqrt((dimensions.x * dimensions.x) + (dimensions.y * dimensions.y)));
+            intensity = classifiedDistance / baseDistance;
+            if (intensity > 1)
+            {
+                intensity = 1;
+            }
         }
 
+        string emotionClass = emotionIndex >= 0 ? emotionDimensions[emotionIndex].name : "NONE";
+
         TextMesh currentEmotion = (TextMesh)classificationIndicator.GetComponent(typeof(TextMesh));
         currentEmotion.text = string.Format("{0} with intensity {1}", emotionClass, intensity);
 
         // set classified emotions position in realtime
         emotion.transform.localPosition = new Vector3(valence * (-0.5f), -1f, arousal * (-0.5f));
 
-        Debug.DrawLine(emotion.transform.position, GameObject.Find(emotionClass).transform.position, Color.green);
+        if (emotionIndex >= 0 && emotionMarkers[emotionIndex] != null)
+        {
+            Debug.DrawLine(emotion.transform.position, emotionMarkers[emotionIndex].transform.position, Color.green);
+        }
+    }
+
+    private void OnDestroy()
+    {
+        if (traces != null)
+        {
+            traces.Dispose();
+            traces = null;
+        }
     }
 
 }
@@ -0,0 +1,51 @@
+/* CereVoice Audio API, as used by the drivers.
+
+   Declarations for building against the stub engine (cerevoice_stub.c),
+   whose player plays to no device: it only keeps the playback clock.
+   The SDK's own header replaces this one in a real build.
+*/
+
+#ifndef CEREVOICE_AUD_H
+#define CEREVOICE_AUD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct CPRC_sc_player CPRC_sc_player;
+typedef struct CPRC_sc_audio CPRC_sc_audio;
+
+enum CPRC_SC_AUDIO_STATUS {
+    CPRC_SC_NONE,
+    CPRC_SC_CUED,
+    CPRC_SC_PLAYING,
+    CPRC_SC_PLAYED,
+    CPRC_SC_ERROR
+};
+
+CPRC_sc_player * CPRC_sc_player_new(int srate);
+void CPRC_sc_player_delete(CPRC_sc_player * p);
+/* Audio buffers referring to the caller's samples; a disposable buffer
+   is freed by the player once cued, the other kind with
+   CPRC_sc_audio_delete. */
+CPRC_sc_audio * CPRC_sc_audio_short(short * data, int sz);
+CPRC_sc_audio * CPRC_sc_audio_short_disposable(short * data, int sz);
+void CPRC_sc_audio_delete(CPRC_sc_audio * a);
+int CPRC_sc_audio_cue(CPRC_sc_player * p, CPRC_sc_audio * a);
+int CPRC_sc_audio_status(CPRC_sc_audio * a);
+double CPRC_sc_audio_start_time(CPRC_sc_audio * a);
+int CPRC_sc_audio_busy(CPRC_sc_player * p);
+int CPRC_sc_audio_paused(CPRC_sc_player * p);
+int CPRC_sc_audio_pauseon(CPRC_sc_player * p);
+int CPRC_sc_audio_pauseoff(CPRC_sc_player * p);
+/* Playback position in samples from the start of the stream */
+double CPRC_sc_player_stream_time(CPRC_sc_player * p);
+double CPRC_sc_player_stream_duration(CPRC_sc_player * p);
+long CPRC_sc_player_samples_sent(CPRC_sc_player * p);
+void CPRC_sc_sleep_msecs(int ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CEREVOICE_AUD_H */
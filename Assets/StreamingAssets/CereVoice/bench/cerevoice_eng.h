@@ -0,0 +1,91 @@
+/* CereVoice Engine API, as used by the drivers.
+
+   Declarations for building against the stub engine (cerevoice_stub.c)
+   on machines without the CereVoice SDK.  Only the functions and types
+   the drivers call are declared; the SDK's own header replaces this one
+   in a real build.
+*/
+
+#ifndef CEREVOICE_ENG_H
+#define CEREVOICE_ENG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct CPRCEN_engine CPRCEN_engine;
+typedef struct CPRC_abuf CPRC_abuf;
+typedef struct CPRC_abuf_trans CPRC_abuf_trans;
+typedef int CPRCEN_channel_handle;
+
+typedef void (*cprcen_channel_callback)(CPRC_abuf * abuf, void * userdata);
+
+typedef enum CPRC_VOICE_LOAD_TYPE {
+    CPRC_VOICE_LOAD,
+    CPRC_VOICE_LOAD_EMB,
+    CPRC_VOICE_LOAD_EMB_AUDIO,
+    CPRC_VOICE_LOAD_TP
+} CPRC_VOICE_LOAD_TYPE;
+
+typedef enum CPRC_ABUF_TRANS_TYPE {
+    CPRC_ABUF_TRANS_PHONE,
+    CPRC_ABUF_TRANS_WORD,
+    CPRC_ABUF_TRANS_MARK,
+    CPRC_ABUF_TRANS_ERROR,
+    CPRC_ABUF_TRANS_TYPES
+} CPRC_ABUF_TRANS_TYPE;
+
+typedef enum CPRCEN_AUDIO_FORMAT {
+    CPRCEN_RAW,
+    CPRCEN_RIFF,
+    CPRCEN_AIFF
+} CPRCEN_AUDIO_FORMAT;
+
+/* Engine and voices */
+CPRCEN_engine * CPRCEN_engine_new(void);
+void CPRCEN_engine_delete(CPRCEN_engine * eng);
+int CPRCEN_engine_load_voice(CPRCEN_engine * eng, const char * licensef, const char * configf,
+                             const char * voicef, CPRC_VOICE_LOAD_TYPE load_type);
+int CPRCEN_engine_load_user_lexicon(CPRCEN_engine * eng, int voice_index, const char * fname);
+const char * CPRCEN_engine_get_voice_info(CPRCEN_engine * eng, int voice_index, const char * key);
+
+/* Channels */
+CPRCEN_channel_handle CPRCEN_engine_open_channel(CPRCEN_engine * eng, const char * iso_language_code,
+                                                 const char * iso_region_code, const char * voice_name,
+                                                 const char * srate);
+CPRCEN_channel_handle CPRCEN_engine_open_default_channel(CPRCEN_engine * eng);
+int CPRCEN_engine_channel_reset(CPRCEN_engine * eng, CPRCEN_channel_handle chan);
+int CPRCEN_engine_channel_close(CPRCEN_engine * eng, CPRCEN_channel_handle chan);
+const char * CPRCEN_channel_get_voice_info(CPRCEN_engine * eng, CPRCEN_channel_handle chan, const char * key);
+int CPRCEN_channel_set_phone_min_max(CPRCEN_engine * eng, CPRCEN_channel_handle chan, int min, int max);
+int CPRCEN_engine_set_callback(CPRCEN_engine * eng, CPRCEN_channel_handle chan, void * userdata,
+                               cprcen_channel_callback callback);
+int CPRCEN_engine_clear_callback(CPRCEN_engine * eng, CPRCEN_channel_handle chan);
+void * CPRCEN_engine_get_channel_userdata(CPRCEN_engine * eng, CPRCEN_channel_handle chan);
+int CPRCEN_engine_channel_to_file(CPRCEN_engine * eng, CPRCEN_channel_handle chan, const char * fname,
+                                  CPRCEN_AUDIO_FORMAT format);
+int CPRCEN_engine_channel_no_file(CPRCEN_engine * eng, CPRCEN_channel_handle chan);
+CPRC_abuf * CPRCEN_engine_channel_speak(CPRCEN_engine * eng, CPRCEN_channel_handle chan,
+                                        const char * text, int textlen, int flush);
+
+/* Audio buffers and their transcription */
+int CPRC_abuf_trans_sz(CPRC_abuf * ab);
+const CPRC_abuf_trans * CPRC_abuf_get_trans(CPRC_abuf * ab, int i);
+CPRC_ABUF_TRANS_TYPE CPRC_abuf_trans_type(const CPRC_abuf_trans * t);
+const char * CPRC_abuf_trans_name(const CPRC_abuf_trans * t);
+float CPRC_abuf_trans_start(const CPRC_abuf_trans * t);
+float CPRC_abuf_trans_end(const CPRC_abuf_trans * t);
+int CPRC_abuf_wav_sz(CPRC_abuf * ab);
+short CPRC_abuf_wav(CPRC_abuf * ab, int i);
+short * CPRC_abuf_wav_data(CPRC_abuf * ab);
+int CPRC_abuf_wav_mk(CPRC_abuf * ab);
+int CPRC_abuf_wav_done(CPRC_abuf * ab);
+int CPRC_abuf_wav_srate(CPRC_abuf * ab);
+int CPRC_riff_save(CPRC_abuf * wav, const char * fname);
+int CPRC_riff_append(CPRC_abuf * wav, const char * fname);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CEREVOICE_ENG_H */
@@ -0,0 +1,654 @@
+/* Stub CereVoice Engine and Audio libraries.
+
+   Implements the calls of cerevoice_eng.h and cerevoice_aud.h that the
+   drivers make, so that they can be built and benchmarked without the
+   CereVoice runtime.  Output is synthetic but deterministic: the same
+   text always gives the same spurts, transcription and samples.
+
+   Text is split into spurts at sentence ends ('.', '!' or '?' followed
+   by a space) and at flush, like the engine's phrase-by-phrase
+   callbacks.  Each spurt starts and ends with a "sil" phone; every
+   letter of a word becomes one phone of the CereVoice English set,
+   vowels a 120 Hz triangle wave and consonants low-level noise.
+   <mark name="..."/> tags become markers, other tags are skipped.
+
+   Environment:
+     CEREVOICE_STUB_RATE      sample rate (default 48000)
+     CEREVOICE_STUB_PHONE_MS  duration of a phone (default 70)
+     CEREVOICE_STUB_SPEED     synthesis speed as a multiple of realtime;
+                              each spurt is delayed by its duration over
+                              the speed.  0 returns at once (default)
+
+   The voice file must exist, its content is not read.  The player
+   plays to no device, it only advances its clock in real time.
+
+   Build, in place of the SDK libraries:
+     gcc -O2 -I<this dir> -I.. ... ../tts_callback.c ... cerevoice_stub.c -lpthread
+   (see run_bench.sh)
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "cerevoice_eng.h"
+#include "cerevoice_aud.h"
+#include "tts_thread.h"
+
+#ifndef WIN32
+#include <time.h>
+#endif
+
+#define STUB_MAX_CHANNELS 64
+#define STUB_NAME_SIZE 64
+
+struct CPRC_abuf_trans {
+    CPRC_ABUF_TRANS_TYPE type;
+    float start;
+    float end;
+    char name[STUB_NAME_SIZE];
+};
+
+struct CPRC_abuf {
+    short * wav;
+    int wav_sz, wav_cap;
+    CPRC_abuf_trans * trans;
+    int trans_sz, trans_cap;
+    int srate;
+};
+
+typedef struct stub_channel {
+    int open;
+    char * pending;            /* text not yet part of a spurt */
+    int pending_sz, pending_cap;
+    CPRC_abuf abuf;            /* reused for every spurt */
+    cprcen_channel_callback callback;
+    void * userdata;
+    char * file;
+    unsigned int noise;
+} stub_channel;
+
+struct CPRCEN_engine {
+    int loaded;
+    int srate;
+    int phone_samples;
+    double speed;
+    char srate_str[16];
+    stub_channel channels[STUB_MAX_CHANNELS];
+};
+
+/* CereVoice phone of each letter, close enough to keep viseme mappings busy */
+static const char * letter_phones[26] = {
+    "a", "b", "k", "d", "e", "f", "g", "h", "i", "jh", "k", "l", "m",
+    "n", "o", "p", "k", "r", "s", "t", "uh", "v", "w", "k", "y", "z"
+};
+
+static double env_number(const char * name, double def) {
+    const char * v = getenv(name);
+    return v && *v ? atof(v) : def;
+}
+
+static void sleep_seconds(double s) {
+#ifndef WIN32
+    struct timespec ts;
+    if (s <= 0) return;
+    ts.tv_sec = (time_t) s;
+    ts.tv_nsec = (long) ((s - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+#else
+    if (s > 0) Sleep((DWORD) (s * 1000));
+#endif
+}
+
+static stub_channel * channel_of(CPRCEN_engine * eng, CPRCEN_channel_handle chan) {
+    if (!eng || chan < 1 || chan > STUB_MAX_CHANNELS || !eng->channels[chan - 1].open) return NULL;
+    return &eng->channels[chan - 1];
+}
+
+/* Synthesis */
+
+static void add_trans(CPRC_abuf * ab, CPRC_ABUF_TRANS_TYPE type, int start, int end, const char * name, int len) {
+    CPRC_abuf_trans * t;
+    if (ab->trans_sz == ab->trans_cap) {
+        ab->trans_cap = ab->trans_cap ? ab->trans_cap * 2 : 64;
+        ab->trans = realloc(ab->trans, ab->trans_cap * sizeof(CPRC_abuf_trans));
+    }
+    t = &ab->trans[ab->trans_sz++];
+    t->type = type;
+    t->start = start / (float) ab->srate;
+    t->end = end / (float) ab->srate;
+    if (len >= STUB_NAME_SIZE) len = STUB_NAME_SIZE - 1;
+    memcpy(t->name, name, len);
+    t->name[len] = '\0';
+}
+
+static int is_vowel(const char * phone) {
+    return strchr("aeiou", phone[0]) != NULL;
+}
+
+/* Appends one phone of audio and its transcription */
+static void add_phone(CPRCEN_engine * eng, stub_channel * ch, const char * phone) {
+    CPRC_abuf * ab = &ch->abuf;
+    int n = eng->phone_samples, i, period, pos;
+    short * out;
+
+    if (ab->wav_sz + n > ab->wav_cap) {
+        while (ab->wav_sz + n > ab->wav_cap) ab->wav_cap = ab->wav_cap ? ab->wav_cap * 2 : 1 << 16;
+        ab->wav = realloc(ab->wav, ab->wav_cap * sizeof(short));
+    }
+    out = ab->wav + ab->wav_sz;
+    period = ab->srate / 120;
+    for (i = 0; i < n; i++) {
+        if (strcmp(phone, "sil") == 0) {
+            out[i] = 0;
+        } else if (is_vowel(phone)) {
+            pos = (ab->wav_sz + i) % period;
+            out[i] = (short) ((pos < period / 2 ? pos : period - pos) * 32000 / period - 8000);
+        } else {
+            ch->noise = ch->noise * 1103515245u + 12345u;
+            out[i] = (short) ((int) ((ch->noise >> 16) & 0x7fff) / 8 - 2048);
+        }
+    }
+    add_trans(ab, CPRC_ABUF_TRANS_PHONE, ab->wav_sz, ab->wav_sz + n, phone, (int) strlen(phone));
+    ab->wav_sz += n;
+}
+
+/* Value of name="..." in a tag, or NULL */
+static const char * tag_name(const char * tag, const char * end, int * len) {
+    const char * p;
+    char q;
+    for (p = tag; p + 5 < end; p++) {
+        if (strncmp(p, "name=", 5) != 0) continue;
+        q = p[5];
+        if (q != '"' && q != '\'') return NULL;
+        p += 6;
+        *len = 0;
+        while (p + *len < end && p[*len] != q) (*len)++;
+        return p;
+    }
+    return NULL;
+}
+
+/* Renders text into the channel's audio buffer and hands it over */
+static void render_spurt(CPRCEN_engine * eng, stub_channel * ch, const char * text, int len) {
+    CPRC_abuf * ab = &ch->abuf;
+    const char * p = text, * end = text + len, * w, * name;
+    double started = tts_clock_seconds(), duration;
+    int word, namelen;
+
+    ab->wav_sz = 0;
+    ab->trans_sz = 0;
+    ab->srate = eng->srate;
+    add_phone(eng, ch, "sil");
+    while (p < end) {
+        if (*p == '<') {
+            w = memchr(p, '>', end - p);
+            if (!w) break;
+            if (strncmp(p, "<mark", 5) == 0 && (name = tag_name(p, w, &namelen)))
+                add_trans(ab, CPRC_ABUF_TRANS_MARK, ab->wav_sz, ab->wav_sz, name, namelen);
+            p = w + 1;
+        } else if (isspace((unsigned char) *p)) {
+            p++;
+        } else {
+            w = p;
+            while (p < end && *p != '<' && !isspace((unsigned char) *p)) p++;
+            /* the word comes before its phones, without punctuation */
+            name = w;
+            namelen = (int) (p - w);
+            while (namelen > 0 && !isalnum((unsigned char) *name)) { name++; namelen--; }
+            while (namelen > 0 && !isalnum((unsigned char) name[namelen - 1])) namelen--;
+            if (namelen == 0) continue;
+            word = ab->trans_sz;
+            add_trans(ab, CPRC_ABUF_TRANS_WORD, ab->wav_sz, ab->wav_sz, name, namelen);
+            for (; name < p; name++) {
+                if (isalpha((unsigned char) *name))
+                    add_phone(eng, ch, letter_phones[tolower((unsigned char) *name) - 'a']);
+            }
+            ab->trans[word].end = ab->wav_sz / (float) ab->srate;
+        }
+    }
+    add_phone(eng, ch, "sil");
+
+    /* an engine running at the configured multiple of realtime */
+    if (eng->speed > 0) {
+        duration = ab->wav_sz / (double) ab->srate / eng->speed;
+        sleep_seconds(started + duration - tts_clock_seconds());
+    }
+    if (ch->file) CPRC_riff_append(ab, ch->file);
+    if (ch->callback) ch->callback(ab, ch->userdata);
+}
+
+/* End of the first complete sentence of the pending text, or 0 */
+static int sentence_end(const char * text, int len) {
+    int i;
+    for (i = 0; i + 1 < len; i++) {
+        if ((text[i] == '.' || text[i] == '!' || text[i] == '?') && isspace((unsigned char) text[i + 1]))
+            return i + 1;
+    }
+    return 0;
+}
+
+static int has_words(const char * text, int len) {
+    int i;
+    for (i = 0; i < len; i++) {
+        if (isalpha((unsigned char) text[i])) return 1;
+    }
+    return 0;
+}
+
+/* Engine */
+
+CPRCEN_engine * CPRCEN_engine_new(void) {
+    CPRCEN_engine * eng = calloc(1, sizeof(CPRCEN_engine));
+    eng->srate = (int) env_number("CEREVOICE_STUB_RATE", 48000);
+    if (eng->srate < 8000) eng->srate = 8000;
+    eng->phone_samples = (int) (env_number("CEREVOICE_STUB_PHONE_MS", 70) * eng->srate / 1000);
+    if (eng->phone_samples < 1) eng->phone_samples = 1;
+    eng->speed = env_number("CEREVOICE_STUB_SPEED", 0);
+    sprintf(eng->srate_str, "%d", eng->srate);
+    return eng;
+}
+
+void CPRCEN_engine_delete(CPRCEN_engine * eng) {
+    int i;
+    if (!eng) return;
+    for (i = 1; i <= STUB_MAX_CHANNELS; i++) {
+        CPRCEN_engine_channel_close(eng, i);
+    }
+    free(eng);
+}
+
+int CPRCEN_engine_load_voice(CPRCEN_engine * eng, const char * licensef, const char * configf,
+                             const char * voicef, CPRC_VOICE_LOAD_TYPE load_type) {
+    FILE * fp;
+    (void) licensef; (void) configf; (void) load_type;
+    fp = voicef ? fopen(voicef, "rb") : NULL;
+    if (!fp) return 0;
+    fclose(fp);
+    eng->loaded = 1;
+    return 1;
+}
+
+int CPRCEN_engine_load_user_lexicon(CPRCEN_engine * eng, int voice_index, const char * fname) {
+    FILE * fp;
+    (void) voice_index;
+    if (!eng->loaded || !(fp = fopen(fname, "rb"))) return 0;
+    fclose(fp);
+    return 1;
+}
+
+const char * CPRCEN_engine_get_voice_info(CPRCEN_engine * eng, int voice_index, const char * key) {
+    (void) voice_index;
+    if (!eng->loaded) return NULL;
+    if (strcmp(key, "SAMPLE_RATE") == 0) return eng->srate_str;
+    if (strcmp(key, "VOICE_NAME") == 0) return "stub";
+    if (strcmp(key, "LANGUAGE_CODE_ISO") == 0) return "en";
+    if (strcmp(key, "COUNTRY_CODE_ISO") == 0) return "GB";
+    return "";
+}
+
+/* Channels */
+
+CPRCEN_channel_handle CPRCEN_engine_open_channel(CPRCEN_engine * eng, const char * iso_language_code,
+                                                 const char * iso_region_code, const char * voice_name,
+                                                 const char * srate) {
+    (void) iso_language_code; (void) iso_region_code; (void) voice_name; (void) srate;
+    return CPRCEN_engine_open_default_channel(eng);
+}
+
+CPRCEN_channel_handle CPRCEN_engine_open_default_channel(CPRCEN_engine * eng) {
+    int i;
+    if (!eng->loaded) return 0;
+    for (i = 0; i < STUB_MAX_CHANNELS; i++) {
+        if (eng->channels[i].open) continue;
+        memset(&eng->channels[i], 0, sizeof(stub_channel));
+        eng->channels[i].open = 1;
+        eng->channels[i].noise = 1;
+        return i + 1;
+    }
+    return 0;
+}
+
+int CPRCEN_engine_channel_reset(CPRCEN_engine * eng, CPRCEN_channel_handle chan) {
+    stub_channel * ch = channel_of(eng, chan);
+    if (!ch) return 0;
+    ch->pending_sz = 0;
+    ch->noise = 1;
+    return 1;
+}
+
+int CPRCEN_engine_channel_close(CPRCEN_engine * eng, CPRCEN_channel_handle chan) {
+    stub_channel * ch = channel_of(eng, chan);
+    if (!ch) return 0;
+    free(ch->pending);
+    free(ch->abuf.wav);
+    free(ch->abuf.trans);
+    free(ch->file);
+    memset(ch, 0, sizeof(stub_channel));
+    return 1;
+}
+
+const char * CPRCEN_channel_get_voice_info(CPRCEN_engine * eng, CPRCEN_channel_handle chan, const char * key) {
+    if (!channel_of(eng, chan)) return NULL;
+    return CPRCEN_engine_get_voice_info(eng, 0, key);
+}
+
+int CPRCEN_channel_set_phone_min_max(CPRCEN_engine * eng, CPRCEN_channel_handle chan, int min, int max) {
+    /* spurts are always returned whole, wav_mk and wav_done span them */
+    (void) min; (void) max;
+    return channel_of(eng, chan) != NULL;
+}
+
+int CPRCEN_engine_set_callback(CPRCEN_engine * eng, CPRCEN_channel_handle chan, void * userdata,
+                               cprcen_channel_callback callback) {
+    stub_channel * ch = channel_of(eng, chan);
+    if (!ch) return 0;
+    ch->callback = callback;
+    ch->userdata = userdata;
+    return 1;
+}
+
+int CPRCEN_engine_clear_callback(CPRCEN_engine * eng, CPRCEN_channel_handle chan) {
+    return CPRCEN_engine_set_callback(eng, chan, NULL, NULL);
+}
+
+void * CPRCEN_engine_get_channel_userdata(CPRCEN_engine * eng, CPRCEN_channel_handle chan) {
+    stub_channel * ch = channel_of(eng, chan);
+    return ch ? ch->userdata : NULL;
+}
+
+int CPRCEN_engine_channel_to_file(CPRCEN_engine * eng, CPRCEN_channel_handle chan, const char * fname,
+                                  CPRCEN_AUDIO_FORMAT format) {
+    stub_channel * ch = channel_of(eng, chan);
+    FILE * fp;
+    if (!ch || format != CPRCEN_RIFF) return 0;
+    /* spurts are appended, start from an empty file */
+    fp = fopen(fname, "wb");
+    if (!fp) return 0;
+    fclose(fp);
+    free(ch->file);
+    ch->file = malloc(strlen(fname) + 1);
+    strcpy(ch->file, fname);
+    return 1;
+}
+
+int CPRCEN_engine_channel_no_file(CPRCEN_engine * eng, CPRCEN_channel_handle chan) {
+    stub_channel * ch = channel_of(eng, chan);
+    if (!ch) return 0;
+    free(ch->file);
+    ch->file = NULL;
+    return 1;
+}
+
+CPRC_abuf * CPRCEN_engine_channel_speak(CPRCEN_engine * eng, CPRCEN_channel_handle chan,
+                                        const char * text, int textlen, int flush) {
+    stub_channel * ch = channel_of(eng, chan);
+    CPRC_abuf * last = NULL;
+    int n;
+
+    if (!ch) return NULL;
+    if (textlen < 0) textlen = (int) strlen(text);
+    if (ch->pending_sz + textlen > ch->pending_cap) {
+        ch->pending_cap = (ch->pending_sz + textlen) * 2 + 256;
+        ch->pending = realloc(ch->pending, ch->pending_cap);
+    }
+    memcpy(ch->pending + ch->pending_sz, text, textlen);
+    ch->pending_sz += textlen;
+
+    while ((n = sentence_end(ch->pending, ch->pending_sz)) > 0 || (flush && ch->pending_sz > 0)) {
+        if (n == 0) n = ch->pending_sz;
+        if (has_words(ch->pending, n)) {
+            render_spurt(eng, ch, ch->pending, n);
+            last = &ch->abuf;
+        }
+        memmove(ch->pending, ch->pending + n, ch->pending_sz - n);
+        ch->pending_sz -= n;
+    }
+    return last;
+}
+
+/* Audio buffers */
+
+int CPRC_abuf_trans_sz(CPRC_abuf * ab) {
+    return ab->trans_sz;
+}
+
+const CPRC_abuf_trans * CPRC_abuf_get_trans(CPRC_abuf * ab, int i) {
+    return i >= 0 && i < ab->trans_sz ? &ab->trans[i] : NULL;
+}
+
+CPRC_ABUF_TRANS_TYPE CPRC_abuf_trans_type(const CPRC_abuf_trans * t) {
+    return t ? t->type : CPRC_ABUF_TRANS_ERROR;
+}
+
+const char * CPRC_abuf_trans_name(const CPRC_abuf_trans * t) {
+    return t ? t->name : "";
+}
+
+float CPRC_abuf_trans_start(const CPRC_abuf_trans * t) {
+    return t ? t->start : 0;
+}
+
+float CPRC_abuf_trans_end(const CPRC_abuf_trans * t) {
+    return t ? t->end : 0;
+}
+
+int CPRC_abuf_wav_sz(CPRC_abuf * ab) {
+    return ab->wav_sz;
+}
+
+short CPRC_abuf_wav(CPRC_abuf * ab, int i) {
+    return i >= 0 && i < ab->wav_sz ? ab->wav[i] : 0;
+}
+
+short * CPRC_abuf_wav_data(CPRC_abuf * ab) {
+    return ab->wav;
+}
+
+int CPRC_abuf_wav_mk(CPRC_abuf * ab) {
+    (void) ab;
+    return 0;
+}
+
+int CPRC_abuf_wav_done(CPRC_abuf * ab) {
+    return ab->wav_sz;
+}
+
+int CPRC_abuf_wav_srate(CPRC_abuf * ab) {
+    return ab->srate;
+}
+
+static void put_u16(unsigned char * p, unsigned int v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32(unsigned char * p, unsigned long v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+/* 16 bit mono PCM */
+static void riff_header(unsigned char * h, int srate, unsigned long samples) {
+    memcpy(h, "RIFF", 4);
+    put_u32(h + 4, 36 + samples * 2);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_u32(h + 16, 16);
+    put_u16(h + 20, 1);
+    put_u16(h + 22, 1);
+    put_u32(h + 24, srate);
+    put_u32(h + 28, srate * 2);
+    put_u16(h + 32, 2);
+    put_u16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    put_u32(h + 40, samples * 2);
+}
+
+int CPRC_riff_save(CPRC_abuf * wav, const char * fname) {
+    unsigned char h[44];
+    FILE * fp = fopen(fname, "wb");
+    int ok;
+    if (!fp) return 0;
+    riff_header(h, wav->srate, wav->wav_sz);
+    ok = fwrite(h, 1, 44, fp) == 44 && fwrite(wav->wav, sizeof(short), wav->wav_sz, fp) == (size_t) wav->wav_sz;
+    return fclose(fp) == 0 && ok;
+}
+
+/* Like the engine: reopens the file, appends and rewrites the header */
+int CPRC_riff_append(CPRC_abuf * wav, const char * fname) {
+    unsigned char h[44];
+    FILE * fp = fopen(fname, "r+b");
+    long size;
+    int ok;
+    if (!fp) return CPRC_riff_save(wav, fname);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    if (size < 44) {
+        fclose(fp);
+        return CPRC_riff_save(wav, fname);
+    }
+    ok = fwrite(wav->wav, sizeof(short), wav->wav_sz, fp) == (size_t) wav->wav_sz;
+    riff_header(h, wav->srate, (unsigned long) (size - 44) / 2 + wav->wav_sz);
+    fseek(fp, 0, SEEK_SET);
+    ok = ok && fwrite(h, 1, 44, fp) == 44;
+    return fclose(fp) == 0 && ok;
+}
+
+/* Audio player, keeps the clock of a device playing in real time */
+
+struct CPRC_sc_player {
+    tts_mutex lock;
+    int srate;
+    long sent;          /* samples cued */
+    long base;          /* position when the clock was last started */
+    double started;     /* clock start, 0 while idle or paused */
+    int paused;
+};
+
+struct CPRC_sc_audio {
+    int sz;
+    int disposable;
+    CPRC_sc_player * player;
+    long start;         /* stream position once cued */
+};
+
+/* Called with the lock held */
+static long player_position(CPRC_sc_player * p) {
+    long pos = p->base;
+    if (p->started > 0) pos += (long) ((tts_clock_seconds() - p->started) * p->srate);
+    if (pos >= p->sent) {
+        /* underrun: the clock waits for the next cue */
+        pos = p->sent;
+        p->base = pos;
+        p->started = 0;
+    }
+    return pos;
+}
+
+CPRC_sc_player * CPRC_sc_player_new(int srate) {
+    CPRC_sc_player * p = calloc(1, sizeof(CPRC_sc_player));
+    tts_mutex_init(&p->lock);
+    p->srate = srate > 0 ? srate : 48000;
+    return p;
+}
+
+void CPRC_sc_player_delete(CPRC_sc_player * p) {
+    if (!p) return;
+    tts_mutex_destroy(&p->lock);
+    free(p);
+}
+
+CPRC_sc_audio * CPRC_sc_audio_short(short * data, int sz) {
+    CPRC_sc_audio * a = calloc(1, sizeof(CPRC_sc_audio));
+    (void) data;
+    a->sz = sz > 0 ? sz : 0;
+    return a;
+}
+
+CPRC_sc_audio * CPRC_sc_audio_short_disposable(short * data, int sz) {
+    CPRC_sc_audio * a = CPRC_sc_audio_short(data, sz);
+    a->disposable = 1;
+    return a;
+}
+
+void CPRC_sc_audio_delete(CPRC_sc_audio * a) {
+    free(a);
+}
+
+int CPRC_sc_audio_cue(CPRC_sc_player * p, CPRC_sc_audio * a) {
+    if (!p || !a) return 0;
+    tts_mutex_lock(&p->lock);
+    player_position(p);
+    a->player = p;
+    a->start = p->sent;
+    p->sent += a->sz;
+    if (p->started == 0 && !p->paused) p->started = tts_clock_seconds();
+    tts_mutex_unlock(&p->lock);
+    if (a->disposable) free(a);
+    return 1;
+}
+
+int CPRC_sc_audio_status(CPRC_sc_audio * a) {
+    long pos;
+    if (!a->player) return CPRC_SC_NONE;
+    tts_mutex_lock(&a->player->lock);
+    pos = player_position(a->player);
+    tts_mutex_unlock(&a->player->lock);
+    if (pos < a->start) return CPRC_SC_CUED;
+    return pos < a->start + a->sz ? CPRC_SC_PLAYING : CPRC_SC_PLAYED;
+}
+
+double CPRC_sc_audio_start_time(CPRC_sc_audio * a) {
+    return a->player ? a->start / (double) a->player->srate : 0;
+}
+
+int CPRC_sc_audio_busy(CPRC_sc_player * p) {
+    int busy;
+    tts_mutex_lock(&p->lock);
+    busy = player_position(p) < p->sent;
+    tts_mutex_unlock(&p->lock);
+    return busy;
+}
+
+int CPRC_sc_audio_paused(CPRC_sc_player * p) {
+    return p->paused;
+}
+
+int CPRC_sc_audio_pauseon(CPRC_sc_player * p) {
+    tts_mutex_lock(&p->lock);
+    p->base = player_position(p);
+    p->started = 0;
+    p->paused = 1;
+    tts_mutex_unlock(&p->lock);
+    return 1;
+}
+
+int CPRC_sc_audio_pauseoff(CPRC_sc_player * p) {
+    tts_mutex_lock(&p->lock);
+    p->paused = 0;
+    if (p->base < p->sent) p->started = tts_clock_seconds();
+    tts_mutex_unlock(&p->lock);
+    return 1;
+}
+
+double CPRC_sc_player_stream_time(CPRC_sc_player * p) {
+    long pos;
+    tts_mutex_lock(&p->lock);
+    pos = player_position(p);
+    tts_mutex_unlock(&p->lock);
+    return (double) pos;
+}
+
+double CPRC_sc_player_stream_duration(CPRC_sc_player * p) {
+    return p->sent / (double) p->srate;
+}
+
+long CPRC_sc_player_samples_sent(CPRC_sc_player * p) {
+    return p->sent;
+}
+
+void CPRC_sc_sleep_msecs(int ms) {
+    sleep_seconds(ms / 1000.0);
+}
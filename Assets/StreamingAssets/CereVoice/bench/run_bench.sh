@@ -0,0 +1,164 @@
+#!/bin/sh
+# Benchmarks tts_callback and tts_sync against the stub engine.
+#
+# Builds both drivers with cerevoice_stub.c and the allocation counters
+# of tts_bench.c, runs them over a fixed set of inputs with -j, and
+# gathers the per-run statistics into one JSON file (see tts_bench.h).
+# With -b the results are compared with an earlier run and the script
+# fails if a scenario got slower, allocates more or uses more memory
+# than the tolerance allows.
+#
+# usage: run_bench.sh [-o results.json] [-b baseline.json] [-t percent]
+#                     [-s speed] [-k]
+#   -o  results file (default: bench_results.json)
+#   -b  baseline results to gate against
+#   -t  tolerated regression in percent (default: 10)
+#   -s  stub synthesis speed, multiple of realtime (default: 40)
+#   -k  keep the work directory
+
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+src=$(dirname "$here")
+out=bench_results.json
+baseline=
+tolerance=10
+speed=40
+keep=
+
+while getopts "o:b:t:s:kh" opt; do
+    case $opt in
+        o) out=$OPTARG ;;
+        b) baseline=$OPTARG ;;
+        t) tolerance=$OPTARG ;;
+        s) speed=$OPTARG ;;
+        k) keep=1 ;;
+        *) sed -n '2,17s/^# \{0,1\}//p' "$0"; exit 0 ;;
+    esac
+done
+
+work=$(mktemp -d "${TMPDIR:-/tmp}/tts_bench.XXXXXX")
+trap '[ -n "$keep" ] || rm -rf "$work"' EXIT
+[ -n "$keep" ] && echo "INFO: work directory $work" >&2
+
+# Build
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+wrap="-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free"
+common="$src/tts_timeline.c $src/tts_wav.c $src/tts_arena.c $src/tts_audio.c $src/tts_bench.c $here/cerevoice_stub.c"
+ls="$src/../LipSync"
+post="$src/tts_post.c $ls/lipsync_pitch.c $ls/lipsync_prosody.c $ls/lipsync_aggregate.c $ls/lipsync_phoneme.c $ls/lipsync_audio.c $ls/lipsync_rig.c"
+echo "INFO: building the drivers with the stub engine" >&2
+$CC $CFLAGS -std=gnu99 -msse2 -DTTS_BENCH_ALLOC -I"$here" -I"$src" -I"$ls" -o "$work/tts_callback" \
+    "$src/tts_callback.c" "$src/tts_batch.c" "$src/tts_pool.c" "$src/tts_server.c" \
+    "$src/tts_cache.c" "$src/tts_sched.c" "$src/tts_split.c" "$src/tts_ring.c" $post $common $wrap -lpthread -lm
+$CC $CFLAGS -std=gnu99 -DTTS_BENCH_ALLOC -I"$here" -I"$src" -o "$work/tts_sync" \
+    "$src/tts_sync.c" "$src/tts_sched.c" "$src/tts_pool.c" "$src/tts_cache.c" "$src/tts_split.c" \
+    $common $wrap -lpthread -lm
+
+# Inputs: one sentence, a paragraph, and the paragraph as a long
+# narration of one line per repetition
+echo "Hello, this is a short test of the speech synthesis path." > "$work/short.txt"
+cat > "$work/paragraph.txt" <<EOF
+The animated character reads the text aloud while its lips follow the phonemes.
+Every spurt returned by the engine is timed, written and scheduled for playback!
+Does a long narration slow down the callback as the output grows?
+Markers such as <mark name="gesture"/> this one are passed through as well.
+EOF
+i=0
+: > "$work/long.txt"
+while [ $i -lt 10 ]; do
+    tr '\n' ' ' < "$work/paragraph.txt" >> "$work/long.txt"
+    echo >> "$work/long.txt"
+    i=$((i + 1))
+done
+: > "$work/stub.voice"
+: > "$work/license.lic"
+
+export CEREVOICE_STUB_SPEED=$speed
+names=
+
+# run name command...: runs a driver with -j and keeps its statistics
+run() {
+    name=$1
+    shift
+    echo "INFO: scenario $name" >&2
+    "$@" > "$work/$name.log" 2>&1 || {
+        echo "ERROR: scenario $name failed, see $work/$name.log" >&2
+        keep=1
+        exit 1
+    }
+    names="$names $name"
+}
+
+v="$work/stub.voice $work/license.lic"
+run callback_short "$work/tts_callback" -o "$work/a.wav" -t "$work/a.tl" -j "$work/callback_short.json" $v "$work/short.txt"
+run callback_long "$work/tts_callback" -o "$work/a.wav" -t "$work/a.tl" -j "$work/callback_long.json" $v "$work/long.txt"
+run callback_print "$work/tts_callback" -o "$work/a.wav" -j "$work/callback_print.json" $v "$work/long.txt"
+run callback_parallel "$work/tts_callback" -P -n 4 -o "$work/a.wav" -t "$work/a.tl" -j "$work/callback_parallel.json" $v "$work/long.txt"
+run sync_long "$work/tts_sync" -o "$work/a.wav" -t "$work/a.tl" -j "$work/sync_long.json" $v "$work/long.txt"
+# plays in real time, the input is kept short
+run sync_play "$work/tts_sync" -j "$work/sync_play.json" $v "$work/short.txt"
+
+# Results: {"scenarios": {"<name>": {...}, ...}}, the statistics of each
+# run indented under its name
+{
+    echo "{"
+    echo "  \"stub_speed\": $speed,"
+    echo "  \"scenarios\": {"
+    sep=
+    for name in $names; do
+        [ -n "$sep" ] && echo ","
+        printf '    "%s": {\n' "$name"
+        sed -e '1d' -e '$d' -e 's/^/    /' "$work/$name.json"
+        printf '    }'
+        sep=1
+    done
+    echo
+    echo "  }"
+    echo "}"
+} > "$out"
+echo "INFO: results written to $out" >&2
+
+# get file scenario key[.field]: a value of one scenario, empty if missing
+get() {
+    awk -v s="$2" -v k="$3" '
+        BEGIN { n = split(k, kk, "."); }
+        /^    "[a-z_]+": \{$/ { split($0, a, "\""); cur = a[2]; next }
+        cur == s && index($0, "\"" kk[1] "\": ") {
+            v = substr($0, index($0, "\"" kk[1] "\": ") + length(kk[1]) + 4)
+            if (n > 1) {
+                if (!index(v, "\"" kk[2] "\": ")) exit
+                v = substr(v, index(v, "\"" kk[2] "\": ") + length(kk[2]) + 4)
+            }
+            sub(/[,}].*/, "", v)
+            if (v != "null") print v
+            exit
+        }' "$1"
+}
+
+[ -z "$baseline" ] && exit 0
+
+# Metrics gated against the baseline, each with the absolute change
+# below which differences are treated as noise
+regressions=0
+for metric in realtime_factor:0.002 ttfa_ms:0.5 spurt_ms.p99:0.5 callback_ms.p99:0.5 \
+              callback_ms.mean:0.2 allocations.synthesis:0 allocations.callback:0 peak_rss_kb:1024; do
+    key=${metric%%:*}
+    floor=${metric#*:}
+    for name in $names; do
+        old=$(get "$baseline" "$name" "$key")
+        new=$(get "$out" "$name" "$key")
+        [ -z "$old" ] || [ -z "$new" ] && continue
+        if awk -v o="$old" -v n="$new" -v t="$tolerance" -v f="$floor" \
+               'BEGIN { exit !(n > o * (1 + t / 100) && n - o > f) }'; then
+            echo "REGRESSION: $name $key $old -> $new" >&2
+            regressions=$((regressions + 1))
+        fi
+    done
+done
+if [ $regressions -gt 0 ]; then
+    echo "ERROR: $regressions regression(s) beyond $tolerance% of $baseline" >&2
+    exit 1
+fi
+echo "INFO: no regression beyond $tolerance% of $baseline" >&2
@@ -0,0 +1,125 @@
+/* Per-utterance storage for transcription records and names.
+   See tts_arena.h for an overview. */
+
+#include <string.h>
+#include <stdlib.h>
+#include "tts_arena.h"
+
+#define ARENA_ALIGN 16
+
+struct tts_arena_chunk {
+    tts_arena_chunk * next;
+    size_t size;
+    size_t used;
+    /* data follows, aligned */
+};
+
+#define CHUNK_HEADER ((sizeof(tts_arena_chunk) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+static uint32_t arena_hash(const char * s) {
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void tts_arena_init(tts_arena * a) {
+    memset(a, 0, sizeof(tts_arena));
+}
+
+static void chunks_free(tts_arena_chunk * c) {
+    tts_arena_chunk * next;
+    for (; c; c = next) {
+        next = c->next;
+        free(c);
+    }
+}
+
+void tts_arena_free(tts_arena * a) {
+    chunks_free(a->chunks);
+    chunks_free(a->spare);
+    free((void *) a->slots);
+    memset(a, 0, sizeof(tts_arena));
+}
+
+void * tts_arena_alloc(tts_arena * a, size_t size) {
+    tts_arena_chunk * c = a->chunks, ** link;
+    void * p;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    if (!c || c->used + size > c->size) {
+        /* First spare chunk large enough, a new one otherwise */
+        for (link = &a->spare; *link && (*link)->size < size; link = &(*link)->next)
+            ;
+        if (*link) {
+            c = *link;
+            *link = c->next;
+        }
+        else {
+            c = malloc(CHUNK_HEADER + (size > TTS_ARENA_CHUNK ? size : TTS_ARENA_CHUNK));
+            if (!c) return NULL;
+            c->size = size > TTS_ARENA_CHUNK ? size : TTS_ARENA_CHUNK;
+        }
+        c->used = 0;
+        c->next = a->chunks;
+        a->chunks = c;
+    }
+    p = (char *) c + CHUNK_HEADER + c->used;
+    c->used += size;
+    return p;
+}
+
+static void arena_rehash(tts_arena * a, uint32_t nslots) {
+    const char ** old = a->slots;
+    uint32_t i, slot, n = a->nslots;
+
+    a->slots = calloc(nslots, sizeof(const char *));
+    a->nslots = nslots;
+    for (i = 0; i < n; i++) {
+        if (!old[i]) continue;
+        slot = arena_hash(old[i]) & (nslots - 1);
+        while (a->slots[slot]) slot = (slot + 1) & (nslots - 1);
+        a->slots[slot] = old[i];
+    }
+    free((void *) old);
+}
+
+const char * tts_arena_intern(tts_arena * a, const char * name) {
+    uint32_t slot;
+    size_t len;
+    char * copy;
+
+    if (a->nslots == 0) arena_rehash(a, 256);
+    slot = arena_hash(name) & (a->nslots - 1);
+    while (a->slots[slot]) {
+        if (strcmp(a->slots[slot], name) == 0) return a->slots[slot];
+        slot = (slot + 1) & (a->nslots - 1);
+    }
+
+    /* New name */
+    len = strlen(name) + 1;
+    copy = tts_arena_alloc(a, len);
+    if (!copy) return NULL;
+    memcpy(copy, name, len);
+    a->slots[slot] = copy;
+    a->count++;
+    /* Keep the load factor under one half */
+    if (a->count * 2 > a->nslots) arena_rehash(a, a->nslots * 2);
+    return copy;
+}
+
+void tts_arena_reset(tts_arena * a) {
+    tts_arena_chunk * c, * next;
+
+    for (c = a->chunks; c; c = next) {
+        next = c->next;
+        c->next = a->spare;
+        a->spare = c;
+    }
+    a->chunks = NULL;
+    if (a->count) memset((void *) a->slots, 0, a->nslots * sizeof(const char *));
+    a->count = 0;
+}
@@ -0,0 +1,44 @@
+/* Per-utterance storage for transcription records and names.
+
+   The synthesis callbacks used to make one allocation per record and
+   one per name, and to keep them until the process ended.  An arena
+   carves them out of large chunks instead, and interns names so that a
+   phone or a word heard a thousand times is stored once.  Everything is
+   released at once by tts_arena_reset when the utterance is over; the
+   chunks are kept for the next one, so a long-running session settles
+   on a fixed footprint and the callbacks stop calling the allocator
+   once it has.
+
+   Chunks never move: pointers returned by the arena stay valid until
+   the next reset, whichever thread reads them.  An arena is not locked,
+   its owner serialises the calls that allocate.
+*/
+
+#ifndef TTS_ARENA_H
+#define TTS_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TTS_ARENA_CHUNK 65536  /* bytes, larger requests get their own chunk */
+
+typedef struct tts_arena_chunk tts_arena_chunk;
+
+typedef struct tts_arena {
+    tts_arena_chunk * chunks;  /* in use, newest first */
+    tts_arena_chunk * spare;   /* released by reset */
+    const char ** slots;       /* interned names, open addressing */
+    uint32_t nslots;
+    uint32_t count;
+} tts_arena;
+
+void tts_arena_init(tts_arena * a);
+void tts_arena_free(tts_arena * a);
+/* Returns size bytes aligned for any type */
+void * tts_arena_alloc(tts_arena * a, size_t size);
+/* Returns the arena's copy of name, the same pointer for equal names */
+const char * tts_arena_intern(tts_arena * a, const char * name);
+/* Releases everything allocated and interned, keeping the chunks */
+void tts_arena_reset(tts_arena * a);
+
+#endif /* TTS_ARENA_H */
@@ -0,0 +1,55 @@
+/* Fixed pool of the audio buffers cued on a player.
+   See tts_audio.h for an overview. */
+
+#include <string.h>
+#include <cerevoice_aud.h>
+#include "tts_audio.h"
+
+void tts_audio_pool_init(tts_audio_pool * pool, CPRC_sc_player * player) {
+    memset(pool, 0, sizeof(tts_audio_pool));
+    pool->player = player;
+}
+
+/* Deletes the played buffers at the head of the ring, they play in
+   order */
+static void recycle(tts_audio_pool * pool) {
+    CPRC_sc_audio * buf;
+    int status;
+
+    while (pool->count > 0) {
+        buf = pool->slots[pool->oldest];
+        status = CPRC_sc_audio_status(buf);
+        if (status != CPRC_SC_PLAYED && status != CPRC_SC_ERROR) break;
+        CPRC_sc_audio_delete(buf);
+        pool->slots[pool->oldest] = NULL;
+        pool->oldest = (pool->oldest + 1) % TTS_AUDIO_SLOTS;
+        pool->count--;
+    }
+}
+
+int tts_audio_pool_cue(tts_audio_pool * pool, short * samples, int n) {
+    CPRC_sc_audio * buf;
+
+    recycle(pool);
+    while (pool->count == TTS_AUDIO_SLOTS) {
+        CPRC_sc_sleep_msecs(TTS_AUDIO_POLL);
+        recycle(pool);
+    }
+    buf = CPRC_sc_audio_short(samples, n);
+    if (!buf) return 0;
+    if (!CPRC_sc_audio_cue(pool->player, buf)) {
+        CPRC_sc_audio_delete(buf);
+        return 0;
+    }
+    pool->slots[(pool->oldest + pool->count) % TTS_AUDIO_SLOTS] = buf;
+    pool->count++;
+    return 1;
+}
+
+void tts_audio_pool_drain(tts_audio_pool * pool) {
+    recycle(pool);
+    while (pool->count > 0) {
+        CPRC_sc_sleep_msecs(TTS_AUDIO_POLL);
+        recycle(pool);
+    }
+}
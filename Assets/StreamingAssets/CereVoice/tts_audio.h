@@ -0,0 +1,39 @@
+/* Fixed pool of the audio buffers cued on a player.
+
+   The CereVoice Audio library copies every spurt into a buffer that
+   lives until it is deleted, and the drivers cued one per spurt without
+   ever deleting it, so the audio of a long-running session stayed in
+   memory.  The pool keeps the cued buffers in a fixed ring of slots:
+   before a spurt is cued, the slots whose buffer has been played
+   (CPRC_sc_audio_status) are recycled, and when every slot is still
+   queued the caller waits for the oldest one to play.  Memory is then
+   bounded by TTS_AUDIO_SLOTS spurts however long the input, and
+   synthesis running ahead of playback is held back by the same amount.
+
+   A pool is used from one thread, the synthesis callback's.
+*/
+
+#ifndef TTS_AUDIO_H
+#define TTS_AUDIO_H
+
+#include <cerevoice_aud.h>
+
+#define TTS_AUDIO_SLOTS 16  /* spurts queued on the player, at most */
+#define TTS_AUDIO_POLL 10   /* ms between status checks of a full pool */
+
+typedef struct tts_audio_pool {
+    CPRC_sc_player * player;
+    CPRC_sc_audio * slots[TTS_AUDIO_SLOTS];
+    int oldest;
+    int count;
+} tts_audio_pool;
+
+void tts_audio_pool_init(tts_audio_pool * pool, CPRC_sc_player * player);
+/* Copies n samples into a buffer and cues it, after recycling the slots
+   that have been played.  Blocks while every slot is queued.  Returns 0
+   if the buffer cannot be cued. */
+int tts_audio_pool_cue(tts_audio_pool * pool, short * samples, int n);
+/* Waits for everything cued to play and deletes the buffers */
+void tts_audio_pool_drain(tts_audio_pool * pool);
+
+#endif /* TTS_AUDIO_H */
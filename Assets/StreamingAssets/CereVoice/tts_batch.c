@@ -0,0 +1,428 @@
+/* Batch rendering for tts_callback's -b mode.
+   See tts_batch.h for the manifest format. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <direct.h>
+#endif
+#include <cerevoice_eng.h>
+#include "tts_batch.h"
+#include "tts_thread.h"
+#include "tts_timeline.h"
+#include "tts_wav.h"
+
+/* some compilers may complain about this not being defined */
+extern char * strdup(const char *s);
+
+typedef struct batch_item {
+    const char * input;
+    char * name;
+    long size;            /* input size, used to order the work */
+    /* Results */
+    int failed;
+    int worker;
+    long samples;
+    double latency;       /* seconds from picking the item to its outputs being closed */
+    double first_audio;   /* seconds from picking the item to its first spurt */
+} batch_item;
+
+/* Work queue of one worker.  The owner takes from the front, thieves
+   take from the back. */
+typedef struct batch_queue {
+    tts_mutex lock;
+    int * items;
+    int begin;
+    int end;
+} batch_queue;
+
+typedef struct batch {
+    tts_pool * pool;
+    const char * output_dir;
+    int sample_rate;
+    batch_item * items;
+    int nitems;
+    batch_queue * queues;
+    int nworkers;
+    tts_mutex report_lock;
+} batch;
+
+typedef struct batch_worker {
+    batch * b;
+    int index;
+} batch_worker;
+
+/* Output state of the item being rendered, the channel handler context */
+typedef struct batch_output {
+    batch_item * item;
+    tts_wav_writer * wav;
+    tts_timeline_writer * timeline;
+    tts_cache_writer * cache;
+    double started;
+    int spurts;
+    int failed;
+} batch_output;
+
+static char * read_file(const char * path, long * size) {
+    FILE * fp = fopen(path, "rb");
+    char * data;
+    long n;
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = malloc(n + 1);
+    if (data && fread(data, 1, n, fp) != (size_t) n) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    if (data) {
+        data[n] = '\0';
+        if (size) *size = n;
+    }
+    return data;
+}
+
+/* Channel handler: appends the spurt to the item's wave file and
+   timeline. */
+static void batch_callback(CPRC_abuf * abuf, void * context) {
+    batch_output * out = (batch_output *) context;
+
+    if (out->spurts++ == 0)
+        out->item->first_audio = tts_clock_seconds() - out->started;
+    if (out->failed) return;
+
+    tts_timeline_writer_add_abuf(out->timeline, abuf);
+    if (out->cache) tts_cache_writer_add_abuf(out->cache, abuf);
+    if (tts_wav_write_abuf(out->wav, abuf) < 0) out->failed = 1;
+}
+
+static char * output_path(const batch * b, const char * name, const char * ext) {
+    size_t len = strlen(b->output_dir) + strlen(name) + strlen(ext) + 2;
+    char * path = malloc(len);
+    sprintf(path, "%s/%s%s", b->output_dir, name, ext);
+    return path;
+}
+
+/* Renders one item on the worker's channel.  Returns 0 on success. */
+static int render_item(batch * b, batch_item * item) {
+    tts_pool_channel * chan;
+    batch_output out;
+    tts_cache * cache;
+    tts_cache_key key;
+    tts_cache_entry * entry = NULL;
+    char * text, * wav_path, * tl_path;
+    long len = 0;
+    int res = 0;
+
+    memset(&out, 0, sizeof(out));
+    out.item = item;
+    out.started = tts_clock_seconds();
+
+    text = read_file(item->input, &len);
+    if (!text) {
+        fprintf(stderr, "ERROR: unable to read input file '%s'\n", item->input);
+        return -1;
+    }
+    wav_path = output_path(b, item->name, ".wav");
+    tl_path = output_path(b, item->name, ".tl");
+
+    /* Repeated lines are copied from the cache */
+    cache = tts_pool_cache(b->pool, text, (int) len, &key);
+    if (cache) entry = tts_cache_get(cache, &key);
+    if (entry) {
+        if (tts_cache_entry_save(entry, wav_path, tl_path) != 0) {
+            fprintf(stderr, "ERROR: unable to write output files for '%s'\n", item->name);
+            res = -1;
+        }
+        item->samples = entry->n_samples;
+        tts_cache_release(cache, entry);
+        item->first_audio = item->latency = tts_clock_seconds() - out.started;
+        free(text);
+        free(wav_path);
+        free(tl_path);
+        return res;
+    }
+
+    out.wav = tts_wav_open(wav_path, b->sample_rate, 0);
+    out.timeline = tts_timeline_writer_open(tl_path, b->sample_rate);
+    if (!out.wav || !out.timeline) {
+        fprintf(stderr, "ERROR: unable to open output files for '%s'\n", item->name);
+        res = -1;
+    }
+    else {
+        if (cache) out.cache = tts_cache_writer_open(cache, &key, b->sample_rate);
+        /* there are as many workers as channels, this does not block */
+        chan = tts_pool_acquire(b->pool);
+        chan->context = &out;
+        chan->handler = batch_callback;
+        tts_pool_speak(b->pool, chan, text, (int) len);
+        tts_pool_release(b->pool, chan);
+        item->samples = tts_wav_samples(out.wav);
+    }
+    if (out.wav && tts_wav_close(out.wav) != 0) {
+        fprintf(stderr, "ERROR: unable to write audio file '%s'\n", wav_path);
+        res = -1;
+    }
+    if (out.timeline && tts_timeline_writer_close(out.timeline) != 0) {
+        fprintf(stderr, "ERROR: unable to write timeline file '%s'\n", tl_path);
+        res = -1;
+    }
+    if (out.cache) {
+        if (res == 0) tts_cache_writer_commit(out.cache);
+        else tts_cache_writer_abort(out.cache);
+    }
+    item->latency = tts_clock_seconds() - out.started;
+
+    free(text);
+    free(wav_path);
+    free(tl_path);
+    return res;
+}
+
+/* Next item for worker w: its own queue first, then the other queues
+   starting with the neighbour.  Returns -1 when all the work is taken. */
+static int next_item(batch * b, int w) {
+    batch_queue * q;
+    int i, k, item = -1;
+
+    q = &b->queues[w];
+    tts_mutex_lock(&q->lock);
+    if (q->begin < q->end) item = q->items[q->begin++];
+    tts_mutex_unlock(&q->lock);
+
+    for (k = 1; item < 0 && k < b->nworkers; k++) {
+        i = (w + k) % b->nworkers;
+        q = &b->queues[i];
+        tts_mutex_lock(&q->lock);
+        if (q->begin < q->end) item = q->items[--q->end];
+        tts_mutex_unlock(&q->lock);
+    }
+    return item;
+}
+
+static tts_thread_ret TTS_THREAD_CALL batch_thread(void * userdata) {
+    batch_worker * worker = (batch_worker *) userdata;
+    batch * b = worker->b;
+    batch_item * item;
+    int i;
+
+    while ((i = next_item(b, worker->index)) >= 0) {
+        item = &b->items[i];
+        item->worker = worker->index;
+        item->failed = render_item(b, item) != 0;
+
+        tts_mutex_lock(&b->report_lock);
+        if (item->failed) {
+            fprintf(stdout, "ERROR: item '%s' failed\n", item->name);
+        }
+        else {
+            fprintf(stdout, "INFO: item '%s': %.2f s audio, latency %.1f ms, first audio %.1f ms, worker %d\n",
+                    item->name, item->samples / (double) b->sample_rate,
+                    item->latency * 1000.0, item->first_audio * 1000.0, worker->index);
+        }
+        fflush(stdout);
+        tts_mutex_unlock(&b->report_lock);
+    }
+    return 0;
+}
+
+/* Output name from the input path: no directory, no extension */
+static char * default_name(const char * input) {
+    const char * base = input, * p;
+    char * name, * dot;
+    for (p = input; *p; p++) {
+        if (*p == '/' || *p == '\\') base = p + 1;
+    }
+    name = strdup(base);
+    dot = strrchr(name, '.');
+    if (dot && dot != name) *dot = '\0';
+    return name;
+}
+
+/* qsort has no context argument */
+static const batch_item * sort_items;
+
+/* Output names in file name order: case is ignored on Windows, where
+   the file system ignores it too */
+static int compare_names(const void * a, const void * b) {
+    const char * na = sort_items[*(const int *) a].name, * nb = sort_items[*(const int *) b].name;
+#ifndef WIN32
+    return strcmp(na, nb);
+#else
+    return _stricmp(na, nb);
+#endif
+}
+
+/* Items with the same output name would be rendered concurrently into
+   the same files.  Returns the number of names used more than once. */
+static int check_names(const batch_item * items, int n) {
+    int * order = malloc((n + 1) * sizeof(int));
+    int i, dups = 0;
+
+    for (i = 0; i < n; i++) order[i] = i;
+    sort_items = items;
+    qsort(order, n, sizeof(int), compare_names);
+    for (i = 1; i < n; i++) {
+        if (compare_names(&order[i - 1], &order[i]) != 0) continue;
+        fprintf(stderr, "ERROR: output name '%s' of '%s' is already used by '%s', give it another name\n",
+                items[order[i]].name, items[order[i]].input, items[order[i - 1]].input);
+        dups++;
+    }
+    free(order);
+    return dups;
+}
+
+/* Splits the manifest in place.  Returns the number of items. */
+static int parse_manifest(char * text, batch_item ** items) {
+    char * line = text, * next, * input, * name;
+    struct stat st;
+    int n = 0, cap = 0;
+
+    *items = NULL;
+    while (line && *line) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+
+        input = strtok(line, " \t\r");
+        name = input ? strtok(NULL, " \t\r") : NULL;
+        line = next;
+        if (!input || input[0] == '#') continue;
+
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            *items = realloc(*items, cap * sizeof(batch_item));
+        }
+        memset(&(*items)[n], 0, sizeof(batch_item));
+        (*items)[n].input = input;
+        (*items)[n].name = name ? strdup(name) : default_name(input);
+        (*items)[n].size = stat(input, &st) == 0 ? (long) st.st_size : 0;
+        n++;
+    }
+    return n;
+}
+
+/* Larger inputs first */
+static int compare_items(const void * a, const void * b) {
+    long sa = sort_items[*(const int *) a].size, sb = sort_items[*(const int *) b].size;
+    return sa < sb ? 1 : (sa > sb ? -1 : 0);
+}
+
+static int compare_latency(const void * a, const void * b) {
+    double la = *(const double *) a, lb = *(const double *) b;
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+int tts_batch_run(tts_pool * pool, const char * manifest, const char * output_dir) {
+    batch b;
+    batch_worker * workers;
+    tts_thread * threads;
+    char * text;
+    int * order;
+    double started, wall, audio = 0, * latencies;
+    int i, w, nok = 0, failed = 0;
+    struct stat st;
+
+    text = read_file(manifest, NULL);
+    if (!text) {
+        fprintf(stderr, "ERROR: unable to read manifest '%s'\n", manifest);
+        return -1;
+    }
+
+    /* Fail once here rather than on every item */
+#ifndef WIN32
+    mkdir(output_dir, 0777);
+#else
+    _mkdir(output_dir);
+#endif
+    if (stat(output_dir, &st) != 0 || !(st.st_mode & S_IFDIR)) {
+        fprintf(stderr, "ERROR: unable to create output directory '%s'\n", output_dir);
+        free(text);
+        return -1;
+    }
+
+    memset(&b, 0, sizeof(b));
+    b.pool = pool;
+    b.output_dir = output_dir;
+    b.sample_rate = tts_pool_sample_rate(pool);
+    b.nitems = parse_manifest(text, &b.items);
+    if (check_names(b.items, b.nitems) > 0) {
+        for (i = 0; i < b.nitems; i++) free(b.items[i].name);
+        free(b.items);
+        free(text);
+        return -1;
+    }
+    b.nworkers = tts_pool_size(pool);
+    if (b.nworkers > b.nitems) b.nworkers = b.nitems > 0 ? b.nitems : 1;
+    fprintf(stderr, "INFO: rendering %d item(s) with %d worker(s)\n", b.nitems, b.nworkers);
+
+    /* Deal the items largest first, round robin, so every worker starts
+       with a similar amount of work and finishes on short items */
+    order = malloc((b.nitems + 1) * sizeof(int));
+    for (i = 0; i < b.nitems; i++) order[i] = i;
+    sort_items = b.items;
+    qsort(order, b.nitems, sizeof(int), compare_items);
+    b.queues = calloc(b.nworkers, sizeof(batch_queue));
+    for (w = 0; w < b.nworkers; w++) {
+        tts_mutex_init(&b.queues[w].lock);
+        b.queues[w].items = malloc((b.nitems / b.nworkers + 1) * sizeof(int));
+    }
+    for (i = 0; i < b.nitems; i++) {
+        batch_queue * q = &b.queues[i % b.nworkers];
+        q->items[q->end++] = order[i];
+    }
+    tts_mutex_init(&b.report_lock);
+
+    started = tts_clock_seconds();
+    workers = calloc(b.nworkers, sizeof(batch_worker));
+    threads = calloc(b.nworkers, sizeof(tts_thread));
+    for (w = 0; w < b.nworkers; w++) {
+        workers[w].b = &b;
+        workers[w].index = w;
+        if (!tts_thread_start(&threads[w], batch_thread, &workers[w])) {
+            fprintf(stderr, "ERROR: unable to start worker %d\n", w);
+            exit(-1);
+        }
+    }
+    for (w = 0; w < b.nworkers; w++) tts_thread_join(threads[w]);
+    wall = tts_clock_seconds() - started;
+
+    /* Aggregate report */
+    latencies = malloc((b.nitems + 1) * sizeof(double));
+    for (i = 0; i < b.nitems; i++) {
+        if (b.items[i].failed) {
+            failed++;
+            continue;
+        }
+        audio += b.items[i].samples / (double) b.sample_rate;
+        latencies[nok++] = b.items[i].latency;
+    }
+    qsort(latencies, nok, sizeof(double), compare_latency);
+    fprintf(stdout, "INFO: %d item(s) rendered, %d failed, %.2f s audio in %.2f s\n",
+            nok, failed, audio, wall);
+    if (nok > 0) {
+        fprintf(stdout, "INFO: realtime factor %.4f (%.1fx realtime)\n",
+                audio > 0 ? wall / audio : 0, wall > 0 ? audio / wall : 0);
+        fprintf(stdout, "INFO: item latency ms: median %.1f, p95 %.1f, max %.1f\n",
+                latencies[nok / 2] * 1000.0, latencies[(nok * 95) / 100] * 1000.0,
+                latencies[nok - 1] * 1000.0);
+    }
+
+    for (w = 0; w < b.nworkers; w++) {
+        tts_mutex_destroy(&b.queues[w].lock);
+        free(b.queues[w].items);
+    }
+    tts_mutex_destroy(&b.report_lock);
+    for (i = 0; i < b.nitems; i++) free(b.items[i].name);
+    free(latencies);
+    free(threads);
+    free(workers);
+    free(b.queues);
+    free(b.items);
+    free(order);
+    free(text);
+    return failed;
+}
@@ -0,0 +1,35 @@
+/* Batch rendering for tts_callback's -b mode.
+
+   Renders every entry of a manifest with the voice loaded once, one
+   worker thread per pool channel.  Items are dealt to per-worker
+   queues largest first; a worker that runs dry steals from the tail of
+   another worker's queue, so a few long lines do not leave the other
+   cores idle at the end of the run.
+
+   Manifest: one item per line, "input_file [output_name]".  Blank lines
+   and lines starting with '#' are skipped.  The input is text or SSML
+   as accepted by tts_callback.  For each item <output_name>.wav and
+   <output_name>.tl (see tts_timeline.h) are written to the output
+   directory, which is created if missing.  The output name defaults to
+   the input file name without its directory and extension.  Output
+   names must be unique, so inputs with the same file name in different
+   directories need one.
+
+   If the pool has a cache (tts_pool_set_cache), items found in it are
+   copied without synthesis and newly rendered items are added to it.
+
+   Per-item latency and the aggregate realtime factor are reported on
+   stdout.
+*/
+
+#ifndef TTS_BATCH_H
+#define TTS_BATCH_H
+
+#include "tts_pool.h"
+
+/* Renders all items of the manifest.  Returns the number of failed
+   items, or -1 if the manifest cannot be read or gives an output name
+   twice, or if the output directory cannot be created. */
+int tts_batch_run(tts_pool * pool, const char * manifest, const char * output_dir);
+
+#endif /* TTS_BATCH_H */
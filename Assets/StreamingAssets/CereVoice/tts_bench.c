@@ -0,0 +1,221 @@
+/* Benchmark instrumentation.
+   See tts_bench.h. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "tts_bench.h"
+#include "tts_thread.h"
+
+#ifndef WIN32
+#include <sys/resource.h>
+#else
+#include <psapi.h>
+#endif
+
+/* Histogram bucket of a latency: 0 below 1 us, then four buckets per
+   power of two. */
+static int bucket_of(double seconds) {
+    uint64_t us = seconds > 0 ? (uint64_t) (seconds * 1e6) : 0;
+    int e = 0, b;
+    if (us == 0) return 0;
+    while ((us >> e) > 1) e++;
+    b = 1 + e * 4 + (int) (((us - ((uint64_t) 1 << e)) * 4) >> e);
+    return b < TTS_BENCH_BUCKETS ? b : TTS_BENCH_BUCKETS - 1;
+}
+
+/* Upper bound of a bucket in microseconds */
+static double bucket_limit(int b) {
+    int e, sub;
+    if (b == 0) return 1;
+    e = (b - 1) / 4;
+    sub = (b - 1) % 4;
+    return (double) ((uint64_t) 1 << e) * (1.0 + (sub + 1) / 4.0);
+}
+
+static void histogram_add(tts_bench_histogram * h, double seconds) {
+    if (h->count == 0 || seconds < h->min) h->min = seconds;
+    if (h->count == 0 || seconds > h->max) h->max = seconds;
+    h->count++;
+    h->sum += seconds;
+    h->buckets[bucket_of(seconds)]++;
+}
+
+static double histogram_percentile(const tts_bench_histogram * h, double p) {
+    int64_t rank = (int64_t) (p * h->count + 0.5), seen = 0;
+    double limit;
+    int b;
+    if (rank < 1) rank = 1;
+    for (b = 0; b < TTS_BENCH_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) break;
+    }
+    limit = bucket_limit(b) / 1e6;
+    return limit < h->max ? limit : h->max;
+}
+
+void tts_bench_init(tts_bench * b, const char * driver, int sample_rate) {
+    memset(b, 0, sizeof(tts_bench));
+    b->driver = driver;
+    b->sample_rate = sample_rate;
+    b->ttfa = -1;
+    b->allocs_started = tts_bench_allocs();
+    b->alloc_bytes_started = tts_bench_alloc_bytes();
+}
+
+void tts_bench_speak(tts_bench * b) {
+    if (b->started > 0) return;
+    b->started = tts_clock_seconds();
+    b->last = b->started;
+    b->allocs_started = tts_bench_allocs();
+    b->alloc_bytes_started = tts_bench_alloc_bytes();
+}
+
+void tts_bench_callback_begin(tts_bench * b) {
+    b->callback_started = tts_clock_seconds();
+    b->callback_allocs = tts_bench_allocs();
+    if (b->started > 0) histogram_add(&b->spurt, b->callback_started - b->last);
+}
+
+void tts_bench_callback_end(tts_bench * b, int samples) {
+    double now = tts_clock_seconds();
+    histogram_add(&b->callback, now - b->callback_started);
+    b->allocs_callback += tts_bench_allocs() - b->callback_allocs;
+    if (samples > 0) {
+        if (b->ttfa < 0 && b->started > 0) b->ttfa = b->callback_started - b->started;
+        b->samples += samples;
+    }
+    b->spurts++;
+    b->last = now;
+}
+
+void tts_bench_done(tts_bench * b) {
+    b->finished = tts_clock_seconds();
+    b->allocs_synthesis = tts_bench_allocs() - b->allocs_started;
+    b->alloc_bytes_synthesis = tts_bench_alloc_bytes() - b->alloc_bytes_started;
+}
+
+/* One histogram as two lines: the summary in milliseconds and the
+   non-empty buckets as [upper bound in us, count] pairs */
+static void write_histogram(FILE * fp, const char * name, const tts_bench_histogram * h) {
+    int b, first = 1;
+    fprintf(fp, "  \"%s_ms\": {\"count\": %lld, \"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+            name, (long long) h->count, h->min * 1e3, h->count ? h->sum / h->count * 1e3 : 0.0,
+            histogram_percentile(h, 0.5) * 1e3, histogram_percentile(h, 0.9) * 1e3,
+            histogram_percentile(h, 0.99) * 1e3, h->max * 1e3);
+    fprintf(fp, "  \"%s_histogram_us\": [", name);
+    for (b = 0; b < TTS_BENCH_BUCKETS; b++) {
+        if (!h->buckets[b]) continue;
+        fprintf(fp, "%s[%g, %lld]", first ? "" : ", ", bucket_limit(b), (long long) h->buckets[b]);
+        first = 0;
+    }
+    fprintf(fp, "],\n");
+}
+
+int tts_bench_write_json(const tts_bench * b, const char * path) {
+    FILE * fp;
+    double audio = b->sample_rate > 0 ? b->samples / (double) b->sample_rate : 0;
+    double wall = b->finished > b->started ? b->finished - b->started : 0;
+
+    fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "ERROR: unable to open benchmark file '%s'\n", path);
+        return -1;
+    }
+    /* one value per line, so that scripts can grep for them */
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"driver\": \"%s\",\n", b->driver);
+    fprintf(fp, "  \"sample_rate\": %d,\n", b->sample_rate);
+    fprintf(fp, "  \"spurts\": %lld,\n", (long long) b->spurts);
+    fprintf(fp, "  \"audio_s\": %.3f,\n", audio);
+    fprintf(fp, "  \"synthesis_s\": %.3f,\n", wall);
+    fprintf(fp, "  \"realtime_factor\": %.4f,\n", audio > 0 ? wall / audio : 0.0);
+    if (b->ttfa >= 0) fprintf(fp, "  \"ttfa_ms\": %.3f,\n", b->ttfa * 1e3);
+    else fprintf(fp, "  \"ttfa_ms\": null,\n");
+    write_histogram(fp, "spurt", &b->spurt);
+    write_histogram(fp, "callback", &b->callback);
+    if (b->allocs_started >= 0)
+        fprintf(fp, "  \"allocations\": {\"synthesis\": %lld, \"synthesis_bytes\": %lld, \"callback\": %lld},\n",
+                (long long) b->allocs_synthesis, (long long) b->alloc_bytes_synthesis, (long long) b->allocs_callback);
+    else
+        fprintf(fp, "  \"allocations\": null,\n");
+    fprintf(fp, "  \"peak_rss_kb\": %ld\n", tts_bench_peak_rss_kb());
+    fprintf(fp, "}\n");
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "ERROR: unable to write benchmark file '%s'\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+long tts_bench_peak_rss_kb(void) {
+#ifndef WIN32
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;   /* bytes on macOS */
+#else
+    return ru.ru_maxrss;
+#endif
+#else
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return -1;
+    return (long) (pmc.PeakWorkingSetSize / 1024);
+#endif
+}
+
+#ifdef TTS_BENCH_ALLOC
+
+/* Allocation counters, filled in by the wrappers that the linker puts
+   in place of malloc and friends (--wrap) */
+static int64_t alloc_count;
+static int64_t alloc_bytes;
+
+void * __real_malloc(size_t n);
+void * __real_calloc(size_t n, size_t size);
+void * __real_realloc(void * p, size_t n);
+void __real_free(void * p);
+
+static void count_alloc(size_t n) {
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&alloc_bytes, (int64_t) n, __ATOMIC_RELAXED);
+}
+
+void * __wrap_malloc(size_t n) {
+    count_alloc(n);
+    return __real_malloc(n);
+}
+
+void * __wrap_calloc(size_t n, size_t size) {
+    count_alloc(n * size);
+    return __real_calloc(n, size);
+}
+
+void * __wrap_realloc(void * p, size_t n) {
+    count_alloc(n);
+    return __real_realloc(p, n);
+}
+
+void __wrap_free(void * p) {
+    __real_free(p);
+}
+
+int64_t tts_bench_allocs(void) {
+    return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+}
+
+int64_t tts_bench_alloc_bytes(void) {
+    return __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED);
+}
+
+#else
+
+int64_t tts_bench_allocs(void) {
+    return -1;
+}
+
+int64_t tts_bench_alloc_bytes(void) {
+    return -1;
+}
+
+#endif
@@ -0,0 +1,86 @@
+/* Benchmark instrumentation of the drivers' synthesis path.
+
+   A driver started with -j records, for the whole input:
+
+     ttfa_ms            time from the first speak call to the first
+                        callback carrying audio
+     spurt_ms           engine time per spurt, from the previous
+                        callback (or the first speak call) to the next
+     callback_ms        time spent inside the driver's callback
+     realtime_factor    synthesis wall time over audio duration
+     allocations        heap allocations during synthesis, and the
+                        share made inside the callback
+     peak_rss_kb        peak resident set size of the process
+
+   and writes them as JSON when the run ends.  Latencies are kept in a
+   fixed log-scale histogram (four buckets per power of two from 1 us),
+   so recording a callback neither allocates nor grows with the input;
+   percentiles are the upper bound of their bucket.
+
+   Allocations are only counted when the driver is linked with the
+   wrappers of this module:
+     -DTTS_BENCH_ALLOC -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+   otherwise they are reported as null.
+
+   bench/run_bench.sh builds the drivers against the stub engine in
+   bench/ and runs them over a fixed set of inputs, so the numbers can
+   be compared between changes on a machine without the CereVoice
+   runtime.
+*/
+
+#ifndef TTS_BENCH_H
+#define TTS_BENCH_H
+
+#include <stdint.h>
+
+#define TTS_BENCH_BUCKETS 160
+
+typedef struct tts_bench_histogram {
+    int64_t count;
+    double min, max, sum;              /* seconds */
+    int64_t buckets[TTS_BENCH_BUCKETS];
+} tts_bench_histogram;
+
+typedef struct tts_bench {
+    const char * driver;
+    int sample_rate;
+    double started;        /* first speak call, 0 before */
+    double finished;
+    double last;           /* end of the previous callback */
+    double ttfa;           /* negative until audio arrives */
+    int64_t samples;
+    int64_t spurts;
+    tts_bench_histogram spurt;
+    tts_bench_histogram callback;
+    int64_t allocs_started;
+    int64_t allocs_synthesis;
+    int64_t allocs_callback;
+    int64_t alloc_bytes_started;
+    int64_t alloc_bytes_synthesis;
+    /* callback in progress */
+    double callback_started;
+    int64_t callback_allocs;
+} tts_bench;
+
+/* Starts an empty measurement for driver at sample_rate */
+void tts_bench_init(tts_bench * b, const char * driver, int sample_rate);
+/* Called before every speak call, the first one starts the clock */
+void tts_bench_speak(tts_bench * b);
+/* Brackets the body of the synthesis callback.  samples is the audio
+   of the spurt (wav_done - wav_mk). */
+void tts_bench_callback_begin(tts_bench * b);
+void tts_bench_callback_end(tts_bench * b, int samples);
+/* Called once the flushing speak call has returned */
+void tts_bench_done(tts_bench * b);
+
+/* Writes the measurement to path.  Returns 0 on success. */
+int tts_bench_write_json(const tts_bench * b, const char * path);
+
+/* Heap allocations and bytes requested so far by the process, or -1
+   when the allocation wrappers are not linked in. */
+int64_t tts_bench_allocs(void);
+int64_t tts_bench_alloc_bytes(void);
+/* Peak resident set size in kB, or -1 if not available */
+long tts_bench_peak_rss_kb(void);
+
+#endif /* TTS_BENCH_H */
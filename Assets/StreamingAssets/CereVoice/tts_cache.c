@@ -0,0 +1,755 @@
+/* Content-addressed synthesis cache.
+   See tts_cache.h for the key and the store layout. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "tts_cache.h"
+#include "tts_thread.h"
+#include "tts_wav.h"
+
+#ifndef WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#include <sys/stat.h>
+#include <sys/utime.h>
+#define stat _stat
+#define utime _utime
+#define getpid _getpid
+#endif
+
+#define CACHE_BUCKETS 4096
+
+/* One entry of the store, mapped or not */
+typedef struct cache_item {
+    tts_cache_key key;
+    int64_t disk_size;
+    tts_cache_entry * entry;          /* mapped, or NULL */
+    struct cache_item * prev, * next; /* disk LRU, most recent first */
+    struct cache_item * chain;        /* hash bucket */
+} cache_item;
+
+struct tts_cache {
+    char * dir;
+    int64_t memory_limit;
+    int64_t disk_limit;
+    tts_mutex lock;
+    cache_item * buckets[CACHE_BUCKETS];
+    cache_item * disk_head, * disk_tail;
+    tts_cache_entry * memory_head, * memory_tail;
+    unsigned int temp_counter;
+    tts_cache_stats stats;
+};
+
+struct tts_cache_writer {
+    tts_cache * cache;
+    tts_cache_key key;
+    tts_wav_writer * wav;
+    tts_timeline_writer * timeline;
+    char * wav_temp;
+    char * timeline_temp;
+    int failed;
+};
+
+/* ---- keys ---- */
+
+/* Two independent 64 bit hashes: FNV-1a, and FNV-1a from another basis
+   finished with a splitmix64 avalanche */
+static void key_init(tts_cache_key * key) {
+    key->h[0] = 14695981039346656037ULL;
+    key->h[1] = 14695981039346656037ULL ^ 0x9e3779b97f4a7c15ULL;
+}
+
+static void key_add(tts_cache_key * key, const void * data, size_t len) {
+    const unsigned char * p = (const unsigned char *) data;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        key->h[0] = (key->h[0] ^ p[i]) * 1099511628211ULL;
+        key->h[1] = (key->h[1] ^ p[i]) * 0x100000001b3ULL + (key->h[1] >> 29);
+    }
+}
+
+static void key_finish(tts_cache_key * key) {
+    uint64_t z = key->h[1];
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    key->h[1] = z ^ (z >> 31);
+}
+
+static void key_add_int(tts_cache_key * key, int64_t v) {
+    unsigned char b[8];
+    int i;
+    for (i = 0; i < 8; i++) b[i] = (unsigned char) ((uint64_t) v >> (8 * i));
+    key_add(key, b, sizeof(b));
+}
+
+static const char * base_name(const char * path) {
+    const char * base = path, * p;
+    for (p = path; *p; p++) {
+        if (*p == '/' || *p == '\\') base = p + 1;
+    }
+    return base;
+}
+
+TTS_EXPORT int tts_cache_key_config(tts_cache_key * key, const char * voice_file,
+                                    const char * lexicon_file, int maxp) {
+    struct stat st;
+    char buf[65536];
+    FILE * fp;
+    size_t n;
+
+    key_init(key);
+    /* voices are hundreds of megabytes, identify them instead of hashing */
+    if (stat(voice_file, &st) != 0) {
+        fprintf(stderr, "ERROR: unable to read voice file '%s'\n", voice_file);
+        return -1;
+    }
+    key_add(key, "voice", 6);
+    key_add(key, base_name(voice_file), strlen(base_name(voice_file)) + 1);
+    key_add_int(key, (int64_t) st.st_size);
+    key_add_int(key, (int64_t) st.st_mtime);
+
+    key_add(key, "lexicon", 8);
+    if (lexicon_file && (fp = fopen(lexicon_file, "rb")) != NULL) {
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) key_add(key, buf, n);
+        fclose(fp);
+    }
+
+    key_add(key, "maxp", 5);
+    key_add_int(key, maxp > 0 ? maxp : 0);
+    key_finish(key);
+    return 0;
+}
+
+TTS_EXPORT void tts_cache_key_text(tts_cache_key * key, const tts_cache_key * config,
+                                   const char * text, int textlen) {
+    const char * p = text, * end = text + textlen, * line_end;
+    int blank;
+
+    key_init(key);
+    key_add(key, config->h, sizeof(config->h));
+    while (p < end) {
+        line_end = memchr(p, '\n', end - p);
+        if (!line_end) line_end = end;
+        /* trim the line and collapse blanks */
+        while (p < line_end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p < line_end) {
+            blank = 0;
+            for (; p < line_end; p++) {
+                if (*p == ' ' || *p == '\t' || *p == '\r') {
+                    blank = 1;
+                    continue;
+                }
+                if (blank) key_add(key, " ", 1);
+                blank = 0;
+                key_add(key, p, 1);
+            }
+            key_add(key, "\n", 1);
+        }
+        p = line_end + 1;
+    }
+    key_finish(key);
+}
+
+void tts_cache_key_hex(const tts_cache_key * key, char * hex) {
+    sprintf(hex, "%016llx%016llx", (unsigned long long) key->h[0], (unsigned long long) key->h[1]);
+}
+
+static int key_parse(tts_cache_key * key, const char * hex) {
+    unsigned long long a, b;
+    char part[17];
+    int i;
+    for (i = 0; i < 32; i++) {
+        if (!((hex[i] >= '0' && hex[i] <= '9') || (hex[i] >= 'a' && hex[i] <= 'f'))) return -1;
+    }
+    memcpy(part, hex, 16);
+    part[16] = '\0';
+    a = strtoull(part, NULL, 16);
+    memcpy(part, hex + 16, 16);
+    b = strtoull(part, NULL, 16);
+    key->h[0] = a;
+    key->h[1] = b;
+    return 0;
+}
+
+static int key_equal(const tts_cache_key * a, const tts_cache_key * b) {
+    return a->h[0] == b->h[0] && a->h[1] == b->h[1];
+}
+
+/* ---- files ---- */
+
+static char * entry_path(const tts_cache * cache, const tts_cache_key * key, const char * ext) {
+    char hex[33];
+    char * path = malloc(strlen(cache->dir) + 32 + strlen(ext) + 2);
+    tts_cache_key_hex(key, hex);
+    sprintf(path, "%s/%s%s", cache->dir, hex, ext);
+    return path;
+}
+
+static int64_t file_size(const char * path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (int64_t) st.st_size : -1;
+}
+
+static int replace_file(const char * from, const char * to) {
+#ifndef WIN32
+    return rename(from, to);
+#else
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#endif
+}
+
+static void * map_file(const char * path, size_t * size) {
+    void * base;
+#ifndef WIN32
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t) st.st_size;
+    base = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return base == MAP_FAILED ? NULL : base;
+#else
+    HANDLE file, mapping;
+    LARGE_INTEGER sz;
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    *size = (size_t) sz.QuadPart;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+    base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    return base;
+#endif
+}
+
+static void unmap_file(void * base, size_t size) {
+#ifndef WIN32
+    munmap(base, size);
+#else
+    (void) size;
+    UnmapViewOfFile(base);
+#endif
+}
+
+static unsigned long get_u32(const unsigned char * p) {
+    return p[0] | (p[1] << 8) | ((unsigned long) p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+/* ---- index, called with the lock held ---- */
+
+static cache_item ** bucket_of(tts_cache * cache, const tts_cache_key * key) {
+    return &cache->buckets[key->h[0] & (CACHE_BUCKETS - 1)];
+}
+
+static cache_item * item_find(tts_cache * cache, const tts_cache_key * key) {
+    cache_item * item;
+    for (item = *bucket_of(cache, key); item; item = item->chain) {
+        if (key_equal(&item->key, key)) return item;
+    }
+    return NULL;
+}
+
+static void disk_unlink(tts_cache * cache, cache_item * item) {
+    if (item->prev) item->prev->next = item->next;
+    else cache->disk_head = item->next;
+    if (item->next) item->next->prev = item->prev;
+    else cache->disk_tail = item->prev;
+    item->prev = item->next = NULL;
+}
+
+static void disk_push_front(tts_cache * cache, cache_item * item) {
+    item->prev = NULL;
+    item->next = cache->disk_head;
+    if (cache->disk_head) cache->disk_head->prev = item;
+    cache->disk_head = item;
+    if (!cache->disk_tail) cache->disk_tail = item;
+}
+
+static void disk_push_back(tts_cache * cache, cache_item * item) {
+    item->next = NULL;
+    item->prev = cache->disk_tail;
+    if (cache->disk_tail) cache->disk_tail->next = item;
+    cache->disk_tail = item;
+    if (!cache->disk_head) cache->disk_head = item;
+}
+
+static void memory_unlink(tts_cache * cache, tts_cache_entry * e) {
+    if (e->prev) e->prev->next = e->next;
+    else cache->memory_head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else cache->memory_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void memory_push_front(tts_cache * cache, tts_cache_entry * e) {
+    e->prev = NULL;
+    e->next = cache->memory_head;
+    if (cache->memory_head) cache->memory_head->prev = e;
+    cache->memory_head = e;
+    if (!cache->memory_tail) cache->memory_tail = e;
+}
+
+static cache_item * item_add(tts_cache * cache, const tts_cache_key * key, int64_t size) {
+    cache_item ** bucket = bucket_of(cache, key);
+    cache_item * item = calloc(1, sizeof(cache_item));
+    item->key = *key;
+    item->disk_size = size;
+    item->chain = *bucket;
+    *bucket = item;
+    cache->stats.disk_bytes += size;
+    cache->stats.entries++;
+    return item;
+}
+
+static void entry_unmap(tts_cache * cache, tts_cache_entry * e) {
+    memory_unlink(cache, e);
+    cache->stats.memory_bytes -= (int64_t) (e->wav_size + e->timeline.size);
+    unmap_file(e->wav_base, e->wav_size);
+    tts_timeline_unmap(&e->timeline);
+    e->item->entry = NULL;
+    free(e);
+}
+
+static void item_remove(tts_cache * cache, cache_item * item) {
+    cache_item ** c;
+    char * path;
+
+    for (c = bucket_of(cache, &item->key); *c; c = &(*c)->chain) {
+        if (*c == item) {
+            *c = item->chain;
+            break;
+        }
+    }
+    disk_unlink(cache, item);
+    if (item->entry) entry_unmap(cache, item->entry);
+    /* timeline first, so a half-removed entry is not picked up again */
+    path = entry_path(cache, &item->key, ".tl");
+    remove(path);
+    free(path);
+    path = entry_path(cache, &item->key, ".wav");
+    remove(path);
+    free(path);
+    cache->stats.disk_bytes -= item->disk_size;
+    cache->stats.entries--;
+    free(item);
+}
+
+/* Unmaps unused entries from the cold end until under the limit */
+static void memory_trim(tts_cache * cache) {
+    tts_cache_entry * e = cache->memory_tail, * prev;
+    while (e && cache->stats.memory_bytes > cache->memory_limit) {
+        prev = e->prev;
+        if (e->refs == 0) {
+            entry_unmap(cache, e);
+            cache->stats.memory_evictions++;
+        }
+        e = prev;
+    }
+}
+
+/* Removes entries not in use from the cold end until under the limit */
+static void disk_trim(tts_cache * cache) {
+    cache_item * item = cache->disk_tail, * prev;
+    while (item && cache->stats.disk_bytes > cache->disk_limit) {
+        prev = item->prev;
+        if (!item->entry || item->entry->refs == 0) {
+            item_remove(cache, item);
+            cache->stats.disk_evictions++;
+        }
+        item = prev;
+    }
+}
+
+/* ---- cache ---- */
+
+typedef struct scanned_item {
+    tts_cache_key key;
+    int64_t size;
+    time_t used;
+} scanned_item;
+
+static int compare_used(const void * a, const void * b) {
+    time_t x = ((const scanned_item *) a)->used, y = ((const scanned_item *) b)->used;
+    return x > y ? -1 : (x < y ? 1 : 0);
+}
+
+/* Considers one directory entry: indexes complete entries, removes
+   leftovers of interrupted writes */
+static void scan_name(tts_cache * cache, const char * name, scanned_item ** items, int * n, int * cap) {
+    size_t len = strlen(name);
+    char * path;
+    struct stat st;
+    int64_t wav_size;
+    tts_cache_key key;
+
+    if (len > 4 && strcmp(name + len - 4, ".tmp") == 0) {
+        path = malloc(strlen(cache->dir) + len + 2);
+        sprintf(path, "%s/%s", cache->dir, name);
+        remove(path);
+        free(path);
+        return;
+    }
+    if (len != 35 || strcmp(name + 32, ".tl") != 0 || key_parse(&key, name) != 0) return;
+
+    path = entry_path(cache, &key, ".tl");
+    wav_size = 0;
+    if (stat(path, &st) == 0) {
+        free(path);
+        path = entry_path(cache, &key, ".wav");
+        wav_size = file_size(path);
+    }
+    free(path);
+    if (wav_size <= 0) return;
+
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 256;
+        *items = realloc(*items, *cap * sizeof(scanned_item));
+    }
+    (*items)[*n].key = key;
+    (*items)[*n].size = (int64_t) st.st_size + wav_size;
+    (*items)[*n].used = st.st_mtime;
+    (*n)++;
+}
+
+static void cache_scan(tts_cache * cache) {
+    scanned_item * items = NULL;
+    int i, n = 0, cap = 0;
+#ifndef WIN32
+    DIR * dir = opendir(cache->dir);
+    struct dirent * de;
+    if (!dir) return;
+    while ((de = readdir(dir)) != NULL) scan_name(cache, de->d_name, &items, &n, &cap);
+    closedir(dir);
+#else
+    WIN32_FIND_DATAA fd;
+    HANDLE find;
+    char * pattern = malloc(strlen(cache->dir) + 3);
+    sprintf(pattern, "%s/*", cache->dir);
+    find = FindFirstFileA(pattern, &fd);
+    free(pattern);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do {
+        scan_name(cache, fd.cFileName, &items, &n, &cap);
+    } while (FindNextFileA(find, &fd));
+    FindClose(find);
+#endif
+
+    /* most recently used first */
+    if (n > 1) qsort(items, n, sizeof(scanned_item), compare_used);
+    for (i = 0; i < n; i++) {
+        if (!item_find(cache, &items[i].key))
+            disk_push_back(cache, item_add(cache, &items[i].key, items[i].size));
+    }
+    free(items);
+}
+
+TTS_EXPORT tts_cache * tts_cache_open(const char * dir, int memory_mb, int disk_mb) {
+    tts_cache * cache;
+    struct stat st;
+
+#ifndef WIN32
+    mkdir(dir, 0777);
+#else
+    _mkdir(dir);
+#endif
+    if (stat(dir, &st) != 0 || !(st.st_mode & S_IFDIR)) {
+        fprintf(stderr, "ERROR: unable to use cache directory '%s'\n", dir);
+        return NULL;
+    }
+
+    cache = calloc(1, sizeof(tts_cache));
+    cache->dir = malloc(strlen(dir) + 1);
+    strcpy(cache->dir, dir);
+    cache->memory_limit = (int64_t) (memory_mb > 0 ? memory_mb : 64) * 1024 * 1024;
+    cache->disk_limit = (int64_t) (disk_mb > 0 ? disk_mb : 1024) * 1024 * 1024;
+    tts_mutex_init(&cache->lock);
+
+    cache_scan(cache);
+    disk_trim(cache);
+    fprintf(stderr, "INFO: cache '%s': %lld entries, %.1f MB\n", dir,
+            (long long) cache->stats.entries, cache->stats.disk_bytes / (1024.0 * 1024.0));
+    return cache;
+}
+
+TTS_EXPORT void tts_cache_close(tts_cache * cache) {
+    cache_item * item, * next;
+    if (!cache) return;
+    for (item = cache->disk_head; item; item = next) {
+        next = item->next;
+        if (item->entry) entry_unmap(cache, item->entry);
+        free(item);
+    }
+    tts_mutex_destroy(&cache->lock);
+    free(cache->dir);
+    free(cache);
+}
+
+/* Maps the files of item.  Returns NULL if they are missing or damaged. */
+static tts_cache_entry * entry_map(tts_cache * cache, cache_item * item) {
+    tts_cache_entry * e = calloc(1, sizeof(tts_cache_entry));
+    const unsigned char * h;
+    char * path;
+    unsigned long data_size;
+
+    path = entry_path(cache, &item->key, ".tl");
+    if (tts_timeline_map(&e->timeline, path) != 0) {
+        free(path);
+        free(e);
+        return NULL;
+    }
+    free(path);
+    path = entry_path(cache, &item->key, ".wav");
+    e->wav_base = map_file(path, &e->wav_size);
+    free(path);
+
+    /* only files written by tts_cache_writer are expected here */
+    h = (const unsigned char *) e->wav_base;
+    data_size = h && e->wav_size >= TTS_WAV_HEADER_SIZE ? get_u32(h + 40) : 0;
+    if (!h || e->wav_size < TTS_WAV_HEADER_SIZE || memcmp(h, "RIFF", 4) != 0 ||
+        memcmp(h + 36, "data", 4) != 0 || data_size > e->wav_size - TTS_WAV_HEADER_SIZE) {
+        if (h) unmap_file(e->wav_base, e->wav_size);
+        tts_timeline_unmap(&e->timeline);
+        free(e);
+        return NULL;
+    }
+
+    e->key = item->key;
+    e->samples = (const short *) (h + TTS_WAV_HEADER_SIZE);
+    e->n_samples = (uint32_t) (data_size / 2);
+    e->sample_rate = (int) get_u32(h + 24);
+    e->item = item;
+    item->entry = e;
+    cache->stats.memory_bytes += (int64_t) (e->wav_size + e->timeline.size);
+    memory_push_front(cache, e);
+    return e;
+}
+
+TTS_EXPORT tts_cache_entry * tts_cache_get(tts_cache * cache, const tts_cache_key * key) {
+    cache_item * item;
+    tts_cache_entry * e = NULL;
+    char * path;
+
+    tts_mutex_lock(&cache->lock);
+    item = item_find(cache, key);
+    if (item && item->entry) {
+        e = item->entry;
+        memory_unlink(cache, e);
+        memory_push_front(cache, e);
+        cache->stats.memory_hits++;
+    }
+    else if (item) {
+        e = entry_map(cache, item);
+        if (e) {
+            cache->stats.disk_hits++;
+        }
+        else {
+            /* removed or damaged behind our back */
+            fprintf(stderr, "WARNING: dropping unreadable cache entry\n");
+            item_remove(cache, item);
+            item = NULL;
+        }
+    }
+    if (e) {
+        e->refs++;
+        disk_unlink(cache, item);
+        disk_push_front(cache, item);
+        memory_trim(cache);
+    }
+    else {
+        cache->stats.misses++;
+    }
+    tts_mutex_unlock(&cache->lock);
+
+    /* keep the order on disk for the next run */
+    if (e) {
+        path = entry_path(cache, key, ".tl");
+        utime(path, NULL);
+        free(path);
+    }
+    return e;
+}
+
+TTS_EXPORT void tts_cache_release(tts_cache * cache, tts_cache_entry * entry) {
+    if (!entry) return;
+    tts_mutex_lock(&cache->lock);
+    entry->refs--;
+    if (entry->refs == 0) memory_trim(cache);
+    tts_mutex_unlock(&cache->lock);
+}
+
+TTS_EXPORT int tts_cache_entry_save(const tts_cache_entry * entry, const char * wav_path,
+                                    const char * timeline_path) {
+    FILE * fp;
+    int res = 0;
+
+    if (wav_path) {
+        fp = fopen(wav_path, "wb");
+        if (!fp || fwrite(entry->wav_base, 1, entry->wav_size, fp) != entry->wav_size) res = -1;
+        if (fp && fclose(fp) != 0) res = -1;
+    }
+    if (timeline_path) {
+        fp = fopen(timeline_path, "wb");
+        if (!fp || fwrite(entry->timeline.base, 1, entry->timeline.size, fp) != entry->timeline.size) res = -1;
+        if (fp && fclose(fp) != 0) res = -1;
+    }
+    return res;
+}
+
+/* ---- writer ---- */
+
+TTS_EXPORT tts_cache_writer * tts_cache_writer_open(tts_cache * cache, const tts_cache_key * key,
+                                                    int sample_rate) {
+    tts_cache_writer * w = calloc(1, sizeof(tts_cache_writer));
+    char suffix[64];
+    unsigned int n;
+
+    tts_mutex_lock(&cache->lock);
+    n = cache->temp_counter++;
+    tts_mutex_unlock(&cache->lock);
+
+    /* unique between the threads and processes sharing the directory */
+    w->cache = cache;
+    w->key = *key;
+    sprintf(suffix, ".wav.%d.%u.tmp", (int) getpid(), n);
+    w->wav_temp = entry_path(cache, key, suffix);
+    sprintf(suffix, ".tl.%d.%u.tmp", (int) getpid(), n);
+    w->timeline_temp = entry_path(cache, key, suffix);
+
+    w->wav = tts_wav_open(w->wav_temp, sample_rate, 0);
+    if (w->wav) w->timeline = tts_timeline_writer_open(w->timeline_temp, sample_rate);
+    if (!w->wav || !w->timeline) {
+        fprintf(stderr, "WARNING: unable to write to cache directory '%s'\n", cache->dir);
+        w->failed = 1;
+    }
+    return w;
+}
+
+#ifndef TTS_TIMELINE_NO_ENGINE
+void tts_cache_writer_add_abuf(tts_cache_writer * w, CPRC_abuf * abuf) {
+    if (w->failed) return;
+    tts_timeline_writer_add_abuf(w->timeline, abuf);
+    if (tts_wav_write_abuf(w->wav, abuf) < 0) w->failed = 1;
+}
+#endif
+
+TTS_EXPORT void tts_cache_writer_add(tts_cache_writer * w, int type, uint32_t start, uint32_t end,
+                                     const char * name) {
+    if (!w->failed) tts_timeline_writer_add(w->timeline, type, start, end, name);
+}
+
+TTS_EXPORT void tts_cache_writer_add_audio(tts_cache_writer * w, const short * samples, int n) {
+    if (w->failed || n <= 0) return;
+    if (tts_wav_write(w->wav, samples, n) < 0) {
+        w->failed = 1;
+        return;
+    }
+    tts_timeline_writer_add_samples(w->timeline, (uint32_t) n);
+}
+
+void tts_cache_writer_add_frames(tts_cache_writer * w, const tts_timeline_frame * frames, int n) {
+    if (!w->failed) tts_timeline_writer_add_frames(w->timeline, frames, n);
+}
+
+static void writer_free(tts_cache_writer * w) {
+    free(w->wav_temp);
+    free(w->timeline_temp);
+    free(w);
+}
+
+TTS_EXPORT void tts_cache_writer_abort(tts_cache_writer * w) {
+    if (w->wav) tts_wav_close(w->wav);
+    if (w->timeline) tts_timeline_writer_close(w->timeline);
+    remove(w->wav_temp);
+    remove(w->timeline_temp);
+    writer_free(w);
+}
+
+TTS_EXPORT int tts_cache_writer_commit(tts_cache_writer * w) {
+    tts_cache * cache = w->cache;
+    char * wav_path, * timeline_path;
+    int64_t size;
+    int res = 0;
+
+    if (w->failed) res = -1;
+    if (w->wav && tts_wav_close(w->wav) != 0) res = -1;
+    w->wav = NULL;
+    if (w->timeline && tts_timeline_writer_close(w->timeline) != 0) res = -1;
+    w->timeline = NULL;
+    if (res != 0) {
+        tts_cache_writer_abort(w);
+        return -1;
+    }
+
+    wav_path = entry_path(cache, &w->key, ".wav");
+    timeline_path = entry_path(cache, &w->key, ".tl");
+    size = file_size(w->wav_temp) + file_size(w->timeline_temp);
+
+    tts_mutex_lock(&cache->lock);
+    if (item_find(cache, &w->key)) {
+        /* stored meanwhile by another request for the same text */
+        tts_mutex_unlock(&cache->lock);
+        remove(w->wav_temp);
+        remove(w->timeline_temp);
+    }
+    else {
+        /* the timeline last: only then does the entry exist */
+        if (replace_file(w->wav_temp, wav_path) != 0 || replace_file(w->timeline_temp, timeline_path) != 0) {
+            remove(w->wav_temp);
+            remove(w->timeline_temp);
+            res = -1;
+        }
+        else {
+            disk_push_front(cache, item_add(cache, &w->key, size));
+            cache->stats.stores++;
+            disk_trim(cache);
+        }
+        tts_mutex_unlock(&cache->lock);
+    }
+
+    free(wav_path);
+    free(timeline_path);
+    writer_free(w);
+    return res;
+}
+
+/* ---- statistics ---- */
+
+TTS_EXPORT void tts_cache_get_stats(tts_cache * cache, tts_cache_stats * stats) {
+    tts_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    tts_mutex_unlock(&cache->lock);
+}
+
+void tts_cache_print_stats(tts_cache * cache) {
+    tts_cache_stats s;
+    int64_t lookups;
+
+    tts_cache_get_stats(cache, &s);
+    lookups = s.memory_hits + s.disk_hits + s.misses;
+    fprintf(stderr, "INFO: cache: %lld lookup(s), %lld memory hit(s), %lld disk hit(s), %lld miss(es), hit rate %.1f%%\n",
+            (long long) lookups, (long long) s.memory_hits, (long long) s.disk_hits, (long long) s.misses,
+            lookups ? 100.0 * (s.memory_hits + s.disk_hits) / lookups : 0.0);
+    fprintf(stderr, "INFO: cache: %lld store(s), %lld memory eviction(s), %lld disk eviction(s)\n",
+            (long long) s.stores, (long long) s.memory_evictions, (long long) s.disk_evictions);
+    fprintf(stderr, "INFO: cache: %lld entries, %.1f MB on disk, %.1f MB mapped\n",
+            (long long) s.entries, s.disk_bytes / (1024.0 * 1024.0), s.memory_bytes / (1024.0 * 1024.0));
+}
@@ -0,0 +1,131 @@
+/* Content-addressed synthesis cache.
+
+   Synthesised utterances are stored under a 128 bit key derived from
+   everything that determines the engine output: the voice file (name,
+   size and modification time), the contents of the user lexicon, the
+   channel settings and the input text or SSML, with whitespace
+   normalised so that reformatting the input does not miss.  A repeated
+   request is answered from the cache without touching the engine.
+
+   On disk each entry is a pair of files in the cache directory named by
+   the key in hex: <key>.wav, 16 bit mono PCM that can be played or
+   copied as is, and <key>.tl, its timeline (see tts_timeline.h).  Both
+   are written under temporary names and renamed, the timeline last, so
+   an entry exists exactly when its .tl file does.  The directory is
+   kept under a size limit by removing the least recently used entries;
+   the order survives restarts through the modification time of the .tl
+   files, which is refreshed on every hit.
+
+   In front of the store, recently used entries stay mapped in memory up
+   to a second limit.  Entries handed out by tts_cache_get are reference
+   counted and are never unmapped while in use.
+
+   The cache is safe to share between threads.  Several processes may
+   use the same directory; each keeps its own index, so the size limit
+   is only approximate in that case.
+
+   Unity uses the cache, the WAV writer and the consumer side of the
+   spurt ring through P/Invoke (SynthesisCache.cs, WavSink.cs,
+   SpeechRing.cs).  Shared library build, no engine
+   needed:
+     gcc -O2 -shared -fPIC -DTTS_TIMELINE_NO_ENGINE -o libtts_tools.so \
+         tts_cache.c tts_wav.c tts_timeline.c tts_ring.c
+   (tts_tools.dll with MinGW on Windows), copied to Assets/Plugins/x86_x64;
+   make in StreamingAssets does both (see the Makefile).
+*/
+
+#ifndef TTS_CACHE_H
+#define TTS_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "tts_timeline.h"
+
+typedef struct tts_cache_key {
+    uint64_t h[2];
+} tts_cache_key;
+
+/* Key of the synthesis settings.  maxp is the phone pipeline limit of
+   CPRCEN_channel_set_phone_min_max, 0 if not set; lexicon_file may be
+   NULL.  Returns -1 if the voice file cannot be found. */
+TTS_EXPORT int tts_cache_key_config(tts_cache_key * key, const char * voice_file,
+                                    const char * lexicon_file, int maxp);
+/* Key of one request: the settings key combined with the normalised
+   text.  Lines are trimmed, runs of blanks collapsed and empty lines
+   dropped. */
+TTS_EXPORT void tts_cache_key_text(tts_cache_key * key, const tts_cache_key * config,
+                                   const char * text, int textlen);
+/* 32 hex digits and a NUL */
+void tts_cache_key_hex(const tts_cache_key * key, char * hex);
+
+typedef struct tts_cache tts_cache;
+
+/* Opens, creating it if needed, the cache directory.  The limits are in
+   megabytes, 0 for the defaults (64 MB mapped, 1024 MB on disk).
+   Returns NULL if the directory cannot be used. */
+TTS_EXPORT tts_cache * tts_cache_open(const char * dir, int memory_mb, int disk_mb);
+/* All entries must have been released */
+TTS_EXPORT void tts_cache_close(tts_cache * cache);
+
+/* A mapped cache entry */
+typedef struct tts_cache_entry {
+    tts_cache_key key;
+    const short * samples;
+    uint32_t n_samples;
+    int sample_rate;
+    tts_timeline timeline;
+    /* private */
+    void * wav_base;
+    size_t wav_size;
+    int refs;
+    struct cache_item * item;
+    struct tts_cache_entry * prev, * next; /* memory LRU, most recent first */
+} tts_cache_entry;
+
+/* Returns the entry of key, or NULL on a miss.  The entry stays valid
+   until given back with tts_cache_release. */
+TTS_EXPORT tts_cache_entry * tts_cache_get(tts_cache * cache, const tts_cache_key * key);
+TTS_EXPORT void tts_cache_release(tts_cache * cache, tts_cache_entry * entry);
+/* Copies the entry's audio and timeline to the given paths, either may
+   be NULL.  Returns 0 on success. */
+TTS_EXPORT int tts_cache_entry_save(const tts_cache_entry * entry, const char * wav_path,
+                                    const char * timeline_path);
+
+/* Records a synthesis into the cache.  Spurts are added as they are
+   returned by the engine; the entry becomes visible on commit. */
+typedef struct tts_cache_writer tts_cache_writer;
+
+TTS_EXPORT tts_cache_writer * tts_cache_writer_open(tts_cache * cache, const tts_cache_key * key,
+                                                    int sample_rate);
+#ifndef TTS_TIMELINE_NO_ENGINE
+void tts_cache_writer_add_abuf(tts_cache_writer * w, CPRC_abuf * abuf);
+#endif
+/* For callers without CPRC_abuf access: transcription records with
+   times in samples from the start of the utterance, then the spurt's
+   audio. */
+TTS_EXPORT void tts_cache_writer_add(tts_cache_writer * w, int type, uint32_t start, uint32_t end,
+                                     const char * name);
+TTS_EXPORT void tts_cache_writer_add_audio(tts_cache_writer * w, const short * samples, int n);
+/* Envelope frames of a post-processed synthesis (tts_post.h) */
+void tts_cache_writer_add_frames(tts_cache_writer * w, const tts_timeline_frame * frames, int n);
+/* Returns 0 if the entry was stored.  The writer is freed either way. */
+TTS_EXPORT int tts_cache_writer_commit(tts_cache_writer * w);
+TTS_EXPORT void tts_cache_writer_abort(tts_cache_writer * w);
+
+typedef struct tts_cache_stats {
+    int64_t memory_hits;       /* found mapped */
+    int64_t disk_hits;         /* found on disk and mapped */
+    int64_t misses;
+    int64_t stores;
+    int64_t memory_evictions;  /* unmapped to stay under the memory limit */
+    int64_t disk_evictions;    /* removed to stay under the disk limit */
+    int64_t memory_bytes;
+    int64_t disk_bytes;
+    int64_t entries;           /* on disk */
+} tts_cache_stats;
+
+TTS_EXPORT void tts_cache_get_stats(tts_cache * cache, tts_cache_stats * stats);
+/* "INFO: cache: ..." summary on stderr */
+void tts_cache_print_stats(tts_cache * cache);
+
+#endif /* TTS_CACHE_H */
@@ -24,8 +24,19 @@
 #include <stdlib.h>
 #include <cerevoice_eng.h>
 #include <cerevoice_aud.h>
-
-#define MAX_READ 100000
+#include "tts_arena.h"
+#include "tts_audio.h"
+#include "tts_batch.h"
+#include "tts_bench.h"
+#include "tts_cache.h"
+#include "tts_pool.h"
+#include "tts_post.h"
+#include "tts_ring.h"
+#include "tts_server.h"
+#include "tts_split.h"
+#include "tts_thread.h"
+#include "tts_timeline.h"
+#include "tts_wav.h"
 
 void usage(char * name){
     fprintf(stderr, "tts_callback - a sample TTS program that uses the CereVoice Engine API with\n");
@@ -33,11 +44,40 @@ void usage(char * name){
     fprintf(stderr, "tts_callback loads a voice, then speaks text/XML from an input file, or from\n");
     fprintf(stderr, "stdin if the input file is not supplied.  Optionally the audio output can be\n");
     fprintf(stderr, "written to a wave file.\n\n");
+    fprintf(stderr, "With -s, tts_callback runs as a synthesis server instead: the voice is\n");
+    fprintf(stderr, "loaded once and requests are served on a Unix socket from a pool of\n");
+    fprintf(stderr, "channels (see tts_server.h for the protocol).\n\n");
+    fprintf(stderr, "With -b, every entry of a manifest is rendered to a wave file and a\n");
+    fprintf(stderr, "timeline, in parallel on a pool of channels (see tts_batch.h).\n\n");
+    fprintf(stderr, "With -c, synthesised input is kept in a cache directory and repeated\n");
+    fprintf(stderr, "input is answered from it without loading the voice (see tts_cache.h).\n\n");
+    fprintf(stderr, "With -P, the input is split at sentence boundaries and synthesised on a\n");
+    fprintf(stderr, "pool of channels, the audio being output in order (see tts_split.h).\n");
+    fprintf(stderr, "Times of the INFO lines are then from the start of the input.\n\n");
+    fprintf(stderr, "With -m, every spurt is handed to the process that created the shared\n");
+    fprintf(stderr, "memory ring ring_name, audio and transcription together (see tts_ring.h).\n\n");
+    fprintf(stderr, "With -r, -L or -e, the audio is resampled, normalised and analysed as it\n");
+    fprintf(stderr, "comes out of the engine (see tts_post.h).  The F0 and loudness frames of -e\n");
+    fprintf(stderr, "go to the timeline and the ring.  Not used by -s and -b.\n\n");
     fprintf(stderr, "Usage: %s [Options] voice_file license_file [input_file]\n", name);
     fprintf(stderr, "Options:\n"); 
     fprintf(stderr, " -h\t\t  Display help\n");
     fprintf(stderr, " -o output_file\t  Output audio to file\n");
     fprintf(stderr, " -p <n>\t  Max number of phones in pipeline\n");
+    fprintf(stderr, " -l lexicon_file\t  Load a user lexicon\n");
+    fprintf(stderr, " -t timeline_file\t  Write the transcription as a binary timeline\n");
+    fprintf(stderr, " -s socket_path\t  Run as a synthesis server on socket_path\n");
+    fprintf(stderr, " -b manifest_file\t  Render all items of manifest_file\n");
+    fprintf(stderr, " -d output_dir\t  Output directory of the batch mode (default: .)\n");
+    fprintf(stderr, " -n <n>\t  Number of server, batch or -P channels (default: number of CPUs)\n");
+    fprintf(stderr, " -P\t\t  Synthesise the sentences of the input in parallel\n");
+    fprintf(stderr, " -c cache_dir\t  Cache synthesis results in cache_dir\n");
+    fprintf(stderr, " -C <n>\t  Cache size limit in MB (default: 1024)\n");
+    fprintf(stderr, " -j stats_file\t  Write benchmark statistics as JSON (see tts_bench.h)\n");
+    fprintf(stderr, " -m ring_name\t  Write the spurts to a shared memory ring instead of playing them\n");
+    fprintf(stderr, " -r <n>\t  Output sample rate (default: the voice's)\n");
+    fprintf(stderr, " -L <dBFS>\t  Normalise the speech to an RMS level, e.g. -20\n");
+    fprintf(stderr, " -e\t\t  Compute the F0 and loudness envelope\n");
     exit(0);
 }
 
@@ -46,9 +86,31 @@ void usage(char * name){
  */
 typedef struct user_data {
     CPRC_sc_player * player;
+    /* Binary transcription output, replaces the printed INFO lines */
+    tts_timeline_writer * timeline;
+    /* Records the synthesis for the cache */
+    tts_cache_writer * cache;
+    /* Audio file output, one stream for the whole input */
+    tts_wav_writer * wav;
+    /* Shared memory output to the consumer that created the ring */
+    tts_ring * ring;
+    /* Latency and allocation measurements, if requested */
+    tts_bench * bench;
+    int sample_rate;
+    /* Resampling, loudness and envelope of the audio before the outputs,
+       sample_rate is then the output rate */
+    tts_post * post;
+    /* Spurts passed to the post-processing in sequential mode */
+    tts_arena arena;
+    int voice_rate;
+    int64_t voice_samples;   /* engine samples output so far, kept by split_output */
+    /* Buffers cued on the player, deleted once played */
+    tts_audio_pool audio;
     /* Add other user-specific settings here */
 } user_data;
 
+void split_output(const tts_split_spurt * spurt, uint32_t offset, void * userdata);
+
 /* Callback function
 
    The callback function is fired for every phrase returned by the
@@ -63,10 +125,10 @@ void channel_callback(CPRC_abuf * abuf, void * userdata) {
        markers etc.
      */
     const CPRC_abuf_trans * trans;
-    CPRC_sc_audio * buf = NULL;
     const char * name;
     float start, end;
     user_data * data = (user_data *) userdata;
+    tts_split_spurt * spurt;
     int i;
     int wav_mk;
     int wav_done;
@@ -75,49 +137,223 @@ void channel_callback(CPRC_abuf * abuf, void * userdata) {
     wav_mk = CPRC_abuf_wav_mk(abuf);
     wav_done = CPRC_abuf_wav_done(abuf);
     printf("INFO: wav_mk %i, wav_done %i\n", wav_mk, wav_done);
+    if (data->post) {
+        /* Processed audio goes the way of the -P spurts, with times from
+           the start of the input */
+        spurt = tts_split_spurt_new(abuf, &data->arena, data->voice_rate, 0);
+        for (i = 0; i < spurt->n_trans; i++) {
+            spurt->trans[i].start += data->voice_samples;
+            spurt->trans[i].end += data->voice_samples;
+            if (spurt->trans[i].start < 0) spurt->trans[i].start = 0;
+            if (spurt->trans[i].end < 0) spurt->trans[i].end = 0;
+        }
+        split_output(spurt, (uint32_t) data->voice_samples, data);
+        tts_arena_reset(&data->arena);
+        return;
+    }
+    if (data->bench) tts_bench_callback_begin(data->bench);
     if (wav_mk < 0) wav_mk = 0;
     if (wav_done < 0) wav_done = 0;
-    /* Process the transcription buffer items and print information. */
-    for(i = 0; i < CPRC_abuf_trans_sz(abuf); i++) {
-        trans = CPRC_abuf_get_trans(abuf, i);
-        start = CPRC_abuf_trans_start(trans);
-        end = CPRC_abuf_trans_end(trans);
-        name = CPRC_abuf_trans_name(trans);
-        if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_PHONE) {
-            printf("INFO: phoneme: %.3f %.3f %s\n", start, end, name);
-        } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_WORD) {
-            printf("INFO: word: %.3f %.3f %s\n", start, end, name);
-        } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_MARK) {
-            printf("INFO: marker: %.3f %.3f %s\n", start, end, name);
-        } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_ERROR) {
-            printf("ERROR: could not retrieve transcription at '%d'", i);
+    /* Process the transcription buffer items and print information,
+       unless the timeline or the ring was requested to carry them. */
+    if (data->cache) tts_cache_writer_add_abuf(data->cache, abuf);
+    if (data->wav) tts_wav_write_abuf(data->wav, abuf);
+    if (data->ring) tts_ring_write_abuf(data->ring, abuf);
+    if (data->timeline) {
+        tts_timeline_writer_add_abuf(data->timeline, abuf);
+    }
+    else if (!data->ring) {
+        for(i = 0; i < CPRC_abuf_trans_sz(abuf); i++) {
+            trans = CPRC_abuf_get_trans(abuf, i);
+            start = CPRC_abuf_trans_start(trans);
+            end = CPRC_abuf_trans_end(trans);
+            name = CPRC_abuf_trans_name(trans);
+            if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_PHONE) {
+                printf("INFO: phoneme: %.3f %.3f %s\n", start, end, name);
+            } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_WORD) {
+                printf("INFO: word: %.3f %.3f %s\n", start, end, name);
+            } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_MARK) {
+                printf("INFO: marker: %.3f %.3f %s\n", start, end, name);
+            } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_ERROR) {
+                printf("ERROR: could not retrieve transcription at '%d'", i);
+            }
         }
     }
     if (data->player) {
         /* Use the CereVoice Audio API to play the audio that has been
            returned, the audio is converted to a buffer and cued for
-           playback.
+           playback.  The pool deletes the buffers already played.
          */
-        buf = CPRC_sc_audio_short_disposable(CPRC_abuf_wav_data(abuf)+wav_mk, wav_done - wav_mk);
-        CPRC_sc_audio_cue(data->player, buf);
+        if (wav_done > wav_mk) tts_audio_pool_cue(&data->audio, CPRC_abuf_wav_data(abuf) + wav_mk, wav_done - wav_mk);
+    }
+    if (data->bench) tts_bench_callback_end(data->bench, wav_done - wav_mk);
+}
+
+/* Sends audio and its transcription to the outputs.  Times are in
+   samples of the output from the start of the input. */
+void output_spurt(user_data * data, const tts_split_trans * trans, int n_trans, const tts_post_output * out) {
+    static const char * kinds[] = { "phoneme", "word", "marker" };
+    uint32_t start, end;
+    int i;
+
+    for (i = 0; i < n_trans; i++) {
+        start = data->post ? tts_post_map(data->post, trans[i].start) : (uint32_t) trans[i].start;
+        end = data->post ? tts_post_map(data->post, trans[i].end) : (uint32_t) trans[i].end;
+        if (data->cache) tts_cache_writer_add(data->cache, trans[i].type, start, end, trans[i].name);
+        if (data->ring) tts_ring_add(data->ring, trans[i].type, start, end, trans[i].name);
+        if (data->timeline) {
+            tts_timeline_writer_add(data->timeline, trans[i].type, start, end, trans[i].name);
+        }
+        else if (!data->ring) {
+            printf("INFO: %s: %.3f %.3f %s\n", kinds[trans[i].type], start / (double) data->sample_rate,
+                   end / (double) data->sample_rate, trans[i].name);
+        }
+    }
+    if (out->n_frames > 0) {
+        if (data->cache) tts_cache_writer_add_frames(data->cache, out->frames, out->n_frames);
+        if (data->ring) tts_ring_add_frames(data->ring, out->frames, out->n_frames);
+        if (data->timeline) tts_timeline_writer_add_frames(data->timeline, out->frames, out->n_frames);
+    }
+    if (data->cache) tts_cache_writer_add_audio(data->cache, out->samples, out->n_samples);
+    if (data->wav) tts_wav_write(data->wav, out->samples, out->n_samples);
+    if (data->ring) tts_ring_write(data->ring, out->samples, out->n_samples);
+    if (data->timeline) tts_timeline_writer_add_samples(data->timeline, (uint32_t) out->n_samples);
+    if (data->player && out->n_samples > 0) {
+        /* The samples are reused on return, the buffer keeps a copy */
+        tts_audio_pool_cue(&data->audio, (short *) out->samples, out->n_samples);
+    }
+}
+
+/* Output function of the -P mode
+
+   Receives the spurts of all channels in the order of the input, with
+   their transcription already offset to the start of the input, and
+   sends them to the same outputs as channel_callback, through the
+   post-processing if it was requested.
+*/
+void split_output(const tts_split_spurt * spurt, uint32_t offset, void * userdata) {
+    user_data * data = (user_data *) userdata;
+    tts_post_output out;
+
+    if (data->bench) tts_bench_callback_begin(data->bench);
+    if (data->post) {
+        tts_post_process(data->post, spurt->samples, spurt->n_samples, &out);
     }
+    else {
+        out.samples = spurt->samples;
+        out.n_samples = spurt->n_samples;
+        out.frames = NULL;
+        out.n_frames = 0;
+    }
+    output_spurt(data, spurt->trans, spurt->n_trans, &out);
+    data->voice_samples = (int64_t) offset + spurt->n_samples;
+    if (data->bench) tts_bench_callback_end(data->bench, out.n_samples);
+}
+
+/* Reads the whole input, the cache key needs all of it */
+char * read_input(FILE * fp, long * len) {
+    char * text = NULL;
+    long cap = 0;
+    size_t n;
+
+    *len = 0;
+    do {
+        if (*len + 4096 + 1 > cap) {
+            cap = cap ? cap * 2 : 65536;
+            text = realloc(text, cap);
+        }
+        n = fread(text + *len, 1, cap - *len - 1, fp);
+        *len += (long) n;
+    } while (n > 0);
+    text[*len] = '\0';
+    return text;
+}
+
+/* Outputs a cached synthesis as the engine would have: audio to the
+   output file or the player, transcription to the timeline or as INFO
+   lines.  Times of the INFO lines are from the start of the input. */
+int output_cached(const tts_cache_entry * entry, const char * file_out, const char * timeline_file,
+                  const char * ring_name) {
+    const tts_timeline * tl = &entry->timeline;
+    const tts_timeline_record * rec;
+    const char * kind;
+    CPRC_sc_player * player;
+    tts_ring * ring;
+    uint32_t i, n;
+
+    if (tts_cache_entry_save(entry, file_out, timeline_file) != 0) {
+        fprintf(stderr, "ERROR: unable to write output files\n");
+        return -1;
+    }
+    if (ring_name) {
+        /* The whole transcription first, then the audio in spurts that
+           fit in the ring */
+        ring = tts_ring_open(ring_name, entry->sample_rate);
+        if (!ring) return -1;
+        for (i = 0; i < tl->header->n_records; i++) {
+            rec = &tl->records[i];
+            tts_ring_add(ring, rec->type, rec->start, rec->end, tts_timeline_symbol(tl, rec->symbol));
+        }
+        tts_ring_add_frames(ring, tl->frames, (int) tl->header->n_frames);
+        tts_ring_write(ring, NULL, 0);
+        for (i = 0; i < entry->n_samples; i += n) {
+            n = entry->n_samples - i < (uint32_t) entry->sample_rate ? entry->n_samples - i : (uint32_t) entry->sample_rate;
+            if (tts_ring_write(ring, entry->samples + i, (int) n) != 0) break;
+        }
+        tts_ring_write_done(ring);
+        tts_ring_close(ring);
+        return i < entry->n_samples ? -1 : 0;
+    }
+    if (!timeline_file) {
+        for (i = 0; i < tl->header->n_records; i++) {
+            rec = &tl->records[i];
+            kind = rec->type == TTS_TIMELINE_PHONE ? "phoneme" : (rec->type == TTS_TIMELINE_WORD ? "word" : "marker");
+            printf("INFO: %s: %.3f %.3f %s\n", kind, tts_timeline_seconds(tl, rec->start),
+                   tts_timeline_seconds(tl, rec->end), tts_timeline_symbol(tl, rec->symbol));
+        }
+    }
+    if (!file_out && !ring_name && entry->n_samples > 0) {
+        player = CPRC_sc_player_new(entry->sample_rate);
+        CPRC_sc_audio_cue(player, CPRC_sc_audio_short_disposable((short *) entry->samples, entry->n_samples));
+        while (CPRC_sc_audio_busy(player)) {
+            CPRC_sc_sleep_msecs(50);
+        }
+        CPRC_sc_player_delete(player);
+    }
+    return 0;
 }
 
 int main(int argc, char * argv[]){
 
-    CPRCEN_engine * eng;
-    CPRCEN_channel_handle hc;
-    user_data data = {NULL};
+    CPRCEN_engine * eng = NULL;
+    CPRCEN_channel_handle hc = 0;
+    user_data data = {0};
 
     char * voice_file = NULL;
     char * license_file = NULL;
     char * text_file = NULL;
     char * file_out = NULL;
-    char text_buffer[MAX_READ];
-    char * ret;
+    char * lexicon_file = NULL;
+    char * timeline_file = NULL;
+    char * socket_path = NULL;
+    char * manifest_file = NULL;
+    char * output_dir = ".";
+    char * cache_dir = NULL;
+    char * stats_file = NULL;
+    char * ring_name = NULL;
+    tts_bench bench;
+    tts_pool * pool = NULL;
+    tts_cache * cache = NULL;
+    tts_cache_key cache_config, key;
+    tts_post_config post_config = {0, 0, 0, 0};
+    tts_post_output post_out;
+    char post_settings[64];
+    tts_cache_entry * entry;
+    char * text, * line, * nl;
+    long textlen;
     const char * freqstr;
     FILE * text_fp;
-    int arg, i, res, freq, maxp = 0;
+    int arg, i, res, freq, maxp = 0, nchannels = 0, cache_mb = 0, parallel = 0, post;
     
     /* Processing arguments */
     arg = 0;
@@ -138,6 +374,96 @@ int main(int argc, char * argv[]){
             }
             else usage(argv[0]);
         }
+        else if (strcmp(argv[i], "-l") == 0) {
+            i++;
+            if (i < argc) {
+                lexicon_file = argv[i];
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-t") == 0) {
+            i++;
+            if (i < argc) {
+                timeline_file = argv[i];
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-s") == 0) {
+            i++;
+            if (i < argc) {
+                socket_path = argv[i];
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-b") == 0) {
+            i++;
+            if (i < argc) {
+                manifest_file = argv[i];
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-d") == 0) {
+            i++;
+            if (i < argc) {
+                output_dir = argv[i];
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-n") == 0) {
+            i++;
+            if (i < argc) {
+                nchannels = strtol(argv[i], NULL, 10);
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-c") == 0) {
+            i++;
+            if (i < argc) {
+                cache_dir = argv[i];
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-C") == 0) {
+            i++;
+            if (i < argc) {
+                cache_mb = strtol(argv[i], NULL, 10);
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-P") == 0) {
+            parallel = 1;
+        }
+        else if (strcmp(argv[i], "-j") == 0) {
+            i++;
+            if (i < argc) {
+                stats_file = argv[i];
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-m") == 0) {
+            i++;
+            if (i < argc) {
+                ring_name = argv[i];
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-r") == 0) {
+            i++;
+            if (i < argc) {
+                post_config.out_rate = strtol(argv[i], NULL, 10);
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-L") == 0) {
+            i++;
+            if (i < argc) {
+                post_config.loudness = (float) strtod(argv[i], NULL);
+            }
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-e") == 0) {
+            post_config.envelope = 1;
+        }
         /* Arguments */
         else {
             switch(arg) {
@@ -159,69 +485,199 @@ int main(int argc, char * argv[]){
     }
     if (arg < 2 || arg > 3) usage(argv[0]);
 
-    /* Create a empty engine object.  The engine maintains the list of
-       loaded voices and makes them available to synthesis channels. */
-    eng = CPRCEN_engine_new();
-    /* Load a voice into the engine */
-    res = CPRCEN_engine_load_voice(eng, license_file, NULL, voice_file, CPRC_VOICE_LOAD);
-    if (!res) {
-        fprintf(stderr, "ERROR: unable to load voice file '%s', exiting.\n", voice_file);
-        exit(-1);
+    /* The cache is keyed by everything that changes the engine output */
+    if (cache_dir) {
+        if (tts_cache_key_config(&cache_config, voice_file, lexicon_file, maxp) == 0)
+            cache = tts_cache_open(cache_dir, 0, cache_mb);
+        if (!cache) fprintf(stderr, "WARNING: continuing without cache\n");
+    }
+    if (post_config.out_rate < 0) post_config.out_rate = 0;
+    post = post_config.out_rate > 0 || post_config.loudness != 0 || post_config.envelope;
+    if (cache && post && !socket_path && !manifest_file) {
+        /* and by the post-processing */
+        snprintf(post_settings, sizeof(post_settings), "post %d %.2f %d", post_config.out_rate,
+                 post_config.loudness, post_config.envelope);
+        key = cache_config;
+        tts_cache_key_text(&cache_config, &key, post_settings, (int) strlen(post_settings));
+    }
+
+    /* Server and batch modes: load the voice once and keep a pool of
+       open channels for the lifetime of the process. */
+    if (socket_path || manifest_file) {
+        if (nchannels <= 0) nchannels = tts_cpu_count();
+        pool = tts_pool_new(voice_file, license_file, lexicon_file, nchannels, maxp);
+        if (!pool) {
+            fprintf(stderr, "ERROR: unable to set up synthesis pool, exiting.\n");
+            exit(-1);
+        }
+        if (cache) tts_pool_set_cache(pool, cache, &cache_config);
+        if (manifest_file)
+            res = tts_batch_run(pool, manifest_file, output_dir);
+        else
+            res = tts_server_run(pool, socket_path);
+        tts_pool_delete(pool);
+        if (cache) {
+            tts_cache_print_stats(cache);
+            tts_cache_close(cache);
+        }
+        return res != 0 ? -1 : 0;
+    }
+
+    /* Load the text to generate */
+    if (text_file == NULL)
+        text_fp = stdin;
+    else {
+        text_fp = fopen(text_file, "rb");
+        if (!text_fp) {
+            fprintf(stderr, "ERROR: unable to open text file '%s', exiting.\n", text_file);
+            exit(-1);
+        }
     }
+    text = read_input(text_fp, &textlen);
+    fclose(text_fp);
 
-    /* Open a synthesis channel. */
-    hc = CPRCEN_engine_open_default_channel(eng);
+    /* Repeated input does not need the engine at all */
+    if (cache) {
+        tts_cache_key_text(&key, &cache_config, text, (int) textlen);
+        entry = tts_cache_get(cache, &key);
+        if (entry) {
+            fprintf(stderr, "INFO: input found in cache\n");
+            res = output_cached(entry, file_out, timeline_file, ring_name);
+            tts_cache_release(cache, entry);
+            tts_cache_print_stats(cache);
+            tts_cache_close(cache);
+            free(text);
+            return res != 0 ? -1 : 0;
+        }
+    }
 
-    if (maxp > 0) {
-        CPRCEN_channel_set_phone_min_max(eng, hc, 0, maxp);
+    if (parallel) {
+        /* Sentences are synthesised concurrently, one per channel */
+        if (nchannels <= 0) nchannels = tts_cpu_count();
+        pool = tts_pool_new(voice_file, license_file, lexicon_file, nchannels, maxp);
+        if (!pool) {
+            fprintf(stderr, "ERROR: unable to set up synthesis pool, exiting.\n");
+            exit(-1);
+        }
+        freq = tts_pool_sample_rate(pool);
     }
+    else {
+        /* Create a empty engine object.  The engine maintains the list of
+           loaded voices and makes them available to synthesis channels. */
+        eng = CPRCEN_engine_new();
+        /* Load a voice into the engine */
+        res = CPRCEN_engine_load_voice(eng, license_file, NULL, voice_file, CPRC_VOICE_LOAD);
+        if (!res) {
+            fprintf(stderr, "ERROR: unable to load voice file '%s', exiting.\n", voice_file);
+            exit(-1);
+        }
+        if (lexicon_file && !CPRCEN_engine_load_user_lexicon(eng, 0, lexicon_file)) {
+            fprintf(stderr, "WARNING: unable to load user lexicon '%s'\n", lexicon_file);
+        }
+
+        /* Open a synthesis channel. */
+        hc = CPRCEN_engine_open_default_channel(eng);
 
-    /* Example of accessing voice information.  Sample rate is
-       required for setting up audio playback. */
-    fprintf(stderr, "INFO: voice name '%s'\n", CPRCEN_channel_get_voice_info(eng, hc, "VOICE_NAME"));
-    freqstr = CPRCEN_channel_get_voice_info(eng, hc, "SAMPLE_RATE");
-    fprintf(stderr, "INFO: voice sample rate is '%s'\n", freqstr);
-    freq = atoi(freqstr);
+        if (maxp > 0) {
+            CPRCEN_channel_set_phone_min_max(eng, hc, 0, maxp);
+        }
+
+        /* Example of accessing voice information.  Sample rate is
+           required for setting up audio playback. */
+        fprintf(stderr, "INFO: voice name '%s'\n", CPRCEN_channel_get_voice_info(eng, hc, "VOICE_NAME"));
+        freqstr = CPRCEN_channel_get_voice_info(eng, hc, "SAMPLE_RATE");
+        fprintf(stderr, "INFO: voice sample rate is '%s'\n", freqstr);
+        freq = atoi(freqstr);
+    }
+    if (post) {
+        post_config.in_rate = freq;
+        data.post = tts_post_new(&post_config);
+        data.voice_rate = freq;
+        tts_arena_init(&data.arena);
+        freq = tts_post_out_rate(data.post);
+        fprintf(stderr, "INFO: output sample rate is '%d'\n", freq);
+    }
+    data.sample_rate = freq;
 
     /* Set file output or audio playback depending on the command line
      options. */
     if (file_out) {
         data.player = NULL;
-        CPRCEN_engine_channel_to_file(eng, hc, file_out, CPRCEN_RIFF);
-    } else {
+        data.wav = tts_wav_open(file_out, freq, 0);
+        if (!data.wav) exit(-1);
+    } else if (!ring_name) {
         data.player = CPRC_sc_player_new(freq); 
-        /* data.cur_buf = NULL;
-          data.prev_buf = NULL; */
+        tts_audio_pool_init(&data.audio, data.player);
     }
-    res = CPRCEN_engine_set_callback(eng, hc, &data, channel_callback);
-    if (res) fprintf(stderr, "INFO: callback initialised\n");
-
-    /* Load the text to generate */
-    if (text_file == NULL)
-        text_fp = stdin;
-    else {
-        text_fp = fopen(text_file, "rb");
-        if (!text_file) {
-            fprintf(stderr, "ERROR: unable to open text file '%s', exiting.\n", text_file);
+    if (ring_name) {
+        data.ring = tts_ring_open(ring_name, freq);
+        if (!data.ring) exit(-1);
+    }
+    if (timeline_file) {
+        data.timeline = tts_timeline_writer_open(timeline_file, freq);
+        if (!data.timeline) exit(-1);
+    }
+    if (cache) data.cache = tts_cache_writer_open(cache, &key, freq);
+    if (stats_file) {
+        tts_bench_init(&bench, "tts_callback", freq);
+        data.bench = &bench;
+    }
+    if (parallel) {
+        if (data.bench) tts_bench_speak(data.bench);
+        if (tts_split_speak(pool, text, (int) textlen, split_output, &data) < 0) {
+            fprintf(stderr, "ERROR: unable to synthesise the input, exiting.\n");
             exit(-1);
         }
+        if (data.bench) tts_bench_done(data.bench);
     }
+    else {
+        res = CPRCEN_engine_set_callback(eng, hc, &data, channel_callback);
+        if (res) fprintf(stderr, "INFO: callback initialised\n");
 
-    /* Synthesise input line-by-line */
-    while (!feof(text_fp)) {
-        ret = fgets(text_buffer, MAX_READ, text_fp);
-        if (!ret) break;
-        fprintf(stderr, "INFO: text read '%s'\n", text_buffer);
-        /* Synthesise the text buffer - the final argument is 'flush'.
-           Do not flush the buffer until all the input is sent.
-         */
-        CPRCEN_engine_channel_speak(eng, hc, text_buffer, strlen(text_buffer), 0);
+        /* Synthesise input line-by-line */
+        for (line = text; line < text + textlen; line = nl) {
+            nl = memchr(line, '\n', text + textlen - line);
+            nl = nl ? nl + 1 : text + textlen;
+            fprintf(stderr, "INFO: text read '%.*s'\n", (int) (nl - line), line);
+            /* Synthesise the text buffer - the final argument is 'flush'.
+               Do not flush the buffer until all the input is sent.
+             */
+            if (data.bench) tts_bench_speak(data.bench);
+            CPRCEN_engine_channel_speak(eng, hc, line, (int) (nl - line), 0);
+        }
+        /* Finished processing, flush the buffer with empty input */
+        if (data.bench) tts_bench_speak(data.bench);
+        CPRCEN_engine_channel_speak(eng, hc, "", 0, 1);
+        if (data.bench) tts_bench_done(data.bench);
+    }
+    if (data.post) {
+        /* The end of the audio held back by the post-processing */
+        tts_post_flush(data.post, &post_out);
+        output_spurt(&data, NULL, 0, &post_out);
+        tts_post_delete(data.post);
+        tts_arena_free(&data.arena);
+    }
+
+    /* The synthesis is complete, store it for the next time */
+    if (data.cache && tts_cache_writer_commit(data.cache) != 0) {
+        fprintf(stderr, "WARNING: unable to store the synthesis in the cache\n");
+    }
+
+    /* All spurts have been returned, the outputs are complete */
+    if (data.wav && tts_wav_close(data.wav) != 0) {
+        fprintf(stderr, "ERROR: unable to write audio file '%s'\n", file_out);
+    }
+    if (data.timeline && tts_timeline_writer_close(data.timeline) != 0) {
+        fprintf(stderr, "ERROR: unable to write timeline file '%s'\n", timeline_file);
+    }
+    if (data.ring) {
+        tts_ring_write_done(data.ring);
+        tts_ring_close(data.ring);
     }
-    /* Finished processing, flush the buffer with empty input */
-    CPRCEN_engine_channel_speak(eng, hc, "", 0, 1);
 
     /* If we're playing audio, wait for completion before quitting */
     if (data.player) {
+        tts_audio_pool_drain(&data.audio);
         while (CPRC_sc_audio_busy(data.player)) {
             CPRC_sc_sleep_msecs(50);
         }
@@ -231,8 +687,18 @@ int main(int argc, char * argv[]){
 
     /* Clean up. The engine deletion function cleans up all loaded
        voices and open channels */
-    CPRCEN_engine_delete(eng);
-    fclose(text_fp);
+    if (parallel)
+        tts_pool_delete(pool);
+    else
+        CPRCEN_engine_delete(eng);
+    free(text);
+    if (cache) {
+        tts_cache_print_stats(cache);
+        tts_cache_close(cache);
+    }
+    if (data.bench && tts_bench_write_json(data.bench, stats_file) != 0) {
+        return -1;
+    }
 
     return 0;
 }
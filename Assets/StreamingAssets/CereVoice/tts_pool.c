@@ -0,0 +1,169 @@
+/* Engine and channel pool for the long-running TTS modes.
+   See tts_pool.h for an overview. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <cerevoice_eng.h>
+#include "tts_pool.h"
+#include "tts_thread.h"
+
+struct tts_pool {
+    CPRCEN_engine * eng;
+    tts_pool_channel * channels;
+    int nchannels;
+    int sample_rate;
+    tts_pool_channel * free_list;
+    tts_mutex lock;
+    tts_cond available;
+    tts_cache * cache;
+    tts_cache_key cache_config;
+};
+
+/* Registered once per channel; forwards the spurt to whoever currently
+   holds the channel. */
+static void pool_channel_callback(CPRC_abuf * abuf, void * userdata) {
+    tts_pool_channel * chan = (tts_pool_channel *) userdata;
+    if (chan->handler) chan->handler(abuf, chan->context);
+}
+
+tts_pool * tts_pool_new(const char * voice_file, const char * license_file,
+                        const char * lexicon_file, int nchannels, int maxp) {
+    tts_pool * pool;
+    const char * freqstr;
+    int i, res;
+
+    if (nchannels < 1) nchannels = 1;
+    pool = calloc(1, sizeof(tts_pool));
+    pool->channels = calloc(nchannels, sizeof(tts_pool_channel));
+    pool->nchannels = nchannels;
+    tts_mutex_init(&pool->lock);
+    tts_cond_init(&pool->available);
+
+    /* The voice is loaded once for the lifetime of the pool. */
+    pool->eng = CPRCEN_engine_new();
+    res = CPRCEN_engine_load_voice(pool->eng, license_file, NULL, voice_file, CPRC_VOICE_LOAD);
+    if (!res) {
+        fprintf(stderr, "ERROR: unable to load voice file '%s'\n", voice_file);
+        tts_pool_delete(pool);
+        return NULL;
+    }
+    if (lexicon_file) {
+        res = CPRCEN_engine_load_user_lexicon(pool->eng, 0, lexicon_file);
+        if (!res) fprintf(stderr, "WARNING: unable to load user lexicon '%s'\n", lexicon_file);
+    }
+
+    for (i = 0; i < nchannels; i++) {
+        tts_pool_channel * chan = &pool->channels[i];
+        chan->index = i;
+        chan->hc = CPRCEN_engine_open_default_channel(pool->eng);
+        if (!chan->hc) {
+            fprintf(stderr, "ERROR: unable to open channel %d of %d\n", i + 1, nchannels);
+            tts_pool_delete(pool);
+            return NULL;
+        }
+        if (maxp > 0) {
+            CPRCEN_channel_set_phone_min_max(pool->eng, chan->hc, 0, maxp);
+        }
+        CPRCEN_engine_set_callback(pool->eng, chan->hc, chan, pool_channel_callback);
+        chan->next_free = pool->free_list;
+        pool->free_list = chan;
+    }
+
+    freqstr = CPRCEN_channel_get_voice_info(pool->eng, pool->channels[0].hc, "SAMPLE_RATE");
+    pool->sample_rate = freqstr ? atoi(freqstr) : 0;
+    fprintf(stderr, "INFO: voice name '%s', sample rate %d, %d channel(s) open\n",
+            tts_pool_voice_name(pool), pool->sample_rate, nchannels);
+    return pool;
+}
+
+tts_pool_channel * tts_pool_acquire(tts_pool * pool) {
+    tts_pool_channel * chan;
+    tts_mutex_lock(&pool->lock);
+    while (!pool->free_list) tts_cond_wait(&pool->available, &pool->lock);
+    chan = pool->free_list;
+    pool->free_list = chan->next_free;
+    chan->next_free = NULL;
+    tts_mutex_unlock(&pool->lock);
+    return chan;
+}
+
+tts_pool_channel * tts_pool_try_acquire(tts_pool * pool) {
+    tts_pool_channel * chan;
+    tts_mutex_lock(&pool->lock);
+    chan = pool->free_list;
+    if (chan) {
+        pool->free_list = chan->next_free;
+        chan->next_free = NULL;
+    }
+    tts_mutex_unlock(&pool->lock);
+    return chan;
+}
+
+void tts_pool_release(tts_pool * pool, tts_pool_channel * chan) {
+    chan->handler = NULL;
+    chan->context = NULL;
+    CPRCEN_engine_channel_reset(pool->eng, chan->hc);
+    /* Re-register the pool callback in case the reset cleared it, before
+       the channel becomes visible to other users again. */
+    CPRCEN_engine_set_callback(pool->eng, chan->hc, chan, pool_channel_callback);
+    tts_mutex_lock(&pool->lock);
+    chan->next_free = pool->free_list;
+    pool->free_list = chan;
+    tts_cond_signal(&pool->available);
+    tts_mutex_unlock(&pool->lock);
+}
+
+void tts_pool_speak(tts_pool * pool, tts_pool_channel * chan, const char * text, int textlen) {
+    const char * line = text;
+    const char * end = text + textlen;
+    const char * nl;
+
+    /* Synthesise input line-by-line, do not flush until all the input
+       is sent. */
+    while (line < end) {
+        nl = memchr(line, '\n', end - line);
+        nl = nl ? nl + 1 : end;
+        CPRCEN_engine_channel_speak(pool->eng, chan->hc, line, (int) (nl - line), 0);
+        line = nl;
+    }
+    CPRCEN_engine_channel_speak(pool->eng, chan->hc, "", 0, 1);
+}
+
+CPRCEN_engine * tts_pool_engine(tts_pool * pool) {
+    return pool->eng;
+}
+
+int tts_pool_size(tts_pool * pool) {
+    return pool->nchannels;
+}
+
+int tts_pool_sample_rate(tts_pool * pool) {
+    return pool->sample_rate;
+}
+
+const char * tts_pool_voice_name(tts_pool * pool) {
+    return CPRCEN_channel_get_voice_info(pool->eng, pool->channels[0].hc, "VOICE_NAME");
+}
+
+void tts_pool_set_cache(tts_pool * pool, tts_cache * cache, const tts_cache_key * config) {
+    pool->cache = cache;
+    if (config) pool->cache_config = *config;
+}
+
+tts_cache * tts_pool_cache(tts_pool * pool, const char * text, int textlen, tts_cache_key * key) {
+    if (!pool->cache) return NULL;
+    tts_cache_key_text(key, &pool->cache_config, text, textlen);
+    return pool->cache;
+}
+
+void tts_pool_delete(tts_pool * pool) {
+    if (!pool) return;
+    /* The engine deletion function cleans up all loaded voices and open
+       channels */
+    if (pool->eng) CPRCEN_engine_delete(pool->eng);
+    tts_cond_destroy(&pool->available);
+    tts_mutex_destroy(&pool->lock);
+    free(pool->channels);
+    free(pool);
+}
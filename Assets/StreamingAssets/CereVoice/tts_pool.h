@@ -0,0 +1,66 @@
+/* Engine and channel pool for the long-running TTS modes.
+
+   The pool owns a single CereVoice engine with the voice and the user
+   lexicon loaded once, plus a fixed number of synthesis channels that
+   are opened up front.  Callers borrow a channel for the duration of a
+   request and give it back afterwards, so under load a request only
+   pays for synthesis.
+*/
+
+#ifndef TTS_POOL_H
+#define TTS_POOL_H
+
+#include <cerevoice_eng.h>
+#include "tts_cache.h"
+
+/* Per-channel state.  The channel callback is registered once when the
+   pool is created, with the channel itself as user data; whoever holds
+   the channel installs its own handler and context for the request. */
+typedef struct tts_pool_channel {
+    CPRCEN_channel_handle hc;
+    int index;
+    void (*handler)(CPRC_abuf * abuf, void * context);
+    void * context;
+    struct tts_pool_channel * next_free;
+} tts_pool_channel;
+
+typedef struct tts_pool tts_pool;
+
+/* Create the engine, load the voice (and the user lexicon if
+   lexicon_file is not NULL) and open nchannels channels.  maxp is
+   passed to CPRCEN_channel_set_phone_min_max when greater than zero.
+   Returns NULL if the voice or any channel cannot be set up. */
+tts_pool * tts_pool_new(const char * voice_file, const char * license_file,
+                        const char * lexicon_file, int nchannels, int maxp);
+
+/* Borrow a channel, blocking until one is free. */
+tts_pool_channel * tts_pool_acquire(tts_pool * pool);
+
+/* Borrow a channel if one is free, NULL otherwise. */
+tts_pool_channel * tts_pool_try_acquire(tts_pool * pool);
+
+/* Give a channel back.  The handler is cleared and the channel reset so
+   the next user starts from a clean state. */
+void tts_pool_release(tts_pool * pool, tts_pool_channel * chan);
+
+/* Synthesise a whole request on a borrowed channel.  The text is sent
+   line by line as the sample drivers do, followed by a flush. */
+void tts_pool_speak(tts_pool * pool, tts_pool_channel * chan, const char * text, int textlen);
+
+CPRCEN_engine * tts_pool_engine(tts_pool * pool);
+int tts_pool_size(tts_pool * pool);
+int tts_pool_sample_rate(tts_pool * pool);
+const char * tts_pool_voice_name(tts_pool * pool);
+
+/* Answer repeated requests from cache.  config is the key of the
+   settings the pool was created with (see tts_cache_key_config); the
+   cache is not owned by the pool. */
+void tts_pool_set_cache(tts_pool * pool, tts_cache * cache, const tts_cache_key * config);
+/* Returns the pool's cache and sets key to the key of text, or returns
+   NULL if the pool has no cache. */
+tts_cache * tts_pool_cache(tts_pool * pool, const char * text, int textlen, tts_cache_key * key);
+
+/* Close all channels and delete the engine. */
+void tts_pool_delete(tts_pool * pool);
+
+#endif /* TTS_POOL_H */
@@ -0,0 +1,279 @@
+/* Post-processing of synthesised speech.
+   See tts_post.h for an overview. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "tts_post.h"
+#include "lipsync_pitch.h"
+#include "lipsync_simd.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PEAK 0.98f   /* highest output sample after the gain */
+
+struct tts_post {
+    tts_post_config cfg;
+    int out_rate;
+
+    /* Resampler: out_rate / in_rate is up / down in lowest terms */
+    int up, down;
+    int taps;            /* per phase, at the input rate */
+    int64_t centre;      /* of the filter, in steps of 1 / up input sample */
+    float * coefs;       /* up phases of taps each, reversed for ls_dot */
+    float * in;          /* pending input, in[0] is input sample in_base */
+    int64_t in_base;
+    long in_count;
+    long in_cap;
+    int64_t in_total;    /* input samples of the utterance */
+    int64_t out_total;   /* output samples of the utterance */
+
+    /* Loudness */
+    int block;           /* samples, 10 ms */
+    float target;        /* mean square */
+    float level;         /* mean square of the speech, 0 before any */
+    float gain;
+    float smooth;        /* weight of a block in the level */
+
+    /* Envelope */
+    ls_pitch * pitch;
+    ls_contour contour;
+    tts_timeline_frame * frames;
+    int frames_cap;
+
+    /* Output */
+    float * work;
+    long work_cap;
+    short * pcm;
+    long pcm_cap;
+};
+
+static int gcd(int a, int b) {
+    int t;
+    while (b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static void * grow(void * buf, long * cap, long need, size_t size) {
+    if (need <= *cap) return buf;
+    while (*cap < need) *cap = *cap ? *cap * 2 : 4096;
+    return realloc(buf, *cap * size);
+}
+
+/* Windowed-sinc prototype at up * in_rate, split into its phases */
+static void design_filter(tts_post * p) {
+    int n = p->up * p->taps, phase, j, m;
+    double cutoff, x, w, sum;
+    float * h = malloc(n * sizeof(float));
+
+    /* cutoff relative to the prototype rate */
+    cutoff = 0.45 * (p->up < p->down ? p->up : p->down) / ((double) p->up * p->down);
+    for (m = 0; m < n; m++) {
+        x = m - (double) p->centre;
+        w = 0.42 + 0.5 * cos(2.0 * M_PI * x / n) + 0.08 * cos(4.0 * M_PI * x / n);
+        h[m] = (float) (w * (x == 0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x)));
+    }
+    p->coefs = malloc(n * sizeof(float));
+    for (phase = 0; phase < p->up; phase++) {
+        /* each phase passes DC unchanged */
+        sum = 0;
+        for (j = 0; j < p->taps; j++) sum += h[phase + j * p->up];
+        for (j = 0; j < p->taps; j++)
+            p->coefs[phase * p->taps + p->taps - 1 - j] = (float) (h[phase + j * p->up] / sum);
+    }
+    free(h);
+}
+
+/* Forgets the utterance, the filter starts on silence */
+static void reset(tts_post * p) {
+    p->in_base = -p->taps;
+    p->in_count = p->taps;
+    p->in = grow(p->in, &p->in_cap, p->in_count, sizeof(float));
+    memset(p->in, 0, p->in_count * sizeof(float));
+    p->in_total = 0;
+    p->out_total = 0;
+    p->level = 0;
+    p->gain = 1;
+}
+
+tts_post * tts_post_new(const tts_post_config * cfg) {
+    tts_post * p = calloc(1, sizeof(tts_post));
+    ls_pitch_config pitch_cfg;
+    int g;
+
+    p->cfg = *cfg;
+    p->out_rate = cfg->out_rate > 0 ? cfg->out_rate : cfg->in_rate;
+    g = gcd(p->out_rate, cfg->in_rate);
+    p->up = p->out_rate / g;
+    p->down = cfg->in_rate / g;
+    if (p->up != p->down) {
+        /* the same length at the lower rate whichever way */
+        p->taps = p->down > p->up ? (TTS_POST_TAPS * p->down + p->up - 1) / p->up : TTS_POST_TAPS;
+        p->taps = (p->taps + 3) & ~3;
+        p->centre = (int64_t) p->up * p->taps / 2;
+        design_filter(p);
+    }
+
+    p->block = p->out_rate / 100;
+    if (p->block < 1) p->block = 1;
+    p->target = powf(10.0f, cfg->loudness / 10.0f);
+    p->smooth = 1.0f - expf(-p->block / (TTS_POST_LEVEL_TIME * p->out_rate));
+
+    if (cfg->envelope) {
+        ls_pitch_config_default(&pitch_cfg, p->out_rate);
+        p->pitch = ls_pitch_new(&pitch_cfg);
+    }
+    reset(p);
+    return p;
+}
+
+void tts_post_delete(tts_post * p) {
+    if (!p) return;
+    if (p->pitch) ls_pitch_delete(p->pitch);
+    ls_contour_free(&p->contour);
+    free(p->coefs);
+    free(p->in);
+    free(p->frames);
+    free(p->work);
+    free(p->pcm);
+    free(p);
+}
+
+int tts_post_out_rate(const tts_post * p) {
+    return p->out_rate;
+}
+
+uint32_t tts_post_map(const tts_post * p, int64_t sample) {
+    if (sample <= 0) return 0;
+    return (uint32_t) ((sample * p->up + p->down / 2) / p->down);
+}
+
+/* Filters the pending input into work, up to limit output samples of
+   the utterance.  Returns the number of samples. */
+static long resample(tts_post * p, int64_t limit) {
+    int64_t pos, last, first;
+    long n = 0, drop;
+
+    p->work = grow(p->work, &p->work_cap, (long) ((p->in_count + 1) * p->up / p->down) + 2, sizeof(float));
+    for (;;) {
+        pos = p->out_total * p->down + p->centre;
+        last = pos / p->up;
+        if (last >= p->in_base + p->in_count || p->out_total >= limit) break;
+        p->work[n++] = ls_dot(p->in + (last - p->taps + 1 - p->in_base),
+                              p->coefs + (pos % p->up) * p->taps, p->taps);
+        p->out_total++;
+    }
+
+    /* keep what the next output sample needs */
+    first = (p->out_total * p->down + p->centre) / p->up - p->taps + 1;
+    drop = (long) (first - p->in_base);
+    if (drop > p->in_count) drop = p->in_count;
+    if (drop > 0) {
+        memmove(p->in, p->in + drop, (p->in_count - drop) * sizeof(float));
+        p->in_count -= drop;
+        p->in_base += drop;
+    }
+    return n;
+}
+
+/* Moves the gain towards the target level, block by block */
+static void normalise(tts_post * p, float * x, long n) {
+    float ms, peak, a, gain, max_gain = powf(10.0f, TTS_POST_MAX_GAIN / 20.0f);
+    long i, len;
+
+    for (; n > 0; x += len, n -= len) {
+        len = n < p->block ? n : p->block;
+        ms = ls_dot(x, x, (int) len) / len;
+        if (ms > powf(10.0f, TTS_POST_GATE / 10.0f))
+            p->level = p->level > 0 ? p->level + p->smooth * (ms - p->level) : ms;
+        gain = p->gain;
+        if (p->level > 0) {
+            gain = sqrtf(p->target / p->level);
+            if (gain > max_gain) gain = max_gain;
+            if (gain < 1.0f / max_gain) gain = 1.0f / max_gain;
+        }
+        peak = 0;
+        for (i = 0; i < len; i++) {
+            a = fabsf(x[i]);
+            if (a > peak) peak = a;
+        }
+        /* the ramp stays between the two gains, both must hold */
+        if (peak * gain > PEAK) gain = PEAK / peak;
+        if (peak * p->gain > PEAK) p->gain = PEAK / peak;
+        ls_ramp(x, p->gain, (gain - p->gain) / len, x, (int) len);
+        p->gain = gain;
+    }
+}
+
+/* Frames completed in the contour, as timeline frames */
+static int take_frames(tts_post * p) {
+    long cap = p->frames_cap;
+    int i;
+
+    p->frames = grow(p->frames, &cap, p->contour.count, sizeof(tts_timeline_frame));
+    p->frames_cap = (int) cap;
+    for (i = 0; i < p->contour.count; i++) {
+        p->frames[i].start = (uint32_t) (p->contour.time[i] * p->out_rate + 0.5f);
+        p->frames[i].f0 = p->contour.f0[i];
+        p->frames[i].loudness = p->contour.loudness[i];
+    }
+    p->contour.count = 0;
+    return i;
+}
+
+/* Gain, envelope and conversion of n samples in work */
+static void finish(tts_post * p, long n, int flush, tts_post_output * out) {
+    if (p->cfg.loudness != 0) normalise(p, p->work, n);
+    out->frames = NULL;
+    out->n_frames = 0;
+    if (p->pitch) {
+        ls_pitch_push(p->pitch, p->work, n, &p->contour);
+        if (flush) ls_pitch_flush(p->pitch, &p->contour);
+        out->n_frames = take_frames(p);
+        out->frames = p->frames;
+    }
+    p->pcm = grow(p->pcm, &p->pcm_cap, n, sizeof(short));
+    ls_to_pcm16(p->work, p->pcm, (int) n);
+    out->samples = p->pcm;
+    out->n_samples = (int) n;
+}
+
+void tts_post_process(tts_post * p, const short * samples, int n, tts_post_output * out) {
+    long m;
+
+    if (n < 0) n = 0;
+    if (p->up == p->down) {
+        p->work = grow(p->work, &p->work_cap, n, sizeof(float));
+        ls_from_pcm16(samples, p->work, n);
+        m = n;
+    }
+    else {
+        p->in = grow(p->in, &p->in_cap, p->in_count + n, sizeof(float));
+        ls_from_pcm16(samples, p->in + p->in_count, n);
+        p->in_count += n;
+        p->in_total += n;
+        m = resample(p, INT64_MAX);
+    }
+    finish(p, m, 0, out);
+}
+
+void tts_post_flush(tts_post * p, tts_post_output * out) {
+    long m = 0;
+
+    if (p->up != p->down) {
+        /* silence after the end completes the last output samples */
+        p->in = grow(p->in, &p->in_cap, p->in_count + p->taps, sizeof(float));
+        memset(p->in + p->in_count, 0, p->taps * sizeof(float));
+        p->in_count += p->taps;
+        m = resample(p, (p->in_total * p->up + p->down - 1) / p->down);
+    }
+    finish(p, m, 1, out);
+    reset(p);
+}
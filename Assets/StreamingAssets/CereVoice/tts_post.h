@@ -0,0 +1,78 @@
+/* Post-processing of synthesised speech in the output callback.
+
+   The engine returns 16 bit audio at the rate of the voice (48 kHz for
+   the shipped voice).  Whatever else the consumer needs was done after
+   the fact: the audio converted by the player, and the F0 and loudness
+   for the pitch and intensity weighting of MyLipSync computed by a
+   second pass over the finished audio.wav (SpeechAnalysis).  This stage
+   does all of it once, spurt by spurt, as the audio comes out of the
+   engine.  Each spurt is converted to float once and goes through:
+
+     - sample rate conversion to out_rate, if it differs from the voice:
+       a polyphase windowed-sinc filter (Blackman window, cutoff at 0.45
+       of the lower rate, TTS_POST_TAPS taps at the lower rate), one
+       vector dot product per output sample;
+     - loudness normalisation to a target RMS level in dBFS: the level
+       of the speech is followed in 10 ms blocks with a time constant of
+       TTS_POST_LEVEL_TIME, blocks below TTS_POST_GATE dBFS (pauses) do
+       not count, and the gain moves towards target - level in a linear
+       ramp over each block, held below full scale on the block's peak;
+     - the F0 and loudness envelope: the prosodyAcf tracker of
+       lipsync_pitch.h, run on the processed audio, so frames come every
+       10 ms and agree with what the natural speech path extracts from
+       recordings;
+
+   and is converted back to 16 bit once, for all the outputs.
+
+   The filter looks TTS_POST_TAPS / 2 input samples ahead and the
+   tracker needs a frame and its neighbour, so the end of each spurt
+   comes out with the next one, and the end of the utterance with
+   tts_post_flush.  The output keeps the timing of the input exactly:
+   transcription times are moved to the output rate with tts_post_map.
+
+   Build: tts_post.c and, from ../LipSync, lipsync_pitch.c
+   lipsync_prosody.c lipsync_aggregate.c lipsync_phoneme.c
+   lipsync_audio.c lipsync_rig.c, with -I../LipSync and -msse2 (see
+   bench/run_bench.sh).
+*/
+
+#ifndef TTS_POST_H
+#define TTS_POST_H
+
+#include <stdint.h>
+#include "tts_timeline.h"
+
+#define TTS_POST_TAPS 32          /* filter length at the lower rate */
+#define TTS_POST_LEVEL_TIME 3.0f  /* seconds */
+#define TTS_POST_GATE -50.0f      /* dBFS */
+#define TTS_POST_MAX_GAIN 24.0f   /* dB, either way */
+
+typedef struct tts_post_config {
+    int in_rate;          /* of the voice */
+    int out_rate;         /* 0 or in_rate: no conversion */
+    float loudness;       /* target RMS level in dBFS, 0 for none */
+    int envelope;         /* compute the F0 and loudness frames */
+} tts_post_config;
+
+/* What a call returns, valid until the next call */
+typedef struct tts_post_output {
+    const short * samples;
+    int n_samples;
+    const tts_timeline_frame * frames;   /* start times at the output rate */
+    int n_frames;
+} tts_post_output;
+
+typedef struct tts_post tts_post;
+
+tts_post * tts_post_new(const tts_post_config * cfg);
+void tts_post_delete(tts_post * p);
+int tts_post_out_rate(const tts_post * p);
+/* Processes the next n samples of the utterance */
+void tts_post_process(tts_post * p, const short * samples, int n, tts_post_output * out);
+/* Ends the utterance with the rest of the audio and of the frames.  The
+   stage then starts a new utterance. */
+void tts_post_flush(tts_post * p, tts_post_output * out);
+/* Output sample of an input sample, both from the start of the utterance */
+uint32_t tts_post_map(const tts_post * p, int64_t sample);
+
+#endif /* TTS_POST_H */
@@ -0,0 +1,426 @@
+/* Shared-memory spurt ring between tts_callback and Unity.
+   See tts_ring.h for an overview. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "tts_ring.h"
+#include "tts_thread.h"
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#define WAIT_SLICE 100   /* ms, the producer checks the consumer in between */
+
+struct tts_ring {
+    tts_ring_header * h;
+    unsigned char * data;
+    size_t map_size;
+    int consumer;
+    uint32_t pos;        /* write position, or position of the next message to read */
+    uint32_t pending;    /* size of the message returned by tts_ring_read */
+    uint32_t seq;
+    uint32_t offset;     /* producer: samples of the utterance so far */
+    /* Records added for the next spurt */
+    tts_ring_trans * trans;
+    const char ** names;
+    int n_trans;
+    int trans_cap;
+    const tts_timeline_frame * frames;
+    int n_frames;
+    char name[TTS_RING_NAME_SIZE + 16];
+#ifdef WIN32
+    HANDLE mapping;
+    HANDLE written;      /* set when write moves */
+    HANDLE room;         /* set when read moves */
+#endif
+};
+
+/* Orders a waiting flag against the position read after it, and a
+   position against the flag read after it */
+static inline void ring_fence(void) {
+#if defined(__GNUC__)
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#else
+    MemoryBarrier();
+#endif
+}
+
+/* Sleeps while *addr is value, at most msecs */
+static void ring_wait(tts_ring * r, volatile uint32_t * addr, uint32_t value, long msecs) {
+#if defined(WIN32)
+    (void) value;
+    WaitForSingleObject(addr == &r->h->write ? r->written : r->room, (DWORD) msecs);
+#elif defined(__linux__)
+    struct timespec ts;
+    (void) r;
+    ts.tv_sec = msecs / 1000;
+    ts.tv_nsec = (msecs % 1000) * 1000000L;
+    /* Not FUTEX_PRIVATE: the word is shared with another process */
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, &ts, NULL, 0);
+#else
+    (void) r;
+    (void) msecs;
+    if (*addr == value) usleep(1000);
+#endif
+}
+
+static void ring_wake(tts_ring * r, volatile uint32_t * addr) {
+#if defined(WIN32)
+    SetEvent(addr == &r->h->write ? r->written : r->room);
+#elif defined(__linux__)
+    (void) r;
+    syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+#else
+    (void) r;
+    (void) addr;
+#endif
+}
+
+/* ---- shared memory ---- */
+
+static tts_ring * ring_map(const char * name, uint32_t size, int create) {
+    tts_ring * r;
+    size_t map_size = sizeof(tts_ring_header) + size;
+#ifndef WIN32
+    struct stat st;
+    int fd;
+#endif
+
+    if (strlen(name) >= TTS_RING_NAME_SIZE || strchr(name, '/') || strchr(name, '\\')) {
+        fprintf(stderr, "ERROR: invalid ring name '%s'\n", name);
+        return NULL;
+    }
+    r = calloc(1, sizeof(tts_ring));
+    r->consumer = create;
+
+#ifndef WIN32
+    snprintf(r->name, sizeof(r->name), "/tts_ring_%s", name);
+    if (create) {
+        shm_unlink(r->name);
+        fd = shm_open(r->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0 && ftruncate(fd, (off_t) map_size) < 0) {
+            close(fd);
+            shm_unlink(r->name);
+            fd = -1;
+        }
+    }
+    else {
+        fd = shm_open(r->name, O_RDWR, 0);
+        if (fd >= 0 && fstat(fd, &st) == 0 && (size_t) st.st_size > sizeof(tts_ring_header))
+            map_size = (size_t) st.st_size;
+        else if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        free(r);
+        return NULL;
+    }
+    r->h = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (r->h == MAP_FAILED) {
+        if (create) shm_unlink(r->name);
+        free(r);
+        return NULL;
+    }
+#else
+    snprintf(r->name, sizeof(r->name), "Local\\tts_ring_%s", name);
+    if (create)
+        r->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD) map_size, r->name);
+    else
+        r->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, r->name);
+    if (r->mapping) r->h = MapViewOfFile(r->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!r->h) {
+        if (r->mapping) CloseHandle(r->mapping);
+        free(r);
+        return NULL;
+    }
+    {
+        char event[sizeof(r->name) + 8];
+        snprintf(event, sizeof(event), "%s_w", r->name);
+        r->written = CreateEventA(NULL, FALSE, FALSE, event);
+        snprintf(event, sizeof(event), "%s_r", r->name);
+        r->room = CreateEventA(NULL, FALSE, FALSE, event);
+    }
+    if (!create) {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(r->h, &info, sizeof(info));
+        map_size = info.RegionSize;
+    }
+#endif
+    r->map_size = map_size;
+    r->data = (unsigned char *) (r->h + 1);
+    return r;
+}
+
+static void ring_unmap(tts_ring * r) {
+#ifndef WIN32
+    munmap(r->h, r->map_size);
+    if (r->consumer) shm_unlink(r->name);
+#else
+    UnmapViewOfFile(r->h);
+    CloseHandle(r->mapping);
+    if (r->written) CloseHandle(r->written);
+    if (r->room) CloseHandle(r->room);
+#endif
+    free(r->trans);
+    free(r->names);
+    free(r);
+}
+
+/* ---- consumer ---- */
+
+TTS_EXPORT tts_ring * tts_ring_create(const char * name, uint32_t size) {
+    tts_ring * r;
+    uint32_t n = 4096;
+
+    if (size == 0) size = TTS_RING_SIZE;
+    while (n < size && n < 0x40000000u) n <<= 1;
+    r = ring_map(name, n, 1);
+    if (!r) {
+        fprintf(stderr, "ERROR: unable to create ring '%s'\n", name);
+        return NULL;
+    }
+    memset(r->h, 0, sizeof(tts_ring_header));
+    r->h->version = TTS_RING_VERSION;
+    r->h->size = n;
+    /* The magic last, the producer checks it */
+    ring_fence();
+    memcpy(r->h->magic, TTS_RING_MAGIC, 4);
+    return r;
+}
+
+TTS_EXPORT const tts_ring_msg * tts_ring_read(tts_ring * r, int timeout_ms) {
+    tts_ring_header * h = r->h;
+    const tts_ring_msg * m;
+    double deadline = timeout_ms >= 0 ? tts_clock_seconds() + timeout_ms / 1000.0 : 0;
+    long left;
+
+    if (r->pending) tts_ring_release(r);
+    for (;;) {
+        if (tts_atomic_load(&h->write) == r->pos) {
+            left = timeout_ms < 0 ? WAIT_SLICE : (long) ((deadline - tts_clock_seconds()) * 1000.0 + 0.5);
+            if (left <= 0) return NULL;
+            if (left > WAIT_SLICE) left = WAIT_SLICE;
+            /* Say we sleep, then look again: a write between the two
+               either is seen here or sees the flag */
+            h->read_waiting = 1;
+            ring_fence();
+            if (tts_atomic_load(&h->write) == r->pos) ring_wait(r, &h->write, r->pos, left);
+            h->read_waiting = 0;
+            continue;
+        }
+        m = (const tts_ring_msg *) (r->data + (r->pos & (h->size - 1)));
+        if (m->type == TTS_RING_PAD) {
+            r->pending = m->size;
+            tts_ring_release(r);
+            continue;
+        }
+        r->pending = m->size;
+        return m;
+    }
+}
+
+TTS_EXPORT void tts_ring_release(tts_ring * r) {
+    if (!r->pending) return;
+    r->pos += r->pending;
+    r->pending = 0;
+    tts_atomic_store(&r->h->read, r->pos);
+    ring_fence();
+    if (r->h->write_waiting) ring_wake(r, &r->h->read);
+}
+
+TTS_EXPORT uint32_t tts_ring_sample_rate(const tts_ring * r) {
+    return tts_atomic_load(&r->h->sample_rate);
+}
+
+TTS_EXPORT void tts_ring_close(tts_ring * r) {
+    if (!r) return;
+    if (r->consumer) {
+        r->h->state |= TTS_RING_CLOSED;
+        ring_fence();
+        ring_wake(r, &r->h->read);
+    }
+    ring_unmap(r);
+}
+
+/* ---- producer ---- */
+
+tts_ring * tts_ring_open(const char * name, int sample_rate) {
+    tts_ring * r = ring_map(name, 0, 0);
+
+    if (!r) {
+        fprintf(stderr, "ERROR: unable to open ring '%s'\n", name);
+        return NULL;
+    }
+    ring_fence();
+    if (memcmp(r->h->magic, TTS_RING_MAGIC, 4) != 0 || r->h->version != TTS_RING_VERSION ||
+        (r->h->size & (r->h->size - 1)) != 0 || sizeof(tts_ring_header) + r->h->size > r->map_size) {
+        fprintf(stderr, "ERROR: '%s' is not a valid ring\n", name);
+        ring_unmap(r);
+        return NULL;
+    }
+    r->pos = tts_atomic_load(&r->h->write);
+    tts_atomic_store(&r->h->sample_rate, (uint32_t) sample_rate);
+    return r;
+}
+
+/* Returns where a message of size bytes goes once there is room, with
+   the padding before it already written, or NULL */
+static unsigned char * ring_reserve(tts_ring * r, uint32_t size) {
+    tts_ring_header * h = r->h;
+    uint32_t tail = h->size - (r->pos & (h->size - 1));
+    uint32_t need = size > tail ? tail + size : size;
+    uint32_t read;
+    long waited = 0;
+    tts_ring_msg * pad;
+
+    if (size > h->size / 2) {
+        fprintf(stderr, "ERROR: spurt of %u bytes does not fit in the ring\n", size);
+        return NULL;
+    }
+    while (r->pos + need - (read = tts_atomic_load(&h->read)) > h->size) {
+        if (h->state & TTS_RING_CLOSED) return NULL;
+        if (waited >= TTS_RING_STALL) {
+            fprintf(stderr, "ERROR: ring consumer stalled\n");
+            return NULL;
+        }
+        h->write_waiting = 1;
+        ring_fence();
+        if (tts_atomic_load(&h->read) == read) ring_wait(r, &h->read, read, WAIT_SLICE);
+        h->write_waiting = 0;
+        waited += WAIT_SLICE;
+    }
+    if (h->state & TTS_RING_CLOSED) return NULL;
+    if (size > tail) {
+        pad = (tts_ring_msg *) (r->data + (r->pos & (h->size - 1)));
+        pad->size = tail;
+        pad->type = TTS_RING_PAD;
+        r->pos += tail;
+    }
+    return r->data + (r->pos & (h->size - 1));
+}
+
+static void ring_commit(tts_ring * r, uint32_t size) {
+    r->pos += size;
+    r->seq++;
+    tts_atomic_store(&r->h->write, r->pos);
+    ring_fence();
+    if (r->h->read_waiting) ring_wake(r, &r->h->write);
+}
+
+void tts_ring_add(tts_ring * r, int type, uint32_t start, uint32_t end, const char * name) {
+    if (r->n_trans == r->trans_cap) {
+        r->trans_cap = r->trans_cap ? r->trans_cap * 2 : 64;
+        r->trans = realloc(r->trans, r->trans_cap * sizeof(tts_ring_trans));
+        r->names = realloc((void *) r->names, r->trans_cap * sizeof(const char *));
+    }
+    r->trans[r->n_trans].type = (uint32_t) type;
+    r->trans[r->n_trans].start = start;
+    r->trans[r->n_trans].end = end;
+    r->names[r->n_trans] = name;
+    r->n_trans++;
+}
+
+void tts_ring_add_frames(tts_ring * r, const tts_timeline_frame * frames, int n) {
+    r->frames = frames;
+    r->n_frames = n;
+}
+
+int tts_ring_write(tts_ring * r, const int16_t * samples, int n_samples) {
+    tts_ring_msg * m;
+    tts_ring_trans * t;
+    uint32_t size, strings = 0, padded = ((uint32_t) n_samples + 1) & ~1u;
+    char * s;
+    int i, n = r->n_trans, n_frames = r->n_frames;
+
+    r->n_trans = 0;
+    r->n_frames = 0;
+    for (i = 0; i < n; i++) strings += (uint32_t) strlen(r->names[i]) + 1;
+    size = (uint32_t) (sizeof(tts_ring_msg) + n * sizeof(tts_ring_trans) + n_frames * sizeof(tts_timeline_frame)
+                       + padded * sizeof(int16_t)) + strings;
+    size = (size + 7) & ~7u;
+    m = (tts_ring_msg *) ring_reserve(r, size);
+    if (!m) return -1;
+
+    m->size = size;
+    m->type = TTS_RING_SPURT;
+    m->seq = r->seq;
+    m->offset = r->offset;
+    m->n_samples = (uint32_t) n_samples;
+    m->n_trans = (uint32_t) n;
+    m->n_frames = (uint32_t) n_frames;
+    m->reserved = 0;
+    t = (tts_ring_trans *) (m + 1);
+    if (n_frames > 0) memcpy((void *) tts_ring_msg_frames(m), r->frames, n_frames * sizeof(tts_timeline_frame));
+    if (n_samples > 0) memcpy((void *) tts_ring_msg_samples(m), samples, n_samples * sizeof(int16_t));
+    s = (char *) tts_ring_msg_samples(m) + padded * sizeof(int16_t);
+    strings = 0;
+    for (i = 0; i < n; i++) {
+        t[i] = r->trans[i];
+        t[i].name = strings;
+        strcpy(s + strings, r->names[i]);
+        strings += (uint32_t) strlen(r->names[i]) + 1;
+    }
+    ring_commit(r, size);
+    r->offset += (uint32_t) n_samples;
+    return 0;
+}
+
+#ifndef TTS_TIMELINE_NO_ENGINE
+int tts_ring_write_abuf(tts_ring * r, CPRC_abuf * abuf) {
+    const CPRC_abuf_trans * trans;
+    double srate = r->h->sample_rate;
+    int64_t base, start, end;
+    int i, type, wav_mk, wav_done;
+
+    wav_mk = CPRC_abuf_wav_mk(abuf);
+    wav_done = CPRC_abuf_wav_done(abuf);
+    if (wav_mk < 0) wav_mk = 0;
+    if (wav_done < wav_mk) wav_done = wav_mk;
+    /* Transcription times are relative to the start of the buffer */
+    base = (int64_t) r->offset - wav_mk;
+
+    for (i = 0; i < CPRC_abuf_trans_sz(abuf); i++) {
+        trans = CPRC_abuf_get_trans(abuf, i);
+        switch (CPRC_abuf_trans_type(trans)) {
+        case CPRC_ABUF_TRANS_PHONE: type = TTS_TIMELINE_PHONE; break;
+        case CPRC_ABUF_TRANS_WORD: type = TTS_TIMELINE_WORD; break;
+        case CPRC_ABUF_TRANS_MARK: type = TTS_TIMELINE_MARK; break;
+        default:
+            fprintf(stderr, "ERROR: could not retrieve transcription at '%d'\n", i);
+            continue;
+        }
+        start = base + (int64_t) (CPRC_abuf_trans_start(trans) * srate + 0.5);
+        end = base + (int64_t) (CPRC_abuf_trans_end(trans) * srate + 0.5);
+        tts_ring_add(r, type, (uint32_t) (start < 0 ? 0 : start), (uint32_t) (end < 0 ? 0 : end),
+                     CPRC_abuf_trans_name(trans));
+    }
+    return tts_ring_write(r, CPRC_abuf_wav_data(abuf) + wav_mk, wav_done - wav_mk);
+}
+#endif
+
+int tts_ring_write_done(tts_ring * r) {
+    tts_ring_msg * m = (tts_ring_msg *) ring_reserve(r, sizeof(tts_ring_msg));
+
+    if (!m) return -1;
+    memset(m, 0, sizeof(tts_ring_msg));
+    m->size = sizeof(tts_ring_msg);
+    m->type = TTS_RING_DONE;
+    m->seq = r->seq;
+    m->offset = r->offset;
+    ring_commit(r, sizeof(tts_ring_msg));
+    r->offset = 0;
+    return 0;
+}
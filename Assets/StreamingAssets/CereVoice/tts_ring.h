@@ -0,0 +1,164 @@
+/* Shared-memory spurt ring between tts_callback and Unity.
+
+   TextToSpeechProcess used to run tts_callback, wait for it to exit and
+   then read the transcription back from a file and the audio from
+   audio.wav.  With -m, tts_callback writes every spurt into a ring in
+   shared memory instead, from inside channel_callback, and the consumer
+   reads it in place: audio, transcription and names in one message,
+   nothing encoded and nothing on disk.
+
+   The consumer creates the ring under a name and passes the name to
+   the producer, so the ring exists before the producer starts and
+   outlives it.  There is one producer and one consumer.
+
+   Layout of the shared memory:
+
+     tts_ring_header                        256 bytes
+     data[size]                             size a power of two
+
+   The write and read positions count bytes since the ring was created
+   and wrap at 2^32; a message starts at position & (size - 1).
+   Messages are 8-byte aligned and never wrap: when the end of the data
+   does not leave room for the next message, the producer fills it with
+   a TTS_RING_PAD message.  A message is
+
+     tts_ring_msg                           32 bytes
+     tts_ring_trans[n_trans]                16 bytes each
+     tts_timeline_frame[n_frames]           12 bytes each
+     int16 samples[n_samples]               padded to 4 bytes
+     char strings[]                         NUL-terminated names
+
+   Record times are samples from the start of the utterance, as in the
+   timeline (tts_timeline.h), and the sample rate is in the header.  The
+   producer ends an utterance with TTS_RING_DONE.  A message may have
+   records and no audio, or audio and no records.  Frames are the F0 and
+   loudness envelope of a post-processed synthesis (tts_post.h), start
+   times from the start of the utterance like the records; they come
+   with the spurt in which they were completed.
+
+   The positions are published with release stores and read with
+   acquire loads, so a message is complete when the reader sees it.  A
+   side that finds the ring empty or full says so in the header and
+   sleeps on the position it waits for; the other side wakes it after
+   moving that position, so a blocked consumer sees a spurt within
+   microseconds of the callback, and neither side makes a system call
+   while the other keeps up.  Sleeping uses a futex on Linux and named
+   events on Windows; elsewhere the waiting side polls every
+   millisecond.
+
+   The consumer functions are exported for Unity (SpeechRing.cs) from
+   the tts_tools library, see tts_cache.h.  tts_callback writes with
+   tts_ring_write_abuf; tools without the engine build with
+   TTS_TIMELINE_NO_ENGINE and use tts_ring_add and tts_ring_write.
+*/
+
+#ifndef TTS_RING_H
+#define TTS_RING_H
+
+#include <stdint.h>
+#include "tts_timeline.h"
+
+#define TTS_RING_MAGIC "TTSR"
+#define TTS_RING_VERSION 2
+#define TTS_RING_SIZE (8 * 1024 * 1024)   /* default data size, about 90 s at 48 kHz */
+#define TTS_RING_NAME_SIZE 64
+#define TTS_RING_STALL 10000              /* ms the producer waits for room */
+
+enum tts_ring_msg_type {
+    TTS_RING_PAD = 0,     /* skip to the start of the data */
+    TTS_RING_SPURT = 1,
+    TTS_RING_DONE = 2     /* end of the utterance, offset is its length */
+};
+
+/* Header state flags */
+#define TTS_RING_CLOSED 0x1   /* the consumer is gone, writes fail */
+
+typedef struct tts_ring_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t size;                /* bytes of data */
+    volatile uint32_t sample_rate;
+    volatile uint32_t state;
+    uint32_t reserved[11];
+    /* Each side's position and waiting flag on their own cache line */
+    volatile uint32_t write;
+    volatile uint32_t read_waiting;   /* the consumer sleeps on write */
+    uint32_t pad_w[14];
+    volatile uint32_t read;
+    volatile uint32_t write_waiting;  /* the producer sleeps on read */
+    uint32_t pad_r[14];
+    uint32_t pad[16];
+} tts_ring_header;
+
+typedef struct tts_ring_msg {
+    uint32_t size;        /* bytes, this header included, multiple of 8 */
+    uint32_t type;        /* tts_ring_msg_type */
+    uint32_t seq;         /* messages since the ring was created */
+    uint32_t offset;      /* samples of the utterance before the spurt */
+    uint32_t n_samples;
+    uint32_t n_trans;
+    uint32_t n_frames;
+    uint32_t reserved;
+} tts_ring_msg;
+
+typedef struct tts_ring_trans {
+    uint32_t type;        /* TTS_TIMELINE_PHONE, WORD or MARK */
+    uint32_t start;       /* first sample, from the start of the utterance */
+    uint32_t end;         /* one past the last sample */
+    uint32_t name;        /* offset into the strings of the message */
+} tts_ring_trans;
+
+typedef struct tts_ring tts_ring;
+
+/* Consumer.  Creates the ring, replacing one of the same name that a
+   crashed consumer left behind.  size 0 is TTS_RING_SIZE, other sizes
+   are rounded up to a power of two.  Returns NULL on failure. */
+TTS_EXPORT tts_ring * tts_ring_create(const char * name, uint32_t size);
+/* Waits at most timeout_ms (-1 forever) for the next message and
+   returns it in place, or NULL on timeout.  The message stays valid
+   until tts_ring_release. */
+TTS_EXPORT const tts_ring_msg * tts_ring_read(tts_ring * r, int timeout_ms);
+TTS_EXPORT void tts_ring_release(tts_ring * r);
+TTS_EXPORT uint32_t tts_ring_sample_rate(const tts_ring * r);
+/* Closes either side.  The consumer also removes the name and makes
+   further writes fail. */
+TTS_EXPORT void tts_ring_close(tts_ring * r);
+
+static inline const tts_ring_trans * tts_ring_msg_trans(const tts_ring_msg * m) {
+    return (const tts_ring_trans *) (m + 1);
+}
+
+static inline const tts_timeline_frame * tts_ring_msg_frames(const tts_ring_msg * m) {
+    return (const tts_timeline_frame *) (tts_ring_msg_trans(m) + m->n_trans);
+}
+
+static inline const int16_t * tts_ring_msg_samples(const tts_ring_msg * m) {
+    return (const int16_t *) (tts_ring_msg_frames(m) + m->n_frames);
+}
+
+static inline const char * tts_ring_msg_name(const tts_ring_msg * m, const tts_ring_trans * t) {
+    return (const char *) (tts_ring_msg_samples(m) + ((m->n_samples + 1) & ~1u)) + t->name;
+}
+
+/* Producer.  Opens a ring created by the consumer, NULL if there is
+   none. */
+tts_ring * tts_ring_open(const char * name, int sample_rate);
+/* Adds a record to the next spurt, times from the start of the
+   utterance.  name is copied by tts_ring_write. */
+void tts_ring_add(tts_ring * r, int type, uint32_t start, uint32_t end, const char * name);
+/* Sets the envelope frames of the next spurt, copied by tts_ring_write */
+void tts_ring_add_frames(tts_ring * r, const tts_timeline_frame * frames, int n);
+/* Writes the records added so far and the audio as one spurt.  Waits
+   while the ring is full.  Returns 0, or -1 if the consumer has closed
+   the ring, has not made room for TTS_RING_STALL ms or the spurt is
+   larger than half the ring. */
+int tts_ring_write(tts_ring * r, const int16_t * samples, int n_samples);
+#ifndef TTS_TIMELINE_NO_ENGINE
+/* Writes the audio and transcription of a spurt returned by the engine
+   (wav_mk to wav_done, as cued by the drivers) */
+int tts_ring_write_abuf(tts_ring * r, CPRC_abuf * abuf);
+#endif
+/* Ends the utterance; the next write starts a new one at offset 0 */
+int tts_ring_write_done(tts_ring * r);
+
+#endif /* TTS_RING_H */
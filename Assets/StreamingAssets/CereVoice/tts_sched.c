@@ -0,0 +1,273 @@
+/* Event scheduler for synchronised playback.
+   See tts_sched.h for an overview. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "tts_arena.h"
+#include "tts_sched.h"
+#include "tts_thread.h"
+
+typedef struct tts_sched_subscriber {
+    unsigned int mask;
+    tts_sched_handler handler;
+    void * userdata;
+} tts_sched_subscriber;
+
+struct tts_sched {
+    tts_sched_clock clock;
+    void * clock_data;
+    tts_sched_subscriber subscribers[TTS_SCHED_SUBSCRIBERS];
+    int nsubscribers;
+    unsigned int mask;          /* union of the subscriber masks */
+
+    /* Timeline, sorted by start time, and the next event to fire.
+       Guarded by lock.  Names are interned in the arena, which is reset
+       with the timeline whenever everything added has been dispatched. */
+    tts_sched_event * events;
+    int count;
+    int cap;
+    int cursor;
+    tts_arena names;
+    int flush;                  /* queue the rest without the clock */
+    int stop;
+    tts_mutex lock;
+    tts_cond changed;
+    tts_thread thread;
+
+    /* Due events, written by the scheduler thread only and read by the
+       dispatching thread only. */
+    tts_sched_event queue[TTS_SCHED_QUEUE];
+    volatile unsigned int head;  /* next slot to write */
+    volatile unsigned int tail;  /* next slot to read */
+    tts_mutex queue_lock;        /* only used to park the consumer */
+    tts_cond queued;
+};
+
+/* Copies due events into the ring.  Returns the number queued; stops
+   early if the ring is full, the rest go on the next pass. */
+static int queue_due(tts_sched * s, double now) {
+    unsigned int head = s->head;
+    unsigned int tail = tts_atomic_load(&s->tail);
+    int n = 0;
+
+    while (s->cursor < s->count && s->events[s->cursor].start <= now) {
+        if (head - tail == TTS_SCHED_QUEUE) break;
+        s->queue[head & (TTS_SCHED_QUEUE - 1)] = s->events[s->cursor];
+        head++;
+        s->cursor++;
+        n++;
+    }
+    if (n) tts_atomic_store(&s->head, head);
+    return n;
+}
+
+static tts_thread_ret TTS_THREAD_CALL sched_thread(void * userdata) {
+    tts_sched * s = (tts_sched *) userdata;
+    double now, next;
+    long msecs;
+
+    tts_mutex_lock(&s->lock);
+    while (!s->stop) {
+        if (s->cursor == s->count) {
+            tts_cond_wait(&s->changed, &s->lock);
+            continue;
+        }
+        if (s->flush) {
+            now = s->events[s->count - 1].start;
+        }
+        else {
+            /* the clock talks to the player, do not hold the lock over it */
+            tts_mutex_unlock(&s->lock);
+            now = s->clock(s->clock_data);
+            tts_mutex_lock(&s->lock);
+        }
+
+        if (now < 0 && !s->flush) {
+            tts_cond_timedwait(&s->changed, &s->lock, TTS_SCHED_IDLE_SLEEP);
+            continue;
+        }
+        if (queue_due(s, now)) {
+            tts_mutex_lock(&s->queue_lock);
+            tts_cond_broadcast(&s->queued);
+            tts_mutex_unlock(&s->queue_lock);
+        }
+        if (s->cursor == s->count) continue;
+
+        /* sleep until the next event is due */
+        next = s->events[s->cursor].start;
+        msecs = (long) ((next - now) * 1000.0) + 1;
+        if (msecs > TTS_SCHED_MAX_SLEEP) msecs = TTS_SCHED_MAX_SLEEP;
+        if (next <= now) msecs = 1; /* ring was full */
+        tts_cond_timedwait(&s->changed, &s->lock, msecs);
+    }
+    tts_mutex_unlock(&s->lock);
+    return 0;
+}
+
+tts_sched * tts_sched_new(tts_sched_clock clock, void * clock_data) {
+    tts_sched * s = calloc(1, sizeof(tts_sched));
+    if (!s) return NULL;
+    s->clock = clock;
+    s->clock_data = clock_data;
+    tts_arena_init(&s->names);
+    tts_mutex_init(&s->lock);
+    tts_cond_init(&s->changed);
+    tts_mutex_init(&s->queue_lock);
+    tts_cond_init(&s->queued);
+    if (!tts_thread_start(&s->thread, sched_thread, s)) {
+        fprintf(stderr, "ERROR: unable to start the scheduler thread\n");
+        tts_cond_destroy(&s->queued);
+        tts_mutex_destroy(&s->queue_lock);
+        tts_cond_destroy(&s->changed);
+        tts_mutex_destroy(&s->lock);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+int tts_sched_subscribe(tts_sched * s, unsigned int mask, tts_sched_handler handler, void * userdata) {
+    tts_sched_subscriber * sub;
+    if (s->nsubscribers == TTS_SCHED_SUBSCRIBERS) return 0;
+    sub = &s->subscribers[s->nsubscribers++];
+    sub->mask = mask;
+    sub->handler = handler;
+    sub->userdata = userdata;
+    s->mask |= mask;
+    return 1;
+}
+
+void tts_sched_add(tts_sched * s, int type, double start, double end, const char * name) {
+    tts_sched_event * ev;
+    int i;
+
+    /* nobody listens to this type, do not schedule it */
+    if (!(s->mask & (1u << type))) return;
+
+    tts_mutex_lock(&s->lock);
+    if (s->cursor == s->count && tts_atomic_load(&s->head) == tts_atomic_load(&s->tail)) {
+        /* Idle, the previous utterance is over: no subscriber holds a
+           name any more */
+        s->cursor = s->count = 0;
+        s->flush = 0;
+        tts_arena_reset(&s->names);
+    }
+    else if (s->count == s->cap && s->cursor > 0) {
+        /* Drop the events already queued rather than grow */
+        memmove(s->events, s->events + s->cursor, (s->count - s->cursor) * sizeof(tts_sched_event));
+        s->count -= s->cursor;
+        s->cursor = 0;
+    }
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 256;
+        s->events = realloc(s->events, s->cap * sizeof(tts_sched_event));
+    }
+    /* events arrive in order, apart from words and the phones they
+       contain sharing a start time; an event that is already late is
+       queued at the cursor */
+    i = s->count;
+    while (i > s->cursor && s->events[i - 1].start > start) {
+        s->events[i] = s->events[i - 1];
+        i--;
+    }
+    ev = &s->events[i];
+    ev->type = type;
+    ev->start = start;
+    ev->end = end;
+    ev->name = tts_arena_intern(&s->names, name);
+    s->count++;
+    if (i == s->cursor) tts_cond_signal(&s->changed);
+    tts_mutex_unlock(&s->lock);
+}
+
+#ifndef TTS_TIMELINE_NO_ENGINE
+void tts_sched_add_abuf(tts_sched * s, CPRC_abuf * abuf, double offset) {
+    const CPRC_abuf_trans * trans;
+    int i, type;
+
+    for (i = 0; i < CPRC_abuf_trans_sz(abuf); i++) {
+        trans = CPRC_abuf_get_trans(abuf, i);
+        switch (CPRC_abuf_trans_type(trans)) {
+            case CPRC_ABUF_TRANS_PHONE: type = TTS_TIMELINE_PHONE; break;
+            case CPRC_ABUF_TRANS_WORD: type = TTS_TIMELINE_WORD; break;
+            case CPRC_ABUF_TRANS_MARK: type = TTS_TIMELINE_MARK; break;
+            default: continue;
+        }
+        tts_sched_add(s, type, CPRC_abuf_trans_start(trans) + offset,
+                      CPRC_abuf_trans_end(trans) + offset, CPRC_abuf_trans_name(trans));
+    }
+}
+#endif
+
+void tts_sched_wake(tts_sched * s) {
+    tts_mutex_lock(&s->lock);
+    tts_cond_signal(&s->changed);
+    tts_mutex_unlock(&s->lock);
+}
+
+void tts_sched_flush(tts_sched * s) {
+    tts_mutex_lock(&s->lock);
+    s->flush = 1;
+    tts_cond_signal(&s->changed);
+    tts_mutex_unlock(&s->lock);
+}
+
+int tts_sched_dispatch(tts_sched * s) {
+    unsigned int tail = s->tail;
+    unsigned int head = tts_atomic_load(&s->head);
+    const tts_sched_event * ev;
+    int i, n = 0;
+
+    while (tail != head) {
+        ev = &s->queue[tail & (TTS_SCHED_QUEUE - 1)];
+        for (i = 0; i < s->nsubscribers; i++) {
+            if (s->subscribers[i].mask & (1u << ev->type))
+                s->subscribers[i].handler(ev, s->subscribers[i].userdata);
+        }
+        tail++;
+        n++;
+        /* give the slot back straight away so a slow subscriber does not
+           stall the scheduler */
+        tts_atomic_store(&s->tail, tail);
+        if (tail == head) head = tts_atomic_load(&s->head);
+    }
+    return n;
+}
+
+int tts_sched_wait(tts_sched * s, long msecs) {
+    int ready;
+    tts_mutex_lock(&s->queue_lock);
+    ready = tts_atomic_load(&s->head) != s->tail;
+    if (!ready) {
+        tts_cond_timedwait(&s->queued, &s->queue_lock, msecs);
+        ready = tts_atomic_load(&s->head) != s->tail;
+    }
+    tts_mutex_unlock(&s->queue_lock);
+    return ready;
+}
+
+int tts_sched_done(tts_sched * s) {
+    int done;
+    tts_mutex_lock(&s->lock);
+    done = s->cursor == s->count && tts_atomic_load(&s->head) == tts_atomic_load(&s->tail);
+    tts_mutex_unlock(&s->lock);
+    return done;
+}
+
+void tts_sched_delete(tts_sched * s) {
+    if (!s) return;
+    tts_mutex_lock(&s->lock);
+    s->stop = 1;
+    tts_cond_signal(&s->changed);
+    tts_mutex_unlock(&s->lock);
+    tts_thread_join(s->thread);
+
+    tts_arena_free(&s->names);
+    free(s->events);
+    tts_cond_destroy(&s->queued);
+    tts_mutex_destroy(&s->queue_lock);
+    tts_cond_destroy(&s->changed);
+    tts_mutex_destroy(&s->lock);
+    free(s);
+}
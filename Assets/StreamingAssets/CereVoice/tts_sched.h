@@ -0,0 +1,89 @@
+/* Event scheduler for synchronised playback.
+
+   The synthesis callback adds the phones, words and markers of every
+   spurt to a time-sorted timeline.  A scheduler thread keeps a cursor
+   into the timeline and sleeps until the start of the next event, as
+   given by the playback clock; due events are copied into a single
+   producer/single consumer ring, and subscribers are called from
+   whichever thread drains the ring with tts_sched_dispatch.  Each event
+   is visited once, however long the text is.
+
+   The clock is polled again at least every TTS_SCHED_MAX_SLEEP
+   milliseconds so that pauses and underruns of the player are followed.
+
+   Memory follows the events still to come, not the length of the
+   session: queued events are dropped from the timeline when it would
+   grow, names are interned (tts_arena.h), and the timeline and the
+   names are released when an event is added after all the earlier ones
+   were dispatched, i.e. at the start of the next utterance.
+*/
+
+#ifndef TTS_SCHED_H
+#define TTS_SCHED_H
+
+#include "tts_timeline.h"
+
+#define TTS_SCHED_MAX_SLEEP 100  /* ms */
+#define TTS_SCHED_IDLE_SLEEP 50  /* ms, while nothing is playing */
+#define TTS_SCHED_QUEUE 1024     /* ring size, power of two */
+#define TTS_SCHED_SUBSCRIBERS 8
+
+typedef struct tts_sched_event {
+    int type;          /* tts_timeline_type */
+    double start;      /* seconds from the start of the stream */
+    double end;
+    const char * name;
+} tts_sched_event;
+
+/* Playback position in seconds, or a negative value when the player is
+   idle or paused. */
+typedef double (*tts_sched_clock)(void * userdata);
+
+typedef void (*tts_sched_handler)(const tts_sched_event * ev, void * userdata);
+
+typedef struct tts_sched tts_sched;
+
+/* Creates the scheduler and starts its thread. */
+tts_sched * tts_sched_new(tts_sched_clock clock, void * clock_data);
+
+/* Registers a handler for the event types in mask (bit 1 << type).
+   Must be called before events are added.  Returns 0 if the subscriber
+   table is full. */
+int tts_sched_subscribe(tts_sched * s, unsigned int mask, tts_sched_handler handler, void * userdata);
+
+/* Adds an event; the name is interned, the pointer handed to the
+   subscribers is valid until they return.  Events normally arrive in
+   time order, so insertion is constant time. */
+void tts_sched_add(tts_sched * s, int type, double start, double end, const char * name);
+
+#ifndef TTS_TIMELINE_NO_ENGINE
+/* Adds the transcription of a spurt, offset by the given start time. */
+void tts_sched_add_abuf(tts_sched * s, CPRC_abuf * abuf, double offset);
+#endif
+
+/* Tells the scheduler that the playback state changed, e.g. after audio
+   was cued or the player was resumed. */
+void tts_sched_wake(tts_sched * s);
+
+/* Queues every event still to come without waiting for the clock, for
+   the end of playback: once the player is idle the clock no longer
+   advances, and events at the very end of the stream would never be
+   due.  Adding an event after they are all dispatched starts the next
+   utterance on the clock again. */
+void tts_sched_flush(tts_sched * s);
+
+/* Calls the subscribers of every queued event from the calling thread.
+   Returns the number of events dispatched. */
+int tts_sched_dispatch(tts_sched * s);
+
+/* Blocks until events are queued or msecs milliseconds have passed.
+   Returns non-zero if events are queued. */
+int tts_sched_wait(tts_sched * s, long msecs);
+
+/* Non-zero once every added event has been dispatched. */
+int tts_sched_done(tts_sched * s);
+
+/* Stops the thread and frees the timeline. */
+void tts_sched_delete(tts_sched * s);
+
+#endif /* TTS_SCHED_H */
@@ -0,0 +1,377 @@
+/* Synthesis server for tts_callback's daemon mode.
+   See tts_server.h for the wire protocol. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <cerevoice_eng.h>
+#include "tts_server.h"
+
+#ifndef WIN32
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "tts_thread.h"
+
+static volatile sig_atomic_t server_stop = 0;
+
+/* State of a single request, installed as the channel handler context */
+typedef struct request_data {
+    int fd;
+    unsigned int flags;
+    int sample_rate;
+    long samples;      /* samples sent so far, used as timing offset */
+    int failed;        /* the client went away */
+    char * trans_buf;  /* reused across spurts of the connection */
+    size_t trans_cap;
+    tts_cache_writer * cache;
+} request_data;
+
+typedef struct connection {
+    tts_pool * pool;
+    int fd;
+    struct connection * next;
+} connection;
+
+/* Open connections, so that shutdown can wake and wait for them */
+static connection * connections = NULL;
+static int n_connections = 0;
+static tts_mutex connections_lock;
+static tts_cond connections_done;
+
+static void on_signal(int sig) {
+    (void) sig;
+    server_stop = 1;
+}
+
+static int write_all(int fd, const void * data, size_t len) {
+    const char * p = (const char *) data;
+    ssize_t n;
+    while (len > 0) {
+        n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void * data, size_t len) {
+    char * p = (char *) data;
+    ssize_t n;
+    while (len > 0) {
+        n = recv(fd, p, len, 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+static int write_frame(int fd, uint32_t type, const void * payload, uint32_t len) {
+    uint32_t hdr[2];
+    hdr[0] = type;
+    hdr[1] = len;
+    if (write_all(fd, hdr, sizeof(hdr)) < 0) return -1;
+    if (len && write_all(fd, payload, len) < 0) return -1;
+    return 0;
+}
+
+static void trans_reserve(request_data * req, size_t need) {
+    if (need <= req->trans_cap) return;
+    while (req->trans_cap < need) req->trans_cap = req->trans_cap ? req->trans_cap * 2 : 4096;
+    req->trans_buf = realloc(req->trans_buf, req->trans_cap);
+}
+
+/* Appends one transcription record at used, returns the new size */
+static size_t trans_append(request_data * req, size_t used, uint32_t kind,
+                           double start, double end, const char * name) {
+    uint32_t name_len = (uint32_t) strlen(name);
+    float times[2];
+    times[0] = (float) start;
+    times[1] = (float) end;
+    trans_reserve(req, used + 4 * sizeof(uint32_t) + name_len);
+    memcpy(req->trans_buf + used, &kind, sizeof(kind));
+    memcpy(req->trans_buf + used + 4, times, sizeof(times));
+    memcpy(req->trans_buf + used + 12, &name_len, sizeof(name_len));
+    memcpy(req->trans_buf + used + 16, name, name_len);
+    return used + 16 + name_len;
+}
+
+/* Channel handler: streams the spurt's transcription and audio back to
+   the client. */
+static void request_callback(CPRC_abuf * abuf, void * context) {
+    request_data * req = (request_data *) context;
+    const CPRC_abuf_trans * trans;
+    double offset;
+    size_t used = 0;
+    int i, wav_mk, wav_done;
+
+    /* recorded in full even if the client went away */
+    if (req->cache) tts_cache_writer_add_abuf(req->cache, abuf);
+    if (req->failed) return;
+
+    /* Used for processing when a min/max phone range has been set */
+    wav_mk = CPRC_abuf_wav_mk(abuf);
+    wav_done = CPRC_abuf_wav_done(abuf);
+    if (wav_mk < 0) wav_mk = 0;
+    if (wav_done < 0) wav_done = 0;
+    offset = (req->samples - wav_mk) / (double) req->sample_rate;
+
+    if (!(req->flags & TTS_REQUEST_NO_TRANS)) {
+        for (i = 0; i < CPRC_abuf_trans_sz(abuf); i++) {
+            trans = CPRC_abuf_get_trans(abuf, i);
+            if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_ERROR) {
+                fprintf(stderr, "ERROR: could not retrieve transcription at '%d'\n", i);
+                continue;
+            }
+            used = trans_append(req, used, (uint32_t) CPRC_abuf_trans_type(trans),
+                                CPRC_abuf_trans_start(trans) + offset,
+                                CPRC_abuf_trans_end(trans) + offset,
+                                CPRC_abuf_trans_name(trans));
+        }
+        if (used && write_frame(req->fd, TTS_FRAME_TRANS, req->trans_buf, (uint32_t) used) < 0) {
+            req->failed = 1;
+            return;
+        }
+    }
+
+    if (!(req->flags & TTS_REQUEST_NO_AUDIO) && wav_done > wav_mk) {
+        /* Samples go straight from the engine buffer to the socket */
+        if (write_frame(req->fd, TTS_FRAME_AUDIO, CPRC_abuf_wav_data(abuf) + wav_mk,
+                        (uint32_t) ((wav_done - wav_mk) * sizeof(short))) < 0) {
+            req->failed = 1;
+            return;
+        }
+    }
+    req->samples += wav_done - wav_mk;
+}
+
+/* Answers a request from a cache entry, with the same frames as a
+   synthesis in a single spurt */
+static void send_cached(request_data * req, const tts_cache_entry * entry) {
+    const tts_timeline * tl = &entry->timeline;
+    const tts_timeline_record * rec;
+    size_t used = 0;
+    uint32_t i, kind;
+
+    if (!(req->flags & TTS_REQUEST_NO_TRANS)) {
+        for (i = 0; i < tl->header->n_records; i++) {
+            rec = &tl->records[i];
+            switch (rec->type) {
+            case TTS_TIMELINE_PHONE: kind = CPRC_ABUF_TRANS_PHONE; break;
+            case TTS_TIMELINE_WORD: kind = CPRC_ABUF_TRANS_WORD; break;
+            default: kind = CPRC_ABUF_TRANS_MARK; break;
+            }
+            used = trans_append(req, used, kind, tts_timeline_seconds(tl, rec->start),
+                                tts_timeline_seconds(tl, rec->end), tts_timeline_symbol(tl, rec->symbol));
+        }
+        if (used && write_frame(req->fd, TTS_FRAME_TRANS, req->trans_buf, (uint32_t) used) < 0) {
+            req->failed = 1;
+            return;
+        }
+    }
+    if (!(req->flags & TTS_REQUEST_NO_AUDIO) && entry->n_samples > 0) {
+        /* straight from the mapped file */
+        if (write_frame(req->fd, TTS_FRAME_AUDIO, entry->samples,
+                        (uint32_t) (entry->n_samples * sizeof(short))) < 0) {
+            req->failed = 1;
+            return;
+        }
+    }
+    req->samples = entry->n_samples;
+}
+
+static void connection_add(connection * conn) {
+    tts_mutex_lock(&connections_lock);
+    conn->next = connections;
+    connections = conn;
+    n_connections++;
+    tts_mutex_unlock(&connections_lock);
+}
+
+static void connection_remove(connection * conn) {
+    connection ** c;
+    tts_mutex_lock(&connections_lock);
+    for (c = &connections; *c; c = &(*c)->next) {
+        if (*c == conn) {
+            *c = conn->next;
+            n_connections--;
+            break;
+        }
+    }
+    close(conn->fd);
+    free(conn);
+    tts_cond_broadcast(&connections_done);
+    tts_mutex_unlock(&connections_lock);
+}
+
+/* Serves all requests of one client connection. */
+static tts_thread_ret TTS_THREAD_CALL serve_connection(void * userdata) {
+    connection * conn = (connection *) userdata;
+    request_data req;
+    tts_pool_channel * chan;
+    tts_cache * cache;
+    tts_cache_key key;
+    tts_cache_entry * entry;
+    uint32_t hdr[3], done[2];
+    char * text = NULL;
+    size_t text_cap = 0;
+    const char * msg;
+    sigset_t mask;
+
+    /* Leave SIGINT/SIGTERM to the accept loop */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    memset(&req, 0, sizeof(req));
+    req.fd = conn->fd;
+    req.sample_rate = tts_pool_sample_rate(conn->pool);
+
+    while (!server_stop && read_all(conn->fd, hdr, sizeof(hdr)) == 0) {
+        if (hdr[0] != TTS_REQUEST_MAGIC || hdr[2] > TTS_REQUEST_MAX) {
+            msg = "bad request header";
+            write_frame(conn->fd, TTS_FRAME_ERROR, msg, (uint32_t) strlen(msg));
+            break;
+        }
+        if (hdr[2] + 1 > text_cap) {
+            text_cap = hdr[2] + 1;
+            text = realloc(text, text_cap);
+        }
+        if (read_all(conn->fd, text, hdr[2]) < 0) break;
+        text[hdr[2]] = '\0';
+
+        req.flags = hdr[1];
+        req.samples = 0;
+        req.failed = 0;
+        req.cache = NULL;
+
+        cache = tts_pool_cache(conn->pool, text, (int) hdr[2], &key);
+        entry = cache ? tts_cache_get(cache, &key) : NULL;
+        if (entry) {
+            send_cached(&req, entry);
+            tts_cache_release(cache, entry);
+        }
+        else {
+            if (cache) req.cache = tts_cache_writer_open(cache, &key, req.sample_rate);
+            chan = tts_pool_acquire(conn->pool);
+            chan->context = &req;
+            chan->handler = request_callback;
+            tts_pool_speak(conn->pool, chan, text, (int) hdr[2]);
+            tts_pool_release(conn->pool, chan);
+            if (req.cache) tts_cache_writer_commit(req.cache);
+        }
+
+        if (req.failed) break;
+        done[0] = (uint32_t) req.sample_rate;
+        done[1] = (uint32_t) req.samples;
+        if (write_frame(conn->fd, TTS_FRAME_DONE, done, sizeof(done)) < 0) break;
+    }
+
+    free(text);
+    free(req.trans_buf);
+    connection_remove(conn);
+    return 0;
+}
+
+int tts_server_run(tts_pool * pool, const char * socket_path) {
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    connection * conn;
+    tts_thread thread;
+    int sock, fd;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "ERROR: socket path '%s' is too long\n", socket_path);
+        return -1;
+    }
+
+    /* No SA_RESTART, so accept() returns when asked to stop */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    tts_mutex_init(&connections_lock);
+    tts_cond_init(&connections_done);
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("ERROR: socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(sock, 64) < 0) {
+        perror("ERROR: unable to listen on socket");
+        close(sock);
+        return -1;
+    }
+    fprintf(stderr, "INFO: listening on '%s'\n", socket_path);
+
+    while (!server_stop) {
+        /* One thread per connection, no more than there are channels;
+           further clients wait in the listen backlog */
+        tts_mutex_lock(&connections_lock);
+        while (n_connections >= tts_pool_size(pool) && !server_stop)
+            tts_cond_timedwait(&connections_done, &connections_lock, 200);
+        tts_mutex_unlock(&connections_lock);
+        if (server_stop) break;
+
+        fd = accept(sock, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("WARNING: accept");
+            continue;
+        }
+        conn = calloc(1, sizeof(connection));
+        conn->pool = pool;
+        conn->fd = fd;
+        connection_add(conn);
+        if (!tts_thread_start(&thread, serve_connection, conn)) {
+            fprintf(stderr, "WARNING: unable to start connection thread\n");
+            connection_remove(conn);
+            continue;
+        }
+        tts_thread_detach(thread);
+    }
+
+    fprintf(stderr, "INFO: shutting down\n");
+    close(sock);
+    unlink(socket_path);
+
+    /* Wake clients blocked on a read and let requests in progress
+       finish before the pool goes away */
+    tts_mutex_lock(&connections_lock);
+    for (conn = connections; conn; conn = conn->next) shutdown(conn->fd, SHUT_RD);
+    while (connections) tts_cond_wait(&connections_done, &connections_lock);
+    tts_mutex_unlock(&connections_lock);
+    tts_cond_destroy(&connections_done);
+    tts_mutex_destroy(&connections_lock);
+    return 0;
+}
+
+#else /* WIN32 */
+
+int tts_server_run(tts_pool * pool, const char * socket_path) {
+    (void) pool;
+    (void) socket_path;
+    fprintf(stderr, "ERROR: server mode needs Unix domain sockets and is not available on this platform\n");
+    return -1;
+}
+
+#endif
@@ -0,0 +1,50 @@
+/* Synthesis server for tts_callback's daemon mode.
+
+   The server listens on a local Unix socket and serves synthesis
+   requests from a tts_pool, so the voice is loaded once per process
+   rather than once per utterance.  A connection may send any number of
+   requests; each is answered in order.  Connections are served
+   concurrently, up to the number of channels in the pool; further
+   clients wait in the listen backlog until one closes.  If the pool
+   has a cache, repeated requests are answered from it without taking a
+   channel: all transcription in one frame, then all audio in one.
+
+   All integers are little-endian 32 bit.
+
+   Request:   "TTSQ" | flags | text_len | text (UTF-8 text or SSML)
+
+   Response:  a sequence of frames, each "type | payload_len | payload":
+
+     TTS_FRAME_AUDIO  16 bit mono PCM at the voice sample rate
+     TTS_FRAME_TRANS  transcription records for the spurt, each
+                      "kind | start | end | name_len | name" where
+                      start/end are float seconds from the beginning of
+                      the request and kind is a CPRC_ABUF_TRANS_* value
+     TTS_FRAME_DONE   "sample_rate | total_samples", ends the response
+     TTS_FRAME_ERROR  error message, ends the response
+*/
+
+#ifndef TTS_SERVER_H
+#define TTS_SERVER_H
+
+#include "tts_pool.h"
+
+#define TTS_REQUEST_MAGIC 0x51535454 /* "TTSQ" */
+#define TTS_REQUEST_MAX (16 * 1024 * 1024)
+
+/* Request flags */
+#define TTS_REQUEST_NO_AUDIO 0x1 /* transcription only */
+#define TTS_REQUEST_NO_TRANS 0x2 /* audio only */
+
+enum tts_frame_type {
+    TTS_FRAME_AUDIO = 1,
+    TTS_FRAME_TRANS = 2,
+    TTS_FRAME_DONE = 3,
+    TTS_FRAME_ERROR = 4
+};
+
+/* Serve requests on socket_path until SIGINT/SIGTERM.  Returns 0 on a
+   clean shutdown, -1 if the socket could not be set up. */
+int tts_server_run(tts_pool * pool, const char * socket_path);
+
+#endif /* TTS_SERVER_H */
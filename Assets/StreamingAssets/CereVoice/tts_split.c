@@ -0,0 +1,411 @@
+/* Parallel synthesis of one document for the drivers' -P mode.
+   See tts_split.h for the splitting rules. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <cerevoice_eng.h>
+#include "tts_arena.h"
+#include "tts_split.h"
+#include "tts_thread.h"
+#include "tts_timeline.h"
+
+/* Words whose full stop does not end a sentence */
+static const char * abbreviations[] = {
+    "mr", "mrs", "ms", "dr", "prof", "st", "jr", "sr", "vs", "e.g", "i.e", "cf", NULL
+};
+
+typedef struct split_segment {
+    struct split_run * run;
+    int index;
+    char * text;
+    tts_arena * arena;    /* holds the spurts until they are output */
+    /* Spurts returned and not yet output */
+    tts_split_spurt * first;
+    tts_split_spurt * last;
+    int done;
+} split_segment;
+
+typedef struct split_run {
+    tts_pool * pool;
+    int sample_rate;
+    split_segment * segments;
+    int nsegments;
+    int next;             /* next segment to synthesise */
+    int output;           /* segment being output */
+    int ahead;            /* segments synthesised beyond output */
+    tts_arena * arenas;   /* one per segment in flight, segment i uses i % ahead */
+    tts_mutex lock;
+    tts_cond ready;       /* a spurt or the end of a segment */
+    tts_cond advanced;    /* output moved to the next segment */
+} split_run;
+
+/* Splitting */
+
+static int is_abbreviation(const char * s, int dot, int begin) {
+    char word[8];
+    int i = dot, n, k;
+
+    while (i > begin && (isalpha((unsigned char) s[i - 1]) || s[i - 1] == '.')) i--;
+    n = dot - i;
+    if (n == 0) return 0;
+    /* Initials */
+    if (n == 1 && isupper((unsigned char) s[i])) return 1;
+    if (n >= (int) sizeof(word)) return 0;
+    for (k = 0; k < n; k++) word[k] = (char) tolower((unsigned char) s[i + k]);
+    word[n] = '\0';
+    for (k = 0; abbreviations[k]; k++) {
+        if (strcmp(word, abbreviations[k]) == 0) return 1;
+    }
+    return 0;
+}
+
+/* Start of the next sentence if the punctuation at i ends one, -1
+   otherwise */
+static int sentence_end(const char * s, int i, int begin, int end) {
+    int j;
+
+    if (s[i] != '.' && s[i] != '!' && s[i] != '?') return -1;
+    if (s[i] == '.' && is_abbreviation(s, i, begin)) return -1;
+    j = i + 1;
+    while (j < end && (s[j] == '"' || s[j] == '\'' || s[j] == ')' || s[j] == ']')) j++;
+    if (j >= end || !isspace((unsigned char) s[j])) return -1;
+    while (j < end && isspace((unsigned char) s[j])) j++;
+    if (j >= end) return -1;
+    if (isupper((unsigned char) s[j]) || isdigit((unsigned char) s[j]) ||
+        s[j] == '"' || s[j] == '\'' || s[j] == '(' || s[j] == '<')
+        return j;
+    return -1;
+}
+
+/* Start of the next paragraph if a blank line starts at the newline at
+   i, -1 otherwise */
+static int paragraph_end(const char * s, int i, int end) {
+    int j = i + 1;
+
+    while (j < end && (s[j] == ' ' || s[j] == '\t' || s[j] == '\r')) j++;
+    if (j >= end || s[j] != '\n') return -1;
+    while (j < end && isspace((unsigned char) s[j])) j++;
+    return j < end ? j : -1;
+}
+
+/* Skips the markup at i, a tag, comment or processing instruction, and
+   updates the element depth.  Returns the position after it, or -1 if
+   it is not closed. */
+static int skip_markup(const char * s, int i, int end, int * depth) {
+    const char * p;
+    char quote = 0;
+    int j;
+
+    if (i + 3 < end && strncmp(s + i, "<!--", 4) == 0) {
+        for (j = i + 4; j + 2 < end; j++) {
+            if (strncmp(s + j, "-->", 3) == 0) return j + 3;
+        }
+        return -1;
+    }
+    for (j = i + 1; j < end; j++) {
+        if (quote) {
+            if (s[j] == quote) quote = 0;
+        }
+        else if (s[j] == '"' || s[j] == '\'') quote = s[j];
+        else if (s[j] == '>') break;
+    }
+    if (j >= end) return -1;
+    p = s + i + 1;
+    if (*p == '/') (*depth)--;
+    else if (*p != '?' && *p != '!' && s[j - 1] != '/') (*depth)++;
+    return j + 1;
+}
+
+static int is_markup(const char * s, int i, int end) {
+    return s[i] == '<' && i + 1 < end &&
+        (isalpha((unsigned char) s[i + 1]) || s[i + 1] == '/' || s[i + 1] == '!' || s[i + 1] == '?');
+}
+
+/* Finds the body of an SSML document, between the start and the end tag
+   of the root element.  Returns 0 if text is not SSML. */
+static int ssml_body(const char * s, int end, int * body, int * body_end, int * name, int * name_len) {
+    int i = 0, depth = 0, n, j;
+
+    for (;;) {
+        while (i < end && isspace((unsigned char) s[i])) i++;
+        if (i >= end || !is_markup(s, i, end)) return 0;
+        if (s[i + 1] == '?' || s[i + 1] == '!') {
+            i = skip_markup(s, i, end, &depth);
+            if (i < 0) return 0;
+            continue;
+        }
+        break;
+    }
+    if (s[i + 1] == '/') return 0;
+    *name = i + 1;
+    for (n = 0; *name + n < end && !isspace((unsigned char) s[*name + n]) &&
+             s[*name + n] != '>' && s[*name + n] != '/'; n++)
+        ;
+    *name_len = n;
+    *body = skip_markup(s, i, end, &depth);
+    if (*body < 0 || depth != 1) return 0;
+    /* The last end tag of the root */
+    for (j = end - n - 2; j >= *body; j--) {
+        if (s[j] == '<' && s[j + 1] == '/' && strncmp(s + j + 2, s + *name, n) == 0) {
+            *body_end = j;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int is_blank(const char * s, int begin, int end) {
+    while (begin < end && isspace((unsigned char) s[begin])) begin++;
+    return begin >= end;
+}
+
+/* Copies text[begin, end), wrapped in the prologue and the end tag of
+   the root element for SSML */
+static char * segment_copy(const char * s, int begin, int end, int prologue, int name, int name_len) {
+    char * seg;
+    int n = end - begin;
+
+    if (!prologue) {
+        seg = malloc(n + 1);
+        memcpy(seg, s + begin, n);
+        seg[n] = '\0';
+        return seg;
+    }
+    seg = malloc(prologue + n + name_len + 5);
+    memcpy(seg, s, prologue);
+    memcpy(seg + prologue, s + begin, n);
+    sprintf(seg + prologue + n, "</%.*s>\n", name_len, s + name);
+    return seg;
+}
+
+int tts_split_text(const char * text, int textlen, char *** segments) {
+    int body = 0, body_end = textlen, name = 0, name_len = 0, prologue = 0;
+    int i, j, depth = 0, start, next, n = 0, cap = 16;
+    char ** segs = malloc(cap * sizeof(char *));
+
+    if (ssml_body(text, textlen, &body, &body_end, &name, &name_len)) prologue = body;
+    start = body;
+    i = body;
+    while (i < body_end) {
+        next = -1;
+        if (is_markup(text, i, body_end)) {
+            j = skip_markup(text, i, body_end, &depth);
+            if (j < 0) break;
+            /* The end of a sentence or paragraph element */
+            if (depth == 0 && text[i + 1] == '/' && (text[i + 2] == 's' || text[i + 2] == 'p') &&
+                (text[i + 3] == '>' || isspace((unsigned char) text[i + 3]))) {
+                next = j;
+                while (next < body_end && isspace((unsigned char) text[next])) next++;
+                if (next >= body_end) next = -1;
+            }
+            if (next < 0) {
+                i = j;
+                continue;
+            }
+        }
+        else if (depth == 0) {
+            if (text[i] == '\n') next = paragraph_end(text, i, body_end);
+            else next = sentence_end(text, i, start, body_end);
+        }
+        if (next < 0) {
+            i++;
+            continue;
+        }
+        /* The first sentence alone, then at least TTS_SPLIT_MIN_CHARS */
+        if ((n == 0 || next - start >= TTS_SPLIT_MIN_CHARS) && !is_blank(text, start, next)) {
+            if (n == cap) {
+                cap *= 2;
+                segs = realloc(segs, cap * sizeof(char *));
+            }
+            segs[n++] = segment_copy(text, start, next, prologue, name, name_len);
+            start = next;
+        }
+        i = next;
+    }
+    if (!is_blank(text, start, body_end)) {
+        if (n == cap) segs = realloc(segs, (cap + 1) * sizeof(char *));
+        segs[n++] = segment_copy(text, start, body_end, prologue, name, name_len);
+    }
+    *segments = segs;
+    return n;
+}
+
+void tts_split_free(char ** segments, int n) {
+    int i;
+    for (i = 0; i < n; i++) free(segments[i]);
+    free(segments);
+}
+
+/* Synthesis */
+
+tts_split_spurt * tts_split_spurt_new(CPRC_abuf * abuf, tts_arena * arena, int sample_rate, int segment) {
+    tts_split_spurt * spurt = tts_arena_alloc(arena, sizeof(tts_split_spurt));
+    const CPRC_abuf_trans * trans;
+    tts_split_trans * t;
+    int i, type, wav_mk, wav_done, ntrans;
+
+    memset(spurt, 0, sizeof(tts_split_spurt));
+    spurt->segment = segment;
+    /* Used for processing when a min/max phone range has been set */
+    wav_mk = CPRC_abuf_wav_mk(abuf);
+    wav_done = CPRC_abuf_wav_done(abuf);
+    if (wav_mk < 0) wav_mk = 0;
+    if (wav_done < 0) wav_done = 0;
+    if (wav_done > wav_mk) {
+        spurt->n_samples = wav_done - wav_mk;
+        spurt->samples = tts_arena_alloc(arena, spurt->n_samples * sizeof(short));
+        memcpy(spurt->samples, CPRC_abuf_wav_data(abuf) + wav_mk, spurt->n_samples * sizeof(short));
+    }
+
+    ntrans = CPRC_abuf_trans_sz(abuf);
+    if (ntrans > 0) spurt->trans = tts_arena_alloc(arena, ntrans * sizeof(tts_split_trans));
+    for (i = 0; i < ntrans; i++) {
+        trans = CPRC_abuf_get_trans(abuf, i);
+        switch (CPRC_abuf_trans_type(trans)) {
+        case CPRC_ABUF_TRANS_PHONE: type = TTS_TIMELINE_PHONE; break;
+        case CPRC_ABUF_TRANS_WORD: type = TTS_TIMELINE_WORD; break;
+        case CPRC_ABUF_TRANS_MARK: type = TTS_TIMELINE_MARK; break;
+        default:
+            fprintf(stderr, "ERROR: could not retrieve transcription at '%d'\n", i);
+            continue;
+        }
+        t = &spurt->trans[spurt->n_trans++];
+        t->type = type;
+        t->start = (int64_t) (CPRC_abuf_trans_start(trans) * sample_rate + 0.5) - wav_mk;
+        t->end = (int64_t) (CPRC_abuf_trans_end(trans) * sample_rate + 0.5) - wav_mk;
+        t->name = tts_arena_intern(arena, CPRC_abuf_trans_name(trans));
+    }
+    return spurt;
+}
+
+/* Channel handler, queues the spurt on its segment */
+static void split_handler(CPRC_abuf * abuf, void * context) {
+    split_segment * seg = (split_segment *) context;
+    split_run * run = seg->run;
+    tts_split_spurt * spurt = tts_split_spurt_new(abuf, seg->arena, run->sample_rate, seg->index);
+
+    tts_mutex_lock(&run->lock);
+    if (seg->last) seg->last->next = spurt;
+    else seg->first = spurt;
+    seg->last = spurt;
+    if (seg->index == run->output) tts_cond_signal(&run->ready);
+    tts_mutex_unlock(&run->lock);
+}
+
+static tts_thread_ret TTS_THREAD_CALL split_worker(void * userdata) {
+    split_run * run = (split_run *) userdata;
+    split_segment * seg;
+    tts_pool_channel * chan;
+
+    for (;;) {
+        /* Segments are taken in order, no further than ahead of the
+           output */
+        tts_mutex_lock(&run->lock);
+        while (run->next < run->nsegments && run->next >= run->output + run->ahead)
+            tts_cond_wait(&run->advanced, &run->lock);
+        if (run->next >= run->nsegments) {
+            tts_mutex_unlock(&run->lock);
+            break;
+        }
+        seg = &run->segments[run->next++];
+        tts_mutex_unlock(&run->lock);
+
+        chan = tts_pool_acquire(run->pool);
+        chan->handler = split_handler;
+        chan->context = seg;
+        tts_pool_speak(run->pool, chan, seg->text, (int) strlen(seg->text));
+        tts_pool_release(run->pool, chan);
+
+        tts_mutex_lock(&run->lock);
+        seg->done = 1;
+        if (seg->index == run->output) tts_cond_signal(&run->ready);
+        tts_mutex_unlock(&run->lock);
+    }
+    return 0;
+}
+
+long tts_split_speak(tts_pool * pool, const char * text, int textlen,
+                     tts_split_output output, void * userdata) {
+    split_run run;
+    split_segment * seg;
+    tts_split_spurt * spurt, * next;
+    tts_thread * threads;
+    char ** texts;
+    uint32_t offset = 0;
+    int i, k, done, nsegments, nworkers, started = 0;
+
+    memset(&run, 0, sizeof(run));
+    run.pool = pool;
+    run.sample_rate = tts_pool_sample_rate(pool);
+    nsegments = tts_split_text(text, textlen, &texts);
+    run.nsegments = nsegments;
+    run.segments = calloc(run.nsegments > 0 ? run.nsegments : 1, sizeof(split_segment));
+    for (i = 0; i < run.nsegments; i++) {
+        run.segments[i].run = &run;
+        run.segments[i].index = i;
+        run.segments[i].text = texts[i];
+    }
+    nworkers = tts_pool_size(pool);
+    if (nworkers > run.nsegments) nworkers = run.nsegments;
+    run.ahead = TTS_SPLIT_AHEAD * (nworkers > 0 ? nworkers : 1);
+    /* Segment i + ahead is only taken once segment i has been output */
+    run.arenas = malloc(run.ahead * sizeof(tts_arena));
+    for (i = 0; i < run.ahead; i++) tts_arena_init(&run.arenas[i]);
+    for (i = 0; i < run.nsegments; i++) run.segments[i].arena = &run.arenas[i % run.ahead];
+    tts_mutex_init(&run.lock);
+    tts_cond_init(&run.ready);
+    tts_cond_init(&run.advanced);
+    fprintf(stderr, "INFO: %d segment(s) on %d channel(s)\n", run.nsegments, nworkers);
+
+    threads = malloc((nworkers > 0 ? nworkers : 1) * sizeof(tts_thread));
+    for (i = 0; i < nworkers; i++) {
+        if (tts_thread_start(&threads[started], split_worker, &run)) started++;
+    }
+    if (nworkers > 0 && started == 0) {
+        fprintf(stderr, "ERROR: unable to start the synthesis threads\n");
+        run.nsegments = 0;
+    }
+
+    /* Output the segments in order, each spurt as soon as it is back */
+    for (i = 0; i < run.nsegments; i++) {
+        seg = &run.segments[i];
+        do {
+            tts_mutex_lock(&run.lock);
+            while (!seg->first && !seg->done) tts_cond_wait(&run.ready, &run.lock);
+            spurt = seg->first;
+            done = seg->done;
+            seg->first = seg->last = NULL;
+            tts_mutex_unlock(&run.lock);
+            for (; spurt; spurt = next) {
+                next = spurt->next;
+                /* Times from the start of the document */
+                for (k = 0; k < spurt->n_trans; k++) {
+                    spurt->trans[k].start += offset;
+                    spurt->trans[k].end += offset;
+                    if (spurt->trans[k].start < 0) spurt->trans[k].start = 0;
+                    if (spurt->trans[k].end < 0) spurt->trans[k].end = 0;
+                }
+                output(spurt, offset, userdata);
+                offset += (uint32_t) spurt->n_samples;
+            }
+        } while (!done);
+        tts_arena_reset(seg->arena);
+        tts_mutex_lock(&run.lock);
+        run.output = i + 1;
+        tts_cond_broadcast(&run.advanced);
+        tts_mutex_unlock(&run.lock);
+    }
+
+    for (i = 0; i < started; i++) tts_thread_join(threads[i]);
+    free(threads);
+    for (i = 0; i < run.ahead; i++) tts_arena_free(&run.arenas[i]);
+    free(run.arenas);
+    tts_cond_destroy(&run.advanced);
+    tts_cond_destroy(&run.ready);
+    tts_mutex_destroy(&run.lock);
+    free(run.segments);
+    tts_split_free(texts, nsegments);
+    return nworkers > 0 && started == 0 ? -1 : (long) offset;
+}
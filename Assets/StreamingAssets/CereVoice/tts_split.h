@@ -0,0 +1,82 @@
+/* Parallel synthesis of one document for the drivers' -P mode.
+
+   A single channel synthesises its input in sequence, so a long text
+   takes as long as the engine needs for all of it on one core, and the
+   first audio waits for the first phrase to come out of the pipeline.
+   Here the input is split at sentence boundaries and the segments are
+   synthesised concurrently on the channels of a pool:
+
+     - plain text is split after '.', '!' or '?' (closing quotes and
+       brackets included) followed by white space and a capital, a digit
+       or an opening quote, skipping common abbreviations and initials,
+       and at blank lines;
+     - SSML (input starting with '<') is split the same way, but only in
+       the text directly under the root element, never inside another
+       element, and every segment is wrapped again in the prologue and
+       the root element so that it stays a valid document;
+     - the first segment is the first sentence alone, so that its audio
+       comes back as soon as possible; the following ones are grouped up
+       to TTS_SPLIT_MIN_CHARS so that each speak call has enough text to
+       keep the prosody of the paragraph;
+     - worker threads take the segments in document order, so segment 0
+       is always synthesised first, and synthesise at most
+       TTS_SPLIT_AHEAD segments per channel beyond the one being output;
+     - the calling thread hands the spurts to the output function in
+       document order as soon as they are complete, with the offset of
+       the spurt from the start of the whole document.
+
+   Spurts are copied out of the engine's buffer, so the output function
+   sees the audio and transcription of a spurt exactly once and in
+   order, whichever channel produced them.  They are kept in an arena
+   per segment in flight (tts_arena.h), reset once the segment has been
+   output, so a long document does not call the allocator per spurt.
+*/
+
+#ifndef TTS_SPLIT_H
+#define TTS_SPLIT_H
+
+#include <stdint.h>
+#include "tts_arena.h"
+#include "tts_pool.h"
+
+#define TTS_SPLIT_MIN_CHARS 400   /* segments after the first */
+#define TTS_SPLIT_AHEAD 2         /* segments per channel */
+
+typedef struct tts_split_trans {
+    int type;             /* TTS_TIMELINE_PHONE, WORD or MARK */
+    int64_t start;        /* samples from the start of the document */
+    int64_t end;
+    const char * name;
+} tts_split_trans;
+
+/* One spurt of the engine, the audio between wav_mk and wav_done */
+typedef struct tts_split_spurt {
+    short * samples;
+    int n_samples;
+    tts_split_trans * trans;
+    int n_trans;
+    int segment;
+    struct tts_split_spurt * next;
+} tts_split_spurt;
+
+/* Called in document order on the thread of tts_split_speak.  offset is
+   the number of samples output before the spurt. */
+typedef void (*tts_split_output)(const tts_split_spurt * spurt, uint32_t offset, void * userdata);
+
+/* Splits text into segments as described above.  Returns the number of
+   segments and sets *segments to an array of nul-terminated copies,
+   freed with tts_split_free. */
+int tts_split_text(const char * text, int textlen, char *** segments);
+void tts_split_free(char ** segments, int n);
+
+/* Copies the audio and transcription of a spurt out of the engine's
+   buffer into arena, times relative to the start of its audio */
+tts_split_spurt * tts_split_spurt_new(CPRC_abuf * abuf, tts_arena * arena, int sample_rate, int segment);
+
+/* Synthesises text on the channels of the pool and outputs the spurts
+   in order.  Returns the number of samples output, or -1 if no worker
+   can be started. */
+long tts_split_speak(tts_pool * pool, const char * text, int textlen,
+                     tts_split_output output, void * userdata);
+
+#endif /* TTS_SPLIT_H */
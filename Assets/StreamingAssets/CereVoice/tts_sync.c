@@ -24,11 +24,14 @@
 #include <stdlib.h>
 #include <cerevoice_eng.h>
 #include <cerevoice_aud.h>
-#ifndef WIN32
-#include <pthread.h>
-#else
-#include <windows.h>
-#endif
+#include "tts_audio.h"
+#include "tts_bench.h"
+#include "tts_pool.h"
+#include "tts_timeline.h"
+#include "tts_sched.h"
+#include "tts_split.h"
+#include "tts_thread.h"
+#include "tts_wav.h"
 
 #define MAX_READ 100000
 
@@ -38,28 +41,24 @@ extern char * strdup(const char *s);
 void usage(char * name){
     fprintf(stderr, "tts_sync - a sample TTS program that uses the CereVoice Engine API with\n");
     fprintf(stderr, "a callback function.  Audio is played using the CereVoice Audio library.\n");
-    fprintf(stderr, "The spoken text is printed synchronously using two different methods.\n\n");
+    fprintf(stderr, "The transcription is printed in sync with playback by an event scheduler.\n\n");
     fprintf(stderr, "tts_sync loads a voice, then speaks text/XML from an input file, or from\n");
     fprintf(stderr, "stdin if the input file is not supplied.  Optionally the audio output can be\n");
     fprintf(stderr, "written to a wave file.\n\n");
+    fprintf(stderr, "With -P, the input is split at sentence boundaries and synthesised on a\n");
+    fprintf(stderr, "pool of channels, the audio being played in order (see tts_split.h).\n");
+    fprintf(stderr, "Times of the INFO lines are then from the start of the input.\n\n");
     fprintf(stderr, "Usage: %s [Options] voice_file license_file [input_file]\n", name);
     fprintf(stderr, "Options:\n"); 
     fprintf(stderr, " -h\t\t  Display help\n");
     fprintf(stderr, " -o output_file\t  Output audio to file\n");
+    fprintf(stderr, " -t timeline_file\t  Write the transcription as a binary timeline\n");
+    fprintf(stderr, " -j stats_file\t  Write benchmark statistics as JSON (see tts_bench.h)\n");
+    fprintf(stderr, " -P\t\t  Synthesise the sentences of the input in parallel\n");
+    fprintf(stderr, " -n <n>\t  Number of -P channels (default: number of CPUs)\n");
     exit(0);
 }
 
-/* This structure contains the data to display and timing information. */
-struct w_data {
-    double ostart; /* start time relative to the spurt */
-    double start;  /* start time relative to the beginning of synthesis */
-    double oend;   /* end time relative to the spurt */
-    double end;    /* end time relative to the beginning of synthesis */
-    char * name;   /* string to display */
-    CPRC_sc_audio * buf; /* audio buffer it belongs to */
-    struct w_data *next;
-};
-
 /* A user data structure is passed into the callback function by the user.
    It allows access to external user-configurable data.
  */
@@ -69,89 +68,46 @@ typedef struct user_data {
     /* Add other user-specific settings here */
     double total_time;
     long int sample_rate;
-    struct w_data *words;
+    /* Fires words, phones and markers as they are played */
+    tts_sched * sched;
+    /* Set by the main thread, read by the printing thread */
+    volatile unsigned int done;
+    /* Binary transcription output, replaces the printed INFO lines */
+    tts_timeline_writer * timeline;
+    /* Audio file output, one stream for the whole input */
+    tts_wav_writer * wav;
+    /* Latency and allocation measurements, if requested */
+    tts_bench * bench;
+    /* Buffers cued on the player, deleted once played */
+    tts_audio_pool audio;
 } user_data;
 
-/* Add a word with timing information to the callback structure */
-
-void add_word(struct w_data ** words, double ostart, double start, double oend, double end, const char * name, CPRC_sc_audio * buf ) {
-    struct w_data * word;
-    while (*words) words = &((*words)->next);
-    word = calloc(1, sizeof(struct w_data));
-    word->start = start;
-    word->end = end;
-    word->ostart = ostart;
-    word->oend = oend;
-    word->name = strdup(name);
-    word->buf = buf;
-    word->next = NULL;
-    *words = word;
-    fprintf(stdout, "Adding at times: %8.15g %8.15g %s\n", start, end, name);
-    fflush(stdout);
+/* Playback clock of the scheduler, in seconds from the start of the
+   stream, negative while nothing is playing */
+double playback_time(void * userdata) {
+    user_data * data = (user_data *) userdata;
+    if (!CPRC_sc_audio_busy(data->player) || CPRC_sc_audio_paused(data->player))
+        return -1;
+    return CPRC_sc_player_stream_time(data->player) / (double) data->sample_rate;
 }
 
-/* Separate thread for printing synchronised information */
-#ifndef WIN32
-void * print_messages(void * userdata) {
-#else
-DWORD WINAPI print_messages(void * userdata) {
-#endif
+/* Subscriber printing the synchronised information */
+void print_event(const tts_sched_event * ev, void * userdata) {
+    static const char * types[] = { "phoneme", "word", "marker" };
     user_data * data = (user_data *) userdata;
-  double t, t2, ts;
-  struct w_data * w, *cw = NULL, *cw2 = NULL, *tw;
-  CPRC_sc_audio * buf;
-  int cnt = 0;
-  while(1) {
-      if (CPRC_sc_audio_busy(data->player) && !CPRC_sc_audio_paused(data->player)) {
-	  t = CPRC_sc_player_stream_duration(data->player) / (double)data->sample_rate;
-	  t2 = CPRC_sc_player_stream_time(data->player);
-
-	  /* First method: using total stream duration */
-	  w = data->words;
-	  while (w && w->end < t) w = w->next;
-	  if (w && w != cw && w->start <= t) {
-	      fprintf(stderr, "Method 1: %d %8.15g %8.15g %s\n", cnt, t, w->start, w->name);
-	      fflush(stderr);
-	      cw = w;
-	  }
-
-	  /* Second method: using timing relative to the spurt. Note that
-	     the code could be much simpler, but is written like this to be 
-	     consistant with the first method. */
-	  w = data->words;
-	  while (w && w->buf == NULL) w = w->next;
-	  if (w) {
-	      buf = w->buf;
-	      ts = CPRC_sc_audio_start_time(w->buf);
-	      t = (t2 - ts) / (double)data->sample_rate;
-	      while (w && w->oend < t && w->buf == buf) w = w->next;
-	      /* New spurt! */
-	      if (w && w->buf != buf && CPRC_sc_audio_status(buf) == CPRC_SC_PLAYED) { 
-		  tw = data->words;
-		  buf = w->buf;
-		  ts = CPRC_sc_audio_start_time(w->buf);
-		  t = (t2 - ts) / (double)data->sample_rate;
-		  /* A better cleaup should be made here... */
-		  while (tw) { if (tw->buf != w->buf) tw->buf = NULL; else break; tw = tw->next; }
-		  /* CPRC_sc_audio_delete(buf); */
-		  buf = w->buf;
-	      }
-	      if (w && w != cw2 && w->ostart <= t) {
-		  fprintf(stderr, "Method 2: %d %8.15g %8.15g %s\n", cnt, t, w->ostart, w->name);
-		  fflush(stderr);
-		  cw2 = w;
-	      }
-	  }
-	  CPRC_sc_sleep_msecs(1);
-	  cnt++;
-	  if (cnt % 1200 == 0) {
-	      CPRC_sc_audio_pauseon(data->player);
-	      CPRC_sc_sleep_msecs(100);
-	      CPRC_sc_audio_pauseoff(data->player);
-	  }
-      }
-  }
-  return NULL;
+    fprintf(stderr, "SYNC: %s: %8.3f %8.3f %s\n", types[ev->type], playback_time(data), ev->start, ev->name);
+    fflush(stderr);
+}
+
+/* Separate thread delivering the scheduled events to the subscribers.
+   It sleeps until the scheduler queues something. */
+tts_thread_ret TTS_THREAD_CALL print_messages(void * userdata) {
+    user_data * data = (user_data *) userdata;
+    while (!tts_atomic_load(&data->done) || !tts_sched_done(data->sched)) {
+        tts_sched_wait(data->sched, TTS_SCHED_MAX_SLEEP);
+        tts_sched_dispatch(data->sched);
+    }
+    return 0;
 }
 
 /* Callback function
@@ -168,20 +124,28 @@ void channel_callback(CPRC_abuf * abuf, void * userdata) {
        markers etc.
      */
     const CPRC_abuf_trans * trans;
-    CPRC_sc_audio * buf = NULL;
     const char * name;
     float start, end;
     user_data * data = (user_data *) userdata;
     int i;
+    if (data->bench) tts_bench_callback_begin(data->bench);
     if (data->player) {
         /* Use the CereVoice Audio API to play the audio that has been
             returned, the audio is converted to a buffer and cued for
-            playback.
+            playback.  The pool deletes the buffers already played.
         */
-        buf = CPRC_sc_audio_short(CPRC_abuf_wav_data(abuf),  CPRC_abuf_wav_sz(abuf));
-        CPRC_sc_audio_cue(data->player, buf);
+        tts_audio_pool_cue(&data->audio, CPRC_abuf_wav_data(abuf), CPRC_abuf_wav_sz(abuf));
+        /* Schedule the transcription at its position in the stream */
+        tts_sched_add_abuf(data->sched, abuf, data->total_time);
         printf("Current audio time: %g; dur: %ld, %8.15g\n", CPRC_sc_player_stream_time(data->player), CPRC_sc_player_samples_sent(data->player), CPRC_sc_player_stream_duration(data->player));
     }
+    if (data->wav) {
+        tts_wav_write_abuf(data->wav, abuf);
+    }
+    /* Store the transcription in the timeline if one was requested */
+    if (data->timeline) {
+        tts_timeline_writer_add_abuf(data->timeline, abuf);
+    }
     /* Process the transcription buffer items and print information. */
     for(i = 0; i < CPRC_abuf_trans_sz(abuf); i++) {
         trans = CPRC_abuf_get_trans(abuf, i);
@@ -189,39 +153,102 @@ void channel_callback(CPRC_abuf * abuf, void * userdata) {
         end = CPRC_abuf_trans_end(trans);
         name = CPRC_abuf_trans_name(trans);
         if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_PHONE) {
-            printf("INFO: phoneme: %.3f %.3f %s\n", start, end, name);
+            if (!data->timeline) printf("INFO: phoneme: %.3f %.3f %s\n", start, end, name);
         } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_WORD) {
-            printf("INFO: word: %.3f %.3f %s\n", start, end, name);
-                  add_word(&(data->words), start, start + data->total_time, end, end + data->total_time, name, buf);
+            if (!data->timeline) printf("INFO: word: %.3f %.3f %s\n", start, end, name);
         } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_MARK) {
-            printf("INFO: marker: %.3f %.3f %s\n", start, end, name);
+            if (!data->timeline) printf("INFO: marker: %.3f %.3f %s\n", start, end, name);
         } else if (CPRC_abuf_trans_type(trans) == CPRC_ABUF_TRANS_ERROR) {
             printf("ERROR: could not retrieve transcription at '%d'", i);
         }
         fflush(stdout);
     }
     data->total_time += CPRC_abuf_wav_sz(abuf) / (double) data->sample_rate; 
+    if (data->bench) tts_bench_callback_end(data->bench, CPRC_abuf_wav_sz(abuf));
+}
+
+/* Output function of the -P mode
+
+   Receives the spurts of all channels in the order of the input, with
+   their transcription already offset to the start of the input, so
+   total_time only follows the audio for the player.
+*/
+void split_output(const tts_split_spurt * spurt, uint32_t offset, void * userdata) {
+    static const char * kinds[] = { "phoneme", "word", "marker" };
+    const tts_split_trans * trans;
+    user_data * data = (user_data *) userdata;
+    double start, end;
+    int i;
+
+    if (data->bench) tts_bench_callback_begin(data->bench);
+    if (data->player && spurt->n_samples > 0) {
+        /* The spurt is freed on return, the buffer keeps a copy */
+        tts_audio_pool_cue(&data->audio, spurt->samples, spurt->n_samples);
+    }
+    if (data->wav) {
+        tts_wav_write(data->wav, spurt->samples, spurt->n_samples);
+    }
+    for (i = 0; i < spurt->n_trans; i++) {
+        trans = &spurt->trans[i];
+        start = trans->start / (double) data->sample_rate;
+        end = trans->end / (double) data->sample_rate;
+        /* Schedule the transcription at its position in the stream */
+        if (data->sched) tts_sched_add(data->sched, trans->type, start, end, trans->name);
+        if (data->timeline) {
+            tts_timeline_writer_add(data->timeline, trans->type, (uint32_t) trans->start, (uint32_t) trans->end, trans->name);
+        }
+        else {
+            printf("INFO: %s: %.3f %.3f %s\n", kinds[trans->type], start, end, trans->name);
+        }
+    }
+    fflush(stdout);
+    if (data->timeline) {
+        tts_timeline_writer_add_samples(data->timeline, (uint32_t) spurt->n_samples);
+    }
+    data->total_time = (offset + spurt->n_samples) / (double) data->sample_rate;
+    if (data->bench) tts_bench_callback_end(data->bench, spurt->n_samples);
+}
+
+/* Reads the whole input for -P, it is split before synthesis */
+char * read_input(FILE * fp, long * len) {
+    char * text = NULL;
+    long cap = 0;
+    size_t n;
+
+    *len = 0;
+    do {
+        if (*len + 4096 + 1 > cap) {
+            cap = cap ? cap * 2 : 65536;
+            text = realloc(text, cap);
+        }
+        n = fread(text + *len, 1, cap - *len - 1, fp);
+        *len += (long) n;
+    } while (n > 0);
+    text[*len] = '\0';
+    return text;
 }
 
 int main(int argc, char * argv[]){
 
-    CPRCEN_engine * eng;
-    CPRCEN_channel_handle hc;
-    user_data data = {NULL, 0, 0, NULL};
-#ifdef WIN32
-    HANDLE thread1;
-#else
-    pthread_t thread1;
-#endif
+    CPRCEN_engine * eng = NULL;
+    CPRCEN_channel_handle hc = 0;
+    tts_pool * pool = NULL;
+    user_data data = {0};
+    tts_thread thread1;
     char * voice_file  = NULL;
     char * license_file  = NULL;
     char * text_file = NULL;
     char * file_out = NULL;
+    char * timeline_file = NULL;
+    char * stats_file = NULL;
+    tts_bench bench;
     char text_buffer[MAX_READ];
     char * ret;
+    char * text;
+    long textlen;
     const char * freqstr;
     FILE * text_fp;
-    int arg, i, res, freq, iret1;
+    int arg, i, res, freq, nchannels = 0, parallel = 0;
 
     /* Processing arguments */
     arg = 0;
@@ -236,6 +263,29 @@ int main(int argc, char * argv[]){
             else
                 usage(argv[0]);
         }
+        else if (strcmp(argv[i], "-t") == 0) {
+            i++;
+            if (i < argc)
+                timeline_file = argv[i];
+            else
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-j") == 0) {
+            i++;
+            if (i < argc)
+                stats_file = argv[i];
+            else
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-n") == 0) {
+            i++;
+            if (i < argc)
+                nchannels = strtol(argv[i], NULL, 10);
+            else
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-P") == 0)
+            parallel = 1;
         /* Arguments */
         else {
             switch(arg) {
@@ -258,59 +308,98 @@ int main(int argc, char * argv[]){
     if (arg < 2 || arg > 3)
       usage(argv[0]);
 
-    /* Create a empty engine object.  The engine maintains the list of
-       loaded voices and makes them available to synthesis channels. */
-    eng = CPRCEN_engine_new();
-    /* Load a voice into the engine */
-    res = CPRCEN_engine_load_voice(eng, license_file, NULL, voice_file, CPRC_VOICE_LOAD);
-    if (!res) {
-        fprintf(stderr, "ERROR: unable to load voice file '%s', exiting.\n", voice_file);
-        exit(-1);
+    if (parallel) {
+        /* Sentences are synthesised concurrently, one per channel */
+        if (nchannels <= 0)
+            nchannels = tts_cpu_count();
+        pool = tts_pool_new(voice_file, license_file, NULL, nchannels, 0);
+        if (!pool) {
+            fprintf(stderr, "ERROR: unable to set up synthesis pool, exiting.\n");
+            exit(-1);
+        }
+        freq = tts_pool_sample_rate(pool);
     }
+    else {
+        /* Create a empty engine object.  The engine maintains the list of
+           loaded voices and makes them available to synthesis channels. */
+        eng = CPRCEN_engine_new();
+        /* Load a voice into the engine */
+        res = CPRCEN_engine_load_voice(eng, license_file, NULL, voice_file, CPRC_VOICE_LOAD);
+        if (!res) {
+            fprintf(stderr, "ERROR: unable to load voice file '%s', exiting.\n", voice_file);
+            exit(-1);
+        }
 
-    /* Open a synthesis channel. */
-    hc = CPRCEN_engine_open_default_channel(eng);
+        /* Open a synthesis channel. */
+        hc = CPRCEN_engine_open_default_channel(eng);
 
-    /* Example of accessing voice information.  Sample rate is
-       required for setting up audio playback. */
-    fprintf(stderr, "INFO: voice name '%s'\n", CPRCEN_channel_get_voice_info(eng, hc, "VOICE_NAME"));
-    freqstr = CPRCEN_channel_get_voice_info(eng, hc, "SAMPLE_RATE");
-    fprintf(stderr, "INFO: voice sample rate is '%s'\n", freqstr);
-    freq = atoi(freqstr);
+        /* Example of accessing voice information.  Sample rate is
+           required for setting up audio playback. */
+        fprintf(stderr, "INFO: voice name '%s'\n", CPRCEN_channel_get_voice_info(eng, hc, "VOICE_NAME"));
+        freqstr = CPRCEN_channel_get_voice_info(eng, hc, "SAMPLE_RATE");
+        fprintf(stderr, "INFO: voice sample rate is '%s'\n", freqstr);
+        freq = atoi(freqstr);
+    }
     data.sample_rate = freq;
 
     /* Set file output or audio playback depending on the command line
      options. */
     if (file_out) {
       data.player = NULL;
-      CPRCEN_engine_channel_to_file(eng, hc, file_out, CPRCEN_RIFF);
+      data.wav = tts_wav_open(file_out, freq, 0);
+      if (!data.wav)
+          exit(-1);
     } else {
         data.player = CPRC_sc_player_new(freq);
-#ifdef WIN32
-        thread1 = CreateThread(NULL,NULL, print_messages, (void*) &data, 0, NULL);
-#else
-        iret1 = pthread_create( &thread1, NULL, print_messages, (void *)&data);
-        (void) iret1; /* stops some compilers giving warnings */
-#endif
-        /* data.cur_buf = NULL;
-           data.prev_buf = NULL; */
+        tts_audio_pool_init(&data.audio, data.player);
+        data.sched = tts_sched_new(playback_time, &data);
+        if (!data.sched)
+            exit(-1);
+        tts_sched_subscribe(data.sched, (1u << TTS_TIMELINE_PHONE) | (1u << TTS_TIMELINE_WORD) | (1u << TTS_TIMELINE_MARK),
+                            print_event, &data);
+        if (!tts_thread_start(&thread1, print_messages, &data)) {
+            fprintf(stderr, "ERROR: unable to start the printing thread\n");
+            exit(-1);
+        }
+    }
+    if (timeline_file) {
+        data.timeline = tts_timeline_writer_open(timeline_file, freq);
+        if (!data.timeline)
+            exit(-1);
+    }
+    if (stats_file) {
+        tts_bench_init(&bench, "tts_sync", freq);
+        data.bench = &bench;
+    }
+    if (!parallel) {
+        res = CPRCEN_engine_set_callback(eng, hc, &data, channel_callback);
+        if (res) fprintf(stderr, "INFO: callback initialised\n");
     }
-    res = CPRCEN_engine_set_callback(eng, hc, &data, channel_callback);
-    if (res) fprintf(stderr, "INFO: callback initialised\n");
 
     /* Load the text to generate */
     if (text_file == NULL) {
         text_fp = stdin;
     } else {
         text_fp = fopen(text_file, "rb");
-        if (!text_file) {
+        if (!text_fp) {
             fprintf(stderr, "ERROR: unable to open text file '%s', exiting.\n", text_file);
             exit(-1);
         }
     }
 
+    if (parallel) {
+        text = read_input(text_fp, &textlen);
+        if (data.bench) tts_bench_speak(data.bench);
+        if (tts_split_speak(pool, text, (int) textlen, split_output, &data) < 0) {
+            fprintf(stderr, "ERROR: unable to synthesise the input, exiting.\n");
+            exit(-1);
+        }
+        if (data.bench) tts_bench_done(data.bench);
+        free(text);
+    }
+
     /* Synthesise input line-by-line */
-    while (!feof(text_fp)) {
+    while (!parallel && !feof(text_fp)) {
       ret = fgets(text_buffer, MAX_READ, text_fp);
       if (!ret)
           break;
@@ -318,16 +407,36 @@ int main(int argc, char * argv[]){
       /* Synthesise the text buffer - the final argument is 'flush'.
         Do not flush the buffer until all the input is sent.
       */
+      if (data.bench) tts_bench_speak(data.bench);
       CPRCEN_engine_channel_speak(eng, hc, text_buffer, strlen(text_buffer), 0);
     }
     /* Finished processing, flush the buffer with empty input */
-    CPRCEN_engine_channel_speak(eng, hc, "", 0, 1);
+    if (!parallel) {
+        if (data.bench) tts_bench_speak(data.bench);
+        CPRCEN_engine_channel_speak(eng, hc, "", 0, 1);
+        if (data.bench) tts_bench_done(data.bench);
+    }
+
+    /* All spurts have been returned, the outputs are complete */
+    if (data.wav && tts_wav_close(data.wav) != 0) {
+        fprintf(stderr, "ERROR: unable to write audio file '%s'\n", file_out);
+    }
+    if (data.timeline && tts_timeline_writer_close(data.timeline) != 0) {
+        fprintf(stderr, "ERROR: unable to write timeline file '%s'\n", timeline_file);
+    }
 
     /* If we're playing audio, wait for completion before quitting */
     if (data.player) {
+        tts_audio_pool_drain(&data.audio);
         while (CPRC_sc_audio_busy(data.player)) {
             CPRC_sc_sleep_msecs(50);
         }
+        /* The clock stops with the player: let the events still due
+           through without it before stopping the scheduler */
+        tts_atomic_store(&data.done, 1);
+        tts_sched_flush(data.sched);
+        tts_thread_join(thread1);
+        tts_sched_delete(data.sched);
         fprintf(stderr, "Played %ld samples, total duration: %8.15g\n", CPRC_sc_player_samples_sent(data.player), CPRC_sc_player_stream_duration(data.player));
         /* Clean up the audio player */
         CPRC_sc_player_delete(data.player);
@@ -335,8 +444,14 @@ int main(int argc, char * argv[]){
 
     /* Clean up. The engine deletion function cleans up all loaded
        voices and open channels */
-    CPRCEN_engine_delete(eng);
+    if (parallel)
+        tts_pool_delete(pool);
+    else
+        CPRCEN_engine_delete(eng);
     fclose(text_fp);
+    if (data.bench && tts_bench_write_json(data.bench, stats_file) != 0) {
+        return -1;
+    }
 
     return 0;
 }
@@ -0,0 +1,198 @@
+/* Minimal threading helpers shared by the TTS drivers.
+
+   The sample programs already switch between pthreads and the Win32
+   API (see tts_sync.c); the long-running modes need mutexes and
+   condition variables as well, so the switch is kept in one place.
+*/
+
+#ifndef TTS_THREAD_H
+#define TTS_THREAD_H
+
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#else
+#include <windows.h>
+#endif
+
+#ifndef WIN32
+typedef pthread_t tts_thread;
+typedef pthread_mutex_t tts_mutex;
+typedef pthread_cond_t tts_cond;
+typedef void * tts_thread_ret;
+#define TTS_THREAD_CALL
+#else
+typedef HANDLE tts_thread;
+typedef CRITICAL_SECTION tts_mutex;
+typedef CONDITION_VARIABLE tts_cond;
+typedef DWORD tts_thread_ret;
+#define TTS_THREAD_CALL WINAPI
+#endif
+
+typedef tts_thread_ret (TTS_THREAD_CALL * tts_thread_func)(void * userdata);
+
+static inline int tts_thread_start(tts_thread * t, tts_thread_func func, void * userdata) {
+#ifndef WIN32
+    return pthread_create(t, NULL, func, userdata) == 0;
+#else
+    *t = CreateThread(NULL, 0, func, userdata, 0, NULL);
+    return *t != NULL;
+#endif
+}
+
+static inline void tts_thread_join(tts_thread t) {
+#ifndef WIN32
+    pthread_join(t, NULL);
+#else
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+#endif
+}
+
+static inline void tts_thread_detach(tts_thread t) {
+#ifndef WIN32
+    pthread_detach(t);
+#else
+    CloseHandle(t);
+#endif
+}
+
+static inline void tts_mutex_init(tts_mutex * m) {
+#ifndef WIN32
+    pthread_mutex_init(m, NULL);
+#else
+    InitializeCriticalSection(m);
+#endif
+}
+
+static inline void tts_mutex_destroy(tts_mutex * m) {
+#ifndef WIN32
+    pthread_mutex_destroy(m);
+#else
+    DeleteCriticalSection(m);
+#endif
+}
+
+static inline void tts_mutex_lock(tts_mutex * m) {
+#ifndef WIN32
+    pthread_mutex_lock(m);
+#else
+    EnterCriticalSection(m);
+#endif
+}
+
+static inline void tts_mutex_unlock(tts_mutex * m) {
+#ifndef WIN32
+    pthread_mutex_unlock(m);
+#else
+    LeaveCriticalSection(m);
+#endif
+}
+
+static inline void tts_cond_init(tts_cond * c) {
+#ifndef WIN32
+    pthread_cond_init(c, NULL);
+#else
+    InitializeConditionVariable(c);
+#endif
+}
+
+static inline void tts_cond_destroy(tts_cond * c) {
+#ifndef WIN32
+    pthread_cond_destroy(c);
+#else
+    (void) c;
+#endif
+}
+
+static inline void tts_cond_wait(tts_cond * c, tts_mutex * m) {
+#ifndef WIN32
+    pthread_cond_wait(c, m);
+#else
+    SleepConditionVariableCS(c, m, INFINITE);
+#endif
+}
+
+/* Waits at most msecs milliseconds.  Returns 0 on timeout. */
+static inline int tts_cond_timedwait(tts_cond * c, tts_mutex * m, long msecs) {
+#ifndef WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += msecs / 1000;
+    ts.tv_nsec += (msecs % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(c, m, &ts) == 0;
+#else
+    return SleepConditionVariableCS(c, m, (DWORD) msecs) != 0;
+#endif
+}
+
+static inline void tts_cond_signal(tts_cond * c) {
+#ifndef WIN32
+    pthread_cond_signal(c);
+#else
+    WakeConditionVariable(c);
+#endif
+}
+
+static inline void tts_cond_broadcast(tts_cond * c) {
+#ifndef WIN32
+    pthread_cond_broadcast(c);
+#else
+    WakeAllConditionVariable(c);
+#endif
+}
+
+/* Index shared by a single producer and a single consumer: the
+   producer publishes with a release store, the consumer reads with an
+   acquire load, so no lock is needed around ring buffer slots. */
+static inline unsigned int tts_atomic_load(const volatile unsigned int * p) {
+#if defined(__GNUC__)
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+    unsigned int v = *p;
+    MemoryBarrier();
+    return v;
+#endif
+}
+
+static inline void tts_atomic_store(volatile unsigned int * p, unsigned int v) {
+#if defined(__GNUC__)
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#else
+    MemoryBarrier();
+    *p = v;
+#endif
+}
+
+/* Monotonic clock in seconds, for latency measurements. */
+static inline double tts_clock_seconds(void) {
+#ifndef WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return now.QuadPart / (double) freq.QuadPart;
+#endif
+}
+
+/* Number of online processors, used as the default worker count. */
+static inline int tts_cpu_count(void) {
+#ifndef WIN32
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+#else
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int) si.dwNumberOfProcessors : 1;
+#endif
+}
+
+#endif /* TTS_THREAD_H */
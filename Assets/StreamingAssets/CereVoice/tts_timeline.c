@@ -0,0 +1,304 @@
+/* Binary phone/word/marker timeline.
+   See tts_timeline.h for the file layout. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "tts_timeline.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <windows.h>
+#endif
+
+struct tts_timeline_writer {
+    FILE * fp;
+    tts_timeline_header header;
+    tts_symtab symbols;
+    uint32_t samples; /* audio written so far, offset of the next spurt */
+    tts_timeline_frame * frames;
+    uint32_t frames_cap;
+};
+
+/* ---- symbol table ---- */
+
+static uint32_t symtab_hash(const char * s) {
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void tts_symtab_init(tts_symtab * tab) {
+    memset(tab, 0, sizeof(tts_symtab));
+}
+
+void tts_symtab_free(tts_symtab * tab) {
+    free(tab->strings);
+    free(tab->offsets);
+    free(tab->slots);
+    memset(tab, 0, sizeof(tts_symtab));
+}
+
+static void symtab_rehash(tts_symtab * tab, uint32_t nslots) {
+    uint32_t i, slot;
+    free(tab->slots);
+    tab->slots = calloc(nslots, sizeof(uint32_t));
+    tab->nslots = nslots;
+    for (i = 0; i < tab->count; i++) {
+        slot = symtab_hash(tab->strings + tab->offsets[i]) & (nslots - 1);
+        while (tab->slots[slot]) slot = (slot + 1) & (nslots - 1);
+        tab->slots[slot] = i + 1;
+    }
+}
+
+uint32_t tts_symtab_intern(tts_symtab * tab, const char * name) {
+    uint32_t slot, id, len;
+
+    if (tab->nslots == 0) symtab_rehash(tab, 64);
+    slot = symtab_hash(name) & (tab->nslots - 1);
+    while ((id = tab->slots[slot]) != 0) {
+        if (strcmp(tab->strings + tab->offsets[id - 1], name) == 0) return id - 1;
+        slot = (slot + 1) & (tab->nslots - 1);
+    }
+
+    /* New symbol */
+    len = (uint32_t) strlen(name) + 1;
+    if (tab->strings_size + len > tab->strings_cap) {
+        while (tab->strings_size + len > tab->strings_cap)
+            tab->strings_cap = tab->strings_cap ? tab->strings_cap * 2 : 1024;
+        tab->strings = realloc(tab->strings, tab->strings_cap);
+    }
+    if (tab->count == tab->cap) {
+        tab->cap = tab->cap ? tab->cap * 2 : 64;
+        tab->offsets = realloc(tab->offsets, tab->cap * sizeof(uint32_t));
+    }
+    memcpy(tab->strings + tab->strings_size, name, len);
+    tab->offsets[tab->count] = tab->strings_size;
+    tab->strings_size += len;
+    tab->slots[slot] = ++tab->count;
+
+    /* Keep the load factor under one half */
+    if (tab->count * 2 > tab->nslots) symtab_rehash(tab, tab->nslots * 2);
+    return tab->count - 1;
+}
+
+const char * tts_symtab_name(const tts_symtab * tab, uint32_t id) {
+    return id < tab->count ? tab->strings + tab->offsets[id] : NULL;
+}
+
+/* ---- writer ---- */
+
+tts_timeline_writer * tts_timeline_writer_open(const char * path, int sample_rate) {
+    tts_timeline_writer * w;
+    FILE * fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "ERROR: unable to open timeline file '%s'\n", path);
+        return NULL;
+    }
+    w = calloc(1, sizeof(tts_timeline_writer));
+    w->fp = fp;
+    w->header.version = TTS_TIMELINE_VERSION;
+    w->header.record_size = sizeof(tts_timeline_record);
+    w->header.sample_rate = (uint32_t) sample_rate;
+    tts_symtab_init(&w->symbols);
+    /* Placeholder header, magic left empty until the file is complete */
+    fwrite(&w->header, sizeof(tts_timeline_header), 1, fp);
+    return w;
+}
+
+void tts_timeline_writer_add(tts_timeline_writer * w, int type, uint32_t start, uint32_t end, const char * name) {
+    tts_timeline_record rec;
+    uint32_t symbol = tts_symtab_intern(&w->symbols, name);
+    if (symbol > 0xffff) {
+        fprintf(stderr, "WARNING: timeline symbol table full, dropping '%s'\n", name);
+        return;
+    }
+    rec.type = (uint8_t) type;
+    rec.flags = 0;
+    rec.symbol = (uint16_t) symbol;
+    rec.start = start;
+    rec.end = end < start ? start : end;
+    fwrite(&rec, sizeof(rec), 1, w->fp);
+    w->header.n_records++;
+}
+
+#ifndef TTS_TIMELINE_NO_ENGINE
+void tts_timeline_writer_add_abuf(tts_timeline_writer * w, CPRC_abuf * abuf) {
+    const CPRC_abuf_trans * trans;
+    double srate = w->header.sample_rate;
+    int64_t base, start, end;
+    int i, type, wav_mk, wav_done;
+
+    wav_mk = CPRC_abuf_wav_mk(abuf);
+    wav_done = CPRC_abuf_wav_done(abuf);
+    if (wav_mk < 0) wav_mk = 0;
+    if (wav_done < 0) wav_done = 0;
+    /* Transcription times are relative to the start of the buffer */
+    base = (int64_t) w->samples - wav_mk;
+
+    for (i = 0; i < CPRC_abuf_trans_sz(abuf); i++) {
+        trans = CPRC_abuf_get_trans(abuf, i);
+        switch (CPRC_abuf_trans_type(trans)) {
+        case CPRC_ABUF_TRANS_PHONE: type = TTS_TIMELINE_PHONE; break;
+        case CPRC_ABUF_TRANS_WORD: type = TTS_TIMELINE_WORD; break;
+        case CPRC_ABUF_TRANS_MARK: type = TTS_TIMELINE_MARK; break;
+        default:
+            fprintf(stderr, "ERROR: could not retrieve transcription at '%d'\n", i);
+            continue;
+        }
+        start = base + (int64_t) (CPRC_abuf_trans_start(trans) * srate + 0.5);
+        end = base + (int64_t) (CPRC_abuf_trans_end(trans) * srate + 0.5);
+        if (start < 0) start = 0;
+        if (end < 0) end = 0;
+        tts_timeline_writer_add(w, type, (uint32_t) start, (uint32_t) end, CPRC_abuf_trans_name(trans));
+    }
+    if (wav_done > wav_mk) w->samples += (uint32_t) (wav_done - wav_mk);
+}
+#endif
+
+void tts_timeline_writer_add_frames(tts_timeline_writer * w, const tts_timeline_frame * frames, int n) {
+    if (n <= 0) return;
+    if (w->header.n_frames + (uint32_t) n > w->frames_cap) {
+        while (w->header.n_frames + (uint32_t) n > w->frames_cap)
+            w->frames_cap = w->frames_cap ? w->frames_cap * 2 : 1024;
+        w->frames = realloc(w->frames, w->frames_cap * sizeof(tts_timeline_frame));
+    }
+    memcpy(w->frames + w->header.n_frames, frames, n * sizeof(tts_timeline_frame));
+    w->header.n_frames += (uint32_t) n;
+}
+
+void tts_timeline_writer_add_samples(tts_timeline_writer * w, uint32_t n) {
+    w->samples += n;
+}
+
+uint32_t tts_timeline_writer_samples(const tts_timeline_writer * w) {
+    return w->samples;
+}
+
+int tts_timeline_writer_close(tts_timeline_writer * w) {
+    static const char zeros[4] = { 0, 0, 0, 0 };
+    size_t end;
+    int res = 0;
+    if (!w) return -1;
+    w->header.n_symbols = w->symbols.count;
+    w->header.strings_size = w->symbols.strings_size;
+    w->header.total_samples = w->samples;
+    if (w->symbols.count) {
+        fwrite(w->symbols.offsets, sizeof(uint32_t), w->symbols.count, w->fp);
+        fwrite(w->symbols.strings, 1, w->symbols.strings_size, w->fp);
+    }
+    if (w->header.n_frames) {
+        end = sizeof(tts_timeline_header) + (size_t) w->header.n_records * sizeof(tts_timeline_record)
+            + (size_t) w->symbols.count * sizeof(uint32_t) + w->symbols.strings_size;
+        fwrite(zeros, 1, tts_timeline_frames_offset(&w->header) - end, w->fp);
+        fwrite(w->frames, sizeof(tts_timeline_frame), w->header.n_frames, w->fp);
+    }
+    /* Only now is the file valid */
+    memcpy(w->header.magic, TTS_TIMELINE_MAGIC, 4);
+    if (fseek(w->fp, 0, SEEK_SET) != 0 ||
+        fwrite(&w->header, sizeof(tts_timeline_header), 1, w->fp) != 1) res = -1;
+    if (fclose(w->fp) != 0) res = -1;
+    tts_symtab_free(&w->symbols);
+    free(w->frames);
+    free(w);
+    return res;
+}
+
+/* ---- reader ---- */
+
+static int timeline_validate(tts_timeline * tl) {
+    const tts_timeline_header * h;
+    size_t need;
+    uint32_t i;
+
+    if (tl->size < sizeof(tts_timeline_header)) return -1;
+    h = (const tts_timeline_header *) tl->base;
+    if (memcmp(h->magic, TTS_TIMELINE_MAGIC, 4) != 0 || h->version != TTS_TIMELINE_VERSION ||
+        h->record_size != sizeof(tts_timeline_record) || h->sample_rate == 0) return -1;
+    need = sizeof(tts_timeline_header) + (size_t) h->n_records * sizeof(tts_timeline_record)
+        + (size_t) h->n_symbols * sizeof(uint32_t) + h->strings_size;
+    if (need > tl->size) return -1;
+    if (h->n_frames && tts_timeline_frames_offset(h) + (size_t) h->n_frames * sizeof(tts_timeline_frame) > tl->size)
+        return -1;
+
+    tl->header = h;
+    tl->records = (const tts_timeline_record *) (h + 1);
+    tl->symbol_offsets = (const uint32_t *) (tl->records + h->n_records);
+    tl->strings = (const char *) (tl->symbol_offsets + h->n_symbols);
+    tl->frames = h->n_frames ? (const tts_timeline_frame *) ((const char *) tl->base + tts_timeline_frames_offset(h)) : NULL;
+    for (i = 0; i < h->n_symbols; i++) {
+        if (tl->symbol_offsets[i] >= h->strings_size) return -1;
+    }
+    if (h->strings_size && tl->strings[h->strings_size - 1] != '\0') return -1;
+    for (i = 0; i < h->n_records; i++) {
+        if (tl->records[i].symbol >= h->n_symbols) return -1;
+    }
+    return 0;
+}
+
+int tts_timeline_map(tts_timeline * tl, const char * path) {
+#ifndef WIN32
+    struct stat st;
+    int fd;
+#else
+    HANDLE file, mapping;
+    LARGE_INTEGER sz;
+#endif
+    memset(tl, 0, sizeof(tts_timeline));
+
+#ifndef WIN32
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    tl->size = (size_t) st.st_size;
+    tl->base = mmap(NULL, tl->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (tl->base == MAP_FAILED) {
+        tl->base = NULL;
+        return -1;
+    }
+#else
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE) return -1;
+    if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+        CloseHandle(file);
+        return -1;
+    }
+    tl->size = (size_t) sz.QuadPart;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return -1;
+    tl->base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!tl->base) return -1;
+#endif
+
+    if (timeline_validate(tl) < 0) {
+        fprintf(stderr, "ERROR: '%s' is not a valid timeline file\n", path);
+        tts_timeline_unmap(tl);
+        return -1;
+    }
+    return 0;
+}
+
+void tts_timeline_unmap(tts_timeline * tl) {
+    if (tl->base) {
+#ifndef WIN32
+        munmap(tl->base, tl->size);
+#else
+        UnmapViewOfFile(tl->base);
+#endif
+    }
+    memset(tl, 0, sizeof(tts_timeline));
+}
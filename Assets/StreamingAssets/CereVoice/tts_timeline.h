@@ -0,0 +1,154 @@
+/* Binary phone/word/marker timeline.
+
+   A timeline file holds the transcription of one utterance as
+   fixed-size records, so that consumers can map the file and index it
+   directly instead of parsing "INFO: phoneme: ..." text.  Times are
+   absolute sample positions from the start of the utterance, so spurt
+   offsets are already applied and nothing is rounded.  Names are
+   interned: each record refers to an entry of the symbol table.
+
+   Layout, all integers little-endian:
+
+     tts_timeline_header                     32 bytes
+     tts_timeline_record[n_records]          12 bytes each, in order
+     uint32 symbol_offsets[n_symbols]        offsets into the strings
+     char strings[strings_size]              NUL-terminated names
+     tts_timeline_frame[n_frames]            12 bytes each, from a 4-byte
+                                             boundary
+
+   The frames are the F0 and loudness envelope of the audio, when the
+   synthesis was post-processed with one (tts_post.h).  Files without
+   frames have n_frames 0, and readers that do not know about them
+   still find everything else where it was.
+
+   The header is written last, so a file whose magic is not set was not
+   closed properly and is rejected by the reader.
+
+   Tools that only read timelines can build this module without the
+   CereVoice SDK by defining TTS_TIMELINE_NO_ENGINE.
+*/
+
+#ifndef TTS_TIMELINE_H
+#define TTS_TIMELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#ifndef TTS_TIMELINE_NO_ENGINE
+#include <cerevoice_eng.h>
+#endif
+
+/* Functions of the shared library used from Unity (see tts_cache.h) */
+#ifdef _WIN32
+#define TTS_EXPORT __declspec(dllexport)
+#else
+#define TTS_EXPORT __attribute__((visibility("default")))
+#endif
+
+#define TTS_TIMELINE_MAGIC "CPTL"
+#define TTS_TIMELINE_VERSION 1
+
+enum tts_timeline_type {
+    TTS_TIMELINE_PHONE = 0,
+    TTS_TIMELINE_WORD = 1,
+    TTS_TIMELINE_MARK = 2
+};
+
+typedef struct tts_timeline_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t sample_rate;
+    uint32_t n_records;
+    uint32_t n_symbols;
+    uint32_t strings_size;
+    uint32_t total_samples;
+    uint32_t n_frames;
+} tts_timeline_header;
+
+typedef struct tts_timeline_record {
+    uint8_t type;     /* tts_timeline_type */
+    uint8_t flags;    /* reserved, 0 */
+    uint16_t symbol;  /* index into the symbol table */
+    uint32_t start;   /* first sample */
+    uint32_t end;     /* one past the last sample */
+} tts_timeline_record;
+
+/* One frame of the envelope, as the prosodyAcf tracker of
+   lipsync_pitch.h computes it */
+typedef struct tts_timeline_frame {
+    uint32_t start;   /* first sample of the frame */
+    float f0;         /* Hz, 0 when unvoiced */
+    float loudness;
+} tts_timeline_frame;
+
+/* Interned name table shared by the writer and other modules that need
+   stable small integer IDs for phone and word names. */
+typedef struct tts_symtab {
+    char * strings;
+    uint32_t strings_size;
+    uint32_t strings_cap;
+    uint32_t * offsets;
+    uint32_t count;
+    uint32_t cap;
+    uint32_t * slots;   /* open addressing hash, symbol id + 1 */
+    uint32_t nslots;
+} tts_symtab;
+
+void tts_symtab_init(tts_symtab * tab);
+void tts_symtab_free(tts_symtab * tab);
+/* Returns the id of name, adding it if needed */
+uint32_t tts_symtab_intern(tts_symtab * tab, const char * name);
+const char * tts_symtab_name(const tts_symtab * tab, uint32_t id);
+
+/* Streaming writer.  Records are written as they arrive, the symbol
+   table and header when the writer is closed. */
+typedef struct tts_timeline_writer tts_timeline_writer;
+
+tts_timeline_writer * tts_timeline_writer_open(const char * path, int sample_rate);
+void tts_timeline_writer_add(tts_timeline_writer * w, int type, uint32_t start, uint32_t end, const char * name);
+#ifndef TTS_TIMELINE_NO_ENGINE
+/* Adds the transcription of a spurt returned by the engine, offset by
+   the audio written so far, then advances the offset by the spurt's
+   audio (wav_mk to wav_done, as cued by the drivers). */
+void tts_timeline_writer_add_abuf(tts_timeline_writer * w, CPRC_abuf * abuf);
+#endif
+/* Appends envelope frames, in time order, kept in memory until the
+   writer is closed */
+void tts_timeline_writer_add_frames(tts_timeline_writer * w, const tts_timeline_frame * frames, int n);
+/* Advances the audio length for writers fed with tts_timeline_writer_add */
+void tts_timeline_writer_add_samples(tts_timeline_writer * w, uint32_t n);
+uint32_t tts_timeline_writer_samples(const tts_timeline_writer * w);
+/* Returns 0 on success */
+int tts_timeline_writer_close(tts_timeline_writer * w);
+
+/* Read-only view of a timeline file, mapped into memory. */
+typedef struct tts_timeline {
+    const tts_timeline_header * header;
+    const tts_timeline_record * records;
+    const uint32_t * symbol_offsets;
+    const char * strings;
+    const tts_timeline_frame * frames;
+    void * base;
+    size_t size;
+} tts_timeline;
+
+/* Returns 0 on success, -1 if the file is missing or not valid */
+int tts_timeline_map(tts_timeline * tl, const char * path);
+void tts_timeline_unmap(tts_timeline * tl);
+
+static inline const char * tts_timeline_symbol(const tts_timeline * tl, uint16_t symbol) {
+    return tl->strings + tl->symbol_offsets[symbol];
+}
+
+/* Offset of the frames in a file */
+static inline size_t tts_timeline_frames_offset(const tts_timeline_header * h) {
+    size_t offset = sizeof(tts_timeline_header) + (size_t) h->n_records * sizeof(tts_timeline_record)
+        + (size_t) h->n_symbols * sizeof(uint32_t) + h->strings_size;
+    return (offset + 3) & ~(size_t) 3;
+}
+
+static inline double tts_timeline_seconds(const tts_timeline * tl, uint32_t sample) {
+    return sample / (double) tl->header->sample_rate;
+}
+
+#endif /* TTS_TIMELINE_H */
@@ -0,0 +1,204 @@
+/* Streaming WAV output.
+   See tts_wav.h. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "tts_wav.h"
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+#define RESERVE_SECONDS 10
+
+struct tts_wav_writer {
+#ifndef WIN32
+    int fd;
+#else
+    HANDLE file;
+#endif
+    int sample_rate;
+    uint32_t samples;
+    int64_t reserved;   /* bytes of the file allocated so far */
+    int64_t chunk;
+    int failed;
+};
+
+static void put_u16(unsigned char * p, unsigned int v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32(unsigned char * p, unsigned long v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+void tts_wav_header(unsigned char * h, int sample_rate, uint32_t samples) {
+    memcpy(h, "RIFF", 4);
+    put_u32(h + 4, 36 + samples * 2);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_u32(h + 16, 16);
+    put_u16(h + 20, 1);
+    put_u16(h + 22, 1);
+    put_u32(h + 24, sample_rate);
+    put_u32(h + 28, sample_rate * 2);
+    put_u16(h + 32, 2);
+    put_u16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    put_u32(h + 40, samples * 2);
+}
+
+#ifndef WIN32
+
+static int write_all(int fd, const void * data, size_t len) {
+    const char * p = (const char *) data;
+    ssize_t n;
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+/* Allocates the file up to size bytes without moving the write
+   position.  Only a hint, failures are ignored. */
+static void reserve(tts_wav_writer * w, int64_t size) {
+#ifdef __linux__
+    if (posix_fallocate(w->fd, 0, (off_t) size) != 0) return;
+#endif
+    w->reserved = size;
+}
+
+#else /* WIN32 */
+
+static int write_all(HANDLE file, const void * data, size_t len) {
+    DWORD n;
+    if (!WriteFile(file, data, (DWORD) len, &n, NULL) || n != len) return -1;
+    return 0;
+}
+
+static void reserve(tts_wav_writer * w, int64_t size) {
+    LARGE_INTEGER pos, zero, end;
+    zero.QuadPart = 0;
+    end.QuadPart = size;
+    if (!SetFilePointerEx(w->file, zero, &pos, FILE_CURRENT)) return;
+    if (SetFilePointerEx(w->file, end, NULL, FILE_BEGIN) && SetEndOfFile(w->file))
+        w->reserved = size;
+    SetFilePointerEx(w->file, pos, NULL, FILE_BEGIN);
+}
+
+#endif
+
+TTS_EXPORT tts_wav_writer * tts_wav_open(const char * path, int sample_rate, uint32_t expected_samples) {
+    tts_wav_writer * w;
+    unsigned char h[TTS_WAV_HEADER_SIZE];
+    int64_t first;
+
+    w = calloc(1, sizeof(tts_wav_writer));
+#ifndef WIN32
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (w->fd < 0) {
+#else
+    w->file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (w->file == INVALID_HANDLE_VALUE) {
+#endif
+        fprintf(stderr, "ERROR: unable to open audio file '%s'\n", path);
+        free(w);
+        return NULL;
+    }
+    w->sample_rate = sample_rate;
+    w->chunk = (int64_t) sample_rate * 2 * RESERVE_SECONDS;
+
+    first = TTS_WAV_HEADER_SIZE + (int64_t) expected_samples * 2;
+    reserve(w, first > w->chunk ? first : w->chunk);
+
+    /* sizes are patched on close */
+    tts_wav_header(h, sample_rate, 0);
+#ifndef WIN32
+    if (write_all(w->fd, h, sizeof(h)) < 0) w->failed = 1;
+#else
+    if (write_all(w->file, h, sizeof(h)) < 0) w->failed = 1;
+#endif
+    return w;
+}
+
+TTS_EXPORT int tts_wav_write(tts_wav_writer * w, const short * samples, int n) {
+    int64_t end;
+
+    if (w->failed) return -1;
+    if (n <= 0) return 0;
+
+    /* grow the reservation geometrically, so long narration takes few
+       allocations */
+    end = TTS_WAV_HEADER_SIZE + ((int64_t) w->samples + n) * 2;
+    if (end > w->reserved)
+        reserve(w, end + (w->reserved / 2 > w->chunk ? w->reserved / 2 : w->chunk));
+
+#ifndef WIN32
+    if (write_all(w->fd, samples, (size_t) n * sizeof(short)) < 0) {
+#else
+    if (write_all(w->file, samples, (size_t) n * sizeof(short)) < 0) {
+#endif
+        w->failed = 1;
+        return -1;
+    }
+    w->samples += (uint32_t) n;
+    return 0;
+}
+
+#ifndef TTS_TIMELINE_NO_ENGINE
+int tts_wav_write_abuf(tts_wav_writer * w, CPRC_abuf * abuf) {
+    int wav_mk, wav_done;
+
+    /* Used for processing when a min/max phone range has been set */
+    wav_mk = CPRC_abuf_wav_mk(abuf);
+    wav_done = CPRC_abuf_wav_done(abuf);
+    if (wav_mk < 0) wav_mk = 0;
+    if (wav_done < 0) wav_done = 0;
+    if (wav_done <= wav_mk) return w->failed ? -1 : 0;
+    return tts_wav_write(w, CPRC_abuf_wav_data(abuf) + wav_mk, wav_done - wav_mk);
+}
+#endif
+
+TTS_EXPORT uint32_t tts_wav_samples(const tts_wav_writer * w) {
+    return w->samples;
+}
+
+TTS_EXPORT int tts_wav_close(tts_wav_writer * w) {
+    unsigned char h[TTS_WAV_HEADER_SIZE];
+    int64_t size = TTS_WAV_HEADER_SIZE + (int64_t) w->samples * 2;
+    int res = w->failed ? -1 : 0;
+
+    tts_wav_header(h, w->sample_rate, w->samples);
+#ifndef WIN32
+    /* drop the unused reservation, then fill in the sizes */
+    if (ftruncate(w->fd, (off_t) size) != 0) res = -1;
+    if (pwrite(w->fd, h, sizeof(h), 0) != (ssize_t) sizeof(h)) res = -1;
+    if (close(w->fd) != 0) res = -1;
+#else
+    {
+        LARGE_INTEGER pos;
+        pos.QuadPart = size;
+        if (!SetFilePointerEx(w->file, pos, NULL, FILE_BEGIN) || !SetEndOfFile(w->file)) res = -1;
+        pos.QuadPart = 0;
+        if (!SetFilePointerEx(w->file, pos, NULL, FILE_BEGIN) || write_all(w->file, h, sizeof(h)) < 0) res = -1;
+        if (!CloseHandle(w->file)) res = -1;
+    }
+#endif
+    free(w);
+    return res;
+}
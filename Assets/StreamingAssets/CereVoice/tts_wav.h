@@ -0,0 +1,52 @@
+/* Streaming WAV output for the drivers' callback path.
+
+   CPRC_riff_append reopens the output and rewrites the RIFF header for
+   every spurt, so each callback pays an open, a seek and a close, and
+   long narration slows down as the file grows.  A tts_wav writer keeps
+   one file open for the whole utterance instead: the spurt's samples go
+   from the engine buffer to the file in a single write, with no copy in
+   between, and the header sizes are patched once when the writer is
+   closed.
+
+   Disk space is reserved ahead of the writes in chunks of a few seconds
+   of audio, so the file does not fragment as it grows; the reservation
+   is trimmed to the audio written on close.
+
+   Output is 16 bit mono PCM with the canonical 44 byte header.  Until
+   the writer is closed the header sizes are 0, which players treat as
+   a stream of unknown length.
+
+   Unity writes audio through this module as well (see WavSink.cs), from
+   the shared library described in tts_cache.h.
+*/
+
+#ifndef TTS_WAV_H
+#define TTS_WAV_H
+
+#include <stdint.h>
+#include "tts_timeline.h"
+
+#define TTS_WAV_HEADER_SIZE 44
+
+/* Fills the 44 byte header of samples 16 bit mono samples */
+void tts_wav_header(unsigned char * h, int sample_rate, uint32_t samples);
+
+typedef struct tts_wav_writer tts_wav_writer;
+
+/* Creates or truncates path.  expected_samples, if known, sizes the
+   first reservation.  Returns NULL if the file cannot be created. */
+TTS_EXPORT tts_wav_writer * tts_wav_open(const char * path, int sample_rate, uint32_t expected_samples);
+/* Appends n samples.  Returns 0 on success; after a failure the writer
+   ignores further audio and close reports the error. */
+TTS_EXPORT int tts_wav_write(tts_wav_writer * w, const short * samples, int n);
+#ifndef TTS_TIMELINE_NO_ENGINE
+/* Appends the audio of a spurt, wav_mk to wav_done as cued by the
+   drivers */
+int tts_wav_write_abuf(tts_wav_writer * w, CPRC_abuf * abuf);
+#endif
+TTS_EXPORT uint32_t tts_wav_samples(const tts_wav_writer * w);
+/* Patches the header and closes the file.  Returns 0 if all the audio
+   was written.  The writer is freed either way. */
+TTS_EXPORT int tts_wav_close(tts_wav_writer * w);
+
+#endif /* TTS_WAV_H */
@@ -0,0 +1,110 @@
+/* clip_aligner - aligns a recording to the synthesized reference of its
+   transcript and writes the phone and word intervals as a TextGrid.
+
+   The reference comes from the CereVoice drivers:
+     tts_callback -o reference.wav -t reference.tl voice license clip.txt
+   see lipsync_align.h for the method.  The output has the tiers of a
+   MAUS result, so it can be dropped next to the clip in place of the
+   TextGrid downloaded from the WebMAUS service.
+
+   Build:
+     gcc -O2 -msse2 -DTTS_TIMELINE_NO_ENGINE -I../CereVoice -o clip_aligner \
+         clip_aligner.c lipsync_align.c lipsync_mfcc.c lipsync_audio.c \
+         lipsync_rig.c lipsync_phoneme.c ../CereVoice/tts_timeline.c -lm
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lipsync_align.h"
+
+void usage(char * name) {
+    fprintf(stderr, "clip_aligner - aligns a recording to synthesized speech of the same text.\n\n");
+    fprintf(stderr, "Usage: %s [-h] [-b band] [-m min_band_s]\n", name);
+    fprintf(stderr, "       reference_wav reference_timeline recording_wav output_textgrid\n");
+    fprintf(stderr, " -b band\t  Warping band half width as a fraction of the clip, default 0.25\n");
+    fprintf(stderr, " -m min_band_s\t  Lower bound of the band half width in seconds, default 0.5\n");
+    exit(0);
+}
+
+static double seconds(void) {
+    return clock() / (double) CLOCKS_PER_SEC;
+}
+
+int main(int argc, char * argv[]) {
+    const char * paths[4];
+    int npaths = 0, i;
+    ls_align_config cfg;
+    ls_audio ref_audio, rec_audio;
+    ls_features ref, rec;
+    tts_timeline tl;
+    ls_alignment al;
+    ls_warp w;
+    double started, featured, aligned;
+    float duration;
+
+    ls_align_config_default(&cfg);
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) {
+            usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-b") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            cfg.band = (float) atof(argv[i]);
+        }
+        else if (strcmp(argv[i], "-m") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            cfg.min_band = (float) atof(argv[i]);
+        }
+        else if (npaths < 4) {
+            paths[npaths++] = argv[i];
+        }
+        else {
+            usage(argv[0]);
+        }
+    }
+    if (npaths != 4) usage(argv[0]);
+
+    if (ls_audio_load_wav(&ref_audio, paths[0]) != 0) {
+        fprintf(stderr, "ERROR: unable to read reference audio '%s'\n", paths[0]);
+        return 1;
+    }
+    if (tts_timeline_map(&tl, paths[1]) != 0) {
+        fprintf(stderr, "ERROR: unable to read timeline '%s'\n", paths[1]);
+        return 1;
+    }
+    if (ls_audio_load_wav(&rec_audio, paths[2]) != 0) {
+        fprintf(stderr, "ERROR: unable to read recording '%s'\n", paths[2]);
+        return 1;
+    }
+    if ((int) tl.header->sample_rate != ref_audio.sample_rate)
+        fprintf(stderr, "WARNING: timeline is at %u Hz, reference audio at %d Hz\n",
+                tl.header->sample_rate, ref_audio.sample_rate);
+    duration = rec_audio.count / (float) rec_audio.sample_rate;
+
+    started = seconds();
+    ls_mfcc_extract(&ref, &ref_audio, NULL);
+    ls_mfcc_extract(&rec, &rec_audio, NULL);
+    featured = seconds();
+    if (ls_dtw(&w, &ref, &rec, &cfg) != 0) {
+        fprintf(stderr, "ERROR: empty audio, nothing to align\n");
+        return 1;
+    }
+    aligned = seconds();
+    ls_alignment_project(&al, &w, &tl, duration);
+    if (ls_alignment_write_textgrid(&al, paths[3]) != 0) return 1;
+
+    fprintf(stderr, "INFO: %d phones, %d words over %.2f s of audio\n", al.nphones, al.nwords, duration);
+    fprintf(stderr, "INFO: features %.3f s, warping %.3f s (%d x %d frames), mean distance %.3f\n",
+            featured - started, aligned - featured, ref.count, rec.count, w.cost);
+
+    ls_alignment_free(&al);
+    ls_warp_free(&w);
+    ls_features_free(&ref);
+    ls_features_free(&rec);
+    ls_audio_free(&ref_audio);
+    ls_audio_free(&rec_audio);
+    tts_timeline_unmap(&tl);
+    return 0;
+}
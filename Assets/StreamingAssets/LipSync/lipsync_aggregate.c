@@ -0,0 +1,154 @@
+/* Interval statistics of a prosody contour.
+   See lipsync_aggregate.h. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include "lipsync_aggregate.h"
+
+struct ls_aggregate {
+    int frames;
+    float * time;
+    /* frames + 1 prefix sums of the covered values, entry i holds the
+       frames before i */
+    double * sum[LS_SERIES_COUNT];
+    int * count[LS_SERIES_COUNT];
+    float min[LS_SERIES_COUNT];
+    float max[LS_SERIES_COUNT];
+};
+
+typedef struct segment_order {
+    float start;
+    int index;
+} segment_order;
+
+static int compare_start(const void * a, const void * b) {
+    const segment_order * x = a, * y = b;
+    if (x->start < y->start) return -1;
+    if (x->start > y->start) return 1;
+    return x->index - y->index;
+}
+
+/* Adds value v of frame i to series s, returns 1 if it counted */
+static int cover(ls_aggregate * a, int s, int i, float v) {
+    if (v == 0) return 0;
+    a->sum[s][i + 1] += v;
+    a->count[s][i + 1]++;
+    if (a->max[s] < v) a->max[s] = v;
+    if (a->min[s] > v) a->min[s] = v;
+    return 1;
+}
+
+LS_EXPORT ls_aggregate * ls_aggregate_new(const float * time, const float * f0, const float * loudness, int frames,
+                                          const float * start, const float * end, const unsigned int * classes, int n,
+                                          float * mean_pitch, float * mean_intensity) {
+    ls_aggregate * a = calloc(1, sizeof(ls_aggregate));
+    segment_order * order = malloc((n ? n : 1) * sizeof(segment_order));
+    int i, k, s, lo = 0, sorted = 1, pitch_series, intensity_series, pitch_n, intensity_n;
+    const float * intensity;
+    double pitch_total, intensity_total;
+
+    a->frames = frames;
+    a->time = malloc((frames ? frames : 1) * sizeof(float));
+    memcpy(a->time, time, frames * sizeof(float));
+    for (s = 0; s < LS_SERIES_COUNT; s++) {
+        a->sum[s] = calloc(frames + 1, sizeof(double));
+        a->count[s] = calloc(frames + 1, sizeof(int));
+        a->min[s] = FLT_MAX;
+        a->max[s] = -FLT_MAX;
+    }
+
+    /* phoneme timings are normally in order already */
+    for (k = 0; k < n; k++) {
+        order[k].start = start[k];
+        order[k].index = k;
+        if (k && start[k] < start[k - 1]) sorted = 0;
+    }
+    if (!sorted) qsort(order, n, sizeof(segment_order), compare_start);
+
+    for (k = 0; k < n; k++) {
+        int seg = order[k].index;
+        if (classes[seg] & LS_CLASS_VOWEL) {
+            pitch_series = LS_SERIES_VOWEL_PITCH;
+            intensity_series = LS_SERIES_VOWEL_INTENSITY;
+            intensity = loudness;
+        }
+        else if (classes[seg] & LS_CLASS_PLOSIVE) {
+            pitch_series = LS_SERIES_CONSONANT_PITCH;
+            intensity_series = LS_SERIES_CONSONANT_INTENSITY;
+            intensity = f0;
+        }
+        else continue;
+
+        /* starts are ascending, so the first frame only moves forward */
+        while (lo < frames && time[lo] < start[seg]) lo++;
+        pitch_total = intensity_total = 0;
+        pitch_n = intensity_n = 0;
+        for (i = lo; i < frames && time[i] <= end[seg]; i++) {
+            if (cover(a, pitch_series, i, f0[i])) {
+                pitch_total += f0[i];
+                pitch_n++;
+            }
+            if (cover(a, intensity_series, i, intensity[i])) {
+                intensity_total += intensity[i];
+                intensity_n++;
+            }
+        }
+        if (mean_pitch) mean_pitch[seg] = pitch_total > 0 ? (float) (pitch_total / pitch_n) : 0;
+        if (mean_intensity) mean_intensity[seg] = intensity_total > 0 ? (float) (intensity_total / intensity_n) : 0;
+    }
+    free(order);
+
+    for (s = 0; s < LS_SERIES_COUNT; s++) {
+        for (i = 1; i <= frames; i++) {
+            a->sum[s][i] += a->sum[s][i - 1];
+            a->count[s][i] += a->count[s][i - 1];
+        }
+    }
+    return a;
+}
+
+LS_EXPORT void ls_aggregate_delete(ls_aggregate * a) {
+    int s;
+    if (!a) return;
+    for (s = 0; s < LS_SERIES_COUNT; s++) {
+        free(a->sum[s]);
+        free(a->count[s]);
+    }
+    free(a->time);
+    free(a);
+}
+
+LS_EXPORT void ls_aggregate_range(const ls_aggregate * a, int series, float * min, float * max) {
+    *min = a->min[series];
+    *max = a->max[series];
+}
+
+LS_EXPORT int ls_aggregate_window_count(const ls_aggregate * a, float window_ms) {
+    float duration = a->frames ? a->time[a->frames - 1] : 0;
+    return ((int) duration * 1000) / (int) window_ms + 1;
+}
+
+/* First frame whose millisecond time is at least ms */
+static int first_frame(const ls_aggregate * a, int ms) {
+    int lo = 0, hi = a->frames, mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if ((int) (a->time[mid] * 1000) < ms) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+LS_EXPORT void ls_aggregate_windows(const ls_aggregate * a, int series, float window_ms, float * means, int windows) {
+    const double * sum = a->sum[series];
+    const int * count = a->count[series];
+    int w, from = 0, to, n;
+
+    for (w = 0; w < windows; w++) {
+        to = w == windows - 1 ? a->frames : first_frame(a, (w + 1) * (int) window_ms);
+        n = count[to] - count[from];
+        means[w] = n ? (float) ((sum[to] - sum[from]) / n) : 0;
+        from = to;
+    }
+}
@@ -0,0 +1,58 @@
+/* Interval statistics of a prosody contour.
+
+   SpeechAnalysis.GetIndividualFrequencies/GetIndividualDecibels and
+   ls_prosody_analyse need, for the vowel and plosive/fricative
+   segments, the mean, min and max of the voiced frames inside each
+   segment, and per sliding window the mean of the frames covered by the
+   segments of each class.
+
+   The frames (sorted by time) are merged with the segments in a single
+   pass that visits each covered frame once per segment covering it.  The
+   covered values of every series are kept as prefix sums over the
+   frames, so the window means for any window length are read with a
+   binary search per window boundary, without going back to the frames.
+
+   Frame times are compared with segment bounds inclusively, and zero
+   values (unvoiced frames) are left out, as in SpeechAnalysis.
+*/
+
+#ifndef LIPSYNC_AGGREGATE_H
+#define LIPSYNC_AGGREGATE_H
+
+#include "lipsync_phoneme.h"
+
+/* The four series MyLipSync weights visemes with */
+typedef enum ls_series {
+    LS_SERIES_VOWEL_PITCH,
+    LS_SERIES_CONSONANT_PITCH,
+    LS_SERIES_VOWEL_INTENSITY,
+    LS_SERIES_CONSONANT_INTENSITY,
+    LS_SERIES_COUNT
+} ls_series;
+
+typedef struct ls_aggregate ls_aggregate;
+
+/* Analyses frames against n segments given as start/end (seconds) and
+   LS_CLASS_* flags; only LS_CLASS_VOWEL and LS_CLASS_PLOSIVE segments
+   contribute.  mean_pitch and mean_intensity, if not NULL, receive the
+   segment means (0 when no voiced frame falls in the segment).
+
+   As SpeechAnalysis.GetIndividualDecibels, the intensity of plosives
+   and fricatives is taken from the F0 values. */
+LS_EXPORT ls_aggregate * ls_aggregate_new(const float * time, const float * f0, const float * loudness, int frames,
+                                          const float * start, const float * end, const unsigned int * classes, int n,
+                                          float * mean_pitch, float * mean_intensity);
+LS_EXPORT void ls_aggregate_delete(ls_aggregate * a);
+
+/* Smallest and largest covered value of a series, FLT_MAX and -FLT_MAX
+   when the series is empty */
+LS_EXPORT void ls_aggregate_range(const ls_aggregate * a, int series, float * min, float * max);
+
+/* Number of windows of window_ms, with the duration truncated to whole
+   seconds as SpeechAnalysis does */
+LS_EXPORT int ls_aggregate_window_count(const ls_aggregate * a, float window_ms);
+/* Mean of the covered values per window, 0 for windows without any.
+   Frames past the last window count towards the last one. */
+LS_EXPORT void ls_aggregate_windows(const ls_aggregate * a, int series, float window_ms, float * means, int windows);
+
+#endif /* LIPSYNC_AGGREGATE_H */
@@ -0,0 +1,384 @@
+/* Forced alignment against synthesized speech.
+   See lipsync_align.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "lipsync_align.h"
+#include "lipsync_simd.h"
+
+#define STEP_DIAGONAL 0
+#define STEP_UP 1        /* next reference frame, same recording frame */
+#define STEP_LEFT 2      /* next recording frame, same reference frame */
+#define MIN_INTERVAL 0.001f
+#define PAUSE_PHONE "sil"
+#define PAUSE_LABEL "<p:>"
+
+void ls_align_config_default(ls_align_config * cfg) {
+    cfg->band = 0.25f;
+    cfg->min_band = 0.5f;
+}
+
+/* Band of reference frame i: recording frames lo .. hi */
+typedef struct band {
+    float slope;
+    int radius;
+    int last;    /* last recording frame */
+} band;
+
+static int band_lo(const band * b, int i) {
+    int lo = (int) floorf(i * b->slope + 0.5f) - b->radius;
+    return lo < 0 ? 0 : lo;
+}
+
+static int band_hi(const band * b, int i) {
+    int hi = (int) floorf(i * b->slope + 0.5f) + b->radius;
+    return hi > b->last ? b->last : hi;
+}
+
+/* Symmetric steps, the diagonal weighted twice, over the band only.
+   Two rows of accumulated cost are kept; the step taken into every
+   cell of the band is kept for the backtrace. */
+int ls_dtw(ls_warp * w, const ls_features * ref, const ls_features * rec, const ls_align_config * cfg) {
+    ls_align_config defaults;
+    int n = ref->count, m = rec->count, width, i, j, lo, hi, plo, phi, step;
+    float * prev, * cur, * dist, * tmp, best, up, diag, left;
+    unsigned char * steps;
+    band b;
+
+    memset(w, 0, sizeof(ls_warp));
+    if (n < 1 || m < 1) return -1;
+    if (!cfg) {
+        ls_align_config_default(&defaults);
+        cfg = &defaults;
+    }
+
+    b.slope = n > 1 ? (m - 1) / (float) (n - 1) : 0;
+    b.last = m - 1;
+    b.radius = (int) ceilf(cfg->band * (n > m ? n : m));
+    if (b.radius < (int) ceilf(cfg->min_band / rec->hop)) b.radius = (int) ceilf(cfg->min_band / rec->hop);
+    /* neighbouring rows must overlap */
+    if (b.radius < (int) ceilf(b.slope) + 1) b.radius = (int) ceilf(b.slope) + 1;
+    width = 2 * b.radius + 1;
+
+    prev = malloc(width * sizeof(float));
+    cur = malloc(width * sizeof(float));
+    dist = malloc(width * sizeof(float));
+    steps = malloc((size_t) n * width);
+
+    plo = phi = 0;
+    for (i = 0; i < n; i++) {
+        const float * r = ls_features_frame(ref, i);
+        unsigned char * row = steps + (size_t) i * width;
+        lo = band_lo(&b, i);
+        hi = band_hi(&b, i);
+        for (j = lo; j <= hi; j++)
+            dist[j - lo] = sqrtf(ls_dist2(r, ls_features_frame(rec, j), LS_MFCC_STRIDE));
+
+        for (j = lo; j <= hi; j++) {
+            if (i == 0 && j == 0) {
+                cur[0] = dist[0];
+                row[0] = STEP_DIAGONAL;
+                continue;
+            }
+            diag = i > 0 && j - 1 >= plo && j - 1 <= phi ? prev[j - 1 - plo] + 2 * dist[j - lo] : HUGE_VALF;
+            up = i > 0 && j >= plo && j <= phi ? prev[j - plo] + dist[j - lo] : HUGE_VALF;
+            left = j > lo ? cur[j - 1 - lo] + dist[j - lo] : HUGE_VALF;
+            best = diag;
+            step = STEP_DIAGONAL;
+            if (up < best) {
+                best = up;
+                step = STEP_UP;
+            }
+            if (left < best) {
+                best = left;
+                step = STEP_LEFT;
+            }
+            cur[j - lo] = best;
+            row[j - lo] = (unsigned char) step;
+        }
+        tmp = prev;
+        prev = cur;
+        cur = tmp;
+        plo = lo;
+        phi = hi;
+    }
+
+    w->count = n;
+    w->ref_hop = ref->hop;
+    w->rec_hop = rec->hop;
+    w->first = malloc(n * sizeof(int));
+    w->last = malloc(n * sizeof(int));
+    w->cost = prev[m - 1 - plo] / (n + m);
+
+    /* backtrace from the last frames of both clips */
+    i = n - 1;
+    j = m - 1;
+    w->last[i] = j;
+    while (i > 0 || j > 0) {
+        step = steps[(size_t) i * width + (j - band_lo(&b, i))];
+        w->first[i] = j;
+        if (step == STEP_LEFT) {
+            j--;
+        }
+        else {
+            if (step == STEP_DIAGONAL) j--;
+            i--;
+            w->last[i] = j;
+        }
+    }
+    w->first[0] = 0;
+
+    free(prev);
+    free(cur);
+    free(dist);
+    free(steps);
+    return 0;
+}
+
+float ls_warp_time(const ls_warp * w, float ref_time) {
+    float x = ref_time / w->ref_hop, pos;
+    int i = (int) ceilf(x);
+
+    /* between the last recording frame of the reference frame before
+       and the first one of the frame after */
+    if (i <= 0) pos = 0;
+    else if (i >= w->count) pos = (float) w->last[w->count - 1];
+    else pos = w->last[i - 1] + (w->first[i] - w->last[i - 1]) * (x - (i - 1));
+    return pos * w->rec_hop;
+}
+
+void ls_warp_free(ls_warp * w) {
+    free(w->first);
+    free(w->last);
+    memset(w, 0, sizeof(ls_warp));
+}
+
+/* Projected boundary of a reference sample */
+typedef struct boundary {
+    uint32_t sample;
+    float time;
+} boundary;
+
+static int compare_boundary(const void * a, const void * b) {
+    uint32_t x = ((const boundary *) a)->sample, y = ((const boundary *) b)->sample;
+    return x < y ? -1 : x > y;
+}
+
+static float boundary_time(const boundary * bs, int n, uint32_t sample) {
+    int lo = 0, hi = n - 1, mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (bs[mid].sample < sample) lo = mid + 1;
+        else hi = mid;
+    }
+    return bs[lo].time;
+}
+
+int ls_alignment_project(ls_alignment * al, const ls_warp * w, const tts_timeline * tl, float duration) {
+    const tts_timeline_record * r;
+    boundary * bs;
+    uint32_t i;
+    int n = 0, k, unique;
+    float limit;
+
+    memset(al, 0, sizeof(ls_alignment));
+    al->duration = duration;
+    al->words = malloc((tl->header->n_records + 1) * sizeof(ls_interval));
+    al->phones = malloc((tl->header->n_records + 1) * sizeof(ls_interval));
+
+    /* every distinct boundary is projected once, so that words and
+       phones sharing a boundary in the reference still share it */
+    bs = malloc((2 * tl->header->n_records + 2) * sizeof(boundary));
+    bs[n++].sample = 0;
+    bs[n++].sample = tl->header->total_samples;
+    for (i = 0; i < tl->header->n_records; i++) {
+        r = &tl->records[i];
+        if (r->type != TTS_TIMELINE_PHONE && r->type != TTS_TIMELINE_WORD) continue;
+        bs[n++].sample = r->start;
+        bs[n++].sample = r->end;
+    }
+    qsort(bs, n, sizeof(boundary), compare_boundary);
+    unique = 0;
+    for (k = 0; k < n; k++)
+        if (unique == 0 || bs[k].sample != bs[unique - 1].sample) bs[unique++] = bs[k];
+
+    for (k = 0; k < unique; k++) {
+        bs[k].time = ls_warp_time(w, (float) tts_timeline_seconds(tl, bs[k].sample));
+        if (bs[k].time > duration) bs[k].time = duration;
+        if (k > 0 && bs[k].time < bs[k - 1].time + MIN_INTERVAL) bs[k].time = bs[k - 1].time + MIN_INTERVAL;
+    }
+    /* the minimum spacing may have pushed the last boundaries past the end */
+    limit = duration;
+    for (k = unique - 1; k >= 0 && bs[k].time > limit; k--) {
+        bs[k].time = limit;
+        limit = limit > MIN_INTERVAL ? limit - MIN_INTERVAL : 0;
+    }
+
+    for (i = 0; i < tl->header->n_records; i++) {
+        ls_interval * iv;
+        r = &tl->records[i];
+        if (r->type == TTS_TIMELINE_PHONE) iv = &al->phones[al->nphones++];
+        else if (r->type == TTS_TIMELINE_WORD) iv = &al->words[al->nwords++];
+        else continue;
+        iv->start = boundary_time(bs, unique, r->start);
+        iv->end = boundary_time(bs, unique, r->end);
+        iv->text = tts_timeline_symbol(tl, r->symbol);
+    }
+    free(bs);
+    return al->nphones;
+}
+
+void ls_alignment_free(ls_alignment * al) {
+    free(al->words);
+    free(al->phones);
+    memset(al, 0, sizeof(ls_alignment));
+}
+
+/* Seconds with four decimals, independent of the C locale of the host
+   process */
+static void print_time(FILE * fp, const char * indent, const char * key, float t) {
+    long v = lroundf(t * 10000.0f);
+    fprintf(fp, "%s%s = %ld.%04ld\n", indent, key, v / 10000, v % 10000);
+}
+
+/* Pronunciation of a word: its phones separated by spaces */
+static void pronunciation(const ls_alignment * al, const ls_interval * word, char * out, size_t size) {
+    size_t used = 0, len;
+    int k;
+
+    out[0] = '\0';
+    for (k = 0; k < al->nphones; k++) {
+        const ls_interval * p = &al->phones[k];
+        if (p->start < word->start || p->end > word->end || strcmp(p->text, PAUSE_PHONE) == 0) continue;
+        len = strlen(p->text);
+        if (used + len + 2 > size) break;
+        if (used) out[used++] = ' ';
+        memcpy(out + used, p->text, len + 1);
+        used += len;
+    }
+}
+
+/* Interval tier, gaps between the intervals filled with empty ones */
+static void write_tier(FILE * fp, const ls_alignment * al, int tier, const char * name) {
+    const ls_interval * ivs = tier == 2 ? al->phones : al->words;
+    int n = tier == 2 ? al->nphones : al->nwords, count = 0, pass, k, index;
+    char text[512];
+    float t;
+
+    fprintf(fp, "    item [%d]:\n", tier + 1);
+    fprintf(fp, "        class = \"IntervalTier\"\n");
+    fprintf(fp, "        name = \"%s\"\n", name);
+    print_time(fp, "        ", "xmin", 0);
+    print_time(fp, "        ", "xmax", al->duration);
+
+    /* first pass counts the intervals, the second writes them */
+    for (pass = 0; pass < 2; pass++) {
+        t = 0;
+        index = 0;
+        if (pass == 1) fprintf(fp, "        intervals: size = %d\n", count);
+        for (k = 0; k <= n; k++) {
+            float start = k < n ? ivs[k].start : al->duration;
+            if (k < n && ivs[k].end <= ivs[k].start) continue;
+            if (start > t) {
+                if (pass == 1) {
+                    fprintf(fp, "        intervals [%d]:\n", ++index);
+                    print_time(fp, "            ", "xmin", t);
+                    print_time(fp, "            ", "xmax", start);
+                    fprintf(fp, "            text = \"\"\n");
+                }
+                else count++;
+            }
+            if (k == n) break;
+            if (pass == 1) {
+                fprintf(fp, "        intervals [%d]:\n", ++index);
+                print_time(fp, "            ", "xmin", ivs[k].start);
+                print_time(fp, "            ", "xmax", ivs[k].end);
+                if (tier == 1) {
+                    pronunciation(al, &ivs[k], text, sizeof(text));
+                }
+                else if (tier == 2 && strcmp(ivs[k].text, PAUSE_PHONE) == 0) {
+                    strcpy(text, PAUSE_LABEL);
+                }
+                else {
+                    /* lower case, MAUS tier names never match a word */
+                    size_t c;
+                    for (c = 0; ivs[k].text[c] && c + 1 < sizeof(text); c++)
+                        text[c] = (char) tolower((unsigned char) ivs[k].text[c]);
+                    text[c] = '\0';
+                }
+                fprintf(fp, "            text = \"%s\"\n", text);
+            }
+            else count++;
+            t = ivs[k].end;
+        }
+    }
+}
+
+int ls_alignment_write_textgrid(const ls_alignment * al, const char * path) {
+    FILE * fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "ERROR: unable to open TextGrid file '%s'\n", path);
+        return -1;
+    }
+    fprintf(fp, "File type = \"ooTextFile\"\n");
+    fprintf(fp, "Object class = \"TextGrid\"\n\n");
+    print_time(fp, "", "xmin", 0);
+    print_time(fp, "", "xmax", al->duration);
+    fprintf(fp, "tiers? <exists>\n");
+    fprintf(fp, "size = 3\n");
+    fprintf(fp, "item []:\n");
+    write_tier(fp, al, 0, "ORT-MAU");
+    write_tier(fp, al, 1, "KAN-MAU");
+    write_tier(fp, al, 2, "MAU");
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "ERROR: unable to write TextGrid file '%s'\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+LS_EXPORT int ls_align_textgrid(const char * reference_wav, const char * reference_timeline,
+                                const char * wav_path, const char * textgrid_path, float band) {
+    ls_audio ref_audio, rec_audio;
+    ls_features ref, rec;
+    ls_align_config cfg;
+    tts_timeline tl;
+    ls_alignment al;
+    ls_warp w;
+    int phones = -1;
+
+    if (tts_timeline_map(&tl, reference_timeline) != 0) {
+        fprintf(stderr, "ERROR: unable to read timeline '%s'\n", reference_timeline);
+        return -1;
+    }
+    if (ls_audio_load_wav(&ref_audio, reference_wav) != 0) {
+        tts_timeline_unmap(&tl);
+        return -1;
+    }
+    if (ls_audio_load_wav(&rec_audio, wav_path) != 0) {
+        ls_audio_free(&ref_audio);
+        tts_timeline_unmap(&tl);
+        return -1;
+    }
+
+    ls_align_config_default(&cfg);
+    if (band > 0) cfg.band = band;
+    ls_mfcc_extract(&ref, &ref_audio, NULL);
+    ls_mfcc_extract(&rec, &rec_audio, NULL);
+    if (ls_dtw(&w, &ref, &rec, &cfg) == 0) {
+        ls_alignment_project(&al, &w, &tl, rec_audio.count / (float) rec_audio.sample_rate);
+        if (ls_alignment_write_textgrid(&al, textgrid_path) == 0) phones = al.nphones;
+        ls_alignment_free(&al);
+        ls_warp_free(&w);
+    }
+
+    ls_features_free(&ref);
+    ls_features_free(&rec);
+    ls_audio_free(&ref_audio);
+    ls_audio_free(&rec_audio);
+    tts_timeline_unmap(&tl);
+    return phones;
+}
@@ -0,0 +1,90 @@
+/* Forced alignment of a recording against synthesized speech, in place
+   of the WebMAUS service (MAUSService.cs).
+
+   The transcript of the clip is synthesized first (tts_callback -o -t),
+   which gives a reference utterance whose phone and word timings are
+   exact: they come from the engine's own transcription, stored in a
+   timeline file (see ../CereVoice/tts_timeline.h).  Both utterances are
+   turned into MFCC frames (lipsync_mfcc.h) and aligned by dynamic time
+   warping, and every phone and word boundary of the reference is then
+   moved along the warping path onto the recording.
+
+   The warping is restricted to a Sakoe-Chiba band around the diagonal
+   scaled to the length ratio of the two clips, so memory and time grow
+   with the clip length times the band instead of its square; the frame
+   distances, which dominate the cost, use the vector kernels of
+   lipsync_simd.h.  A minute of speech aligns in a fraction of a second.
+
+   The result is written as a Praat TextGrid with the tiers of a MAUS
+   result (ORT-MAU words, KAN-MAU pronunciations, MAU phones, pauses as
+   <p:>), so PhonemeAnalyzer.ManageTextGridInfo reads it unchanged.
+   Phones keep the CereVoice names, which PhonemeInformation.MapPhoneme
+   accepts as well as X-SAMPA.
+
+   Unity calls ls_align_textgrid through P/Invoke (LocalAligner.cs); the
+   shared library build is given in lipsync_pitch.h.  clip_aligner.c is
+   the command line front end.
+*/
+
+#ifndef LIPSYNC_ALIGN_H
+#define LIPSYNC_ALIGN_H
+
+#include "tts_timeline.h"
+#include "lipsync_phoneme.h"
+#include "lipsync_mfcc.h"
+
+typedef struct ls_align_config {
+    float band;        /* band half width, fraction of the longer clip */
+    float min_band;    /* lower bound of the half width, seconds */
+} ls_align_config;
+
+void ls_align_config_default(ls_align_config * cfg);
+
+/* Warping path reduced to the recording frames matched by each
+   reference frame */
+typedef struct ls_warp {
+    int count;         /* reference frames */
+    float ref_hop;     /* seconds */
+    float rec_hop;
+    int * first;       /* first and last recording frame of reference frame i */
+    int * last;
+    float cost;        /* accumulated distance over the path length */
+} ls_warp;
+
+/* Aligns rec to ref.  Returns 0 on success, -1 if either clip has no
+   frames. */
+int ls_dtw(ls_warp * w, const ls_features * ref, const ls_features * rec, const ls_align_config * cfg);
+/* Time in the recording of a reference time, both in seconds */
+float ls_warp_time(const ls_warp * w, float ref_time);
+void ls_warp_free(ls_warp * w);
+
+typedef struct ls_interval {
+    float start, end;      /* seconds in the recording */
+    const char * text;     /* owned by the timeline */
+} ls_interval;
+
+typedef struct ls_alignment {
+    float duration;        /* seconds */
+    int nwords, nphones;
+    ls_interval * words;
+    ls_interval * phones;
+} ls_alignment;
+
+/* Projects the phones and words of the reference timeline onto the
+   recording of the given duration.  Boundaries stay in order and
+   intervals at least a millisecond long, as far as the recording has
+   room for them (empty ones are left out of the TextGrid).  Returns the
+   number of phones. */
+int ls_alignment_project(ls_alignment * al, const ls_warp * w, const tts_timeline * tl, float duration);
+/* Returns 0 on success */
+int ls_alignment_write_textgrid(const ls_alignment * al, const char * path);
+void ls_alignment_free(ls_alignment * al);
+
+/* P/Invoke entry point: aligns wav_path to the synthesized reference
+   (reference_wav, reference_timeline) and writes textgrid_path.  band
+   is the fraction of ls_align_config, 0 for the default.  Returns the
+   number of phones, or -1 if a file cannot be read or written. */
+LS_EXPORT int ls_align_textgrid(const char * reference_wav, const char * reference_timeline,
+                                const char * wav_path, const char * textgrid_path, float band);
+
+#endif /* LIPSYNC_ALIGN_H */
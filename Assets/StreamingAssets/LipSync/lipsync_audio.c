@@ -0,0 +1,110 @@
+/* Audio input for the native analysis tools.
+   See lipsync_audio.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lipsync_audio.h"
+#include "lipsync_rig.h"
+
+#define WAVE_PCM 1
+#define WAVE_FLOAT 3
+#define WAVE_EXTENSIBLE 0xfffe
+
+static unsigned int get_u16(const unsigned char * p) {
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned long get_u32(const unsigned char * p) {
+    return p[0] | (p[1] << 8) | ((unsigned long) p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+/* One sample of the given format as a float in [-1, 1] */
+static float get_sample(const unsigned char * p, int format, int bits) {
+    long v;
+    float f;
+    if (format == WAVE_FLOAT) {
+        memcpy(&f, p, sizeof(f));
+        return f;
+    }
+    switch (bits) {
+    case 8:
+        return (p[0] - 128) / 128.0f;
+    case 16:
+        return (short) get_u16(p) / 32768.0f;
+    case 24:
+        v = (long) (p[0] | (p[1] << 8) | ((unsigned long) p[2] << 16));
+        if (v & 0x800000) v -= 0x1000000;
+        return v / 8388608.0f;
+    default:
+        return (float) ((int) get_u32(p) / 2147483648.0);
+    }
+}
+
+int ls_audio_load_wav(ls_audio * a, const char * path) {
+    unsigned char * buf, * p, * end, * data = NULL, * fmt = NULL;
+    unsigned long chunk, data_size = 0;
+    int format, channels, bits, frame, c;
+    long size, i;
+    float sum;
+
+    memset(a, 0, sizeof(ls_audio));
+    buf = (unsigned char *) ls_read_file(path, &size);
+    if (!buf) {
+        fprintf(stderr, "ERROR: unable to read audio file '%s'\n", path);
+        return -1;
+    }
+    if (size < 12 || memcmp(buf, "RIFF", 4) != 0 || memcmp(buf + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "ERROR: '%s' is not a wave file\n", path);
+        free(buf);
+        return -1;
+    }
+
+    /* walk the chunks for "fmt " and "data" */
+    end = buf + size;
+    for (p = buf + 12; p + 8 <= end; p += 8 + chunk + (chunk & 1)) {
+        chunk = get_u32(p + 4);
+        if (memcmp(p, "fmt ", 4) == 0 && chunk >= 16) fmt = p + 8;
+        else if (memcmp(p, "data", 4) == 0) {
+            data = p + 8;
+            data_size = chunk;
+            if (data + data_size > end) data_size = (unsigned long) (end - data);
+            break;
+        }
+    }
+    if (!fmt || !data) {
+        fprintf(stderr, "ERROR: '%s' has no audio data\n", path);
+        free(buf);
+        return -1;
+    }
+
+    format = (int) get_u16(fmt);
+    channels = (int) get_u16(fmt + 2);
+    bits = (int) get_u16(fmt + 14);
+    if (format == WAVE_EXTENSIBLE) format = (int) get_u16(fmt + 24);
+    if ((format != WAVE_PCM && format != WAVE_FLOAT) || channels < 1 ||
+        (format == WAVE_PCM && bits != 8 && bits != 16 && bits != 24 && bits != 32) ||
+        (format == WAVE_FLOAT && bits != 32)) {
+        fprintf(stderr, "ERROR: unsupported wave format in '%s'\n", path);
+        free(buf);
+        return -1;
+    }
+
+    frame = channels * bits / 8;
+    a->sample_rate = (int) get_u32(fmt + 4);
+    a->count = (long) (data_size / frame);
+    a->samples = malloc((a->count + 1) * sizeof(float));
+    for (i = 0; i < a->count; i++) {
+        p = data + i * frame;
+        sum = 0;
+        for (c = 0; c < channels; c++) sum += get_sample(p + c * bits / 8, format, bits);
+        a->samples[i] = sum / channels;
+    }
+    free(buf);
+    return 0;
+}
+
+void ls_audio_free(ls_audio * a) {
+    free(a->samples);
+    memset(a, 0, sizeof(ls_audio));
+}
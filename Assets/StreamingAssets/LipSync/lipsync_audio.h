@@ -0,0 +1,20 @@
+/* Audio input for the native analysis tools.
+
+   Reads RIFF/WAVE files with 8, 16, 24 or 32 bit integer PCM or 32 bit
+   float samples and mixes them down to mono float samples in [-1, 1].
+*/
+
+#ifndef LIPSYNC_AUDIO_H
+#define LIPSYNC_AUDIO_H
+
+typedef struct ls_audio {
+    int sample_rate;
+    long count;
+    float * samples;
+} ls_audio;
+
+/* Returns 0 on success */
+int ls_audio_load_wav(ls_audio * a, const char * path);
+void ls_audio_free(ls_audio * a);
+
+#endif /* LIPSYNC_AUDIO_H */
@@ -0,0 +1,64 @@
+/* Dominance-function coarticulation.
+   See lipsync_coartic.h. */
+
+#include "lipsync_coartic.h"
+#include "lipsync_simd.h"
+
+/* Vowel magnitudes follow the sonority order of
+   PhonemeInformation.GetPhonemicInfluence; a lower rate spreads the
+   phone further into its neighbours. */
+const ls_dominance ls_dominances[LS_PHONEME_COUNT] = {
+    {0.7f,  15, 15},   /* AAA */
+    {0.7f,  15, 15},   /* AHH */
+    {1.0f,   8, 12},   /* UUU, rounding is anticipated well ahead */
+    {0.6f,  20, 20},   /* RRR */
+    {0.3f,  30, 30},   /* T, tongue only */
+    {0.3f,  30, 30},   /* TH */
+    {2.5f,  35, 35},   /* FFF, labiodental closure */
+    {0.75f, 15, 15},   /* EHH */
+    {1.0f,   8, 12},   /* OHH */
+    {0.8f,  15, 15},   /* IEE */
+    {0.4f,  25, 25},   /* SSS */
+    {1.0f,  10, 12},   /* SSH */
+    {2.5f,  35, 35},   /* MMM, bilabial closure */
+    {0.3f,  25, 25},   /* Schwa, unstressed */
+    {0.3f,  30, 30},   /* L */
+    {0.3f,  30, 30},   /* N */
+    {0.3f,  30, 30},   /* GK */
+    {0.8f,  15, 15},   /* DiphoneAI, normally split before animation */
+    {0.8f,  15, 15},   /* DiphoneAU */
+    {0.8f,  15, 15},   /* DiphoneOI */
+    {0.8f,  15, 15},   /* DiphoneOU */
+    {0.8f,  15, 15},   /* DiphoneEI */
+    {0.8f,  15, 15},   /* DiphoneX */
+    {0.8f,  15, 15},   /* DiphoneIA */
+    {0.8f,  15, 15},   /* DiphoneUA */
+    {0.8f,  15, 15},   /* DiphoneEA */
+    {1.0f,  12, 12}    /* Rest, pauses */
+};
+
+int ls_coartic_window(const unsigned char * phoneme, const float * start, const float * end,
+                      int count, float t, int * first, int * index, float * dominance) {
+    float exponent[LS_COARTIC_MAX_PHONES], magnitude[LS_COARTIC_MAX_PHONES];
+    const ls_dominance * d;
+    int i, n = 0;
+
+    while (*first < count && end[*first] < t - LS_COARTIC_WINDOW) (*first)++;
+
+    for (i = *first; i < count && n < LS_COARTIC_MAX_PHONES; i++) {
+        if (start[i] > t + LS_COARTIC_WINDOW) break;
+        /* intervals moved by the onset/offset rearrangement can end
+           out of order */
+        if (end[i] < t - LS_COARTIC_WINDOW) continue;
+        d = &ls_dominances[phoneme[i] < LS_PHONEME_COUNT ? phoneme[i] : LS_REST];
+        if (t < start[i]) exponent[n] = -d->backward * (start[i] - t);
+        else if (t > end[i]) exponent[n] = -d->forward * (t - end[i]);
+        else exponent[n] = 0;
+        magnitude[n] = d->magnitude;
+        index[n++] = i;
+    }
+
+    ls_exp_neg(exponent, dominance, n);
+    ls_mul(dominance, magnitude, dominance, n);
+    return n;
+}
@@ -0,0 +1,60 @@
+/* Dominance-function coarticulation (Cohen and Massaro).
+
+   The rise/decay model of MyLipSync animates every phoneme on its own:
+   a phoneme's blendshapes ramp up to its targets and back to zero, and
+   a neighbour only shows through when their intervals overlap.  In the
+   dominance model every phone exerts a pull on every blendshape for as
+   long as its dominance lasts, and the weight of a blendshape is the
+   dominance-weighted mean of the targets:
+
+     D_i(t) = a_i e^(-theta_i tau),   w(t) = sum D_i T_i / (d_0 + sum D_i)
+
+   where tau is the distance from t to the phone's interval (0 inside
+   it), theta_i the backward rate before the phone and the forward rate
+   after it, and T_i the phone's target for the blendshape (0 for the
+   blendshapes its viseme does not use).  d_0 is a small neutral
+   dominance that brings the mouth back to rest away from any phone.
+
+   The magnitudes and rates come from the ls_dominances table, which
+   covers the open items of CoarticulationEnhancement: lip-heavy
+   visemes (rounded vowels, SSH) spread far into their neighbours,
+   tongue-only consonants are weak and take the lip shape of the
+   surrounding vowels, the schwa yields to its neighbours, bilabial and
+   labiodental closures are strong but short, and pauses pull towards
+   rest.
+
+   A phone only counts within a bounded window of t, so evaluating a
+   time costs O(phones in the window); times are visited in increasing
+   order and the window start moves forward with them.  The exponentials
+   of a window are evaluated together with ls_exp_neg (lipsync_simd.h).
+   The solver (lipsync_solver.h) evaluates the model per tick for every
+   character using it, viseme_baker bakes it with -d.
+*/
+
+#ifndef LIPSYNC_COARTIC_H
+#define LIPSYNC_COARTIC_H
+
+#include "lipsync_phoneme.h"
+
+#define LS_COARTIC_WINDOW 0.3f         /* seconds either side of t */
+#define LS_COARTIC_NEUTRAL 0.02f       /* d_0 */
+#define LS_COARTIC_MAX_PHONES 32       /* phones of one window */
+
+typedef struct ls_dominance {
+    float magnitude;       /* a */
+    float backward;        /* theta before the phone, 1/s */
+    float forward;         /* theta after the phone */
+} ls_dominance;
+
+extern const ls_dominance ls_dominances[LS_PHONEME_COUNT];
+
+/* Dominances at time t of the phones (in time order, count of them)
+   whose interval is within LS_COARTIC_WINDOW of t.  *first is the phone
+   the search starts from; it is moved past the phones that ended
+   before the window, so it must be reset to 0 when t goes back.  The
+   phone indices go to index and their dominances to dominance, at
+   most LS_COARTIC_MAX_PHONES of each.  Returns the number of phones. */
+int ls_coartic_window(const unsigned char * phoneme, const float * start, const float * end,
+                      int count, float t, int * first, int * index, float * dominance);
+
+#endif /* LIPSYNC_COARTIC_H */
@@ -0,0 +1,402 @@
+/* Real-time viseme estimation.
+   See lipsync_live.h. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "tts_thread.h"
+#include "lipsync_live.h"
+#include "lipsync_pitch.h"
+#include "lipsync_simd.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RING_SECONDS 0.5f       /* capture ring, rounded up to a power of two */
+#define HISTORY 8               /* frame weights kept, power of two > LS_LIVE_MAX_LOOKAHEAD + 1 */
+#define SILENCE_DB -65.0f       /* below this nothing is speech */
+#define SPEECH_MARGIN 10.0f     /* dB above the noise floor */
+#define FLOOR_RISE 0.02f        /* dB per frame the noise floor creeps up */
+#define PEAK_FALL 0.05f         /* dB per frame the speech peak falls */
+#define ATTACK 0.010f           /* easing time constants, seconds */
+#define RELEASE 0.040f
+#define VOWEL_SPREAD 0.15f      /* prototype distance of a third of the weight */
+#define POWER_FLOOR 1e-12f
+
+/* band edges, Hz */
+static const float band_edges[LS_LIVE_BANDS + 1] = {80, 300, 900, 2200, 4000, 8000};
+
+/* Vowel prototypes: share of the 300-900 Hz band in 300-2200 Hz
+   (openness) and of 900-4000 Hz in 300-4000 Hz (frontness) */
+typedef struct vowel {
+    ls_phoneme phoneme;
+    float open, front;
+} vowel;
+
+static const vowel vowels[] = {
+    {LS_AAA,   0.75f, 0.35f},
+    {LS_EHH,   0.55f, 0.55f},
+    {LS_IEE,   0.30f, 0.75f},
+    {LS_OHH,   0.65f, 0.15f},
+    {LS_UUU,   0.40f, 0.10f},
+    {LS_SCHWA, 0.50f, 0.40f}
+};
+#define VOWELS ((int) (sizeof(vowels) / sizeof(vowels[0])))
+
+struct ls_live {
+    int sample_rate, frame_len, hop_len, fft_len, lookahead;
+    float attack, release;
+    tts_mutex lock;
+    tts_cond wake;
+    int stop;
+    int started;
+    tts_thread thread;
+
+    /* capture ring, written by the audio thread only */
+    float * ring;
+    unsigned int ring_size;
+    volatile unsigned int head;      /* next sample to write */
+    volatile unsigned int tail;      /* next sample to read */
+    volatile unsigned int overruns;
+
+    /* analysis, worker only */
+    float * frame;                   /* last frame_len samples */
+    float * hop;
+    float * window;
+    float * re, * im;
+    float * cos_tab, * sin_tab;
+    int * reverse;
+    int band_lo[LS_LIVE_BANDS + 1];  /* band b covers bins band_lo[b] .. band_lo[b + 1] - 1 */
+    ls_pitch * pitch;
+    ls_contour contour;
+    float f0;
+    float floor_db, peak_db;
+    long frames;
+    float history[HISTORY][LS_PHONEME_COUNT];
+    float eased[LS_PHONEME_COUNT];
+
+    /* published weights, written by the worker only */
+    float queue[LS_LIVE_QUEUE][LS_PHONEME_COUNT];
+    volatile unsigned int queue_head;
+    volatile unsigned int queue_tail;
+};
+
+static void fft_init(ls_live * l) {
+    int i, j, bits = 0;
+    for (l->fft_len = 1; l->fft_len < l->frame_len; l->fft_len <<= 1) bits++;
+    l->cos_tab = malloc((l->fft_len / 2 + 1) * sizeof(float));
+    l->sin_tab = malloc((l->fft_len / 2 + 1) * sizeof(float));
+    for (i = 0; i < l->fft_len / 2; i++) {
+        l->cos_tab[i] = (float) cos(2.0 * M_PI * i / l->fft_len);
+        l->sin_tab[i] = (float) sin(2.0 * M_PI * i / l->fft_len);
+    }
+    l->reverse = malloc(l->fft_len * sizeof(int));
+    for (i = 0; i < l->fft_len; i++) {
+        l->reverse[i] = 0;
+        for (j = 0; j < bits; j++)
+            if (i & (1 << j)) l->reverse[i] |= 1 << (bits - 1 - j);
+    }
+}
+
+/* In-place radix-2 transform of fft_len complex values, as lipsync_mfcc.c */
+static void fft(const ls_live * l, float * re, float * im) {
+    int n = l->fft_len, i, j, k, len, half, step, a, b;
+    float wr, wi, xr, xi, tmp;
+
+    for (i = 0; i < n; i++) {
+        j = l->reverse[i];
+        if (j <= i) continue;
+        tmp = re[i]; re[i] = re[j]; re[j] = tmp;
+        tmp = im[i]; im[i] = im[j]; im[j] = tmp;
+    }
+    for (len = 2; len <= n; len <<= 1) {
+        half = len >> 1;
+        step = n / len;
+        for (i = 0; i < n; i += len) {
+            for (k = 0; k < half; k++) {
+                wr = l->cos_tab[k * step];
+                wi = -l->sin_tab[k * step];
+                a = i + k;
+                b = a + half;
+                xr = re[b] * wr - im[b] * wi;
+                xi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - xr;
+                im[b] = im[a] - xi;
+                re[a] += xr;
+                im[a] += xi;
+            }
+        }
+    }
+}
+
+static float clamp01(float x) {
+    return x < 0 ? 0 : x > 1 ? 1 : x;
+}
+
+/* Class weights of the current frame, summing to 1 */
+static void classify(ls_live * l, float * weights) {
+    float band[LS_LIVE_BANDS], total = POWER_FLOOR, level, open, high, sibilance, d[VOWELS], w[VOWELS];
+    float vowel_open, vowel_front, amplitude, sum;
+    int b, i;
+
+    memset(l->re, 0, l->fft_len * sizeof(float));
+    memset(l->im, 0, l->fft_len * sizeof(float));
+    ls_mul(l->frame, l->window, l->re, l->frame_len);
+    fft(l, l->re, l->im);
+    ls_mul(l->re, l->re, l->re, l->fft_len / 2 + 1);
+    ls_mul(l->im, l->im, l->im, l->fft_len / 2 + 1);
+    for (i = 0; i <= l->fft_len / 2; i++) l->re[i] += l->im[i];
+    for (b = 0; b < LS_LIVE_BANDS; b++) {
+        band[b] = ls_sum(l->re + l->band_lo[b], l->band_lo[b + 1] - l->band_lo[b]);
+        total += band[b];
+    }
+    level = 10 * log10f(ls_dot(l->frame, l->frame, l->frame_len) / l->frame_len + POWER_FLOOR);
+
+    /* the floor follows the quietest frames down at once and creeps
+       up, the peak the loudest frames up at once and falls slowly */
+    if (level < l->floor_db) l->floor_db = level;
+    else l->floor_db += FLOOR_RISE;
+    if (level > l->peak_db) l->peak_db = level;
+    else l->peak_db -= PEAK_FALL;
+    if (l->peak_db < l->floor_db + 2 * SPEECH_MARGIN) l->peak_db = l->floor_db + 2 * SPEECH_MARGIN;
+
+    memset(weights, 0, LS_PHONEME_COUNT * sizeof(float));
+    if (level < SILENCE_DB || level < l->floor_db + SPEECH_MARGIN) {
+        weights[LS_REST] = 1;
+        return;
+    }
+    open = clamp01((level - l->floor_db - SPEECH_MARGIN) / (l->peak_db - l->floor_db - SPEECH_MARGIN));
+    high = (band[3] + band[4]) / total;
+
+    if (l->f0 <= 0) {
+        if (high > 0.5f) {
+            /* hiss: /s/ peaks above 4 kHz, /sh/ below; weak flat
+               friction is labiodental */
+            sibilance = band[4] / (band[3] + band[4] + POWER_FLOOR);
+            amplitude = clamp01(2 * open);
+            weights[LS_SSS] = sibilance * amplitude;
+            weights[LS_SSH] = (1 - sibilance) * amplitude;
+            weights[LS_FFF] = 1 - amplitude;
+        }
+        else {
+            weights[LS_T] = 1;
+        }
+        return;
+    }
+    if (band[0] / total > 0.7f) {
+        /* murmur through the nose, the lips may or may not be closed */
+        weights[LS_MMM] = 0.5f;
+        weights[LS_N] = 0.5f;
+        return;
+    }
+
+    vowel_open = band[1] / (band[1] + band[2] + POWER_FLOOR);
+    vowel_front = (band[2] + band[3]) / (band[1] + band[2] + band[3] + POWER_FLOOR);
+    for (i = 0; i < VOWELS; i++)
+        d[i] = -((vowel_open - vowels[i].open) * (vowel_open - vowels[i].open) +
+                (vowel_front - vowels[i].front) * (vowel_front - vowels[i].front)) /
+               (VOWEL_SPREAD * VOWEL_SPREAD);
+    ls_exp_neg(d, w, VOWELS);
+    sum = ls_sum(w, VOWELS);
+    /* louder vowels open the mouth further, the rest stays closed */
+    amplitude = 0.4f + 0.6f * open;
+    for (i = 0; i < VOWELS; i++)
+        weights[vowels[i].phoneme] = sum > 0 ? amplitude * w[i] / sum : 0;
+    if (sum <= 0) weights[LS_SCHWA] = amplitude;
+    weights[LS_REST] = 1 - amplitude;
+}
+
+/* Publishes the weights of frame k - lookahead once frame k is in */
+static void publish(ls_live * l) {
+    const float * h;
+    float mean[LS_PHONEME_COUNT], weight, total = 0, alpha;
+    long centre = l->frames - 1 - l->lookahead, k;
+    unsigned int head;
+    int p;
+
+    if (centre < 0) return;
+    memset(mean, 0, sizeof(mean));
+    for (k = centre - 1; k <= l->frames - 1; k++) {
+        if (k < 0) continue;
+        weight = k == centre ? 2.0f : 1.0f;
+        h = l->history[k & (HISTORY - 1)];
+        for (p = 0; p < LS_PHONEME_COUNT; p++) mean[p] += weight * h[p];
+        total += weight;
+    }
+    for (p = 0; p < LS_PHONEME_COUNT; p++) {
+        mean[p] /= total;
+        alpha = mean[p] > l->eased[p] ? l->attack : l->release;
+        l->eased[p] += (mean[p] - l->eased[p]) * alpha;
+    }
+
+    /* a game thread that stopped reading loses the newest frames, not
+       the producer's time */
+    head = l->queue_head;
+    if (head - tts_atomic_load(&l->queue_tail) == LS_LIVE_QUEUE) return;
+    memcpy(l->queue[head & (LS_LIVE_QUEUE - 1)], l->eased, sizeof(l->eased));
+    tts_atomic_store(&l->queue_head, head + 1);
+}
+
+/* Analyses every complete hop in the ring.  Returns the number of hops. */
+static int process(ls_live * l) {
+    unsigned int tail = l->tail, head = tts_atomic_load(&l->head), mask = l->ring_size - 1, first;
+    int hops = 0;
+
+    while (head - tail >= (unsigned int) l->hop_len) {
+        first = l->ring_size - (tail & mask);
+        if (first >= (unsigned int) l->hop_len) {
+            memcpy(l->hop, l->ring + (tail & mask), l->hop_len * sizeof(float));
+        }
+        else {
+            memcpy(l->hop, l->ring + (tail & mask), first * sizeof(float));
+            memcpy(l->hop + first, l->ring, (l->hop_len - first) * sizeof(float));
+        }
+        tail += l->hop_len;
+        tts_atomic_store(&l->tail, tail);
+
+        memmove(l->frame, l->frame + l->hop_len, (l->frame_len - l->hop_len) * sizeof(float));
+        memcpy(l->frame + l->frame_len - l->hop_len, l->hop, l->hop_len * sizeof(float));
+        if (ls_pitch_push(l->pitch, l->hop, l->hop_len, &l->contour) > 0) {
+            l->f0 = l->contour.f0[l->contour.count - 1];
+            l->contour.count = 0;
+        }
+
+        classify(l, l->history[l->frames & (HISTORY - 1)]);
+        l->frames++;
+        publish(l);
+        hops++;
+        if (head - tail < (unsigned int) l->hop_len) head = tts_atomic_load(&l->head);
+    }
+    return hops;
+}
+
+static tts_thread_ret TTS_THREAD_CALL live_thread(void * userdata) {
+    ls_live * l = (ls_live *) userdata;
+    int hops;
+
+    tts_mutex_lock(&l->lock);
+    while (!l->stop) {
+        tts_mutex_unlock(&l->lock);
+        hops = process(l);
+        tts_mutex_lock(&l->lock);
+        /* the capture thread must not take a lock, so it does not
+           signal: the worker polls while the ring is short of a hop */
+        if (hops == 0 && !l->stop) tts_cond_timedwait(&l->wake, &l->lock, LS_LIVE_POLL);
+    }
+    tts_mutex_unlock(&l->lock);
+    return 0;
+}
+
+LS_EXPORT ls_live * ls_live_new(int sample_rate, int lookahead) {
+    ls_live * l = calloc(1, sizeof(ls_live));
+    ls_pitch_config cfg;
+    int i, b, bin;
+
+    l->sample_rate = sample_rate;
+    l->frame_len = (int) (LS_LIVE_FRAME * sample_rate + 0.5f);
+    l->hop_len = (int) (LS_LIVE_HOP * sample_rate + 0.5f);
+    if (l->hop_len < 1) l->hop_len = 1;
+    l->lookahead = lookahead < 0 ? 0 : lookahead > LS_LIVE_MAX_LOOKAHEAD ? LS_LIVE_MAX_LOOKAHEAD : lookahead;
+    l->attack = 1 - expf(-LS_LIVE_HOP / ATTACK);
+    l->release = 1 - expf(-LS_LIVE_HOP / RELEASE);
+
+    for (l->ring_size = 1; l->ring_size < RING_SECONDS * sample_rate; l->ring_size <<= 1) {}
+    l->ring = malloc(l->ring_size * sizeof(float));
+    l->frame = calloc(l->frame_len, sizeof(float));
+    l->hop = malloc(l->hop_len * sizeof(float));
+    l->window = malloc(l->frame_len * sizeof(float));
+    for (i = 0; i < l->frame_len; i++)
+        l->window[i] = (float) (0.5 - 0.5 * cos(2.0 * M_PI * i / (l->frame_len - 1)));
+    fft_init(l);
+    l->re = malloc(l->fft_len * sizeof(float));
+    l->im = malloc(l->fft_len * sizeof(float));
+    for (b = 0; b <= LS_LIVE_BANDS; b++) {
+        bin = (int) (band_edges[b] * l->fft_len / sample_rate + 0.5f);
+        l->band_lo[b] = bin < l->fft_len / 2 + 1 ? bin : l->fft_len / 2 + 1;
+    }
+
+    ls_pitch_config_default(&cfg, sample_rate);
+    cfg.frame = LS_LIVE_PITCH_FRAME;
+    cfg.hop = LS_LIVE_HOP;
+    cfg.smooth = 1;
+    l->pitch = ls_pitch_new(&cfg);
+    l->floor_db = SILENCE_DB;
+    l->peak_db = SILENCE_DB + 2 * SPEECH_MARGIN;
+    l->eased[LS_REST] = 1;
+
+    tts_mutex_init(&l->lock);
+    tts_cond_init(&l->wake);
+    if (!tts_thread_start(&l->thread, live_thread, l)) {
+        ls_live_delete(l);
+        return NULL;
+    }
+    l->started = 1;
+    return l;
+}
+
+LS_EXPORT void ls_live_delete(ls_live * l) {
+    if (!l) return;
+    if (l->started) {
+        tts_mutex_lock(&l->lock);
+        l->stop = 1;
+        tts_cond_signal(&l->wake);
+        tts_mutex_unlock(&l->lock);
+        tts_thread_join(l->thread);
+    }
+    tts_mutex_destroy(&l->lock);
+    tts_cond_destroy(&l->wake);
+    ls_pitch_delete(l->pitch);
+    ls_contour_free(&l->contour);
+    free(l->ring);
+    free(l->frame);
+    free(l->hop);
+    free(l->window);
+    free(l->re);
+    free(l->im);
+    free(l->cos_tab);
+    free(l->sin_tab);
+    free(l->reverse);
+    free(l);
+}
+
+LS_EXPORT int ls_live_push(ls_live * l, const float * samples, int frames, int channels) {
+    unsigned int head = l->head, mask = l->ring_size - 1;
+    unsigned int space = l->ring_size - (head - tts_atomic_load(&l->tail));
+    float sum;
+    int i, c, n = frames;
+
+    if ((unsigned int) n > space) {
+        l->overruns += n - space;
+        n = (int) space;
+    }
+    if (channels == 1) {
+        for (i = 0; i < n; i++) l->ring[(head + i) & mask] = samples[i];
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            sum = 0;
+            for (c = 0; c < channels; c++) sum += samples[i * channels + c];
+            l->ring[(head + i) & mask] = sum / channels;
+        }
+    }
+    tts_atomic_store(&l->head, head + n);
+    return n;
+}
+
+LS_EXPORT int ls_live_weights(ls_live * l, float * weights) {
+    unsigned int tail = l->queue_tail, head = tts_atomic_load(&l->queue_head);
+    if (head == tail) return 0;
+    memcpy(weights, l->queue[(head - 1) & (LS_LIVE_QUEUE - 1)], LS_PHONEME_COUNT * sizeof(float));
+    tts_atomic_store(&l->queue_tail, head);
+    return (int) (head - tail);
+}
+
+LS_EXPORT float ls_live_latency(const ls_live * l) {
+    return (l->hop_len + l->frame_len / 2 + l->lookahead * l->hop_len) / (float) l->sample_rate +
+           LS_LIVE_POLL / 1000.0f;
+}
+
+LS_EXPORT int ls_live_overruns(const ls_live * l) {
+    return (int) l->overruns;
+}
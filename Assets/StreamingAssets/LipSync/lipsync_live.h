@@ -0,0 +1,73 @@
+/* Real-time viseme estimation from a live voice (LiveLipSync.cs).
+
+   Every other path of the component animates from a timeline known in
+   advance (CereVoice transcription, MAUS or clip_aligner TextGrids), so
+   a voice heard for the first time, a VoIP peer or a streamer, cannot
+   drive a character.  Here the visemes are guessed from the sound
+   itself, frame by frame:
+
+     - Unity's audio thread pushes the captured samples into a single
+       producer/single consumer ring; the push never locks or allocates,
+       and drops what does not fit rather than wait (the drops are
+       counted);
+     - a worker thread takes a hop of 10 ms at a time and computes the
+       level of the last 25 ms, the energy of five bands of its power
+       spectrum (the vector kernels of lipsync_simd.h) and the F0 of the
+       streaming tracker of lipsync_pitch.h on a shorter 40 ms frame
+       without smoothing;
+     - each frame is classified into the Phoneme classes that can be
+       told apart from those features: silence (Rest) against an
+       adaptive noise floor, sibilants (SSS, SSH) and FFF from the high
+       bands of unvoiced frames, T for other unvoiced sounds, MMM/N for
+       voiced frames with almost all their energy below 300 Hz, and the
+       vowels by the nearness of their openness (300-900 Hz share) and
+       frontness (above 900 Hz share) to a prototype of each;
+     - the class weights of a frame are averaged with those of the
+       frame before and the lookahead frames after it, eased with a
+       fast attack and a slower release, and published through a
+       second ring that the game thread drains without blocking.
+
+   Latency from a sound to its weights is one hop, half a frame, the
+   lookahead and the worker's polling interval: 45 ms with the default
+   lookahead of 2 frames, to which the audio buffer of Unity adds about
+   10 ms at 48 kHz.
+
+   Unity calls these through P/Invoke; the shared library build is given
+   in lipsync_pitch.h.
+*/
+
+#ifndef LIPSYNC_LIVE_H
+#define LIPSYNC_LIVE_H
+
+#include "lipsync_phoneme.h"
+
+#define LS_LIVE_FRAME 0.025f          /* spectral frame, seconds */
+#define LS_LIVE_HOP 0.010f            /* seconds */
+#define LS_LIVE_PITCH_FRAME 0.040f    /* seconds, down to 50 Hz */
+#define LS_LIVE_MAX_LOOKAHEAD 6       /* frames */
+#define LS_LIVE_POLL 2                /* ms the worker waits for a hop */
+#define LS_LIVE_QUEUE 16              /* published frames, power of two */
+#define LS_LIVE_BANDS 5
+
+typedef struct ls_live ls_live;
+
+/* Starts the worker for audio at sample_rate, classifying with
+   lookahead frames after each one (clamped to LS_LIVE_MAX_LOOKAHEAD).
+   Returns NULL if the thread cannot be started. */
+LS_EXPORT ls_live * ls_live_new(int sample_rate, int lookahead);
+LS_EXPORT void ls_live_delete(ls_live * l);
+/* Adds frames of interleaved samples, mixed down to mono.  Called from
+   the capture thread only.  Returns the number of frames taken, fewer
+   if the ring is full. */
+LS_EXPORT int ls_live_push(ls_live * l, const float * samples, int frames, int channels);
+/* Copies the latest weights, LS_PHONEME_COUNT values in [0, 1], and
+   discards the older ones.  Called from one thread only.  Returns the
+   number of frames published since the last call, 0 if weights is
+   unchanged. */
+LS_EXPORT int ls_live_weights(ls_live * l, float * weights);
+/* Delay from a sound to its weights, seconds, Unity's buffer excluded */
+LS_EXPORT float ls_live_latency(const ls_live * l);
+/* Capture frames dropped because the ring was full */
+LS_EXPORT int ls_live_overruns(const ls_live * l);
+
+#endif /* LIPSYNC_LIVE_H */
@@ -0,0 +1,257 @@
+/* MFCC features.
+   See lipsync_mfcc.h. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lipsync_mfcc.h"
+#include "lipsync_simd.h"
+
+#define LOG_FLOOR 1e-10f
+#define DELTA_SPAN 2
+
+void ls_mfcc_config_default(ls_mfcc_config * cfg) {
+    cfg->frame = 0.025f;
+    cfg->hop = 0.010f;
+    cfg->preemphasis = 0.97f;
+    cfg->filters = 26;
+    cfg->low = 60;
+    cfg->high = 7600;
+}
+
+/* Window, transform and filterbank tables for one sample rate */
+typedef struct mfcc_tables {
+    int frame_len, hop_len, fft_len, bins, filters;
+    float * window;
+    float * cos_tab, * sin_tab;   /* fft_len / 2 twiddles */
+    int * reverse;                /* bit reversal permutation */
+    int * lo, * len;              /* filter m covers bins lo[m] .. lo[m] + len[m] - 1 */
+    float * weights;              /* filters rows of bins weights */
+    float * dct;                  /* LS_MFCC_CEPSTRA rows of filters */
+} mfcc_tables;
+
+static float hz_to_mel(float hz) {
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float mel_to_hz(float mel) {
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+static void tables_init(mfcc_tables * t, const ls_mfcc_config * cfg, int sample_rate) {
+    float high = cfg->high < sample_rate / 2.0f ? cfg->high : sample_rate / 2.0f;
+    float mel_low = hz_to_mel(cfg->low), mel_high = hz_to_mel(high);
+    float left, centre, right, hz, w;
+    int i, j, m, bits = 0;
+
+    t->frame_len = (int) (cfg->frame * sample_rate + 0.5f);
+    t->hop_len = (int) (cfg->hop * sample_rate + 0.5f);
+    if (t->hop_len < 1) t->hop_len = 1;
+    for (t->fft_len = 1; t->fft_len < t->frame_len; t->fft_len <<= 1) bits++;
+    t->bins = t->fft_len / 2 + 1;
+    t->filters = cfg->filters;
+
+    t->window = malloc(t->frame_len * sizeof(float));
+    for (i = 0; i < t->frame_len; i++)
+        t->window[i] = (float) (0.54 - 0.46 * cos(2.0 * M_PI * i / (t->frame_len - 1)));
+
+    t->cos_tab = malloc((t->fft_len / 2 + 1) * sizeof(float));
+    t->sin_tab = malloc((t->fft_len / 2 + 1) * sizeof(float));
+    for (i = 0; i < t->fft_len / 2; i++) {
+        t->cos_tab[i] = (float) cos(2.0 * M_PI * i / t->fft_len);
+        t->sin_tab[i] = (float) sin(2.0 * M_PI * i / t->fft_len);
+    }
+    t->reverse = malloc(t->fft_len * sizeof(int));
+    for (i = 0; i < t->fft_len; i++) {
+        t->reverse[i] = 0;
+        for (j = 0; j < bits; j++)
+            if (i & (1 << j)) t->reverse[i] |= 1 << (bits - 1 - j);
+    }
+
+    /* triangles evenly spaced on the mel scale, in Hz between their
+       neighbours' centres */
+    t->lo = malloc(t->filters * sizeof(int));
+    t->len = malloc(t->filters * sizeof(int));
+    t->weights = calloc((size_t) t->filters * t->bins, sizeof(float));
+    for (m = 0; m < t->filters; m++) {
+        left = mel_to_hz(mel_low + (mel_high - mel_low) * m / (t->filters + 1));
+        centre = mel_to_hz(mel_low + (mel_high - mel_low) * (m + 1) / (t->filters + 1));
+        right = mel_to_hz(mel_low + (mel_high - mel_low) * (m + 2) / (t->filters + 1));
+        t->lo[m] = t->bins;
+        t->len[m] = 0;
+        for (i = 0; i < t->bins; i++) {
+            hz = i * (float) sample_rate / t->fft_len;
+            if (hz <= left || hz >= right) continue;
+            w = hz < centre ? (hz - left) / (centre - left) : (right - hz) / (right - centre);
+            t->weights[(size_t) m * t->bins + i] = w;
+            if (i < t->lo[m]) t->lo[m] = i;
+            t->len[m] = i - t->lo[m] + 1;
+        }
+        if (t->lo[m] == t->bins) t->lo[m] = 0;
+    }
+
+    t->dct = malloc(LS_MFCC_CEPSTRA * t->filters * sizeof(float));
+    for (i = 0; i < LS_MFCC_CEPSTRA; i++)
+        for (m = 0; m < t->filters; m++)
+            t->dct[i * t->filters + m] = (float) cos(M_PI * i * (m + 0.5) / t->filters);
+}
+
+static void tables_free(mfcc_tables * t) {
+    free(t->window);
+    free(t->cos_tab);
+    free(t->sin_tab);
+    free(t->reverse);
+    free(t->lo);
+    free(t->len);
+    free(t->weights);
+    free(t->dct);
+}
+
+/* In-place radix-2 transform of fft_len complex values */
+static void fft(const mfcc_tables * t, float * re, float * im) {
+    int n = t->fft_len, i, j, k, len, half, step, a, b;
+    float wr, wi, xr, xi, tmp;
+
+    for (i = 0; i < n; i++) {
+        j = t->reverse[i];
+        if (j <= i) continue;
+        tmp = re[i]; re[i] = re[j]; re[j] = tmp;
+        tmp = im[i]; im[i] = im[j]; im[j] = tmp;
+    }
+    for (len = 2; len <= n; len <<= 1) {
+        half = len >> 1;
+        step = n / len;
+        for (i = 0; i < n; i += len) {
+            for (k = 0; k < half; k++) {
+                wr = t->cos_tab[k * step];
+                wi = -t->sin_tab[k * step];
+                a = i + k;
+                b = a + half;
+                xr = re[b] * wr - im[b] * wi;
+                xi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - xr;
+                im[b] = im[a] - xi;
+                re[a] += xr;
+                im[a] += xi;
+            }
+        }
+    }
+}
+
+/* Cepstra of the frame centred on sample centre of the pre-emphasised
+   signal x */
+static void frame_cepstra(const mfcc_tables * t, const float * x, long count, long centre,
+                          float * re, float * im, float * energies, float * out) {
+    long start = centre - t->frame_len / 2, i;
+    int m;
+
+    memset(re, 0, t->fft_len * sizeof(float));
+    memset(im, 0, t->fft_len * sizeof(float));
+    for (i = 0; i < t->frame_len; i++)
+        if (start + i >= 0 && start + i < count) re[i] = x[start + i];
+    ls_mul(re, t->window, re, t->frame_len);
+    fft(t, re, im);
+
+    /* power spectrum, kept in re */
+    ls_mul(re, re, re, t->bins);
+    ls_mul(im, im, im, t->bins);
+    for (i = 0; i < t->bins; i++) re[i] += im[i];
+
+    for (m = 0; m < t->filters; m++) {
+        float e = ls_dot(re + t->lo[m], t->weights + (size_t) m * t->bins + t->lo[m], t->len[m]);
+        energies[m] = logf(e > LOG_FLOOR ? e : LOG_FLOOR);
+    }
+    for (m = 0; m < LS_MFCC_CEPSTRA; m++)
+        out[m] = ls_dot(t->dct + m * t->filters, energies, t->filters);
+}
+
+/* Regression deltas over DELTA_SPAN frames each side, the edges
+   repeated */
+static void add_deltas(ls_features * f) {
+    int k, q, s, prev, next;
+    float norm = 0;
+
+    for (s = 1; s <= DELTA_SPAN; s++) norm += 2.0f * s * s;
+    for (k = 0; k < f->count; k++) {
+        float * out = f->data + (long) k * LS_MFCC_STRIDE + LS_MFCC_CEPSTRA;
+        for (q = 0; q < LS_MFCC_CEPSTRA; q++) out[q] = 0;
+        for (s = 1; s <= DELTA_SPAN; s++) {
+            const float * a, * b;
+            next = k + s < f->count ? k + s : f->count - 1;
+            prev = k - s >= 0 ? k - s : 0;
+            a = ls_features_frame(f, next);
+            b = ls_features_frame(f, prev);
+            for (q = 0; q < LS_MFCC_CEPSTRA; q++) out[q] += s * (a[q] - b[q]);
+        }
+        for (q = 0; q < LS_MFCC_CEPSTRA; q++) out[q] /= norm;
+    }
+}
+
+/* Zero mean, unit variance per coefficient over the clip */
+static void normalise(ls_features * f) {
+    double sum[LS_MFCC_DIM], sq[LS_MFCC_DIM];
+    float mean[LS_MFCC_DIM], scale[LS_MFCC_DIM];
+    int k, q;
+
+    memset(sum, 0, sizeof(sum));
+    memset(sq, 0, sizeof(sq));
+    for (k = 0; k < f->count; k++) {
+        const float * v = ls_features_frame(f, k);
+        for (q = 0; q < LS_MFCC_DIM; q++) {
+            sum[q] += v[q];
+            sq[q] += (double) v[q] * v[q];
+        }
+    }
+    for (q = 0; q < LS_MFCC_DIM; q++) {
+        double m = sum[q] / f->count, var = sq[q] / f->count - m * m;
+        mean[q] = (float) m;
+        scale[q] = var > 1e-12 ? (float) (1.0 / sqrt(var)) : 1.0f;
+    }
+    for (k = 0; k < f->count; k++) {
+        float * v = f->data + (long) k * LS_MFCC_STRIDE;
+        for (q = 0; q < LS_MFCC_DIM; q++) v[q] = (v[q] - mean[q]) * scale[q];
+    }
+}
+
+int ls_mfcc_extract(ls_features * f, const ls_audio * a, const ls_mfcc_config * cfg) {
+    ls_mfcc_config defaults;
+    mfcc_tables t;
+    float * x, * re, * im, * energies;
+    long i;
+    int k;
+
+    memset(f, 0, sizeof(ls_features));
+    if (!cfg) {
+        ls_mfcc_config_default(&defaults);
+        cfg = &defaults;
+    }
+    tables_init(&t, cfg, a->sample_rate);
+    f->hop = t.hop_len / (float) a->sample_rate;
+    f->count = (int) (a->count / t.hop_len) + 1;
+    f->data = calloc((size_t) f->count * LS_MFCC_STRIDE, sizeof(float));
+
+    x = malloc((a->count + 1) * sizeof(float));
+    for (i = 0; i < a->count; i++)
+        x[i] = a->samples[i] - (i > 0 ? cfg->preemphasis * a->samples[i - 1] : 0);
+    re = malloc(t.fft_len * sizeof(float));
+    im = malloc(t.fft_len * sizeof(float));
+    energies = malloc(t.filters * sizeof(float));
+
+    for (k = 0; k < f->count; k++)
+        frame_cepstra(&t, x, a->count, (long) k * t.hop_len, re, im, energies,
+                      f->data + (long) k * LS_MFCC_STRIDE);
+    add_deltas(f);
+    normalise(f);
+
+    free(x);
+    free(re);
+    free(im);
+    free(energies);
+    tables_free(&t);
+    return f->count;
+}
+
+void ls_features_free(ls_features * f) {
+    free(f->data);
+    memset(f, 0, sizeof(ls_features));
+}
@@ -0,0 +1,50 @@
+/* MFCC features for the forced aligner (see lipsync_align.h).
+
+   The usual speech front end: frames of 25 ms every 10 ms centred on
+   their time, pre-emphasis, Hamming window, power spectrum, 26 mel
+   filters between 60 and 7600 Hz, log and DCT to 13 cepstra, plus
+   their deltas.  Each coefficient is normalised to zero mean and unit
+   variance over the clip, which removes most of the difference between
+   a recording and the synthesized reference it is aligned to (channel,
+   level, and the spectral resolution at different sample rates).
+
+   Frames are stored LS_MFCC_STRIDE floats apart with the padding
+   zeroed, so the distance kernel of lipsync_simd.h runs on whole
+   vectors.
+*/
+
+#ifndef LIPSYNC_MFCC_H
+#define LIPSYNC_MFCC_H
+
+#include "lipsync_audio.h"
+
+#define LS_MFCC_CEPSTRA 13
+#define LS_MFCC_DIM (2 * LS_MFCC_CEPSTRA)   /* cepstra and deltas */
+#define LS_MFCC_STRIDE 32
+
+typedef struct ls_mfcc_config {
+    float frame;          /* seconds */
+    float hop;            /* seconds */
+    float preemphasis;
+    int filters;
+    float low, high;      /* filterbank range, Hz */
+} ls_mfcc_config;
+
+void ls_mfcc_config_default(ls_mfcc_config * cfg);
+
+typedef struct ls_features {
+    int count;            /* frames, frame k is centred on k * hop */
+    float hop;            /* seconds */
+    float * data;         /* count * LS_MFCC_STRIDE */
+} ls_features;
+
+/* Features of a loaded clip, cfg NULL for the defaults.  Returns the
+   number of frames. */
+int ls_mfcc_extract(ls_features * f, const ls_audio * a, const ls_mfcc_config * cfg);
+void ls_features_free(ls_features * f);
+
+static inline const float * ls_features_frame(const ls_features * f, int k) {
+    return f->data + (long) k * LS_MFCC_STRIDE;
+}
+
+#endif /* LIPSYNC_MFCC_H */
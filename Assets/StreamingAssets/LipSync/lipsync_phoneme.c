@@ -0,0 +1,156 @@
+/* Phoneme set of the lip sync component for the native tools.
+   See lipsync_phoneme.h. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lipsync_phoneme.h"
+
+#define V LS_CLASS_VOWEL
+#define P LS_CLASS_PLOSIVE
+#define H LS_CLASS_LIP_HEAVY
+#define LL LS_CLASS_LIP_LIGHT
+#define C LS_CLASS_CONSONANT
+#define A LS_CLASS_ALVEORAL
+#define D LS_CLASS_DIPHONE
+
+const ls_phoneme_info ls_phonemes[LS_PHONEME_COUNT] = {
+    {"AAA",        V,          0.7f},
+    {"AHH",        V,          0.7f},
+    {"UUU",        V | H,      1.0f},
+    {"RRR",        C | A,      0.1f},
+    {"T",          P | LL | C, 0.5f},
+    {"TH",         P | LL | C, 0.5f},
+    {"FFF",        P | LL | C, 0.5f},
+    {"EHH",        V,          0.75f},
+    {"OHH",        V | H,      1.0f},
+    {"IEE",        V,          0.8f},
+    {"SSS",        P | C,      0.1f},
+    {"SSH",        H | C,      1.0f},
+    {"MMM",        P | LL | C, 0.5f},
+    {"Schwa",      V,          1.0f},
+    {"L",          LL | C | A, 0.5f},
+    {"N",          LL | C | A, 0.5f},
+    {"GK",         P | LL | C | A, 0.5f},
+    {"DiphoneAI",  D,          0},
+    {"DiphoneAU",  D,          0},
+    {"DiphoneOI",  D,          0},
+    {"DiphoneOU",  D,          0},
+    {"DiphoneEI",  D,          0},
+    {"DiphoneX",   D,          0},
+    {"DiphoneIA",  D,          0},
+    {"DiphoneUA",  D,          0},
+    {"DiphoneEA",  D,          0},
+    {"Rest",       0,          0}
+};
+
+#undef V
+#undef P
+#undef H
+#undef LL
+#undef C
+#undef A
+#undef D
+
+typedef struct phone_map {
+    const char * phone;
+    ls_phoneme phoneme;
+} phone_map;
+
+/* CereVoice and X-SAMPA names, sorted for bsearch */
+static const phone_map phone_table[] = {
+    {"3:", LS_EHH},
+    {"3`", LS_EHH},
+    {"6", LS_SCHWA},
+    {"@", LS_SCHWA},
+    {"@@", LS_SCHWA},
+    {"@U", LS_DIPHONE_OU},
+    {"A:", LS_AAA},
+    {"D", LS_TH},
+    {"E", LS_EHH},
+    {"I", LS_IEE},
+    {"I@", LS_DIPHONE_IA},
+    {"N", LS_GK},
+    {"O:", LS_OHH},
+    {"OI", LS_DIPHONE_OI},
+    {"Q", LS_AAA},
+    {"R", LS_RRR},
+    {"S", LS_SSH},
+    {"T", LS_T},
+    {"U", LS_UUU},
+    {"U@", LS_DIPHONE_UA},
+    {"V", LS_SCHWA},
+    {"Z", LS_SSH},
+    {"a", LS_AHH},
+    {"aI", LS_DIPHONE_AI},
+    {"aU", LS_DIPHONE_AU},
+    {"aa", LS_AHH},
+    {"ai", LS_DIPHONE_AI},
+    {"au", LS_DIPHONE_AU},
+    {"b", LS_MMM},
+    {"ch", LS_SSH},
+    {"d", LS_T},
+    {"dZ", LS_SSH},
+    {"dh", LS_TH},
+    {"e", LS_EHH},
+    {"e@", LS_DIPHONE_EA},
+    {"eI", LS_DIPHONE_EI},
+    {"ei", LS_DIPHONE_EI},
+    {"f", LS_FFF},
+    {"g", LS_GK},
+    {"h", LS_GK},
+    {"h\\", LS_GK},
+    {"i", LS_IEE},
+    {"i:", LS_IEE},
+    {"ii", LS_IEE},
+    {"j", LS_UUU},
+    {"jh", LS_SSH},
+    {"k", LS_GK},
+    {"l", LS_L},
+    {"l=", LS_L},
+    {"m", LS_MMM},
+    {"m=", LS_MMM},
+    {"n", LS_N},
+    {"n=", LS_N},
+    {"ng", LS_GK},
+    {"o", LS_OHH},
+    {"oi", LS_DIPHONE_OI},
+    {"oo", LS_OHH},
+    {"ou", LS_DIPHONE_OU},
+    {"p", LS_MMM},
+    {"r", LS_RRR},
+    {"r\\", LS_RRR},
+    {"s", LS_SSS},
+    {"sh", LS_SSH},
+    {"t", LS_T},
+    {"tS", LS_SSH},
+    {"th", LS_TH},
+    {"u", LS_UUU},
+    {"u:", LS_UUU},
+    {"uh", LS_UUU},
+    {"uu", LS_UUU},
+    {"v", LS_FFF},
+    {"w", LS_UUU},
+    {"x", LS_DIPHONE_X},
+    {"y", LS_IEE},
+    {"z", LS_SSS},
+    {"zh", LS_SSH},
+    {"{", LS_AAA},
+};
+
+static int phone_compare(const void * key, const void * entry) {
+    return strcmp((const char *) key, ((const phone_map *) entry)->phone);
+}
+
+ls_phoneme ls_phoneme_map(const char * phone) {
+    const phone_map * m = bsearch(phone, phone_table, sizeof(phone_table) / sizeof(phone_table[0]),
+                                  sizeof(phone_map), phone_compare);
+    return m ? m->phoneme : LS_REST;
+}
+
+int ls_phoneme_parse(const char * name) {
+    int i;
+    for (i = 0; i < LS_PHONEME_COUNT; i++) {
+        if (strcmp(ls_phonemes[i].name, name) == 0) return i;
+    }
+    return -1;
+}
@@ -0,0 +1,95 @@
+/* Phoneme set of the lip sync component for the native tools.
+
+   The enumeration follows the order of the C# Phoneme enum, so values
+   can be exchanged with the Unity side as plain integers.  The class
+   table replaces the Enum.IsDefined(typeof(Vowel), ...) style lookups
+   with one bit test; it mirrors the Vowel, PlosiveFricative, LipHeavy,
+   LipLight, Consonant and Alveorals enums, including their quirks
+   (SSH is not a plosive/fricative because that enum spells it SHH).
+*/
+
+#ifndef LIPSYNC_PHONEME_H
+#define LIPSYNC_PHONEME_H
+
+/* Functions called from Unity through P/Invoke when the modules are
+   built as the lipsync shared library */
+#ifdef _WIN32
+#define LS_EXPORT __declspec(dllexport)
+#else
+#define LS_EXPORT __attribute__((visibility("default")))
+#endif
+
+typedef enum ls_phoneme {
+    LS_AAA,
+    LS_AHH,
+    LS_UUU,
+    LS_RRR,
+    LS_T,
+    LS_TH,
+    LS_FFF,
+    LS_EHH,
+    LS_OHH,
+    LS_IEE,
+    LS_SSS,
+    LS_SSH,
+    LS_MMM,
+    LS_SCHWA,
+    LS_L,
+    LS_N,
+    LS_GK,
+    LS_DIPHONE_AI,
+    LS_DIPHONE_AU,
+    LS_DIPHONE_OI,
+    LS_DIPHONE_OU,
+    LS_DIPHONE_EI,
+    LS_DIPHONE_X,
+    LS_DIPHONE_IA,
+    LS_DIPHONE_UA,
+    LS_DIPHONE_EA,
+    LS_REST,
+    LS_PHONEME_COUNT
+} ls_phoneme;
+
+/* Phoneme classes */
+#define LS_CLASS_VOWEL      0x01
+#define LS_CLASS_PLOSIVE    0x02 /* plosives and fricatives */
+#define LS_CLASS_LIP_HEAVY  0x04
+#define LS_CLASS_LIP_LIGHT  0x08
+#define LS_CLASS_CONSONANT  0x10
+#define LS_CLASS_ALVEORAL   0x20
+#define LS_CLASS_DIPHONE    0x40
+
+typedef struct ls_phoneme_info {
+    const char * name;   /* C# enum name, as used in the XML mappings */
+    unsigned int classes;
+    float influence;     /* PhonemeInformation.GetPhonemicInfluence */
+} ls_phoneme_info;
+
+extern const ls_phoneme_info ls_phonemes[LS_PHONEME_COUNT];
+
+static inline int ls_phoneme_is(ls_phoneme p, unsigned int classes) {
+    return (unsigned int) p < LS_PHONEME_COUNT && (ls_phonemes[p].classes & classes) != 0;
+}
+
+static inline const char * ls_phoneme_name(ls_phoneme p) {
+    return (unsigned int) p < LS_PHONEME_COUNT ? ls_phonemes[p].name : "Rest";
+}
+
+/* A timed phoneme, as PhonemeInformation */
+typedef struct ls_segment {
+    ls_phoneme phoneme;
+    float start;           /* seconds */
+    float end;
+    float mean_pitch;      /* 0 if not analysed */
+    float mean_intensity;
+} ls_segment;
+
+/* Maps a CereVoice or X-SAMPA (MAUS) phone name, as
+   PhonemeInformation.MapPhoneme.  Unknown names map to LS_REST. */
+ls_phoneme ls_phoneme_map(const char * phone);
+
+/* Parses a C# enum name such as "AHH" or "DiphoneAI".  Returns -1 if
+   the name is not a phoneme. */
+int ls_phoneme_parse(const char * name);
+
+#endif /* LIPSYNC_PHONEME_H */
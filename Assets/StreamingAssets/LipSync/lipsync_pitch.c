@@ -0,0 +1,271 @@
+/* F0 and loudness extraction.
+   See lipsync_pitch.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lipsync_pitch.h"
+#include "lipsync_simd.h"
+
+#define PITCH_RATE 16000        /* autocorrelation sample rate, at most */
+#define LOUDNESS_REF 0.000001f  /* openSMILE cIntensity I0 */
+#define SMOOTH_MAX 9
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct ls_pitch {
+    ls_pitch_config cfg;
+    int frame_len;     /* samples at the input rate */
+    int hop_len;
+    int decimation;
+    int pitch_len;     /* samples of the decimated frame */
+    float pitch_rate;
+    int lag_min;
+    int lag_max;
+
+    float * hamming;
+    float hamming_sum;
+    float * gauss;
+    float * window_acf; /* normalised autocorrelation of the window */
+    float * work;       /* frame_len */
+    float * acf;        /* lag_max + 2 */
+
+    /* pending input, frames start at buf[start] */
+    float * buf;
+    long start;
+    long count;
+    long cap;
+    long frames;        /* frames analysed in this stream */
+
+    /* raw values of the last frames for the moving average, indexed
+       by frame number modulo SMOOTH_MAX */
+    float raw_f0[SMOOTH_MAX];
+    float raw_loudness[SMOOTH_MAX];
+};
+
+void ls_pitch_config_default(ls_pitch_config * cfg, int sample_rate) {
+    cfg->sample_rate = sample_rate;
+    cfg->frame = 0.050f;
+    cfg->hop = 0.010f;
+    cfg->min_f0 = 52.0f;
+    cfg->max_f0 = 500.0f;
+    cfg->voicing_cutoff = 0.55f;
+    cfg->smooth = 3;
+}
+
+ls_pitch * ls_pitch_new(const ls_pitch_config * cfg) {
+    ls_pitch * p = calloc(1, sizeof(ls_pitch));
+    float centre, sigma, x;
+    int i, lag;
+
+    p->cfg = *cfg;
+    if (p->cfg.smooth < 1) p->cfg.smooth = 1;
+    if (p->cfg.smooth > SMOOTH_MAX) p->cfg.smooth = SMOOTH_MAX;
+    if ((p->cfg.smooth & 1) == 0) p->cfg.smooth++;
+    p->frame_len = (int) (cfg->frame * cfg->sample_rate + 0.5f);
+    p->hop_len = (int) (cfg->hop * cfg->sample_rate + 0.5f);
+    if (p->hop_len < 1) p->hop_len = 1;
+    p->decimation = cfg->sample_rate > PITCH_RATE ? cfg->sample_rate / PITCH_RATE : 1;
+    p->pitch_len = p->frame_len / p->decimation;
+    p->pitch_rate = cfg->sample_rate / (float) p->decimation;
+    p->lag_min = (int) (p->pitch_rate / cfg->max_f0);
+    p->lag_max = (int) ceilf(p->pitch_rate / cfg->min_f0);
+    if (p->lag_min < 2) p->lag_min = 2;
+    /* beyond half a frame the window correction is unreliable */
+    if (p->lag_max > p->pitch_len / 2) p->lag_max = p->pitch_len / 2;
+
+    p->hamming = malloc(p->frame_len * sizeof(float));
+    p->hamming_sum = 0;
+    for (i = 0; i < p->frame_len; i++) {
+        p->hamming[i] = (float) (0.54 - 0.46 * cos(2.0 * M_PI * i / (p->frame_len - 1)));
+        p->hamming_sum += p->hamming[i];
+    }
+
+    p->gauss = malloc(p->pitch_len * sizeof(float));
+    centre = (p->pitch_len - 1) / 2.0f;
+    sigma = 0.4f * centre;
+    for (i = 0; i < p->pitch_len; i++) {
+        x = (i - centre) / sigma;
+        p->gauss[i] = expf(-0.5f * x * x);
+    }
+    p->window_acf = malloc((p->lag_max + 2) * sizeof(float));
+    for (lag = 0; lag < p->lag_max + 2; lag++)
+        p->window_acf[lag] = ls_dot(p->gauss, p->gauss + lag, p->pitch_len - lag);
+    for (lag = p->lag_max + 1; lag >= 0; lag--) p->window_acf[lag] /= p->window_acf[0];
+
+    p->work = malloc(p->frame_len * sizeof(float));
+    p->acf = malloc((p->lag_max + 2) * sizeof(float));
+    p->cap = p->frame_len * 4;
+    p->buf = malloc(p->cap * sizeof(float));
+    return p;
+}
+
+void ls_pitch_delete(ls_pitch * p) {
+    if (!p) return;
+    free(p->hamming);
+    free(p->gauss);
+    free(p->window_acf);
+    free(p->work);
+    free(p->acf);
+    free(p->buf);
+    free(p);
+}
+
+/* openSMILE cIntensity loudness */
+static float frame_loudness(ls_pitch * p, const float * x) {
+    float intensity;
+    ls_mul(x, x, p->work, p->frame_len);
+    intensity = ls_dot(p->work, p->hamming, p->frame_len) / p->hamming_sum;
+    return powf(intensity / LOUDNESS_REF, 0.3f);
+}
+
+/* Autocorrelation pitch of one frame, 0 if unvoiced */
+static float frame_f0(ls_pitch * p, const float * x) {
+    float * d = p->work;
+    float mean, energy, best = 0, a, b, c, delta;
+    int i, k, lag, best_lag = 0;
+
+    /* decimate by averaging, which also low-passes the signal */
+    for (i = 0; i < p->pitch_len; i++) {
+        a = 0;
+        for (k = 0; k < p->decimation; k++) a += x[i * p->decimation + k];
+        d[i] = a / p->decimation;
+    }
+    mean = ls_sum(d, p->pitch_len) / p->pitch_len;
+    for (i = 0; i < p->pitch_len; i++) d[i] -= mean;
+    ls_mul(d, p->gauss, d, p->pitch_len);
+
+    energy = ls_dot(d, d, p->pitch_len);
+    if (energy <= 1e-10f) return 0;
+
+    /* normalised and corrected for the window, so a periodic signal
+       peaks near 1 at its period */
+    for (lag = p->lag_min - 1; lag <= p->lag_max + 1; lag++)
+        p->acf[lag] = ls_dot(d, d + lag, p->pitch_len - lag) / (energy * p->window_acf[lag]);
+
+    for (lag = p->lag_min; lag <= p->lag_max; lag++) {
+        if (p->acf[lag] > best && p->acf[lag] >= p->acf[lag - 1] && p->acf[lag] >= p->acf[lag + 1]) {
+            best = p->acf[lag];
+            best_lag = lag;
+        }
+    }
+    if (!best_lag || best < p->cfg.voicing_cutoff) return 0;
+
+    /* parabolic interpolation of the peak */
+    a = p->acf[best_lag - 1];
+    b = p->acf[best_lag];
+    c = p->acf[best_lag + 1];
+    delta = a - 2 * b + c;
+    delta = delta < 0 ? 0.5f * (a - c) / delta : 0;
+    return p->pitch_rate / (best_lag + delta);
+}
+
+/* Appends frame k averaged over its neighbours up to frame last */
+static void emit_smoothed(ls_pitch * p, long k, long last, ls_contour * c) {
+    int half = p->cfg.smooth / 2, n = 0;
+    float f0 = 0, loudness = 0;
+    long j;
+    for (j = k - half < 0 ? 0 : k - half; j <= k + half && j <= last; j++) {
+        f0 += p->raw_f0[j % SMOOTH_MAX];
+        loudness += p->raw_loudness[j % SMOOTH_MAX];
+        n++;
+    }
+    ls_contour_append(c, k * p->cfg.hop, f0 / n, loudness / n);
+}
+
+/* Analyses one frame and emits the frame half a window back, whose
+   neighbours are now all known.  Returns the number of frames emitted. */
+static int analyse_frame(ls_pitch * p, const float * x, ls_contour * c) {
+    int half = p->cfg.smooth / 2;
+    long j = p->frames++;
+
+    p->raw_f0[j % SMOOTH_MAX] = frame_f0(p, x);
+    p->raw_loudness[j % SMOOTH_MAX] = frame_loudness(p, x);
+    if (j < half) return 0;
+    emit_smoothed(p, j - half, j, c);
+    return 1;
+}
+
+int ls_pitch_push(ls_pitch * p, const float * samples, long n, ls_contour * c) {
+    int emitted = 0;
+
+    if (p->count + n > p->cap) {
+        /* drop consumed samples first, then grow if needed */
+        memmove(p->buf, p->buf + p->start, (p->count - p->start) * sizeof(float));
+        p->count -= p->start;
+        p->start = 0;
+        while (p->count + n > p->cap) p->cap *= 2;
+        p->buf = realloc(p->buf, p->cap * sizeof(float));
+    }
+    memcpy(p->buf + p->count, samples, n * sizeof(float));
+    p->count += n;
+
+    while (p->count - p->start >= p->frame_len) {
+        emitted += analyse_frame(p, p->buf + p->start, c);
+        p->start += p->hop_len;
+    }
+    return emitted;
+}
+
+int ls_pitch_flush(ls_pitch * p, ls_contour * c) {
+    int emitted = 0, half = p->cfg.smooth / 2;
+    float * zeros;
+    long k, last;
+
+    /* frame_len - 1 zeros complete exactly the frames that start
+       before the end of the audio */
+    if (p->count > p->start) {
+        zeros = calloc(p->frame_len, sizeof(float));
+        emitted += ls_pitch_push(p, zeros, p->frame_len - 1, c);
+        free(zeros);
+    }
+
+    /* the last frames average over fewer neighbours */
+    last = p->frames - 1;
+    for (k = last - half + 1 < 0 ? 0 : last - half + 1; k <= last; k++) {
+        emit_smoothed(p, k, last, c);
+        emitted++;
+    }
+
+    p->start = p->count = 0;
+    p->frames = 0;
+    return emitted;
+}
+
+int ls_contour_extract(ls_contour * c, const ls_audio * a, float hop) {
+    ls_pitch_config cfg;
+    ls_pitch * p;
+
+    memset(c, 0, sizeof(ls_contour));
+    ls_pitch_config_default(&cfg, a->sample_rate);
+    if (hop > 0) cfg.hop = hop;
+    p = ls_pitch_new(&cfg);
+    ls_pitch_push(p, a->samples, a->count, c);
+    ls_pitch_flush(p, c);
+    ls_pitch_delete(p);
+    return c->count;
+}
+
+LS_EXPORT int ls_extract_prosody(const char * wav_path, float hop_ms,
+                                 float ** time, float ** f0, float ** loudness) {
+    ls_audio audio;
+    ls_contour contour;
+
+    *time = *f0 = *loudness = NULL;
+    if (ls_audio_load_wav(&audio, wav_path) != 0) return -1;
+    ls_contour_extract(&contour, &audio, hop_ms / 1000.0f);
+    ls_audio_free(&audio);
+    *time = contour.time;
+    *f0 = contour.f0;
+    *loudness = contour.loudness;
+    return contour.count;
+}
+
+LS_EXPORT void ls_free_prosody(float * time, float * f0, float * loudness) {
+    free(time);
+    free(f0);
+    free(loudness);
+}
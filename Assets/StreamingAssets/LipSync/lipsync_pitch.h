@@ -0,0 +1,70 @@
+/* F0 and loudness extraction, in place of the openSMILE prosodyAcf
+   configuration that SpeechAnalysis runs through SMILExtract.
+
+   The tracker follows that configuration: 50 ms frames every 10 ms,
+   frame times at the frame start, loudness as (intensity / 1e-6)^0.3 of
+   the Hamming weighted frame, F0 from the autocorrelation of a Gaussian
+   windowed frame (sigma 0.4) between 52 and 500 Hz with a voicing
+   cutoff of 0.55 (F0 is 0 when unvoiced), and a 3 frame moving average
+   on both outputs.  The autocorrelation is computed on the signal
+   decimated to at most 16 kHz, which is enough for the F0 range and
+   keeps the cost well below real time.  Values are close to, not
+   identical with, openSMILE's.
+
+   Audio is pushed in blocks of any size and frames are appended to an
+   ls_contour as soon as they are complete, so the tracker can run on a
+   stream as well as on a file.
+
+   Unity calls ls_extract_prosody through P/Invoke (ProsodyExtractor.cs).
+   Shared library build:
+     gcc -O2 -msse2 -shared -fPIC -DTTS_TIMELINE_NO_ENGINE -I../CereVoice \
+         -o liblipsync.so lipsync_pitch.c lipsync_aggregate.c lipsync_prosody.c \
+         lipsync_audio.c lipsync_rig.c lipsync_phoneme.c lipsync_mfcc.c \
+         lipsync_align.c lipsync_solver.c lipsync_coartic.c lipsync_trace.c \
+         lipsync_live.c lipsync_rigtab.c ../CereVoice/tts_timeline.c -lpthread -lm
+   (lipsync.dll with MinGW on Windows), copied to Assets/Plugins/x86_x64;
+   make in StreamingAssets does both (see the Makefile).
+*/
+
+#ifndef LIPSYNC_PITCH_H
+#define LIPSYNC_PITCH_H
+
+#include "lipsync_audio.h"
+#include "lipsync_prosody.h"
+
+typedef struct ls_pitch_config {
+    int sample_rate;
+    float frame;            /* seconds */
+    float hop;              /* seconds */
+    float min_f0;           /* Hz */
+    float max_f0;
+    float voicing_cutoff;   /* normalised autocorrelation peak, 0-1 */
+    int smooth;             /* moving average length in frames, odd, 1 for none */
+} ls_pitch_config;
+
+/* The prosodyAcf settings */
+void ls_pitch_config_default(ls_pitch_config * cfg, int sample_rate);
+
+typedef struct ls_pitch ls_pitch;
+
+ls_pitch * ls_pitch_new(const ls_pitch_config * cfg);
+/* Feeds n samples in [-1, 1] and appends the completed frames to c.
+   Returns the number of frames appended. */
+int ls_pitch_push(ls_pitch * p, const float * samples, long n, ls_contour * c);
+/* Ends the stream: the last partial frames are zero padded.  The
+   tracker can be reused for a new stream afterwards. */
+int ls_pitch_flush(ls_pitch * p, ls_contour * c);
+void ls_pitch_delete(ls_pitch * p);
+
+/* Whole-clip convenience: contour of a loaded file.  hop is in seconds,
+   0 for the default. */
+int ls_contour_extract(ls_contour * c, const ls_audio * a, float hop);
+
+/* P/Invoke entry points.  Returns the number of frames and sets the
+   three arrays, or -1 if the file cannot be read.  The arrays are freed
+   with ls_free_prosody. */
+LS_EXPORT int ls_extract_prosody(const char * wav_path, float hop_ms,
+                                 float ** time, float ** f0, float ** loudness);
+LS_EXPORT void ls_free_prosody(float * time, float * f0, float * loudness);
+
+#endif /* LIPSYNC_PITCH_H */
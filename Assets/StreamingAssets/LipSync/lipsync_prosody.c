@@ -0,0 +1,197 @@
+/* Pitch and intensity weighting for the native tools.
+   See lipsync_prosody.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "lipsync_prosody.h"
+#include "lipsync_rig.h"
+#include "lipsync_aggregate.h"
+
+/* RangeTransformation.Transform */
+static float transform(float x, float a, float b, float c, float d) {
+    return (x - a) * ((d - c) / (b - a)) + c;
+}
+
+/* MyLipSync.GetRatio */
+static float ratio(float min, float mean, float max) {
+    float r = transform(mean, min, max, 0, 1);
+    if (r <= 0) return 0.2f;
+    if (r > 1) return 1;
+    return r;
+}
+
+int ls_contour_load_csv(ls_contour * c, const char * path) {
+    char * buf, * line, * next, * field;
+    int col;
+    float t, f0, loudness, last = -1;
+
+    memset(c, 0, sizeof(ls_contour));
+    buf = ls_read_file(path, NULL);
+    if (!buf) {
+        fprintf(stderr, "ERROR: unable to read prosody file '%s'\n", path);
+        return -1;
+    }
+
+    /* skip first line containing the column names */
+    line = strchr(buf, '\n');
+    if (line) line++;
+    while (line && *line) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        t = f0 = loudness = 0;
+        col = 0;
+        for (field = strtok(line, ";\r"); field; field = strtok(NULL, ";\r"), col++) {
+            if (col == 1) t = (float) atof(field);
+            else if (col == 3) f0 = (float) atof(field);
+            else if (col == 4) loudness = (float) atof(field);
+        }
+        line = next;
+        if (col < 5) continue;
+
+        /* frames are keyed by time rounded to 10 ms, first one wins */
+        t = roundf(t * 100) / 100;
+        if (t <= last) continue;
+        last = t;
+        ls_contour_append(c, t, f0, loudness);
+    }
+    free(buf);
+    return 0;
+}
+
+void ls_contour_append(ls_contour * c, float time, float f0, float loudness) {
+    if (c->count == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 1024;
+        c->time = realloc(c->time, c->cap * sizeof(float));
+        c->f0 = realloc(c->f0, c->cap * sizeof(float));
+        c->loudness = realloc(c->loudness, c->cap * sizeof(float));
+    }
+    c->time[c->count] = time;
+    c->f0[c->count] = f0;
+    c->loudness[c->count] = loudness;
+    c->count++;
+}
+
+void ls_contour_free(ls_contour * c) {
+    free(c->time);
+    free(c->f0);
+    free(c->loudness);
+    memset(c, 0, sizeof(ls_contour));
+}
+
+void ls_prosody_init(ls_prosody * p, float window_ms, int male) {
+    memset(p, 0, sizeof(ls_prosody));
+    p->window = window_ms;
+    p->min_frequency = male ? 45.0f : 80.0f;
+    p->max_frequency = male ? 180.0f : 220.0f;
+}
+
+void ls_prosody_free(ls_prosody * p) {
+    free(p->vowel_pitch_window);
+    free(p->consonant_pitch_window);
+    free(p->vowel_intensity_window);
+    free(p->consonant_intensity_window);
+    p->vowel_pitch_window = p->consonant_pitch_window = NULL;
+    p->vowel_intensity_window = p->consonant_intensity_window = NULL;
+    p->windows = 0;
+}
+
+/* SpeechAnalysis.GetMeanValues: mean of the non-zero segment means */
+static float mean_of_means(const ls_segment * segs, int n, unsigned int cls, int intensity) {
+    float sum = 0, count = 0, v;
+    int i;
+    for (i = 0; i < n; i++) {
+        if (!ls_phoneme_is(segs[i].phoneme, cls)) continue;
+        v = intensity ? segs[i].mean_intensity : segs[i].mean_pitch;
+        if (v > 0) {
+            sum += v;
+            count += 1;
+        }
+    }
+    return sum / count;
+}
+
+void ls_prosody_analyse(ls_prosody * p, const ls_contour * c, ls_segment * segs, int n) {
+    ls_aggregate * a;
+    float * start = malloc((n ? n : 1) * sizeof(float));
+    float * end = malloc((n ? n : 1) * sizeof(float));
+    float * mean_pitch = malloc((n ? n : 1) * sizeof(float));
+    float * mean_intensity = malloc((n ? n : 1) * sizeof(float));
+    unsigned int * classes = malloc((n ? n : 1) * sizeof(unsigned int));
+    float ** windows[LS_SERIES_COUNT];
+    ls_range * ranges[LS_SERIES_COUNT];
+    int i, s;
+
+    for (i = 0; i < n; i++) {
+        start[i] = segs[i].start;
+        end[i] = segs[i].end;
+        classes[i] = (unsigned int) segs[i].phoneme < LS_PHONEME_COUNT ? ls_phonemes[segs[i].phoneme].classes : 0;
+    }
+    a = ls_aggregate_new(c->time, c->f0, c->loudness, c->count, start, end, classes, n, mean_pitch, mean_intensity);
+    for (i = 0; i < n; i++) {
+        if (classes[i] & (LS_CLASS_VOWEL | LS_CLASS_PLOSIVE)) {
+            segs[i].mean_pitch = mean_pitch[i];
+            segs[i].mean_intensity = mean_intensity[i];
+        }
+    }
+
+    ls_prosody_free(p);
+    windows[LS_SERIES_VOWEL_PITCH] = &p->vowel_pitch_window;
+    windows[LS_SERIES_CONSONANT_PITCH] = &p->consonant_pitch_window;
+    windows[LS_SERIES_VOWEL_INTENSITY] = &p->vowel_intensity_window;
+    windows[LS_SERIES_CONSONANT_INTENSITY] = &p->consonant_intensity_window;
+    ranges[LS_SERIES_VOWEL_PITCH] = &p->vowel_pitch;
+    ranges[LS_SERIES_CONSONANT_PITCH] = &p->consonant_pitch;
+    ranges[LS_SERIES_VOWEL_INTENSITY] = &p->vowel_intensity;
+    ranges[LS_SERIES_CONSONANT_INTENSITY] = &p->consonant_intensity;
+    p->windows = ls_aggregate_window_count(a, p->window);
+    for (s = 0; s < LS_SERIES_COUNT; s++) {
+        *windows[s] = malloc(p->windows * sizeof(float));
+        ls_aggregate_windows(a, s, p->window, *windows[s], p->windows);
+        ls_aggregate_range(a, s, &ranges[s]->min, &ranges[s]->max);
+    }
+    ls_aggregate_delete(a);
+    free(start);
+    free(end);
+    free(mean_pitch);
+    free(mean_intensity);
+    free(classes);
+
+    p->vowel_pitch.mean = mean_of_means(segs, n, LS_CLASS_VOWEL, 0);
+    p->consonant_pitch.mean = mean_of_means(segs, n, LS_CLASS_PLOSIVE, 0);
+    p->vowel_intensity.mean = mean_of_means(segs, n, LS_CLASS_VOWEL, 1);
+    p->consonant_intensity.mean = mean_of_means(segs, n, LS_CLASS_PLOSIVE, 1);
+    p->vowel_pitch_ratio = ratio(p->min_frequency, p->vowel_pitch.mean, p->max_frequency);
+    p->consonant_pitch_ratio = ratio(p->min_frequency, p->consonant_pitch.mean, p->max_frequency);
+}
+
+/* MyLipSync.GetTargetWeightPitch/GetTargetWeightIntensity */
+static float target_weight(float weight, float value, float mean, const ls_range * range) {
+    if (value == 0) return weight;
+    if (value < mean) return transform(value, range->min, mean, 0.0f, weight);
+    return transform(value, mean, range->max, weight, 100.0f);
+}
+
+float ls_prosody_target(const ls_prosody * p, const ls_segment * seg, float weight) {
+    float initial, target;
+    int w;
+
+    if (!p->windows) return weight;
+    /* the runtime truncates the start time to whole seconds before
+       scaling it */
+    w = (int) seg->start * 1000 / (int) p->window;
+    if (w >= p->windows) w = p->windows - 1;
+
+    if (ls_phoneme_is(seg->phoneme, LS_CLASS_VOWEL)) {
+        initial = weight * p->vowel_pitch_ratio;
+        target = target_weight(initial, seg->mean_intensity, p->vowel_intensity_window[w], &p->vowel_intensity);
+        return (target + target_weight(initial, seg->mean_pitch, p->vowel_pitch_window[w], &p->vowel_pitch)) / 2.0f;
+    }
+    if (ls_phoneme_is(seg->phoneme, LS_CLASS_PLOSIVE)) {
+        initial = weight * p->consonant_pitch_ratio;
+        return target_weight(initial, seg->mean_pitch, p->consonant_pitch_window[w], &p->consonant_pitch);
+    }
+    return weight;
+}
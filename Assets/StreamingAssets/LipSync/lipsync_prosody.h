@@ -0,0 +1,60 @@
+/* Pitch and intensity weighting for the native tools.
+
+   Computes the statistics SpeechAnalysis hands to MyLipSync (per-phoneme
+   means, per-window vowel/consonant means, min/mean/max) from an F0 and
+   loudness contour, and evaluates the target weight MyLipSync.PhonemeRise
+   uses when considerFrequency is set.
+*/
+
+#ifndef LIPSYNC_PROSODY_H
+#define LIPSYNC_PROSODY_H
+
+#include "lipsync_phoneme.h"
+
+/* F0/loudness contour, one frame per entry in time order */
+typedef struct ls_contour {
+    int count;
+    int cap;
+    float * time;      /* seconds */
+    float * f0;        /* Hz, 0 when unvoiced */
+    float * loudness;
+} ls_contour;
+
+/* Loads the openSMILE prosodyAcf CSV output (';' separated, one header
+   line, frameTime/F0final/pcm_loudness_sma in columns 1, 3 and 4).
+   Returns 0 on success. */
+int ls_contour_load_csv(ls_contour * c, const char * path);
+/* Appends one frame, time must not be before the last frame */
+void ls_contour_append(ls_contour * c, float time, float f0, float loudness);
+void ls_contour_free(ls_contour * c);
+
+typedef struct ls_range {
+    float min, mean, max;
+} ls_range;
+
+typedef struct ls_prosody {
+    float window;               /* sliding window, milliseconds */
+    float min_frequency;        /* speaker range, see SetMinMaxFrequencyValues */
+    float max_frequency;
+    ls_range vowel_pitch, vowel_intensity;
+    ls_range consonant_pitch, consonant_intensity;
+    float vowel_pitch_ratio, consonant_pitch_ratio;
+    int windows;
+    float * vowel_pitch_window;
+    float * consonant_pitch_window;
+    float * vowel_intensity_window;
+    float * consonant_intensity_window;
+} ls_prosody;
+
+/* Speaker frequency range of MyLipSync.SetMinMaxFrequencyValues */
+void ls_prosody_init(ls_prosody * p, float window_ms, int male);
+/* Fills mean_pitch/mean_intensity of the vowel and plosive/fricative
+   segments and the statistics of p from the contour. */
+void ls_prosody_analyse(ls_prosody * p, const ls_contour * c, ls_segment * segs, int n);
+void ls_prosody_free(ls_prosody * p);
+
+/* Target weight of one blendshape of seg, as PhonemeRise with
+   considerFrequency set */
+float ls_prosody_target(const ls_prosody * p, const ls_segment * seg, float weight);
+
+#endif /* LIPSYNC_PROSODY_H */
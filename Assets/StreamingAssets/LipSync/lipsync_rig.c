@@ -0,0 +1,186 @@
+/* Character rig mapping for the native tools.
+   See lipsync_rig.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "lipsync_rig.h"
+
+typedef struct span {
+    const char * begin;
+    const char * end;
+} span;
+
+char * ls_read_file(const char * path, long * size) {
+    FILE * fp = fopen(path, "rb");
+    char * buf;
+    long sz;
+
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    sz = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (sz < 0) {
+        fclose(fp);
+        return NULL;
+    }
+    buf = malloc(sz + 1);
+    if (fread(buf, 1, sz, fp) != (size_t) sz) {
+        free(buf);
+        fclose(fp);
+        return NULL;
+    }
+    buf[sz] = '\0';
+    fclose(fp);
+    if (size) *size = sz;
+    return buf;
+}
+
+/* Finds the next <tag>...</tag> within s and returns its content.  The
+   same tag is never nested in the mapping files. */
+static int next_element(span * s, const char * tag, span * content) {
+    char open[64], close[64];
+    const char * b, * e;
+    size_t n;
+
+    snprintf(open, sizeof(open), "<%s>", tag);
+    snprintf(close, sizeof(close), "</%s>", tag);
+    n = strlen(open);
+    b = strstr(s->begin, open);
+    if (!b || b >= s->end) return 0;
+    e = strstr(b + n, close);
+    if (!e || e >= s->end) return 0;
+    content->begin = b + n;
+    content->end = e;
+    s->begin = e + n + 1;
+    return 1;
+}
+
+/* Copies the trimmed text of an element */
+static void element_text(span * s, const char * tag, char * out, size_t size) {
+    span scan = *s, content;
+    size_t len;
+
+    out[0] = '\0';
+    if (!next_element(&scan, tag, &content)) return;
+    while (content.begin < content.end && isspace((unsigned char) *content.begin)) content.begin++;
+    while (content.end > content.begin && isspace((unsigned char) content.end[-1])) content.end--;
+    len = (size_t) (content.end - content.begin);
+    if (len >= size) len = size - 1;
+    memcpy(out, content.begin, len);
+    out[len] = '\0';
+}
+
+void ls_rig_init(ls_rig * rig) {
+    memset(rig, 0, sizeof(ls_rig));
+}
+
+void ls_rig_free(ls_rig * rig) {
+    int i;
+    for (i = 0; i < LS_PHONEME_COUNT; i++) free(rig->visemes[i].shapes);
+    for (i = 0; i < rig->n_emotions; i++) free(rig->emotions[i].shapes);
+    free(rig->emotions);
+    memset(rig, 0, sizeof(ls_rig));
+}
+
+/* Appends the <BlendShape> elements of an ATTR */
+static void read_blendshapes(span * attr, ls_blendshape ** shapes, int * count) {
+    span bs;
+    char text[64];
+
+    while (next_element(attr, "BlendShape", &bs)) {
+        *shapes = realloc(*shapes, (*count + 1) * sizeof(ls_blendshape));
+        element_text(&bs, "Index", text, sizeof(text));
+        (*shapes)[*count].index = atoi(text);
+        element_text(&bs, "Weight", text, sizeof(text));
+        (*shapes)[*count].weight = (float) atof(text);
+        (*count)++;
+    }
+}
+
+int ls_rig_load_visemes(ls_rig * rig, const char * path) {
+    span doc, attr;
+    char text[64];
+    ls_viseme * v;
+    char * buf;
+    int p;
+
+    buf = ls_read_file(path, NULL);
+    if (!buf) {
+        fprintf(stderr, "ERROR: unable to read phoneme mapping '%s'\n", path);
+        return -1;
+    }
+    doc.begin = buf;
+    doc.end = buf + strlen(buf);
+    while (next_element(&doc, "ATTR", &attr)) {
+        element_text(&attr, "Phoneme", text, sizeof(text));
+        p = ls_phoneme_parse(text);
+        if (p < 0) {
+            fprintf(stderr, "WARNING: unknown phoneme '%s' in '%s'\n", text, path);
+            continue;
+        }
+        v = &rig->visemes[p];
+        v->mapped = 1;
+        read_blendshapes(&attr, &v->shapes, &v->count);
+    }
+    free(buf);
+    return 0;
+}
+
+int ls_rig_load_diphones(ls_rig * rig, const char * path) {
+    span doc, attr, ph;
+    char text[64];
+    char * buf;
+    int d, p, n;
+
+    buf = ls_read_file(path, NULL);
+    if (!buf) {
+        fprintf(stderr, "ERROR: unable to read diphone mapping '%s'\n", path);
+        return -1;
+    }
+    doc.begin = buf;
+    doc.end = buf + strlen(buf);
+    while (next_element(&doc, "ATTR", &attr)) {
+        element_text(&attr, "Diphone", text, sizeof(text));
+        d = ls_phoneme_parse(text);
+        if (d < 0) {
+            fprintf(stderr, "WARNING: unknown diphone '%s' in '%s'\n", text, path);
+            continue;
+        }
+        n = 0;
+        while (n < 2 && next_element(&attr, "Phoneme", &ph)) {
+            element_text(&ph, "Type", text, sizeof(text));
+            p = ls_phoneme_parse(text);
+            if (p < 0) break;
+            rig->diphones[d][n++] = (ls_phoneme) p;
+        }
+        rig->has_diphone[d] = (n == 2);
+        if (n != 2) fprintf(stderr, "WARNING: diphone '%s' needs two phonemes\n", ls_phoneme_name(d));
+    }
+    free(buf);
+    return 0;
+}
+
+int ls_rig_load_emotions(ls_rig * rig, const char * path) {
+    span doc, attr;
+    ls_rig_emotion * e;
+    char * buf;
+
+    buf = ls_read_file(path, NULL);
+    if (!buf) {
+        fprintf(stderr, "ERROR: unable to read emotion mapping '%s'\n", path);
+        return -1;
+    }
+    doc.begin = buf;
+    doc.end = buf + strlen(buf);
+    while (next_element(&doc, "ATTR", &attr)) {
+        rig->emotions = realloc(rig->emotions, (rig->n_emotions + 1) * sizeof(ls_rig_emotion));
+        e = &rig->emotions[rig->n_emotions++];
+        memset(e, 0, sizeof(ls_rig_emotion));
+        element_text(&attr, "Emotion", e->name, sizeof(e->name));
+        read_blendshapes(&attr, &e->shapes, &e->count);
+    }
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/* Character rig mapping for the native tools.
+
+   Reads the <Character>-phonemeMapping.xml, -diphoneMapping.xml and
+   -emotionMapping.xml files that MyLipSync loads in
+   PhonemeBlendShapeMapping/DiphoneMapping/EmotionBlendShapeMapping:
+
+     <ATTR><Phoneme>AHH</Phoneme>
+           <BlendShape><Index>40</Index><Weight>74.8</Weight></BlendShape>
+           ...</ATTR>
+
+     <ATTR><Diphone>DiphoneAI</Diphone>
+           <Phoneme><Type>AHH</Type></Phoneme>
+           <Phoneme><Type>IEE</Type></Phoneme></ATTR>
+
+     <ATTR><Emotion>SmileLeft</Emotion>
+           <BlendShape>...</BlendShape></ATTR>
+
+   Only this fixed layout is understood, not XML in general.
+*/
+
+#ifndef LIPSYNC_RIG_H
+#define LIPSYNC_RIG_H
+
+#include "lipsync_phoneme.h"
+
+typedef struct ls_blendshape {
+    int index;     /* blendshape index on the character mesh */
+    float weight;  /* target weight, 0-100 */
+} ls_blendshape;
+
+typedef struct ls_viseme {
+    int mapped;    /* the phoneme has an ATTR entry */
+    int count;
+    ls_blendshape * shapes;
+} ls_viseme;
+
+#define LS_RIG_NAME_SIZE 32
+
+typedef struct ls_rig_emotion {
+    char name[LS_RIG_NAME_SIZE];  /* C# Emotion enum name */
+    int count;
+    ls_blendshape * shapes;
+} ls_rig_emotion;
+
+typedef struct ls_rig {
+    ls_viseme visemes[LS_PHONEME_COUNT];
+    int has_diphone[LS_PHONEME_COUNT];
+    ls_phoneme diphones[LS_PHONEME_COUNT][2];
+    ls_rig_emotion * emotions;     /* in file order */
+    int n_emotions;
+} ls_rig;
+
+void ls_rig_init(ls_rig * rig);
+void ls_rig_free(ls_rig * rig);
+/* Return 0 on success, -1 if the file could not be read */
+int ls_rig_load_visemes(ls_rig * rig, const char * path);
+int ls_rig_load_diphones(ls_rig * rig, const char * path);
+int ls_rig_load_emotions(ls_rig * rig, const char * path);
+
+/* Reads a whole file into a NUL-terminated buffer, NULL on failure */
+char * ls_read_file(const char * path, long * size);
+
+#endif /* LIPSYNC_RIG_H */
@@ -0,0 +1,270 @@
+/* Compiled rig tables.
+   See lipsync_rigtab.h for the file layout. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lipsync_rigtab.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <windows.h>
+#endif
+
+uint32_t ls_rigtab_hash(uint32_t h, const void * data, size_t n) {
+    /* FNV-1a */
+    const unsigned char * p = data;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int ls_rigtab_hash_file(uint32_t * h, const char * path) {
+    unsigned char buf[4096];
+    FILE * fp = fopen(path, "rb");
+    size_t n;
+
+    if (!fp) return -1;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) *h = ls_rigtab_hash(*h, buf, n);
+    fclose(fp);
+    return 0;
+}
+
+/* ---- writer ---- */
+
+static void set_shapes(ls_rigtab_entry * e, ls_rigtab_shape * shapes, uint32_t * n_shapes,
+                       const ls_blendshape * src, int count) {
+    int i;
+    e->first_shape = *n_shapes;
+    e->n_shapes = (uint16_t) count;
+    for (i = 0; i < count; i++) {
+        shapes[*n_shapes].index = (uint32_t) src[i].index;
+        shapes[*n_shapes].weight = src[i].weight;
+        (*n_shapes)++;
+    }
+}
+
+int ls_rigtab_write(const ls_rig * rig, uint32_t sources, const char * path) {
+    ls_rigtab_header h;
+    ls_rigtab_entry * entries;
+    ls_rigtab_shape * shapes;
+    char * strings;
+    unsigned char * body;
+    size_t entries_size, shapes_size, body_size;
+    uint32_t n_shapes = 0, total = 0, strings_size = 0;
+    int i, n_entries = LS_PHONEME_COUNT + rig->n_emotions, res = 0;
+    FILE * fp;
+
+    for (i = 0; i < LS_PHONEME_COUNT; i++) total += (uint32_t) rig->visemes[i].count;
+    for (i = 0; i < rig->n_emotions; i++) {
+        total += (uint32_t) rig->emotions[i].count;
+        strings_size += (uint32_t) strlen(rig->emotions[i].name) + 1;
+    }
+    /* Keeps the table a multiple of 4 bytes */
+    strings_size = (strings_size + 3) & ~3u;
+
+    entries_size = n_entries * sizeof(ls_rigtab_entry);
+    shapes_size = total * sizeof(ls_rigtab_shape);
+    body_size = entries_size + shapes_size + strings_size;
+    body = calloc(1, body_size ? body_size : 1);
+    entries = (ls_rigtab_entry *) body;
+    shapes = (ls_rigtab_shape *) (body + entries_size);
+    strings = (char *) (body + entries_size + shapes_size);
+
+    for (i = 0; i < LS_PHONEME_COUNT; i++) {
+        const ls_viseme * v = &rig->visemes[i];
+        if (v->mapped) entries[i].flags |= LS_RIGTAB_MAPPED;
+        set_shapes(&entries[i], shapes, &n_shapes, v->shapes, v->count);
+        if (rig->has_diphone[i]) {
+            entries[i].flags |= LS_RIGTAB_DIPHONE;
+            entries[i].diphone[0] = (uint8_t) rig->diphones[i][0];
+            entries[i].diphone[1] = (uint8_t) rig->diphones[i][1];
+        }
+    }
+    strings_size = 0;
+    for (i = 0; i < rig->n_emotions; i++) {
+        ls_rigtab_entry * e = &entries[LS_PHONEME_COUNT + i];
+        e->flags = LS_RIGTAB_MAPPED;
+        set_shapes(e, shapes, &n_shapes, rig->emotions[i].shapes, rig->emotions[i].count);
+        e->name = (uint16_t) strings_size;
+        strcpy(strings + strings_size, rig->emotions[i].name);
+        strings_size += (uint32_t) strlen(rig->emotions[i].name) + 1;
+    }
+    strings_size = (strings_size + 3) & ~3u;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LS_RIGTAB_MAGIC, 4);
+    h.version = LS_RIGTAB_VERSION;
+    h.n_phonemes = LS_PHONEME_COUNT;
+    h.n_emotions = (uint32_t) rig->n_emotions;
+    h.n_shapes = n_shapes;
+    h.strings_size = strings_size;
+    h.checksum = ls_rigtab_hash(LS_RIGTAB_HASH_SEED, body, body_size);
+    h.sources = sources;
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "ERROR: unable to write rig table '%s'\n", path);
+        free(body);
+        return -1;
+    }
+    if (fwrite(&h, sizeof(h), 1, fp) != 1 ||
+        (body_size && fwrite(body, 1, body_size, fp) != body_size)) res = -1;
+    if (fclose(fp) != 0) res = -1;
+    if (res != 0) fprintf(stderr, "ERROR: unable to write rig table '%s'\n", path);
+    free(body);
+    return res;
+}
+
+/* ---- reader ---- */
+
+static int entry_valid(const ls_rigtab_entry * e, uint32_t n_shapes) {
+    return e->first_shape <= n_shapes && e->n_shapes <= n_shapes - e->first_shape;
+}
+
+static int rigtab_validate(ls_rigtab * t) {
+    const ls_rigtab_header * h;
+    size_t need;
+    uint32_t i;
+
+    if (t->size < sizeof(ls_rigtab_header)) return -1;
+    h = (const ls_rigtab_header *) t->base;
+    if (memcmp(h->magic, LS_RIGTAB_MAGIC, 4) != 0 || h->version != LS_RIGTAB_VERSION ||
+        h->n_phonemes != LS_PHONEME_COUNT) return -1;
+    need = sizeof(ls_rigtab_header) + ((size_t) h->n_phonemes + h->n_emotions) * sizeof(ls_rigtab_entry)
+        + (size_t) h->n_shapes * sizeof(ls_rigtab_shape) + h->strings_size;
+    if (need != t->size) return -1;
+    if (ls_rigtab_hash(LS_RIGTAB_HASH_SEED, h + 1, t->size - sizeof(ls_rigtab_header)) != h->checksum)
+        return -1;
+
+    t->header = h;
+    t->phonemes = (const ls_rigtab_entry *) (h + 1);
+    t->emotions = t->phonemes + h->n_phonemes;
+    t->shapes = (const ls_rigtab_shape *) (t->emotions + h->n_emotions);
+    t->strings = (const char *) (t->shapes + h->n_shapes);
+    for (i = 0; i < h->n_phonemes; i++) {
+        if (!entry_valid(&t->phonemes[i], h->n_shapes)) return -1;
+        if ((t->phonemes[i].flags & LS_RIGTAB_DIPHONE) &&
+            (t->phonemes[i].diphone[0] >= LS_PHONEME_COUNT || t->phonemes[i].diphone[1] >= LS_PHONEME_COUNT))
+            return -1;
+    }
+    for (i = 0; i < h->n_emotions; i++) {
+        if (!entry_valid(&t->emotions[i], h->n_shapes) || t->emotions[i].name >= h->strings_size) return -1;
+    }
+    if (h->n_emotions && t->strings[h->strings_size - 1] != '\0') return -1;
+    return 0;
+}
+
+LS_EXPORT ls_rigtab * ls_rigtab_open(const char * path) {
+    ls_rigtab * t;
+#ifndef WIN32
+    struct stat st;
+    int fd;
+#else
+    HANDLE file, mapping;
+    LARGE_INTEGER sz;
+#endif
+
+#ifndef WIN32
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    t = calloc(1, sizeof(ls_rigtab));
+    t->size = (size_t) st.st_size;
+    t->base = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (t->base == MAP_FAILED) {
+        free(t);
+        return NULL;
+    }
+#else
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+    t = calloc(1, sizeof(ls_rigtab));
+    t->size = (size_t) sz.QuadPart;
+    t->base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!t->base) {
+        free(t);
+        return NULL;
+    }
+#endif
+
+    if (rigtab_validate(t) < 0) {
+        fprintf(stderr, "ERROR: '%s' is not a valid rig table\n", path);
+        ls_rigtab_close(t);
+        return NULL;
+    }
+    return t;
+}
+
+LS_EXPORT void ls_rigtab_close(ls_rigtab * t) {
+    if (!t) return;
+#ifndef WIN32
+    munmap(t->base, t->size);
+#else
+    UnmapViewOfFile(t->base);
+#endif
+    free(t);
+}
+
+LS_EXPORT uint32_t ls_rigtab_sources(const ls_rigtab * t) {
+    return t->header->sources;
+}
+
+static int copy_shapes(const ls_rigtab * t, const ls_rigtab_entry * e, int * indices, float * weights, int max) {
+    int i, n;
+    if (!(e->flags & LS_RIGTAB_MAPPED)) return -1;
+    n = e->n_shapes < max ? e->n_shapes : max;
+    for (i = 0; i < n; i++) {
+        indices[i] = (int) t->shapes[e->first_shape + i].index;
+        weights[i] = t->shapes[e->first_shape + i].weight;
+    }
+    return e->n_shapes;
+}
+
+LS_EXPORT int ls_rigtab_viseme(const ls_rigtab * t, int phoneme, int * indices, float * weights, int max) {
+    if (phoneme < 0 || phoneme >= LS_PHONEME_COUNT) return -1;
+    return copy_shapes(t, &t->phonemes[phoneme], indices, weights, max);
+}
+
+LS_EXPORT int ls_rigtab_diphone(const ls_rigtab * t, int phoneme, int * phonemes) {
+    const ls_rigtab_entry * e;
+    if (phoneme < 0 || phoneme >= LS_PHONEME_COUNT) return 0;
+    e = &t->phonemes[phoneme];
+    if (!(e->flags & LS_RIGTAB_DIPHONE)) return 0;
+    phonemes[0] = e->diphone[0];
+    phonemes[1] = e->diphone[1];
+    return 2;
+}
+
+LS_EXPORT int ls_rigtab_emotions(const ls_rigtab * t) {
+    return (int) t->header->n_emotions;
+}
+
+LS_EXPORT const char * ls_rigtab_emotion_name(const ls_rigtab * t, int emotion) {
+    if (emotion < 0 || (uint32_t) emotion >= t->header->n_emotions) return NULL;
+    return t->strings + t->emotions[emotion].name;
+}
+
+LS_EXPORT int ls_rigtab_emotion(const ls_rigtab * t, int emotion, int * indices, float * weights, int max) {
+    if (emotion < 0 || (uint32_t) emotion >= t->header->n_emotions) return -1;
+    return copy_shapes(t, &t->emotions[emotion], indices, weights, max);
+}
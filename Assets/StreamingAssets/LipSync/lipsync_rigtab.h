@@ -0,0 +1,112 @@
+/* Compiled rig tables (RigTable.cs, rig_compiler).
+
+   MyLipSync used to build the rig of a character from its three XML
+   mappings on every Awake: an XDocument per file, an Enum.Parse per
+   phoneme and a float.Parse per blendshape.  rig_compiler turns the
+   mappings into one binary table that is mapped into memory and only
+   validated, and RigTable.cs loads each character's table once for all
+   of its instances.
+
+   Every phoneme of the ls_phoneme enumeration and every emotion of the
+   mapping has an entry giving the range of its blendshapes in one flat
+   index/weight array; phoneme entries also carry the two phonemes of a
+   diphone.  Emotions are named, their enum is only known to Unity.
+
+   Layout, all values little-endian:
+
+     ls_rigtab_header                       32 bytes
+     ls_rigtab_entry[n_phonemes]            12 bytes each, in ls_phoneme order
+     ls_rigtab_entry[n_emotions]            12 bytes each, in file order
+     ls_rigtab_shape[n_shapes]              8 bytes each
+     char strings[strings_size]             NUL-terminated emotion names
+
+   The checksum is the FNV-1a hash of everything after the header, so a
+   truncated or edited table is rejected instead of animating the wrong
+   blendshapes.  A table compiled for another phoneme set (n_phonemes)
+   is rejected too and has to be compiled again.  sources is the FNV-1a
+   hash of the bytes of the XML mappings the table was compiled from,
+   in the order phoneme, diphone, emotion mapping; RigTable.cs hashes
+   the mappings again and ignores a table that no longer matches them.
+   File times are not used, a checkout sets them arbitrarily.
+*/
+
+#ifndef LIPSYNC_RIGTAB_H
+#define LIPSYNC_RIGTAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lipsync_rig.h"
+
+#define LS_RIGTAB_MAGIC "LSRT"
+#define LS_RIGTAB_VERSION 1
+
+/* Entry flags */
+#define LS_RIGTAB_MAPPED  0x01  /* the phoneme or emotion has an ATTR */
+#define LS_RIGTAB_DIPHONE 0x02  /* diphone[] is set */
+
+typedef struct ls_rigtab_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t n_phonemes;
+    uint32_t n_emotions;
+    uint32_t n_shapes;
+    uint32_t strings_size;
+    uint32_t checksum;
+    uint32_t sources;       /* hash of the source mappings */
+    uint32_t reserved;
+} ls_rigtab_header;
+
+typedef struct ls_rigtab_entry {
+    uint32_t first_shape;
+    uint16_t n_shapes;
+    uint8_t flags;
+    uint8_t reserved;
+    uint8_t diphone[2];     /* phonemes of a diphone */
+    uint16_t name;          /* emotions: offset into the strings */
+} ls_rigtab_entry;
+
+typedef struct ls_rigtab_shape {
+    uint32_t index;         /* blendshape index on the character mesh */
+    float weight;           /* target weight, 0-100 */
+} ls_rigtab_shape;
+
+/* Read-only view of a table file, mapped into memory */
+typedef struct ls_rigtab {
+    const ls_rigtab_header * header;
+    const ls_rigtab_entry * phonemes;
+    const ls_rigtab_entry * emotions;
+    const ls_rigtab_shape * shapes;
+    const char * strings;
+    void * base;
+    size_t size;
+} ls_rigtab;
+
+#define LS_RIGTAB_HASH_SEED 2166136261u
+
+/* Continues an FNV-1a hash, starting from LS_RIGTAB_HASH_SEED */
+uint32_t ls_rigtab_hash(uint32_t h, const void * data, size_t n);
+/* Adds the bytes of a file to a hash.  Returns -1 if it cannot be read. */
+int ls_rigtab_hash_file(uint32_t * h, const char * path);
+
+/* Writes the table of a loaded rig, with the hash of its source
+   mappings.  Returns 0 on success. */
+int ls_rigtab_write(const ls_rig * rig, uint32_t sources, const char * path);
+
+/* Maps and validates a table.  Returns NULL if the file is missing or
+   not valid. */
+LS_EXPORT ls_rigtab * ls_rigtab_open(const char * path);
+LS_EXPORT void ls_rigtab_close(ls_rigtab * t);
+/* Hash of the mappings the table was compiled from */
+LS_EXPORT uint32_t ls_rigtab_sources(const ls_rigtab * t);
+/* Copies up to max blendshapes of a phoneme.  Returns their number, or
+   -1 if the phoneme is not mapped. */
+LS_EXPORT int ls_rigtab_viseme(const ls_rigtab * t, int phoneme, int * indices, float * weights, int max);
+/* Sets the two phonemes of a diphone.  Returns 2, or 0 if phoneme is
+   not a mapped diphone. */
+LS_EXPORT int ls_rigtab_diphone(const ls_rigtab * t, int phoneme, int * phonemes);
+LS_EXPORT int ls_rigtab_emotions(const ls_rigtab * t);
+LS_EXPORT const char * ls_rigtab_emotion_name(const ls_rigtab * t, int emotion);
+/* As ls_rigtab_viseme, for the emotion-th emotion of the table */
+LS_EXPORT int ls_rigtab_emotion(const ls_rigtab * t, int emotion, int * indices, float * weights, int max);
+
+#endif /* LIPSYNC_RIGTAB_H */
@@ -0,0 +1,253 @@
+/* Vector kernels for the native audio analysis.
+
+   SSE on x86/x64, NEON on ARM, plain C elsewhere.  Loads are unaligned
+   so callers can pass any offset into a frame.  Sums are accumulated in
+   four lanes and reduced at the end, so results can differ from a
+   sequential loop in the last bits.
+*/
+
+#ifndef LIPSYNC_SIMD_H
+#define LIPSYNC_SIMD_H
+
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LS_SIMD_SSE 1
+#include <xmmintrin.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LS_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define LS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* sum of a[i] * b[i] */
+static inline float ls_dot(const float * a, const float * b, int n) {
+    float sum = 0;
+    int i = 0;
+#if defined(LS_SIMD_SSE)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    float lanes[4];
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(LS_SIMD_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+    float lanes[4];
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    vst1q_f32(lanes, vaddq_f32(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+/* out[i] = a[i] * b[i], out may alias a or b */
+static inline void ls_mul(const float * a, const float * b, float * out, int n) {
+    int i = 0;
+#if defined(LS_SIMD_SSE)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+#elif defined(LS_SIMD_NEON)
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(out + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+#endif
+    for (; i < n; i++) out[i] = a[i] * b[i];
+}
+
+/* sum of a[i] */
+static inline float ls_sum(const float * a, int n) {
+    float sum = 0;
+    int i = 0;
+#if defined(LS_SIMD_SSE)
+    __m128 acc = _mm_setzero_ps();
+    float lanes[4];
+    for (; i + 4 <= n; i += 4) acc = _mm_add_ps(acc, _mm_loadu_ps(a + i));
+    _mm_storeu_ps(lanes, acc);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(LS_SIMD_NEON)
+    float32x4_t acc = vdupq_n_f32(0);
+    float lanes[4];
+    for (; i + 4 <= n; i += 4) acc = vaddq_f32(acc, vld1q_f32(a + i));
+    vst1q_f32(lanes, acc);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < n; i++) sum += a[i];
+    return sum;
+}
+
+/* sum of (a[i] - b[i])^2 */
+static inline float ls_dist2(const float * a, const float * b, int n) {
+    float sum = 0, d;
+    int i = 0;
+#if defined(LS_SIMD_SSE)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps(), d0, d1;
+    float lanes[4];
+    for (; i + 8 <= n; i += 8) {
+        d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+    }
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(LS_SIMD_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0), d0, d1;
+    float lanes[4];
+    for (; i + 8 <= n; i += 8) {
+        d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        acc0 = vmlaq_f32(acc0, d0, d0);
+        acc1 = vmlaq_f32(acc1, d1, d1);
+    }
+    vst1q_f32(lanes, vaddq_f32(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < n; i++) {
+        d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+/* out[i] = a[i] * (gain + i * step), a gain ramp; out may alias a */
+static inline void ls_ramp(const float * a, float gain, float step, float * out, int n) {
+    int i = 0;
+#if defined(LS_SIMD_SSE)
+    __m128 g = _mm_add_ps(_mm_set1_ps(gain), _mm_mul_ps(_mm_set1_ps(step), _mm_set_ps(3, 2, 1, 0)));
+    const __m128 dg = _mm_set1_ps(4 * step);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), g));
+        g = _mm_add_ps(g, dg);
+    }
+#elif defined(LS_SIMD_NEON)
+    const float ramp[4] = { 0, 1, 2, 3 };
+    float32x4_t g = vmlaq_f32(vdupq_n_f32(gain), vdupq_n_f32(step), vld1q_f32(ramp));
+    const float32x4_t dg = vdupq_n_f32(4 * step);
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(out + i, vmulq_f32(vld1q_f32(a + i), g));
+        g = vaddq_f32(g, dg);
+    }
+#endif
+    for (; i < n; i++) out[i] = a[i] * (gain + i * step);
+}
+
+/* 16 bit PCM to float in [-1, 1) */
+static inline void ls_from_pcm16(const short * a, float * out, int n) {
+    int i = 0;
+#if defined(LS_SIMD_SSE2)
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    __m128i v;
+    for (; i + 8 <= n; i += 8) {
+        v = _mm_loadu_si128((const __m128i *) (a + i));
+        /* sign extend by unpacking into the high halves and shifting */
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), scale));
+    }
+#elif defined(LS_SIMD_NEON)
+    int16x8_t v;
+    for (; i + 8 <= n; i += 8) {
+        v = vld1q_s16(a + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / 32768.0f));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / 32768.0f));
+    }
+#endif
+    for (; i < n; i++) out[i] = a[i] * (1.0f / 32768.0f);
+}
+
+/* float to 16 bit PCM, rounded and saturated */
+static inline void ls_to_pcm16(const float * a, short * out, int n) {
+    float v;
+    int i = 0;
+#if defined(LS_SIMD_SSE2)
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    __m128i lo, hi;
+    for (; i + 8 <= n; i += 8) {
+        /* cvtps rounds to nearest, packs saturates */
+        lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(a + i), scale));
+        hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(a + i + 4), scale));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(lo, hi));
+    }
+#elif defined(LS_SIMD_NEON)
+    const uint32x4_t sign = vdupq_n_u32(0x80000000u), half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+    float32x4_t lo, hi;
+    for (; i + 8 <= n; i += 8) {
+        /* vcvtq truncates and saturates, round half away from zero first */
+        lo = vmulq_n_f32(vld1q_f32(a + i), 32768.0f);
+        hi = vmulq_n_f32(vld1q_f32(a + i + 4), 32768.0f);
+        lo = vaddq_f32(lo, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(lo), sign), half)));
+        hi = vaddq_f32(hi, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(hi), sign), half)));
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(lo)), vqmovn_s32(vcvtq_s32_f32(hi))));
+    }
+#endif
+    for (; i < n; i++) {
+        v = a[i] * 32768.0f;
+        out[i] = (short) (v >= 32767.0f ? 32767 : (v <= -32768.0f ? -32768 : lrintf(v)));
+    }
+}
+
+/* out[i] = e^x[i] for x[i] <= 0, out may alias x.  The vector paths
+   use the range reduction and polynomial of the Cephes expf, relative
+   error below 2e-7.  Arguments are clamped to -87, which keeps the
+   result a normal float. */
+static inline void ls_exp_neg(const float * x, float * out, int n) {
+    int i = 0;
+#if defined(LS_SIMD_SSE2)
+    const __m128 lo = _mm_set1_ps(-87.0f), one = _mm_set1_ps(1.0f);
+    __m128 v, fx, t, y, z;
+    __m128i e;
+    for (; i + 4 <= n; i += 4) {
+        v = _mm_max_ps(_mm_loadu_ps(x + i), lo);
+        /* n = floor(x / ln 2 + 0.5), x -= n ln 2 in two parts */
+        fx = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+        t = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+        fx = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, fx), one));
+        v = _mm_sub_ps(v, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+        v = _mm_sub_ps(v, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+        z = _mm_mul_ps(v, v);
+        y = _mm_set1_ps(1.9875691500e-4f);
+        y = _mm_add_ps(_mm_mul_ps(y, v), _mm_set1_ps(1.3981999507e-3f));
+        y = _mm_add_ps(_mm_mul_ps(y, v), _mm_set1_ps(8.3334519073e-3f));
+        y = _mm_add_ps(_mm_mul_ps(y, v), _mm_set1_ps(4.1665795894e-2f));
+        y = _mm_add_ps(_mm_mul_ps(y, v), _mm_set1_ps(1.6666665459e-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, v), _mm_set1_ps(5.0000001201e-1f));
+        y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), v), one);
+        /* times 2^n */
+        e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+        _mm_storeu_ps(out + i, _mm_mul_ps(y, _mm_castsi128_ps(e)));
+    }
+#elif defined(LS_SIMD_NEON)
+    const float32x4_t lo = vdupq_n_f32(-87.0f), one = vdupq_n_f32(1.0f);
+    float32x4_t v, fx, t, y, z;
+    int32x4_t e;
+    for (; i + 4 <= n; i += 4) {
+        v = vmaxq_f32(vld1q_f32(x + i), lo);
+        fx = vmlaq_f32(vdupq_n_f32(0.5f), v, vdupq_n_f32(1.44269504088896341f));
+        t = vcvtq_f32_s32(vcvtq_s32_f32(fx));
+        fx = vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(t, fx), vreinterpretq_u32_f32(one))));
+        v = vmlsq_f32(v, fx, vdupq_n_f32(0.693359375f));
+        v = vmlsq_f32(v, fx, vdupq_n_f32(-2.12194440e-4f));
+        z = vmulq_f32(v, v);
+        y = vdupq_n_f32(1.9875691500e-4f);
+        y = vmlaq_f32(vdupq_n_f32(1.3981999507e-3f), y, v);
+        y = vmlaq_f32(vdupq_n_f32(8.3334519073e-3f), y, v);
+        y = vmlaq_f32(vdupq_n_f32(4.1665795894e-2f), y, v);
+        y = vmlaq_f32(vdupq_n_f32(1.6666665459e-1f), y, v);
+        y = vmlaq_f32(vdupq_n_f32(5.0000001201e-1f), y, v);
+        y = vaddq_f32(vmlaq_f32(v, y, z), one);
+        e = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(fx), vdupq_n_s32(127)), 23);
+        vst1q_f32(out + i, vmulq_f32(y, vreinterpretq_f32_s32(e)));
+    }
+#endif
+    for (; i < n; i++) out[i] = (float) exp(x[i] < -87.0f ? -87.0f : x[i]);
+}
+
+#endif /* LIPSYNC_SIMD_H */
@@ -0,0 +1,544 @@
+/* Batched viseme solver.
+   See lipsync_solver.h. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lipsync_solver.h"
+#include "lipsync_prosody.h"
+#include "lipsync_aggregate.h"
+#include "lipsync_coartic.h"
+#include "lipsync_simd.h"
+#include "tts_thread.h"
+
+/* fewer characters than this per thread are not worth a wake-up */
+#define MIN_PER_THREAD 8
+
+#define ACTIVE_RISING 0
+#define ACTIVE_DECAYING 1
+#define ACTIVE_ENDED 2
+
+/* Segments of one track, as MyLipSync.phonemeInformation, and its
+   playback state, as currentIndex and currentPhonemes */
+typedef struct solver_track {
+    int count, cap;
+    unsigned char * phoneme;
+    float * start, * end;
+    float * apex;            /* 75% of the phoneme */
+    float * rise, * decay;   /* durations truncated to milliseconds */
+    int * target_first;      /* into targets, one per blendshape of the phoneme */
+    float * targets;
+    int ntargets, targets_cap;
+    int cursor;
+    int window_first;        /* first phoneme of the dominance window */
+    int nactive;
+    int * active;            /* segment of each active phoneme */
+    unsigned char * state;
+} solver_track;
+
+typedef struct solver_worker {
+    ls_solver * solver;
+    int index;
+    int evaluated;
+    tts_thread thread;
+} solver_worker;
+
+struct ls_solver {
+    int count, cap;
+    /* per character */
+    unsigned char * quadratic;
+    unsigned char * model;
+    int * slot_first, * slot_count;
+    int * rig_first;         /* cap * LS_PHONEME_COUNT, -1 for unmapped phonemes */
+    int * rig_count;
+    ls_prosody * prosody;
+    solver_track * tracks;   /* cap * LS_SOLVER_TRACKS */
+    /* rig entries of all characters */
+    int nrig, rig_cap;
+    int * rig_slot;
+    float * rig_weight;
+    float * held;            /* weight at the last rise step, BlendShape.currentWeight */
+    /* slots of all characters */
+    int nslots, slots_cap;
+    int * slot_shape;
+    float * weights;
+    float * scratch;         /* alveoral weights of the dominance model */
+    /* a step in progress */
+    const float * times;
+    int parts;
+    /* workers, the caller is part 0 */
+    int nthreads;
+    solver_worker * workers;
+    tts_mutex lock;
+    tts_cond start, done;
+    unsigned int generation;
+    int pending;
+    int quit;
+};
+
+/* Grows *p to hold need elements of size bytes */
+static void * grow(void * p, int * cap, int need, size_t size) {
+    if (need <= *cap) return p;
+    while (*cap < need) *cap = *cap ? *cap * 2 : 16;
+    return realloc(p, (size_t) *cap * size);
+}
+
+static float ease_in(int quadratic, float t) {
+    if (quadratic) return t * t;
+    return ((float) exp(t) - 1.0f) / ((float) exp(1) - 1.0f);
+}
+
+static float ease_out(int quadratic, float t) {
+    if (quadratic) return (1 - t) * (2 - (1 - t));
+    return ((float) exp(1 - t) - 1.0f) / ((float) exp(1) - 1.0f);
+}
+
+/* Timings are compared at millisecond resolution, as the runtime does */
+static float truncate_ms(float t) {
+    return (float) trunc(t * 1000) / 1000.0f;
+}
+
+/* MyLipSync.AnimatePhoneme: at most one new phoneme per step, the first
+   one and rests are never animated */
+static void animate(ls_solver * s, int c, solver_track * tr, float t) {
+    float next_start;
+    int p;
+
+    if (tr->cursor >= tr->count) return;
+    next_start = tr->cursor < tr->count - 1 ? tr->start[tr->cursor + 1] : 0;
+    if (t <= next_start) return;
+    tr->cursor++;
+    if (tr->cursor >= tr->count) return;
+    p = tr->phoneme[tr->cursor];
+    if (p == LS_REST || s->rig_first[c * LS_PHONEME_COUNT + p] < 0) return;
+    tr->active[tr->nactive] = tr->cursor;
+    tr->state[tr->nactive] = ACTIVE_RISING;
+    tr->nactive++;
+}
+
+/* PhonemeRise/PhonemeDecay of every active phoneme of a track, then
+   RefreshCurrentPhonemes */
+static void evaluate(ls_solver * s, int c, solver_track * tr, float t) {
+    int quadratic = s->quadratic[c], a, b, n, seg, first, count;
+    const float * targets;
+    float step, blend;
+
+    for (a = 0; a < tr->nactive; a++) {
+        seg = tr->active[a];
+        first = s->rig_first[c * LS_PHONEME_COUNT + tr->phoneme[seg]];
+        count = s->rig_count[c * LS_PHONEME_COUNT + tr->phoneme[seg]];
+        if (tr->state[a] == ACTIVE_RISING) {
+            step = ease_in(quadratic, truncate_ms(t - tr->start[seg]) / tr->rise[seg]);
+            targets = tr->targets + tr->target_first[seg];
+            for (b = 0; b < count; b++) {
+                blend = (step < 1) ? targets[b] * step : targets[b];
+                s->weights[s->rig_slot[first + b]] = blend;
+                s->held[first + b] = blend;
+            }
+            if (t >= tr->apex[seg]) tr->state[a] = ACTIVE_DECAYING;
+        }
+        else {
+            step = ease_out(quadratic, truncate_ms(t - tr->apex[seg]) / tr->decay[seg]);
+            for (b = 0; b < count; b++) {
+                blend = (step > 0) ? s->held[first + b] * step : 0;
+                s->weights[s->rig_slot[first + b]] = blend;
+            }
+            if (t >= tr->end[seg]) tr->state[a] = ACTIVE_ENDED;
+        }
+    }
+
+    for (a = 0, n = 0; a < tr->nactive; a++) {
+        if (tr->state[a] == ACTIVE_ENDED) continue;
+        tr->active[n] = tr->active[a];
+        tr->state[n] = tr->state[a];
+        n++;
+    }
+    tr->nactive = n;
+}
+
+/* Dominance model: the phonemes set every slot of the character, the
+   alveorals, which MyLipSync lays over the phonemes, raise the slots of
+   the alveorals within the window */
+static void dominance(ls_solver * s, int c, float t) {
+    int index[LS_COARTIC_MAX_PHONES], k, n, j, b, p, first, count;
+    float d[LS_COARTIC_MAX_PHONES], scale, * out;
+    const float * targets;
+    solver_track * tr;
+    int slot;
+
+    for (k = 0; k < LS_SOLVER_TRACKS; k++) {
+        tr = &s->tracks[c * LS_SOLVER_TRACKS + k];
+        n = ls_coartic_window(tr->phoneme, tr->start, tr->end, tr->count, t, &tr->window_first, index, d);
+        scale = 1.0f / (LS_COARTIC_NEUTRAL + ls_sum(d, n));
+        if (k == 0) {
+            out = s->weights;
+            memset(out + s->slot_first[c], 0, s->slot_count[c] * sizeof(float));
+        }
+        else {
+            out = s->scratch;
+            for (j = 0; j < n; j++) {
+                p = tr->phoneme[index[j]];
+                first = s->rig_first[c * LS_PHONEME_COUNT + p];
+                count = s->rig_count[c * LS_PHONEME_COUNT + p];
+                for (b = 0; b < count; b++) out[s->rig_slot[first + b]] = 0;
+            }
+        }
+
+        for (j = 0; j < n; j++) {
+            p = tr->phoneme[index[j]];
+            first = s->rig_first[c * LS_PHONEME_COUNT + p];
+            count = s->rig_count[c * LS_PHONEME_COUNT + p];
+            targets = tr->targets + tr->target_first[index[j]];
+            for (b = 0; b < count; b++) out[s->rig_slot[first + b]] += d[j] * scale * targets[b];
+        }
+
+        if (k > 0) {
+            for (j = 0; j < n; j++) {
+                p = tr->phoneme[index[j]];
+                first = s->rig_first[c * LS_PHONEME_COUNT + p];
+                count = s->rig_count[c * LS_PHONEME_COUNT + p];
+                for (b = 0; b < count; b++) {
+                    slot = s->rig_slot[first + b];
+                    if (out[slot] > s->weights[slot]) s->weights[slot] = out[slot];
+                }
+            }
+        }
+    }
+}
+
+/* Characters of one part of a step, as FixedUpdate of each */
+static int run_part(ls_solver * s, int part, int parts) {
+    int first = (int) ((long) s->count * part / parts);
+    int last = (int) ((long) s->count * (part + 1) / parts);
+    int c, k, evaluated = 0;
+    float t;
+
+    for (c = first; c < last; c++) {
+        t = s->times[c];
+        if (t < 0) continue;
+        if (s->model[c] == LS_SOLVER_DOMINANCE) {
+            dominance(s, c, t);
+            evaluated++;
+            continue;
+        }
+        for (k = 0; k < LS_SOLVER_TRACKS; k++) animate(s, c, &s->tracks[c * LS_SOLVER_TRACKS + k], t);
+        for (k = 0; k < LS_SOLVER_TRACKS; k++) evaluate(s, c, &s->tracks[c * LS_SOLVER_TRACKS + k], t);
+        evaluated++;
+    }
+    return evaluated;
+}
+
+static tts_thread_ret TTS_THREAD_CALL worker_main(void * userdata) {
+    solver_worker * w = (solver_worker *) userdata;
+    ls_solver * s = w->solver;
+    unsigned int seen = 0;
+
+    for (;;) {
+        tts_mutex_lock(&s->lock);
+        while (s->generation == seen && !s->quit) tts_cond_wait(&s->start, &s->lock);
+        if (s->quit) {
+            tts_mutex_unlock(&s->lock);
+            break;
+        }
+        seen = s->generation;
+        tts_mutex_unlock(&s->lock);
+
+        w->evaluated = w->index < s->parts ? run_part(s, w->index, s->parts) : 0;
+
+        tts_mutex_lock(&s->lock);
+        if (--s->pending == 0) tts_cond_signal(&s->done);
+        tts_mutex_unlock(&s->lock);
+    }
+    return 0;
+}
+
+LS_EXPORT ls_solver * ls_solver_new(int threads) {
+    ls_solver * s = calloc(1, sizeof(ls_solver));
+    int i;
+
+    s->nthreads = threads > 0 ? threads : tts_cpu_count();
+    tts_mutex_init(&s->lock);
+    tts_cond_init(&s->start);
+    tts_cond_init(&s->done);
+    s->workers = calloc(s->nthreads, sizeof(solver_worker));
+    for (i = 1; i < s->nthreads; i++) {
+        s->workers[i].solver = s;
+        s->workers[i].index = i;
+        if (!tts_thread_start(&s->workers[i].thread, worker_main, &s->workers[i])) {
+            /* run with the threads started so far */
+            s->nthreads = i;
+            break;
+        }
+    }
+    return s;
+}
+
+static void track_free(solver_track * tr) {
+    free(tr->phoneme);
+    free(tr->start);
+    free(tr->end);
+    free(tr->apex);
+    free(tr->rise);
+    free(tr->decay);
+    free(tr->target_first);
+    free(tr->targets);
+    free(tr->active);
+    free(tr->state);
+}
+
+LS_EXPORT void ls_solver_delete(ls_solver * s) {
+    int i;
+
+    if (!s) return;
+    tts_mutex_lock(&s->lock);
+    s->quit = 1;
+    tts_cond_broadcast(&s->start);
+    tts_mutex_unlock(&s->lock);
+    for (i = 1; i < s->nthreads; i++) tts_thread_join(s->workers[i].thread);
+    tts_cond_destroy(&s->start);
+    tts_cond_destroy(&s->done);
+    tts_mutex_destroy(&s->lock);
+
+    for (i = 0; i < s->count; i++) ls_prosody_free(&s->prosody[i]);
+    for (i = 0; i < s->count * LS_SOLVER_TRACKS; i++) track_free(&s->tracks[i]);
+    free(s->quadratic);
+    free(s->model);
+    free(s->slot_first);
+    free(s->slot_count);
+    free(s->rig_first);
+    free(s->rig_count);
+    free(s->prosody);
+    free(s->tracks);
+    free(s->rig_slot);
+    free(s->rig_weight);
+    free(s->held);
+    free(s->slot_shape);
+    free(s->weights);
+    free(s->scratch);
+    free(s->workers);
+    free(s);
+}
+
+LS_EXPORT int ls_solver_add_character(ls_solver * s, const int * counts, const int * shapes, const float * weights) {
+    int c = s->count, cap, p, b, k, total = 0, slot, entry = 0;
+
+    if (c == s->cap) {
+        cap = s->cap ? s->cap * 2 : 8;
+        s->quadratic = realloc(s->quadratic, cap);
+        s->model = realloc(s->model, cap);
+        s->slot_first = realloc(s->slot_first, cap * sizeof(int));
+        s->slot_count = realloc(s->slot_count, cap * sizeof(int));
+        s->rig_first = realloc(s->rig_first, (size_t) cap * LS_PHONEME_COUNT * sizeof(int));
+        s->rig_count = realloc(s->rig_count, (size_t) cap * LS_PHONEME_COUNT * sizeof(int));
+        s->prosody = realloc(s->prosody, cap * sizeof(ls_prosody));
+        s->tracks = realloc(s->tracks, (size_t) cap * LS_SOLVER_TRACKS * sizeof(solver_track));
+        s->cap = cap;
+    }
+    s->count++;
+    s->quadratic[c] = 0;
+    s->model[c] = LS_SOLVER_RISE_DECAY;
+    memset(&s->prosody[c], 0, sizeof(ls_prosody));
+    memset(&s->tracks[c * LS_SOLVER_TRACKS], 0, LS_SOLVER_TRACKS * sizeof(solver_track));
+
+    for (p = 0; p < LS_PHONEME_COUNT; p++)
+        if (counts[p] > 0) total += counts[p];
+    s->rig_slot = grow(s->rig_slot, &s->rig_cap, s->nrig + total, sizeof(int));
+    k = s->rig_cap;
+    s->rig_weight = realloc(s->rig_weight, k * sizeof(float));
+    s->held = realloc(s->held, k * sizeof(float));
+    k = s->slots_cap;
+    s->slot_shape = grow(s->slot_shape, &s->slots_cap, s->nslots + total, sizeof(int));
+    if (s->slots_cap != k) {
+        s->weights = realloc(s->weights, s->slots_cap * sizeof(float));
+        s->scratch = realloc(s->scratch, s->slots_cap * sizeof(float));
+    }
+
+    /* one slot per distinct blendshape of the mapping */
+    s->slot_first[c] = s->nslots;
+    s->slot_count[c] = 0;
+    for (p = 0; p < LS_PHONEME_COUNT; p++) {
+        s->rig_first[c * LS_PHONEME_COUNT + p] = counts[p] < 0 ? -1 : s->nrig;
+        s->rig_count[c * LS_PHONEME_COUNT + p] = counts[p] < 0 ? 0 : counts[p];
+        for (b = 0; b < counts[p]; b++, entry++) {
+            for (slot = 0; slot < s->slot_count[c]; slot++)
+                if (s->slot_shape[s->slot_first[c] + slot] == shapes[entry]) break;
+            if (slot == s->slot_count[c]) {
+                s->slot_shape[s->nslots] = shapes[entry];
+                s->weights[s->nslots] = 0;
+                s->nslots++;
+                s->slot_count[c]++;
+            }
+            s->rig_slot[s->nrig] = s->slot_first[c] + slot;
+            s->rig_weight[s->nrig] = weights[entry];
+            s->held[s->nrig] = 0;
+            s->nrig++;
+        }
+    }
+    return c;
+}
+
+LS_EXPORT int ls_solver_slots(const ls_solver * s, int character, int * shapes) {
+    if (character < 0 || character >= s->count) return 0;
+    if (shapes)
+        memcpy(shapes, s->slot_shape + s->slot_first[character], s->slot_count[character] * sizeof(int));
+    return s->slot_count[character];
+}
+
+LS_EXPORT int ls_solver_slot_offset(const ls_solver * s, int character) {
+    if (character < 0 || character >= s->count) return -1;
+    return s->slot_first[character];
+}
+
+LS_EXPORT int ls_solver_weight_count(const ls_solver * s) {
+    return s->nslots;
+}
+
+LS_EXPORT void ls_solver_set_curve(ls_solver * s, int character, int quadratic) {
+    if (character < 0 || character >= s->count) return;
+    s->quadratic[character] = quadratic != 0;
+}
+
+LS_EXPORT void ls_solver_set_model(ls_solver * s, int character, int model) {
+    if (character < 0 || character >= s->count) return;
+    s->model[character] = model == LS_SOLVER_DOMINANCE ? LS_SOLVER_DOMINANCE : LS_SOLVER_RISE_DECAY;
+}
+
+LS_EXPORT void ls_solver_set_prosody(ls_solver * s, int character, float window_ms,
+                                     const float * ranges, float vowel_pitch_ratio,
+                                     float consonant_pitch_ratio, const float * windows, int count) {
+    ls_prosody * p;
+    ls_range * range[LS_SERIES_COUNT];
+    float ** window[LS_SERIES_COUNT];
+    int k;
+
+    if (character < 0 || character >= s->count) return;
+    p = &s->prosody[character];
+    ls_prosody_free(p);
+    p->window = window_ms;
+    p->vowel_pitch_ratio = vowel_pitch_ratio;
+    p->consonant_pitch_ratio = consonant_pitch_ratio;
+    if (!windows || count < 1 || window_ms < 1) return;
+
+    range[LS_SERIES_VOWEL_PITCH] = &p->vowel_pitch;
+    range[LS_SERIES_CONSONANT_PITCH] = &p->consonant_pitch;
+    range[LS_SERIES_VOWEL_INTENSITY] = &p->vowel_intensity;
+    range[LS_SERIES_CONSONANT_INTENSITY] = &p->consonant_intensity;
+    window[LS_SERIES_VOWEL_PITCH] = &p->vowel_pitch_window;
+    window[LS_SERIES_CONSONANT_PITCH] = &p->consonant_pitch_window;
+    window[LS_SERIES_VOWEL_INTENSITY] = &p->vowel_intensity_window;
+    window[LS_SERIES_CONSONANT_INTENSITY] = &p->consonant_intensity_window;
+    for (k = 0; k < LS_SERIES_COUNT; k++) {
+        range[k]->min = ranges[k * 3];
+        range[k]->mean = ranges[k * 3 + 1];
+        range[k]->max = ranges[k * 3 + 2];
+        *window[k] = malloc(count * sizeof(float));
+        memcpy(*window[k], windows + (size_t) k * count, count * sizeof(float));
+    }
+    p->windows = count;
+}
+
+LS_EXPORT void ls_solver_set_track(ls_solver * s, int character, int track, const int * phonemes,
+                                   const float * start, const float * end, const float * mean_pitch,
+                                   const float * mean_intensity, int count, int weighted) {
+    solver_track * tr;
+    ls_segment seg;
+    int i, b, a, n, p, first, shapes;
+
+    if (character < 0 || character >= s->count || track < 0 || track >= LS_SOLVER_TRACKS) return;
+    tr = &s->tracks[character * LS_SOLVER_TRACKS + track];
+    if (count < 0) count = 0;
+
+    if (count > tr->cap) {
+        n = tr->cap;
+        tr->phoneme = grow(tr->phoneme, &n, count, 1);
+        tr->start = realloc(tr->start, n * sizeof(float));
+        tr->end = realloc(tr->end, n * sizeof(float));
+        tr->apex = realloc(tr->apex, n * sizeof(float));
+        tr->rise = realloc(tr->rise, n * sizeof(float));
+        tr->decay = realloc(tr->decay, n * sizeof(float));
+        tr->target_first = realloc(tr->target_first, n * sizeof(int));
+        tr->active = realloc(tr->active, n * sizeof(int));
+        tr->state = realloc(tr->state, n);
+        tr->cap = n;
+    }
+
+    tr->ntargets = 0;
+    for (i = 0; i < count; i++) {
+        p = phonemes[i] >= 0 && phonemes[i] < LS_PHONEME_COUNT ? phonemes[i] : LS_REST;
+        tr->phoneme[i] = (unsigned char) p;
+        tr->start[i] = start[i];
+        tr->end[i] = end[i];
+        tr->apex[i] = start[i] + (end[i] - start[i]) * 0.75f;
+        tr->rise[i] = truncate_ms(tr->apex[i] - start[i]);
+        tr->decay[i] = truncate_ms(end[i] - tr->apex[i]);
+
+        /* the target of every blendshape, as the rise step computes it */
+        first = s->rig_first[character * LS_PHONEME_COUNT + p];
+        shapes = s->rig_count[character * LS_PHONEME_COUNT + p];
+        tr->target_first[i] = tr->ntargets;
+        if (first < 0 || shapes == 0) continue;
+        tr->targets = grow(tr->targets, &tr->targets_cap, tr->ntargets + shapes, sizeof(float));
+        seg.phoneme = (ls_phoneme) p;
+        seg.start = start[i];
+        seg.end = end[i];
+        seg.mean_pitch = mean_pitch ? mean_pitch[i] : 0;
+        seg.mean_intensity = mean_intensity ? mean_intensity[i] : 0;
+        for (b = 0; b < shapes; b++) {
+            float w = s->rig_weight[first + b];
+            tr->targets[tr->ntargets++] = weighted ? ls_prosody_target(&s->prosody[character], &seg, w) : w;
+        }
+    }
+
+    /* playback continues, without the phonemes that are gone */
+    tr->count = count;
+    if (tr->cursor > count) tr->cursor = count;
+    if (tr->window_first > count) tr->window_first = count;
+    for (a = 0, n = 0; a < tr->nactive; a++) {
+        if (tr->active[a] >= count) continue;
+        tr->active[n] = tr->active[a];
+        tr->state[n] = tr->state[a];
+        n++;
+    }
+    tr->nactive = n;
+}
+
+LS_EXPORT void ls_solver_reset(ls_solver * s, int character) {
+    int k;
+    if (character < 0 || character >= s->count) return;
+    for (k = 0; k < LS_SOLVER_TRACKS; k++) {
+        s->tracks[character * LS_SOLVER_TRACKS + k].cursor = 0;
+        s->tracks[character * LS_SOLVER_TRACKS + k].nactive = 0;
+        s->tracks[character * LS_SOLVER_TRACKS + k].window_first = 0;
+    }
+}
+
+LS_EXPORT int ls_solver_step(ls_solver * s, const float * times, float * weights) {
+    int parts, evaluated, i;
+
+    s->times = times;
+    parts = (s->count + MIN_PER_THREAD - 1) / MIN_PER_THREAD;
+    if (parts > s->nthreads) parts = s->nthreads;
+    if (parts < 1) parts = 1;
+    s->parts = parts;
+
+    if (parts > 1) {
+        tts_mutex_lock(&s->lock);
+        s->generation++;
+        s->pending = s->nthreads - 1;
+        tts_cond_broadcast(&s->start);
+        tts_mutex_unlock(&s->lock);
+
+        evaluated = run_part(s, 0, parts);
+
+        tts_mutex_lock(&s->lock);
+        while (s->pending > 0) tts_cond_wait(&s->done, &s->lock);
+        tts_mutex_unlock(&s->lock);
+        for (i = 1; i < s->nthreads; i++) evaluated += s->workers[i].evaluated;
+    }
+    else {
+        evaluated = run_part(s, 0, 1);
+    }
+
+    if (weights) memcpy(weights, s->weights, s->nslots * sizeof(float));
+    return evaluated;
+}
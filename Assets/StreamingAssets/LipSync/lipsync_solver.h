@@ -0,0 +1,96 @@
+/* Batched viseme solver for scenes with many speaking characters.
+
+   Every MyLipSync evaluates its own phonemes in FixedUpdate: it looks up
+   the blendshapes of each active phoneme in a dictionary, classifies the
+   phoneme with Enum.IsDefined, reads the prosody windows and sets each
+   weight on the mesh, per blendshape and per tick.  The solver holds the
+   same model (phoneme activation, ease-in rise to 75% of the phoneme,
+   ease-out decay, the per-phoneme weight held at the apex) for all
+   registered characters and evaluates them in one call per tick:
+
+     - per character state (curve, rig tables, slot range, prosody) and
+       per track segment data (phoneme, start, apex, end, targets) are
+       kept in flat arrays;
+     - phoneme classes come from the ls_phonemes table, and the target
+       weights, which MyLipSync recomputes from the prosody windows at
+       every rise step, are computed once when a track is loaded;
+     - characters are split between worker threads, each writing the
+       weights of its own characters;
+     - the weights of all characters come back in one contiguous buffer,
+       character after character, one entry per blendshape the
+       character's mapping uses (its slots).
+
+   The results are those of MyLipSync with the same timings, including
+   the truncation of times to milliseconds.  The second track holds the
+   alveorals, which MyLipSync animates alongside the phonemes.  A
+   character can use dominance-function coarticulation instead
+   (lipsync_coartic.h), with the same tracks and targets.
+
+   Unity drives the solver through VisemeSolver.cs.  The shared library
+   build is given in lipsync_pitch.h.
+*/
+
+#ifndef LIPSYNC_SOLVER_H
+#define LIPSYNC_SOLVER_H
+
+#include "lipsync_phoneme.h"
+
+#define LS_SOLVER_TRACKS 2    /* phonemes and alveorals */
+
+typedef struct ls_solver ls_solver;
+
+/* threads is the number of threads evaluating a step, the caller's
+   included; 0 for one per processor. */
+LS_EXPORT ls_solver * ls_solver_new(int threads);
+LS_EXPORT void ls_solver_delete(ls_solver * s);
+
+/* Adds a character with its viseme mapping: counts[p] blendshapes for
+   each of the LS_PHONEME_COUNT phonemes, their mesh indices and
+   weights listed in phoneme order in shapes and weights (a count of -1
+   marks an unmapped phoneme, which is never animated).  Returns the
+   character's id. */
+LS_EXPORT int ls_solver_add_character(ls_solver * s, const int * counts, const int * shapes, const float * weights);
+/* Slots of a character: number of blendshapes, and their mesh indices
+   copied to shapes if not NULL */
+LS_EXPORT int ls_solver_slots(const ls_solver * s, int character, int * shapes);
+/* Position of the character's first slot in the weight buffer */
+LS_EXPORT int ls_solver_slot_offset(const ls_solver * s, int character);
+/* Length of the weight buffer, all characters */
+LS_EXPORT int ls_solver_weight_count(const ls_solver * s);
+
+/* Exponential (0) or quadratic (1) easing, as MyLipSync.CurveMode */
+LS_EXPORT void ls_solver_set_curve(ls_solver * s, int character, int quadratic);
+
+#define LS_SOLVER_RISE_DECAY 0
+#define LS_SOLVER_DOMINANCE 1
+
+/* Animation model of a character, rise/decay by default */
+LS_EXPORT void ls_solver_set_model(ls_solver * s, int character, int model);
+
+/* Pitch and intensity statistics the target weights are scaled with,
+   as the statics SpeechAnalysis sets on MyLipSync.  ranges holds min,
+   mean and max of each ls_series (lipsync_aggregate.h order), windows
+   the window means of each series, count per series.  Applies to tracks
+   loaded afterwards. */
+LS_EXPORT void ls_solver_set_prosody(ls_solver * s, int character, float window_ms,
+                                     const float * ranges, float vowel_pitch_ratio,
+                                     float consonant_pitch_ratio, const float * windows, int count);
+
+/* Loads the phonemes of a track.  mean_pitch and mean_intensity may be
+   NULL; with weighted set the targets are scaled by the prosody, as
+   MyLipSync with considerFrequency.  The playback position is kept,
+   so a track can be reloaded with more phonemes while it plays. */
+LS_EXPORT void ls_solver_set_track(ls_solver * s, int character, int track, const int * phonemes,
+                                   const float * start, const float * end, const float * mean_pitch,
+                                   const float * mean_intensity, int count, int weighted);
+/* Rewinds the character to the start of its tracks */
+LS_EXPORT void ls_solver_reset(ls_solver * s, int character);
+
+/* Evaluates every character at times[character] seconds into its
+   utterance (negative for characters that are not playing, whose
+   weights are left as they are) and copies the weight buffer to
+   weights.  Times must not go backwards without a reset.  Returns the
+   number of characters evaluated. */
+LS_EXPORT int ls_solver_step(ls_solver * s, const float * times, float * weights);
+
+#endif /* LIPSYNC_SOLVER_H */
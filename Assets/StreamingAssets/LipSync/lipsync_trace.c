@@ -0,0 +1,271 @@
+/* Arousal/valence traces and circumplex classification.
+   See lipsync_trace.h. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lipsync_trace.h"
+#include "lipsync_rig.h"
+
+/* grid spacing within which ratings count as regular, fraction of the step */
+#define GRID_TOLERANCE 0.01f
+
+/* cell whose corners have different nearest emotions */
+#define CELL_BORDER -2
+
+struct ls_traces {
+    int count, cap;
+    int * first;           /* range of each trace in time/value */
+    int * length;
+    float * origin;        /* time of the first rating */
+    float * step;          /* grid step of regular traces, 0 otherwise */
+    int * cursor;          /* rating at or before the last sampled time */
+    int nratings, ratings_cap;
+    float * time;
+    float * value;
+};
+
+struct ls_circumplex {
+    int count;
+    float * arousal, * valence;
+    float max_distance;
+    int * cells;           /* LS_CIRCUMPLEX_GRID^2, valence major */
+};
+
+LS_EXPORT ls_traces * ls_traces_new(void) {
+    return calloc(1, sizeof(ls_traces));
+}
+
+LS_EXPORT void ls_traces_delete(ls_traces * s) {
+    if (!s) return;
+    free(s->first);
+    free(s->length);
+    free(s->origin);
+    free(s->step);
+    free(s->cursor);
+    free(s->time);
+    free(s->value);
+    free(s);
+}
+
+typedef struct rating {
+    float time, value;
+} rating;
+
+static int compare_rating(const void * a, const void * b) {
+    float ta = ((const rating *) a)->time, tb = ((const rating *) b)->time;
+    return (ta > tb) - (ta < tb);
+}
+
+LS_EXPORT int ls_traces_load(ls_traces * s, const char * path) {
+    char * buf = ls_read_file(path, NULL), * p, * end;
+    rating * ratings = NULL;
+    int n = 0, cap = 0, i, sorted = 1, t;
+    float time, value, step;
+
+    if (!buf) return -1;
+    for (p = buf; *p; ) {
+        time = (float) strtod(p, &end);
+        if (end != p) {
+            p = end;
+            value = (float) strtod(p, &end);
+            if (end != p) {
+                if (n == cap) {
+                    cap = cap ? cap * 2 : 1024;
+                    ratings = realloc(ratings, cap * sizeof(rating));
+                }
+                if (n && time < ratings[n - 1].time) sorted = 0;
+                ratings[n].time = time;
+                ratings[n].value = value;
+                n++;
+                p = end;
+            }
+        }
+        /* next line */
+        while (*p && *p != '\n') p++;
+        if (*p) p++;
+    }
+    free(buf);
+    if (n == 0) {
+        free(ratings);
+        return -1;
+    }
+    if (!sorted) qsort(ratings, n, sizeof(rating), compare_rating);
+
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 8;
+        s->first = realloc(s->first, s->cap * sizeof(int));
+        s->length = realloc(s->length, s->cap * sizeof(int));
+        s->origin = realloc(s->origin, s->cap * sizeof(float));
+        s->step = realloc(s->step, s->cap * sizeof(float));
+        s->cursor = realloc(s->cursor, s->cap * sizeof(int));
+    }
+    if (s->nratings + n > s->ratings_cap) {
+        while (s->nratings + n > s->ratings_cap) s->ratings_cap = s->ratings_cap ? s->ratings_cap * 2 : 4096;
+        s->time = realloc(s->time, s->ratings_cap * sizeof(float));
+        s->value = realloc(s->value, s->ratings_cap * sizeof(float));
+    }
+
+    t = s->count++;
+    s->first[t] = s->nratings;
+    s->length[t] = n;
+    s->origin[t] = ratings[0].time;
+    s->cursor[t] = 0;
+    for (i = 0; i < n; i++) {
+        s->time[s->nratings + i] = ratings[i].time;
+        s->value[s->nratings + i] = ratings[i].value;
+    }
+    s->nratings += n;
+
+    /* regular grid: every rating within tolerance of its grid time */
+    step = n > 1 ? (ratings[n - 1].time - ratings[0].time) / (n - 1) : 0;
+    for (i = 1; i < n && step > 0; i++)
+        if (fabsf(ratings[i].time - (ratings[0].time + i * step)) > step * GRID_TOLERANCE) step = 0;
+    s->step[t] = step;
+
+    free(ratings);
+    return t;
+}
+
+LS_EXPORT int ls_traces_count(const ls_traces * s) {
+    return s->count;
+}
+
+LS_EXPORT float ls_traces_duration(const ls_traces * s) {
+    float duration = 0, last;
+    int t;
+    for (t = 0; t < s->count; t++) {
+        last = s->time[s->first[t] + s->length[t] - 1];
+        if (last > duration) duration = last;
+    }
+    return duration;
+}
+
+/* Rating at or before t of trace k, t within the trace */
+static int locate(ls_traces * s, int k, float t) {
+    const float * time = s->time + s->first[k];
+    int n = s->length[k], i = s->cursor[k], lo, hi, mid;
+
+    if (s->step[k] > 0) {
+        i = (int) ((t - s->origin[k]) / s->step[k]);
+        if (i > n - 2) i = n - 2;
+        /* the grid time can be off by the tolerance */
+        if (i > 0 && time[i] > t) i--;
+        else if (time[i + 1] <= t) i++;
+        return i;
+    }
+
+    if (time[i] > t) {
+        /* seek backwards */
+        lo = 0;
+        hi = i;
+        while (hi - lo > 1) {
+            mid = (lo + hi) / 2;
+            if (time[mid] <= t) lo = mid;
+            else hi = mid;
+        }
+        i = lo;
+    }
+    while (i < n - 2 && time[i + 1] <= t) i++;
+    s->cursor[k] = i;
+    return i;
+}
+
+LS_EXPORT void ls_traces_sample(ls_traces * s, float t, float * values) {
+    const float * time, * value;
+    float span;
+    int k, n, i;
+
+    for (k = 0; k < s->count; k++) {
+        time = s->time + s->first[k];
+        value = s->value + s->first[k];
+        n = s->length[k];
+        if (n == 1 || t <= time[0]) {
+            values[k] = value[0];
+            continue;
+        }
+        if (t >= time[n - 1]) {
+            values[k] = value[n - 1];
+            continue;
+        }
+        i = locate(s, k, t);
+        span = time[i + 1] - time[i];
+        values[k] = span > 0 ? value[i] + (value[i + 1] - value[i]) * (t - time[i]) / span : value[i + 1];
+    }
+}
+
+/* Nearest emotion within the distance limit, by scanning them all */
+static int nearest(const ls_circumplex * c, float arousal, float valence) {
+    float best = c->max_distance, d;
+    int i, index = -1;
+    for (i = 0; i < c->count; i++) {
+        d = sqrtf((arousal - c->arousal[i]) * (arousal - c->arousal[i]) +
+                  (valence - c->valence[i]) * (valence - c->valence[i]));
+        if (d < best) {
+            best = d;
+            index = i;
+        }
+    }
+    return index;
+}
+
+LS_EXPORT ls_circumplex * ls_circumplex_new(const float * arousal, const float * valence, int count, float max_distance) {
+    ls_circumplex * c = calloc(1, sizeof(ls_circumplex));
+    const int g = LS_CIRCUMPLEX_GRID;
+    const float cell = 2.0f / g;
+    int * corner = malloc((size_t) (g + 1) * (g + 1) * sizeof(int));
+    int x, y, n;
+
+    c->count = count;
+    c->max_distance = max_distance;
+    c->arousal = malloc((count ? count : 1) * sizeof(float));
+    c->valence = malloc((count ? count : 1) * sizeof(float));
+    memcpy(c->arousal, arousal, count * sizeof(float));
+    memcpy(c->valence, valence, count * sizeof(float));
+    c->cells = malloc((size_t) g * g * sizeof(int));
+
+    for (y = 0; y <= g; y++)
+        for (x = 0; x <= g; x++)
+            corner[y * (g + 1) + x] = nearest(c, -1 + x * cell, -1 + y * cell);
+
+    /* a cell has one answer if all its corners agree; otherwise it
+       straddles a border and is resolved by a scan when hit */
+    for (y = 0; y < g; y++) {
+        for (x = 0; x < g; x++) {
+            n = corner[y * (g + 1) + x];
+            if (corner[y * (g + 1) + x + 1] != n || corner[(y + 1) * (g + 1) + x] != n ||
+                corner[(y + 1) * (g + 1) + x + 1] != n)
+                n = CELL_BORDER;
+            c->cells[y * g + x] = n;
+        }
+    }
+    free(corner);
+    return c;
+}
+
+LS_EXPORT void ls_circumplex_delete(ls_circumplex * c) {
+    if (!c) return;
+    free(c->arousal);
+    free(c->valence);
+    free(c->cells);
+    free(c);
+}
+
+LS_EXPORT int ls_circumplex_classify(const ls_circumplex * c, float arousal, float valence, float * intensity) {
+    const int g = LS_CIRCUMPLEX_GRID;
+    int x = (int) floorf((arousal + 1) * g / 2), y = (int) floorf((valence + 1) * g / 2), index;
+    float base;
+
+    if (x >= 0 && x < g && y >= 0 && y < g && c->cells[y * g + x] != CELL_BORDER)
+        index = c->cells[y * g + x];
+    else
+        index = nearest(c, arousal, valence);
+
+    if (intensity) {
+        /* relative to the centre, as ClassifyEmotion */
+        base = index >= 0 ? sqrtf(c->arousal[index] * c->arousal[index] + c->valence[index] * c->valence[index]) : 0;
+        *intensity = base > 0 ? sqrtf(arousal * arousal + valence * valence) / base : 1;
+        if (*intensity > 1) *intensity = 1;
+    }
+    return index;
+}
@@ -0,0 +1,65 @@
+/* Arousal/valence traces for the emotion playback of the SEMAINE
+   videos (PlayVideo.cs).
+
+   A trace is one annotator's FeelTrace rating of one dimension, a text
+   file of "time value" lines.  PlayVideo used to keep each trace in a
+   Dictionary keyed by the float time, probe it with the playback time
+   truncated to 1/100 s and hold the last value on a miss; the nearest
+   emotion of the circumplex model was then found by a scan over all of
+   them and its marker with GameObject.Find, every tick.
+
+   Here all traces of a session are kept in one store, as flat time and
+   value arrays with a range per trace:
+
+     - a sample is the linear interpolation between the two ratings
+       around t, clamped to the first and last rating;
+     - traces on a regular time grid, which FeelTrace writes, are
+       indexed directly; irregular ones keep a cursor that follows the
+       playback and only fall back to a binary search when it seeks
+       backwards, so a sample costs O(1) either way;
+     - one call samples every trace of the store, so several annotators
+       play side by side at the cost of one.
+
+   The circumplex classifier tabulates the nearest emotion of every cell
+   of a grid over the arousal/valence plane once, so classifying is a
+   table lookup whatever the number of emotions.
+
+   Unity calls these through P/Invoke (EmotionTraces.cs); the shared
+   library build is given in lipsync_pitch.h.
+*/
+
+#ifndef LIPSYNC_TRACE_H
+#define LIPSYNC_TRACE_H
+
+#include "lipsync_phoneme.h"
+
+typedef struct ls_traces ls_traces;
+
+LS_EXPORT ls_traces * ls_traces_new(void);
+LS_EXPORT void ls_traces_delete(ls_traces * s);
+/* Adds the trace of a "time value" file, ratings in any order.
+   Returns its index in the store, or -1 if the file cannot be read or
+   holds no rating. */
+LS_EXPORT int ls_traces_load(ls_traces * s, const char * path);
+LS_EXPORT int ls_traces_count(const ls_traces * s);
+/* Duration of the longest trace, seconds */
+LS_EXPORT float ls_traces_duration(const ls_traces * s);
+/* Value of every trace at t seconds, in load order */
+LS_EXPORT void ls_traces_sample(ls_traces * s, float t, float * values);
+
+#define LS_CIRCUMPLEX_GRID 256    /* cells per axis over [-1, 1] */
+
+typedef struct ls_circumplex ls_circumplex;
+
+/* Tabulates the nearest of count emotions, given by their arousal and
+   valence, for every cell of the plane; points further than
+   max_distance from every emotion are not classified, as the 1.0 limit
+   of PlayVideo.ClassifyEmotion. */
+LS_EXPORT ls_circumplex * ls_circumplex_new(const float * arousal, const float * valence, int count, float max_distance);
+LS_EXPORT void ls_circumplex_delete(ls_circumplex * c);
+/* Index of the emotion nearest to (arousal, valence), -1 for none.
+   intensity, if not NULL, receives the distance of the point from the
+   centre relative to the emotion's, at most 1. */
+LS_EXPORT int ls_circumplex_classify(const ls_circumplex * c, float arousal, float valence, float * intensity);
+
+#endif /* LIPSYNC_TRACE_H */
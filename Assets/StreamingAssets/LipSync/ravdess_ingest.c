@@ -0,0 +1,720 @@
+/* ravdess_ingest - analyses every clip of the RAVDESS emotional speech
+   corpus in one run, in place of loading them one at a time through
+   RuvdessParser, SpeechAnalysis (openSMILE), MAUS and PhonemeAnalyzer.
+
+   RAVDESS names its files modality-channel-emotion-intensity-statement-
+   repetition-actor.wav (e.g. 03-01-06-01-02-01-12.wav); the corpus
+   directory is searched recursively, so the Actor_NN folders of the
+   download can be given as they are.  Every clip speaks one of two
+   statements, which are synthesized once as alignment references:
+     tts_callback -o kids.wav -t kids.tl voice license kids.txt
+     tts_callback -o dogs.wav -t dogs.tl voice license dogs.txt
+   with kids.txt holding "Kids are talking by the door" (statement 01)
+   and dogs.txt "Dogs are sitting by the door" (statement 02).  The
+   references are given by their path without extension.
+
+   For each clip the output directory receives
+     - NAME.TextGrid, the phones and words aligned as clip_aligner does,
+       which PhonemeAnalyzer.ManageTextGridInfo reads;
+     - prosody_NAME.csv, the F0 and loudness contour of lipsync_pitch.h
+       in the columns of openSMILE's prosodyAcf output, which
+       SpeechAnalysis reads;
+     - NAME.txt, the transcript RuvdessParser writes with
+       generateTranscripts set;
+   and for the whole corpus
+     - clips.csv, one line per clip with its fields and the pitch and
+       intensity statistics SpeechAnalysis hands to MyLipSync;
+     - emotions.csv, the same statistics per channel, emotion and
+       intensity: the min and max over the clips, the mean of the clip
+       means and the mean of each sliding window, as the per-window
+       means of MyLipSync.SetMeanPitches.
+
+   The clips go through a pipeline of three stages connected by bounded
+   queues:
+     - a reader thread decodes the WAV files in name order;
+     - worker threads, one per processor by default, extract the
+       contour and the MFCC frames, align the clip to the reference of
+       its statement (whose frames are computed once and shared) and
+       compute the segment and window statistics;
+     - the main thread writes the per-clip files and keeps the
+       statistics of each clip for the summaries.
+   Each worker releases the decoded samples as soon as the frames are
+   extracted and a stage blocks when the queue after it is full, so at
+   most depth + threads clips are held in memory whatever the size of
+   the corpus; the summaries are computed in name order at the end, so
+   they do not depend on the number of threads.
+
+   Build:
+     gcc -O2 -msse2 -DTTS_TIMELINE_NO_ENGINE -I../CereVoice -o ravdess_ingest \
+         ravdess_ingest.c lipsync_align.c lipsync_mfcc.c lipsync_pitch.c \
+         lipsync_prosody.c lipsync_aggregate.c lipsync_audio.c lipsync_rig.c \
+         lipsync_phoneme.c ../CereVoice/tts_timeline.c -lpthread -lm
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <dirent.h>
+#else
+#include <direct.h>
+#endif
+#include "tts_thread.h"
+#include "lipsync_align.h"
+#include "lipsync_pitch.h"
+#include "lipsync_aggregate.h"
+
+/* fields of a RAVDESS file name */
+enum {
+    FIELD_MODALITY,
+    FIELD_CHANNEL,
+    FIELD_EMOTION,
+    FIELD_INTENSITY,
+    FIELD_STATEMENT,
+    FIELD_REPETITION,
+    FIELD_ACTOR,
+    FIELD_COUNT
+};
+
+#define CHANNELS 2
+#define EMOTIONS 8
+#define INTENSITIES 2
+#define STATEMENTS 2
+#define GROUPS (CHANNELS * EMOTIONS * INTENSITIES)
+
+/* as RuvdessParser */
+static const char * channel_names[CHANNELS] = {"speech", "song"};
+static const char * emotion_names[EMOTIONS] = {
+    "neutral", "calm", "happy", "sad", "angry", "fearful", "disgust", "surprised"
+};
+static const char * intensity_names[INTENSITIES] = {"normal", "strong"};
+static const char * statement_texts[STATEMENTS] = {
+    "kids are talking by the door", "dogs are sitting by the door"
+};
+static const char * series_names[LS_SERIES_COUNT] = {
+    "vowel_pitch", "consonant_pitch", "vowel_intensity", "consonant_intensity"
+};
+
+typedef struct reference {
+    ls_audio audio;
+    tts_timeline timeline;
+    ls_features features;
+} reference;
+
+typedef struct clip {
+    int index;                 /* in name order */
+    const char * path;
+    char name[64];             /* file name without extension */
+    int fields[FIELD_COUNT];
+    ls_audio audio;
+    float duration;            /* seconds */
+    int failed;
+    ls_contour contour;
+    ls_alignment alignment;
+    float cost;
+    ls_prosody prosody;
+} clip;
+
+/* What the summaries need of a clip once its files are written */
+typedef struct clip_summary {
+    int done;
+    int fields[FIELD_COUNT];
+    char name[64];
+    float duration;
+    int phones;
+    float cost;
+    ls_range ranges[LS_SERIES_COUNT];
+    float vowel_pitch_ratio, consonant_pitch_ratio;
+    int windows;
+    float * window[LS_SERIES_COUNT];
+} clip_summary;
+
+/* Bounded blocking queue of clips */
+typedef struct queue {
+    clip ** items;
+    int cap, head, count, closed;
+    tts_mutex lock;
+    tts_cond not_empty, not_full;
+} queue;
+
+typedef struct pipeline {
+    char ** paths;
+    int npaths;
+    reference refs[STATEMENTS];
+    ls_align_config cfg;
+    float window;              /* milliseconds */
+    int gender;                /* 1 male, 0 female, -1 from the actor number */
+    queue decoded, analysed;
+    tts_mutex lock;
+    int workers;               /* still running */
+    int unreadable;
+} pipeline;
+
+void usage(char * name) {
+    fprintf(stderr, "ravdess_ingest - aligns and analyses the clips of the RAVDESS corpus.\n\n");
+    fprintf(stderr, "Usage: %s [-h] [-j threads] [-q depth] [-w window_ms] [-g male|female] [-b band]\n", name);
+    fprintf(stderr, "       corpus_dir statement1_reference statement2_reference output_dir\n");
+    fprintf(stderr, " -j threads\t  Analysis threads, default one per processor\n");
+    fprintf(stderr, " -q depth\t  Clips queued between stages, default twice the threads\n");
+    fprintf(stderr, " -w window_ms\t  Sliding window of the pitch/intensity means, default 1000\n");
+    fprintf(stderr, " -g male|female\t  Speaker frequency range, default from the actor number (odd male)\n");
+    fprintf(stderr, " -b band\t  Warping band half width as a fraction of the clip, default 0.25\n");
+    fprintf(stderr, " The references are synthesized with tts_callback -o REF.wav -t REF.tl and given without extension.\n");
+    exit(0);
+}
+
+static void queue_init(queue * q, int cap) {
+    q->items = malloc(cap * sizeof(clip *));
+    q->cap = cap;
+    q->head = q->count = q->closed = 0;
+    tts_mutex_init(&q->lock);
+    tts_cond_init(&q->not_empty);
+    tts_cond_init(&q->not_full);
+}
+
+static void queue_destroy(queue * q) {
+    free(q->items);
+    tts_mutex_destroy(&q->lock);
+    tts_cond_destroy(&q->not_empty);
+    tts_cond_destroy(&q->not_full);
+}
+
+static void queue_push(queue * q, clip * c) {
+    tts_mutex_lock(&q->lock);
+    while (q->count == q->cap) tts_cond_wait(&q->not_full, &q->lock);
+    q->items[(q->head + q->count) % q->cap] = c;
+    q->count++;
+    tts_cond_signal(&q->not_empty);
+    tts_mutex_unlock(&q->lock);
+}
+
+/* Returns NULL once the queue is closed and empty */
+static clip * queue_pop(queue * q) {
+    clip * c = NULL;
+    tts_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) tts_cond_wait(&q->not_empty, &q->lock);
+    if (q->count) {
+        c = q->items[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->count--;
+        tts_cond_signal(&q->not_full);
+    }
+    tts_mutex_unlock(&q->lock);
+    return c;
+}
+
+static void queue_close(queue * q) {
+    tts_mutex_lock(&q->lock);
+    q->closed = 1;
+    tts_cond_broadcast(&q->not_empty);
+    tts_mutex_unlock(&q->lock);
+}
+
+/* Splits a RAVDESS file name into its fields.  Returns 0 if it is one
+   of a spoken or sung clip. */
+static int parse_name(const char * name, int * fields) {
+    const char * p = name;
+    char * end;
+    int k;
+    for (k = 0; k < FIELD_COUNT; k++) {
+        fields[k] = (int) strtol(p, &end, 10);
+        if (end == p || (k < FIELD_COUNT - 1 && *end != '-')) return -1;
+        p = end + 1;
+    }
+    if (*end != '\0') return -1;
+    if (fields[FIELD_CHANNEL] < 1 || fields[FIELD_CHANNEL] > CHANNELS) return -1;
+    if (fields[FIELD_EMOTION] < 1 || fields[FIELD_EMOTION] > EMOTIONS) return -1;
+    if (fields[FIELD_INTENSITY] < 1 || fields[FIELD_INTENSITY] > INTENSITIES) return -1;
+    if (fields[FIELD_STATEMENT] < 1 || fields[FIELD_STATEMENT] > STATEMENTS) return -1;
+    return 0;
+}
+
+static int group_of(const int * fields) {
+    return ((fields[FIELD_CHANNEL] - 1) * EMOTIONS + fields[FIELD_EMOTION] - 1) * INTENSITIES +
+           fields[FIELD_INTENSITY] - 1;
+}
+
+/* File name without directory and extension, 0 if it is not a .wav */
+static int clip_name(const char * path, char * name, size_t size) {
+    const char * base = path, * p, * dot;
+    for (p = path; *p; p++)
+        if (*p == '/' || *p == '\\') base = p + 1;
+    dot = strrchr(base, '.');
+    if (!dot || (strcmp(dot, ".wav") != 0 && strcmp(dot, ".WAV") != 0)) return 0;
+    if ((size_t) (dot - base) >= size) return 0;
+    memcpy(name, base, dot - base);
+    name[dot - base] = '\0';
+    return 1;
+}
+
+static void add_path(pipeline * p, const char * path, int * cap) {
+    if (p->npaths == *cap) {
+        *cap = *cap ? *cap * 2 : 256;
+        p->paths = realloc(p->paths, *cap * sizeof(char *));
+    }
+    p->paths[p->npaths] = malloc(strlen(path) + 1);
+    strcpy(p->paths[p->npaths++], path);
+}
+
+static int is_directory(const char * path) {
+    struct stat st;
+    return stat(path, &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+/* Collects the .wav files under dir */
+static void scan(pipeline * p, const char * dir, int * cap) {
+    char * path;
+    const char * entry;
+#ifndef WIN32
+    DIR * d = opendir(dir);
+    struct dirent * de;
+    if (!d) return;
+    while ((de = readdir(d)) != NULL) {
+        entry = de->d_name;
+#else
+    WIN32_FIND_DATAA fd;
+    HANDLE find;
+    path = malloc(strlen(dir) + 3);
+    sprintf(path, "%s/*", dir);
+    find = FindFirstFileA(path, &fd);
+    free(path);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do {
+        entry = fd.cFileName;
+#endif
+        if (entry[0] != '.') {
+            char name[64];
+            path = malloc(strlen(dir) + strlen(entry) + 2);
+            sprintf(path, "%s/%s", dir, entry);
+            if (is_directory(path)) scan(p, path, cap);
+            else if (clip_name(path, name, sizeof(name))) add_path(p, path, cap);
+            free(path);
+        }
+#ifndef WIN32
+    }
+    closedir(d);
+#else
+    } while (FindNextFileA(find, &fd));
+    FindClose(find);
+#endif
+}
+
+static int compare_path(const void * a, const void * b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+static tts_thread_ret TTS_THREAD_CALL reader_main(void * userdata) {
+    pipeline * p = userdata;
+    clip * c;
+    int i, index = 0;
+
+    for (i = 0; i < p->npaths; i++) {
+        c = calloc(1, sizeof(clip));
+        c->path = p->paths[i];
+        clip_name(c->path, c->name, sizeof(c->name));
+        if (parse_name(c->name, c->fields) != 0) {
+            fprintf(stderr, "WARNING: '%s' is not named as a RAVDESS clip, skipped\n", c->path);
+            free(c);
+            continue;
+        }
+        if (ls_audio_load_wav(&c->audio, c->path) != 0) {
+            fprintf(stderr, "WARNING: unable to read '%s', skipped\n", c->path);
+            tts_mutex_lock(&p->lock);
+            p->unreadable++;
+            tts_mutex_unlock(&p->lock);
+            free(c);
+            continue;
+        }
+        c->index = index++;
+        c->duration = c->audio.count / (float) c->audio.sample_rate;
+        queue_push(&p->decoded, c);
+    }
+    queue_close(&p->decoded);
+    return 0;
+}
+
+static void analyse(pipeline * p, clip * c) {
+    const reference * r = &p->refs[c->fields[FIELD_STATEMENT] - 1];
+    ls_features rec;
+    ls_warp w;
+    ls_segment * segs;
+    int i, n;
+
+    ls_contour_extract(&c->contour, &c->audio, 0);
+    ls_mfcc_extract(&rec, &c->audio, NULL);
+    ls_audio_free(&c->audio);
+
+    if (ls_dtw(&w, &r->features, &rec, &p->cfg) != 0) {
+        ls_features_free(&rec);
+        c->failed = 1;
+        return;
+    }
+    c->cost = w.cost;
+    n = ls_alignment_project(&c->alignment, &w, &r->timeline, c->duration);
+    ls_warp_free(&w);
+    ls_features_free(&rec);
+
+    segs = malloc((n ? n : 1) * sizeof(ls_segment));
+    for (i = 0; i < n; i++) {
+        segs[i].phoneme = ls_phoneme_map(c->alignment.phones[i].text);
+        segs[i].start = c->alignment.phones[i].start;
+        segs[i].end = c->alignment.phones[i].end;
+        segs[i].mean_pitch = segs[i].mean_intensity = 0;
+    }
+    ls_prosody_init(&c->prosody, p->window, p->gender >= 0 ? p->gender : c->fields[FIELD_ACTOR] % 2);
+    ls_prosody_analyse(&c->prosody, &c->contour, segs, n);
+    free(segs);
+}
+
+static tts_thread_ret TTS_THREAD_CALL worker_main(void * userdata) {
+    pipeline * p = userdata;
+    clip * c;
+    int last;
+
+    while ((c = queue_pop(&p->decoded)) != NULL) {
+        analyse(p, c);
+        queue_push(&p->analysed, c);
+    }
+    tts_mutex_lock(&p->lock);
+    last = --p->workers == 0;
+    tts_mutex_unlock(&p->lock);
+    if (last) queue_close(&p->analysed);
+    return 0;
+}
+
+static int load_reference(reference * r, const char * prefix, int statement) {
+    char * path = malloc(strlen(prefix) + 5);
+
+    sprintf(path, "%s.wav", prefix);
+    if (ls_audio_load_wav(&r->audio, path) != 0) {
+        fprintf(stderr, "ERROR: unable to read reference audio '%s' of statement %d\n", path, statement);
+        free(path);
+        return -1;
+    }
+    sprintf(path, "%s.tl", prefix);
+    if (tts_timeline_map(&r->timeline, path) != 0) {
+        fprintf(stderr, "ERROR: unable to read timeline '%s' of statement %d\n", path, statement);
+        free(path);
+        return -1;
+    }
+    free(path);
+    if ((int) r->timeline.header->sample_rate != r->audio.sample_rate)
+        fprintf(stderr, "WARNING: timeline of statement %d is at %u Hz, its audio at %d Hz\n",
+                statement, r->timeline.header->sample_rate, r->audio.sample_rate);
+    if (ls_mfcc_extract(&r->features, &r->audio, NULL) < 1) {
+        fprintf(stderr, "ERROR: reference audio of statement %d is empty\n", statement);
+        return -1;
+    }
+    return 0;
+}
+
+static char * output_path(const char * dir, const char * prefix, const char * name, const char * ext) {
+    char * path = malloc(strlen(dir) + strlen(prefix) + strlen(name) + strlen(ext) + 2);
+    sprintf(path, "%s/%s%s%s", dir, prefix, name, ext);
+    return path;
+}
+
+/* openSMILE prosodyAcf layout, as read by ls_contour_load_csv */
+static int write_contour(const ls_contour * c, const char * path) {
+    FILE * fp = fopen(path, "w");
+    int i;
+    if (!fp) return -1;
+    fprintf(fp, "name;frameTime;voicingFinalUnclipped_sma;F0final_sma;pcm_loudness_sma\n");
+    for (i = 0; i < c->count; i++)
+        fprintf(fp, "'unknown';%.2f;0;%f;%f\n", c->time[i], c->f0[i], c->loudness[i]);
+    return fclose(fp);
+}
+
+static int write_text(const char * text, const char * path) {
+    FILE * fp = fopen(path, "w");
+    if (!fp) return -1;
+    fputs(text, fp);
+    return fclose(fp);
+}
+
+/* Writes the files of an analysed clip and keeps its statistics.
+   Returns 0 on success. */
+static int store(clip * c, clip_summary * s, const char * dir) {
+    const ls_prosody * pr = &c->prosody;
+    char * path;
+    int failed = 0, k;
+
+    path = output_path(dir, "", c->name, ".TextGrid");
+    if (ls_alignment_write_textgrid(&c->alignment, path) != 0) failed = 1;
+    free(path);
+    path = output_path(dir, "prosody_", c->name, ".csv");
+    if (!failed && write_contour(&c->contour, path) != 0) {
+        fprintf(stderr, "ERROR: unable to write '%s'\n", path);
+        failed = 1;
+    }
+    free(path);
+    path = output_path(dir, "", c->name, ".txt");
+    if (!failed && write_text(statement_texts[c->fields[FIELD_STATEMENT] - 1], path) != 0) {
+        fprintf(stderr, "ERROR: unable to write '%s'\n", path);
+        failed = 1;
+    }
+    free(path);
+    if (failed) return -1;
+
+    s->done = 1;
+    memcpy(s->fields, c->fields, sizeof(s->fields));
+    strcpy(s->name, c->name);
+    s->duration = c->duration;
+    s->phones = c->alignment.nphones;
+    s->cost = c->cost;
+    s->ranges[LS_SERIES_VOWEL_PITCH] = pr->vowel_pitch;
+    s->ranges[LS_SERIES_CONSONANT_PITCH] = pr->consonant_pitch;
+    s->ranges[LS_SERIES_VOWEL_INTENSITY] = pr->vowel_intensity;
+    s->ranges[LS_SERIES_CONSONANT_INTENSITY] = pr->consonant_intensity;
+    s->vowel_pitch_ratio = pr->vowel_pitch_ratio;
+    s->consonant_pitch_ratio = pr->consonant_pitch_ratio;
+    s->windows = pr->windows;
+    s->window[LS_SERIES_VOWEL_PITCH] = pr->vowel_pitch_window;
+    s->window[LS_SERIES_CONSONANT_PITCH] = pr->consonant_pitch_window;
+    s->window[LS_SERIES_VOWEL_INTENSITY] = pr->vowel_intensity_window;
+    s->window[LS_SERIES_CONSONANT_INTENSITY] = pr->consonant_intensity_window;
+    for (k = 0; k < LS_SERIES_COUNT; k++) {
+        /* empty series: no frame in range, mean of no segment */
+        if (s->ranges[k].min == FLT_MAX) s->ranges[k].min = s->ranges[k].max = 0;
+        if (!(s->ranges[k].mean > 0)) s->ranges[k].mean = 0;
+    }
+    return 0;
+}
+
+static void release(clip * c) {
+    ls_contour_free(&c->contour);
+    ls_alignment_free(&c->alignment);
+    /* the window arrays have moved to the clip summary */
+    free(c);
+}
+
+static int write_clips(const clip_summary * summaries, int n, const char * dir) {
+    char * path = output_path(dir, "", "clips", ".csv");
+    FILE * fp = fopen(path, "w");
+    const clip_summary * s;
+    int i, k;
+
+    if (!fp) {
+        fprintf(stderr, "ERROR: unable to write '%s'\n", path);
+        free(path);
+        return -1;
+    }
+    fprintf(fp, "file;channel;emotion;intensity;statement;repetition;actor;duration;phones;distance");
+    for (k = 0; k < LS_SERIES_COUNT; k++)
+        fprintf(fp, ";%s_min;%s_mean;%s_max", series_names[k], series_names[k], series_names[k]);
+    fprintf(fp, ";vowel_pitch_ratio;consonant_pitch_ratio\n");
+    for (i = 0; i < n; i++) {
+        s = &summaries[i];
+        if (!s->done) continue;
+        fprintf(fp, "%s;%s;%s;%s;%d;%d;%d;%.3f;%d;%.4f", s->name,
+                channel_names[s->fields[FIELD_CHANNEL] - 1], emotion_names[s->fields[FIELD_EMOTION] - 1],
+                intensity_names[s->fields[FIELD_INTENSITY] - 1], s->fields[FIELD_STATEMENT],
+                s->fields[FIELD_REPETITION], s->fields[FIELD_ACTOR], s->duration, s->phones, s->cost);
+        for (k = 0; k < LS_SERIES_COUNT; k++)
+            fprintf(fp, ";%f;%f;%f", s->ranges[k].min, s->ranges[k].mean, s->ranges[k].max);
+        fprintf(fp, ";%f;%f\n", s->vowel_pitch_ratio, s->consonant_pitch_ratio);
+    }
+    free(path);
+    return fclose(fp);
+}
+
+/* Statistics of one series over the clips of a group: extremes over
+   the clips, and the means of the non-zero clip means and window means,
+   as SpeechAnalysis.GetMeanValues */
+static int write_emotions(const clip_summary * summaries, int n, const char * dir) {
+    char * path = output_path(dir, "", "emotions", ".csv");
+    FILE * fp = fopen(path, "w");
+    const clip_summary * s;
+    double * sums;
+    int * counts;
+    int i, g, k, j, windows = 0, clips, means;
+    float min, max;
+    double mean;
+
+    if (!fp) {
+        fprintf(stderr, "ERROR: unable to write '%s'\n", path);
+        free(path);
+        return -1;
+    }
+    for (i = 0; i < n; i++)
+        if (summaries[i].done && summaries[i].windows > windows) windows = summaries[i].windows;
+    sums = malloc((windows ? windows : 1) * sizeof(double));
+    counts = malloc((windows ? windows : 1) * sizeof(int));
+
+    fprintf(fp, "channel;emotion;intensity;series;clips;min;mean;max");
+    for (j = 0; j < windows; j++) fprintf(fp, ";window_%d", j + 1);
+    fprintf(fp, "\n");
+    for (g = 0; g < GROUPS; g++) {
+        for (k = 0; k < LS_SERIES_COUNT; k++) {
+            clips = means = 0;
+            min = FLT_MAX;
+            max = 0;
+            mean = 0;
+            memset(sums, 0, (windows ? windows : 1) * sizeof(double));
+            memset(counts, 0, (windows ? windows : 1) * sizeof(int));
+            for (i = 0; i < n; i++) {
+                s = &summaries[i];
+                if (!s->done || group_of(s->fields) != g) continue;
+                clips++;
+                if (s->ranges[k].max > 0) {
+                    if (s->ranges[k].min < min) min = s->ranges[k].min;
+                    if (s->ranges[k].max > max) max = s->ranges[k].max;
+                }
+                if (s->ranges[k].mean > 0) {
+                    mean += s->ranges[k].mean;
+                    means++;
+                }
+                for (j = 0; j < s->windows; j++) {
+                    if (s->window[k][j] > 0) {
+                        sums[j] += s->window[k][j];
+                        counts[j]++;
+                    }
+                }
+            }
+            if (clips == 0) break;
+            if (min == FLT_MAX) min = 0;
+            fprintf(fp, "%s;%s;%s;%s;%d;%f;%f;%f", channel_names[g / (EMOTIONS * INTENSITIES)],
+                    emotion_names[g / INTENSITIES % EMOTIONS], intensity_names[g % INTENSITIES],
+                    series_names[k], clips, min, means ? mean / means : 0, max);
+            for (j = 0; j < windows; j++) fprintf(fp, ";%f", counts[j] ? sums[j] / counts[j] : 0);
+            fprintf(fp, "\n");
+        }
+    }
+    free(sums);
+    free(counts);
+    free(path);
+    return fclose(fp);
+}
+
+int main(int argc, char * argv[]) {
+    const char * args[4];
+    int nargs = 0, threads = 0, depth = 0, i, k, cap = 0, stored = 0, failed = 0, started;
+    pipeline p;
+    tts_thread reader, * workers;
+    clip_summary * summaries;
+    clip * c;
+    double start, elapsed;
+
+    memset(&p, 0, sizeof(p));
+    ls_align_config_default(&p.cfg);
+    p.window = 1000;
+    p.gender = -1;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) {
+            usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-j") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            threads = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "-q") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            depth = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "-w") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            p.window = (float) atof(argv[i]);
+        }
+        else if (strcmp(argv[i], "-g") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            if (strcmp(argv[i], "male") == 0) p.gender = 1;
+            else if (strcmp(argv[i], "female") == 0) p.gender = 0;
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-b") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            p.cfg.band = (float) atof(argv[i]);
+        }
+        else if (nargs < 4) {
+            args[nargs++] = argv[i];
+        }
+        else {
+            usage(argv[0]);
+        }
+    }
+    if (nargs != 4 || p.window <= 0) usage(argv[0]);
+    if (threads <= 0) threads = tts_cpu_count();
+    if (depth <= 0) depth = 2 * threads;
+
+    for (k = 0; k < STATEMENTS; k++)
+        if (load_reference(&p.refs[k], args[1 + k], k + 1) != 0) return 1;
+    if (!is_directory(args[0])) {
+        fprintf(stderr, "ERROR: '%s' is not a directory\n", args[0]);
+        return 1;
+    }
+#ifndef WIN32
+    mkdir(args[3], 0777);
+#else
+    _mkdir(args[3]);
+#endif
+    if (!is_directory(args[3])) {
+        fprintf(stderr, "ERROR: unable to create output directory '%s'\n", args[3]);
+        return 1;
+    }
+
+    scan(&p, args[0], &cap);
+    if (p.npaths == 0) {
+        fprintf(stderr, "ERROR: no .wav file under '%s'\n", args[0]);
+        return 1;
+    }
+    qsort(p.paths, p.npaths, sizeof(char *), compare_path);
+    fprintf(stderr, "INFO: %d files, %d analysis threads, %d clips queued per stage\n", p.npaths, threads, depth);
+
+    start = tts_clock_seconds();
+    queue_init(&p.decoded, depth);
+    queue_init(&p.analysed, depth);
+    tts_mutex_init(&p.lock);
+    workers = malloc(threads * sizeof(tts_thread));
+    summaries = calloc(p.npaths, sizeof(clip_summary));
+    for (started = 0; started < threads; started++) {
+        if (!tts_thread_start(&workers[started], worker_main, &p)) break;
+        p.workers++;
+    }
+    if (started == 0 || !tts_thread_start(&reader, reader_main, &p)) {
+        fprintf(stderr, "ERROR: unable to start the pipeline threads\n");
+        return 1;
+    }
+
+    while ((c = queue_pop(&p.analysed)) != NULL) {
+        if (c->failed) {
+            fprintf(stderr, "WARNING: '%s' has no audio to align, skipped\n", c->path);
+            failed++;
+        }
+        else if (store(c, &summaries[c->index], args[3]) != 0) {
+            failed++;
+        }
+        else if (++stored % 100 == 0) {
+            fprintf(stderr, "INFO: %d clips\n", stored);
+        }
+        if (!summaries[c->index].done) ls_prosody_free(&c->prosody);
+        release(c);
+    }
+    tts_thread_join(reader);
+    for (i = 0; i < started; i++) tts_thread_join(workers[i]);
+    elapsed = tts_clock_seconds() - start;
+
+    if (write_clips(summaries, p.npaths, args[3]) != 0 || write_emotions(summaries, p.npaths, args[3]) != 0)
+        return 1;
+    fprintf(stderr, "INFO: %d clips in %.2f s (%.1f clips/s), %d not analysed\n", stored, elapsed,
+            elapsed > 0 ? stored / elapsed : 0, failed + p.unreadable);
+
+    for (i = 0; i < p.npaths; i++) {
+        for (k = 0; k < LS_SERIES_COUNT; k++) free(summaries[i].window[k]);
+        free(p.paths[i]);
+    }
+    free(summaries);
+    free(p.paths);
+    free(workers);
+    queue_destroy(&p.decoded);
+    queue_destroy(&p.analysed);
+    tts_mutex_destroy(&p.lock);
+    for (k = 0; k < STATEMENTS; k++) {
+        ls_features_free(&p.refs[k].features);
+        ls_audio_free(&p.refs[k].audio);
+        tts_timeline_unmap(&p.refs[k].timeline);
+    }
+    return 0;
+}
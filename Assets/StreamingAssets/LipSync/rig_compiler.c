@@ -0,0 +1,143 @@
+/* rig_compiler - compiles the XML rig mappings of a character into a
+   binary rig table (lipsync_rigtab.h) that RigTable.cs maps at startup.
+
+   With -c, the mappings of each character named on the command line
+   are read from xml_dir/<Character>-phonemeMapping.Xml,
+   -diphoneMapping.Xml and -emotionMapping.Xml and the table is written
+   to xml_dir/<Character>.rig, next to them.  A character without one of
+   the mappings gets a table without that part, so the shared
+   diphoneMapping.Xml compiles to diphoneMapping.rig the same way.
+
+   Build:
+     gcc -O2 -o rig_compiler rig_compiler.c lipsync_rigtab.c lipsync_rig.c lipsync_phoneme.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lipsync_rig.h"
+#include "lipsync_rigtab.h"
+
+#define PATH_SIZE 1024
+
+void usage(char * name) {
+    fprintf(stderr, "rig_compiler - compiles character rig mappings into a binary rig table.\n\n");
+    fprintf(stderr, "Usage: %s [-h] [-p phoneme_mapping] [-d diphone_mapping] [-e emotion_mapping] output_rig\n", name);
+    fprintf(stderr, "       %s [-h] -c xml_dir character [character ...]\n", name);
+    fprintf(stderr, " -p file\t  <Character>-phonemeMapping.Xml\n");
+    fprintf(stderr, " -d file\t  <Character>-diphoneMapping.Xml or diphoneMapping.Xml\n");
+    fprintf(stderr, " -e file\t  <Character>-emotionMapping.Xml\n");
+    fprintf(stderr, " -c xml_dir\t  Compile xml_dir/<character>.rig from the mappings in xml_dir\n");
+    exit(0);
+}
+
+/* Finds <dir>/<character><suffix> with the .Xml extension of the
+   shipped mappings or .xml.  Returns 0 if neither exists. */
+static int find_mapping(char * path, const char * dir, const char * character, const char * suffix) {
+    FILE * fp;
+    snprintf(path, PATH_SIZE, "%s/%s%s.Xml", dir, character, suffix);
+    if ((fp = fopen(path, "rb"))) {
+        fclose(fp);
+        return 1;
+    }
+    snprintf(path, PATH_SIZE, "%s/%s%s.xml", dir, character, suffix);
+    if ((fp = fopen(path, "rb"))) {
+        fclose(fp);
+        return 1;
+    }
+    return 0;
+}
+
+static int count_mapped(const ls_rig * rig, int diphones) {
+    int i, n = 0;
+    for (i = 0; i < LS_PHONEME_COUNT; i++) n += diphones ? rig->has_diphone[i] : rig->visemes[i].mapped;
+    return n;
+}
+
+static int compile(const char * phoneme_file, const char * diphone_file, const char * emotion_file,
+                   const char * output_file) {
+    ls_rig rig;
+    uint32_t sources = LS_RIGTAB_HASH_SEED;
+    int res = 0;
+
+    ls_rig_init(&rig);
+    if (phoneme_file && ls_rig_load_visemes(&rig, phoneme_file) < 0) res = -1;
+    if (diphone_file && ls_rig_load_diphones(&rig, diphone_file) < 0) res = -1;
+    if (emotion_file && ls_rig_load_emotions(&rig, emotion_file) < 0) res = -1;
+    /* In the order RigTable.cs hashes them */
+    if (phoneme_file && ls_rigtab_hash_file(&sources, phoneme_file) < 0) res = -1;
+    if (diphone_file && ls_rigtab_hash_file(&sources, diphone_file) < 0) res = -1;
+    if (emotion_file && ls_rigtab_hash_file(&sources, emotion_file) < 0) res = -1;
+    if (res == 0) res = ls_rigtab_write(&rig, sources, output_file);
+    if (res == 0) {
+        fprintf(stderr, "INFO: %s: %d visemes, %d diphones, %d emotions\n", output_file,
+                count_mapped(&rig, 0), count_mapped(&rig, 1), rig.n_emotions);
+    }
+    ls_rig_free(&rig);
+    return res;
+}
+
+int main(int argc, char ** argv) {
+    char * phoneme_file = NULL, * diphone_file = NULL, * emotion_file = NULL, * output_file = NULL;
+    char * xml_dir = NULL;
+    char phoneme_path[PATH_SIZE], diphone_path[PATH_SIZE], emotion_path[PATH_SIZE], output_path[PATH_SIZE];
+    int i, arg = 0, first = 0, failed = 0;
+    int has_phonemes, has_diphones, has_emotions;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) usage(argv[0]);
+        else if (strcmp(argv[i], "-p") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            phoneme_file = argv[i];
+        }
+        else if (strcmp(argv[i], "-d") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            diphone_file = argv[i];
+        }
+        else if (strcmp(argv[i], "-e") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            emotion_file = argv[i];
+        }
+        else if (strcmp(argv[i], "-c") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            xml_dir = argv[i];
+        }
+        /* Arguments */
+        else {
+            if (arg++ == 0) first = i;
+            if (!xml_dir && arg > 1) {
+                fprintf(stderr, "ERROR: unable to process argument '%s'\n", argv[i]);
+                usage(argv[0]);
+            }
+        }
+    }
+    if (arg == 0) usage(argv[0]);
+
+    if (!xml_dir) {
+        output_file = argv[first];
+        if (!phoneme_file && !diphone_file && !emotion_file) usage(argv[0]);
+        return compile(phoneme_file, diphone_file, emotion_file, output_file) < 0 ? 1 : 0;
+    }
+
+    for (i = first; i < argc; i++) {
+        /* Skip the options between the characters */
+        if (argv[i][0] == '-') {
+            i++;
+            continue;
+        }
+        has_phonemes = find_mapping(phoneme_path, xml_dir, argv[i], "-phonemeMapping");
+        has_emotions = find_mapping(emotion_path, xml_dir, argv[i], "-emotionMapping");
+        /* The shared diphone mapping has no character prefix */
+        has_diphones = find_mapping(diphone_path, xml_dir, argv[i], "-diphoneMapping") ||
+            find_mapping(diphone_path, xml_dir, argv[i], "");
+        if (!has_phonemes && !has_diphones && !has_emotions) {
+            fprintf(stderr, "ERROR: no mapping for character '%s' in '%s'\n", argv[i], xml_dir);
+            failed++;
+            continue;
+        }
+        snprintf(output_path, sizeof(output_path), "%s/%s.rig", xml_dir, argv[i]);
+        if (compile(has_phonemes ? phoneme_path : NULL, has_diphones ? diphone_path : NULL,
+                    has_emotions ? emotion_path : NULL, output_path) < 0) failed++;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,405 @@
+/* viseme_baker - bakes the lip sync animation of an utterance into
+   per-blendshape keyframe tracks.
+
+   The baker runs the same model MyLipSync evaluates every FixedUpdate
+   (phoneme activation, ease-in rise to 75% of the phoneme, ease-out
+   decay, optional pitch/intensity weighting) at the fixed timestep, for
+   every blendshape of the character's phoneme mapping, then reduces each
+   dense curve to keyframes within an error tolerance.  At runtime the
+   character only samples the tracks (see VisemeTrack.cs).  With -d the
+   dominance-function coarticulation model of lipsync_coartic.h is baked
+   instead of the rise/decay model.
+
+   MyLipSync plays <Character>-<clip>.track from the data folder
+   (<Character>-visemes.track for the synthesized clip), and only if
+   the length of the audio recorded in the track matches the clip.
+
+   Build:
+     gcc -O2 -DTTS_TIMELINE_NO_ENGINE -I../CereVoice -o viseme_baker \
+         viseme_baker.c viseme_track.c lipsync_prosody.c lipsync_aggregate.c \
+         lipsync_pitch.c lipsync_audio.c lipsync_rig.c lipsync_phoneme.c \
+         lipsync_coartic.c ../CereVoice/tts_timeline.c -lm
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "tts_timeline.h"
+#include "lipsync_phoneme.h"
+#include "lipsync_prosody.h"
+#include "lipsync_pitch.h"
+#include "lipsync_rig.h"
+#include "lipsync_coartic.h"
+#include "lipsync_simd.h"
+#include "viseme_track.h"
+
+/* CoarticulationEnhancement.RemoveDuplicates */
+#define DUPLICATE_GAP 1.0f
+
+typedef enum curve_mode {
+    CURVE_EXPONENTIAL,
+    CURVE_QUADRATIC
+} curve_mode;
+
+typedef struct bake_options {
+    curve_mode curve;
+    int dominance;         /* dominance functions instead of rise/decay */
+    float interval;        /* Time.fixedDeltaTime */
+    float tolerance;       /* blendshape weight units, 0-100 */
+    const ls_prosody * prosody;
+} bake_options;
+
+/* Playback state of an active phoneme, as the apex/animationEnded flags
+   of PhonemeInformation */
+typedef struct active_phoneme {
+    int segment;
+    int apex;
+    int ended;
+} active_phoneme;
+
+void usage(char * name) {
+    fprintf(stderr, "viseme_baker - bakes lip sync animation tracks from a phoneme timeline.\n\n");
+    fprintf(stderr, "Usage: %s [-h] [-c exp|quad] [-d] [-r rate] [-e tolerance]\n", name);
+    fprintf(stderr, "       [-p prosody_csv | -a audio_wav [-g male|female] [-w window_ms]]\n");
+    fprintf(stderr, "       timeline phoneme_mapping diphone_mapping output_track\n");
+    fprintf(stderr, " -c curve\t  Rise/decay easing, exponential (default) or quadratic\n");
+    fprintf(stderr, " -d\t\t  Dominance-function coarticulation instead of rise/decay\n");
+    fprintf(stderr, " -r rate\t  Animation rate in Hz, default 50 (fixed timestep 0.02)\n");
+    fprintf(stderr, " -e tolerance\t  Maximum weight error of the keyframe reduction, default 0.5\n");
+    fprintf(stderr, " -p prosody_csv\t  Weight visemes by pitch and intensity (openSMILE prosodyAcf CSV)\n");
+    fprintf(stderr, " -a audio_wav\t  Weight visemes by pitch and intensity extracted from the audio\n");
+    fprintf(stderr, " -g gender\t  Speaker frequency range, default male\n");
+    fprintf(stderr, " -w window_ms\t  Pitch/intensity sliding window, default 1000\n");
+    exit(0);
+}
+
+static float ease_in(curve_mode curve, float t) {
+    if (curve == CURVE_QUADRATIC) return t * t;
+    return ((float) exp(t) - 1.0f) / ((float) exp(1) - 1.0f);
+}
+
+static float ease_out(curve_mode curve, float t) {
+    if (curve == CURVE_QUADRATIC) return (1 - t) * (2 - (1 - t));
+    return ((float) exp(1 - t) - 1.0f) / ((float) exp(1) - 1.0f);
+}
+
+/* Timings are compared at millisecond resolution, as the runtime does */
+static float truncate_ms(float t) {
+    return (float) trunc(t * 1000) / 1000.0f;
+}
+
+/* Phones of the timeline mapped to lip sync phonemes, with diphones
+   split (CoarticulationEnhancement.AddDiphoneVisemes) and consecutive
+   duplicates merged (RemoveDuplicates). */
+static ls_segment * load_segments(const tts_timeline * tl, const ls_rig * rig, int * count) {
+    ls_segment * segs = malloc((2 * tl->header->n_records + 1) * sizeof(ls_segment));
+    ls_segment seg, * last;
+    uint32_t i;
+    int n = 0, k, parts;
+    float mid;
+
+    for (i = 0; i < tl->header->n_records; i++) {
+        const tts_timeline_record * r = &tl->records[i];
+        if (r->type != TTS_TIMELINE_PHONE) continue;
+        memset(&seg, 0, sizeof(seg));
+        seg.phoneme = ls_phoneme_map(tts_timeline_symbol(tl, r->symbol));
+        seg.start = (float) tts_timeline_seconds(tl, r->start);
+        seg.end = (float) tts_timeline_seconds(tl, r->end);
+
+        parts = 1;
+        if (ls_phoneme_is(seg.phoneme, LS_CLASS_DIPHONE)) {
+            if (!rig->has_diphone[seg.phoneme]) {
+                fprintf(stderr, "WARNING: no mapping for %s, left at rest\n", ls_phoneme_name(seg.phoneme));
+                seg.phoneme = LS_REST;
+            }
+            else {
+                parts = 2;
+            }
+        }
+        for (k = 0; k < parts; k++) {
+            ls_segment part = seg;
+            if (parts == 2) {
+                /* both halves get half of the diphone */
+                mid = seg.start + (seg.end - seg.start) * 0.5f;
+                part.phoneme = rig->diphones[seg.phoneme][k];
+                if (k == 0) part.end = mid;
+                else part.start = mid;
+            }
+            last = n ? &segs[n - 1] : NULL;
+            if (last && last->phoneme == part.phoneme && part.start - last->end <= DUPLICATE_GAP) {
+                last->end = part.end;
+            }
+            else {
+                segs[n++] = part;
+            }
+        }
+    }
+    *count = n;
+    return segs;
+}
+
+/* Evaluates the animation at every fixed step and stores the weight of
+   each blendshape, as MyLipSync.FixedUpdate. */
+static void bake(const ls_segment * segs, int nsegs, const ls_rig * rig, const bake_options * opt,
+                 const int * slot_of, int nslots, int nsteps, float * dense) {
+    active_phoneme * active = calloc(nsegs + 1, sizeof(active_phoneme));
+    float * shape_weight[LS_PHONEME_COUNT]; /* BlendShape.currentWeight */
+    float * current = calloc(nslots, sizeof(float));
+    float t = 0, next_start, start, end, apex_time, duration, step, target, blend;
+    int nactive = 0, index = 0, step_i, a, b, p;
+
+    for (p = 0; p < LS_PHONEME_COUNT; p++) {
+        shape_weight[p] = calloc(rig->visemes[p].count + 1, sizeof(float));
+    }
+
+    /* sample 0 is the model at rest, before the first FixedUpdate */
+    memcpy(dense, current, nslots * sizeof(float));
+    for (step_i = 1; step_i < nsteps; step_i++) {
+        t += opt->interval;
+
+        /* AnimatePhoneme: at most one new phoneme per step, the first
+           one and rests are never animated */
+        next_start = index < nsegs - 1 ? segs[index + 1].start : 0;
+        if (t > next_start) {
+            index++;
+            if (index < nsegs && segs[index].phoneme != LS_REST && rig->visemes[segs[index].phoneme].mapped) {
+                active[nactive].segment = index;
+                active[nactive].apex = 0;
+                active[nactive].ended = 0;
+                nactive++;
+            }
+        }
+
+        for (a = 0; a < nactive; a++) {
+            const ls_segment * seg = &segs[active[a].segment];
+            const ls_viseme * v = &rig->visemes[seg->phoneme];
+            start = seg->start;
+            end = seg->end;
+            apex_time = start + (end - start) * 0.75f;
+
+            if (!active[a].apex) {
+                /* PhonemeRise */
+                duration = truncate_ms(apex_time - start);
+                step = ease_in(opt->curve, truncate_ms(t - start) / duration);
+                for (b = 0; b < v->count; b++) {
+                    target = v->shapes[b].weight;
+                    if (opt->prosody) target = ls_prosody_target(opt->prosody, seg, target);
+                    blend = (step < 1) ? target * step : target;
+                    current[slot_of[v->shapes[b].index]] = blend;
+                    shape_weight[seg->phoneme][b] = blend;
+                }
+                if (t >= apex_time) active[a].apex = 1;
+            }
+            else {
+                /* PhonemeDecay */
+                duration = truncate_ms(end - apex_time);
+                step = ease_out(opt->curve, truncate_ms(t - apex_time) / duration);
+                for (b = 0; b < v->count; b++) {
+                    blend = (step > 0) ? shape_weight[seg->phoneme][b] * step : 0;
+                    current[slot_of[v->shapes[b].index]] = blend;
+                }
+                if (t >= end) active[a].ended = 1;
+            }
+        }
+
+        /* RefreshCurrentPhonemes */
+        for (a = 0, b = 0; a < nactive; a++) {
+            if (!active[a].ended) active[b++] = active[a];
+        }
+        nactive = b;
+
+        memcpy(dense + (size_t) step_i * nslots, current, nslots * sizeof(float));
+    }
+
+    for (p = 0; p < LS_PHONEME_COUNT; p++) free(shape_weight[p]);
+    free(current);
+    free(active);
+}
+
+/* Evaluates the dominance model at every fixed step */
+static void bake_dominance(const ls_segment * segs, int nsegs, const ls_rig * rig, const bake_options * opt,
+                           const int * slot_of, int nslots, int nsteps, float * dense) {
+    unsigned char * phoneme = malloc(nsegs + 1);
+    float * start = malloc((nsegs + 1) * sizeof(float));
+    float * end = malloc((nsegs + 1) * sizeof(float));
+    float dominance[LS_COARTIC_MAX_PHONES], scale, target, t, * current;
+    int index[LS_COARTIC_MAX_PHONES], first = 0, step_i, n, j, b;
+
+    for (j = 0; j < nsegs; j++) {
+        phoneme[j] = (unsigned char) segs[j].phoneme;
+        start[j] = segs[j].start;
+        end[j] = segs[j].end;
+    }
+
+    for (step_i = 0; step_i < nsteps; step_i++) {
+        t = step_i * opt->interval;
+        current = dense + (size_t) step_i * nslots;
+        memset(current, 0, nslots * sizeof(float));
+        n = ls_coartic_window(phoneme, start, end, nsegs, t, &first, index, dominance);
+        scale = 1.0f / (LS_COARTIC_NEUTRAL + ls_sum(dominance, n));
+        for (j = 0; j < n; j++) {
+            const ls_segment * seg = &segs[index[j]];
+            const ls_viseme * v = &rig->visemes[seg->phoneme];
+            if (!v->mapped) continue;
+            for (b = 0; b < v->count; b++) {
+                target = v->shapes[b].weight;
+                if (opt->prosody) target = ls_prosody_target(opt->prosody, seg, target);
+                current[slot_of[v->shapes[b].index]] += dominance[j] * scale * target;
+            }
+        }
+    }
+
+    free(phoneme);
+    free(start);
+    free(end);
+}
+
+int main(int argc, char ** argv) {
+    char * timeline_file = NULL, * phoneme_file = NULL, * diphone_file = NULL, * track_file = NULL;
+    char * prosody_file = NULL, * audio_file = NULL;
+    bake_options opt;
+    tts_timeline tl;
+    ls_rig rig;
+    ls_segment * segs;
+    ls_audio audio;
+    ls_contour contour;
+    ls_prosody prosody;
+    viseme_track_set set;
+    viseme_key * keys;
+    int slot_of[1024], shape_of[1024];
+    float * dense, * curve, duration, audio_duration, window = 1000, rate = 50;
+    int i, s, p, arg = 0, male = 1, nsegs, nslots = 0, nsteps, nkeys, total_keys = 0;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.curve = CURVE_EXPONENTIAL;
+    opt.tolerance = 0.5f;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) usage(argv[0]);
+        else if (strcmp(argv[i], "-c") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            if (strncmp(argv[i], "quad", 4) == 0) opt.curve = CURVE_QUADRATIC;
+            else if (strncmp(argv[i], "exp", 3) == 0) opt.curve = CURVE_EXPONENTIAL;
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-d") == 0) {
+            opt.dominance = 1;
+        }
+        else if (strcmp(argv[i], "-r") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            rate = (float) atof(argv[i]);
+        }
+        else if (strcmp(argv[i], "-e") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            opt.tolerance = (float) atof(argv[i]);
+        }
+        else if (strcmp(argv[i], "-p") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            prosody_file = argv[i];
+        }
+        else if (strcmp(argv[i], "-a") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            audio_file = argv[i];
+        }
+        else if (strcmp(argv[i], "-g") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            male = strcmp(argv[i], "female") != 0;
+        }
+        else if (strcmp(argv[i], "-w") == 0) {
+            if (++i >= argc) usage(argv[0]);
+            window = (float) atof(argv[i]);
+        }
+        /* Arguments */
+        else {
+            arg++;
+            if (arg == 1) timeline_file = argv[i];
+            else if (arg == 2) phoneme_file = argv[i];
+            else if (arg == 3) diphone_file = argv[i];
+            else if (arg == 4) track_file = argv[i];
+            else {
+                fprintf(stderr, "ERROR: unable to process argument '%s'\n", argv[i]);
+                usage(argv[0]);
+            }
+        }
+    }
+    if (arg != 4 || rate <= 0 || window < 1) usage(argv[0]);
+    opt.interval = 1.0f / rate;
+
+    if (tts_timeline_map(&tl, timeline_file) != 0) {
+        fprintf(stderr, "ERROR: unable to read timeline '%s'\n", timeline_file);
+        exit(1);
+    }
+    ls_rig_init(&rig);
+    if (ls_rig_load_visemes(&rig, phoneme_file) != 0 || ls_rig_load_diphones(&rig, diphone_file) != 0) {
+        exit(1);
+    }
+    segs = load_segments(&tl, &rig, &nsegs);
+    /* the track is checked against the audio length, the bake covers
+       the last phoneme if it ends later */
+    audio_duration = (float) tts_timeline_seconds(&tl, tl.header->total_samples);
+    duration = audio_duration;
+    if (nsegs && segs[nsegs - 1].end > duration) duration = segs[nsegs - 1].end;
+    tts_timeline_unmap(&tl);
+
+    if (prosody_file || audio_file) {
+        if (prosody_file) {
+            if (ls_contour_load_csv(&contour, prosody_file) != 0) exit(1);
+        }
+        else {
+            if (ls_audio_load_wav(&audio, audio_file) != 0) exit(1);
+            ls_contour_extract(&contour, &audio, 0);
+            ls_audio_free(&audio);
+        }
+        ls_prosody_init(&prosody, window, male);
+        ls_prosody_analyse(&prosody, &contour, segs, nsegs);
+        ls_contour_free(&contour);
+        opt.prosody = &prosody;
+    }
+
+    /* One dense curve per blendshape used by any viseme */
+    for (i = 0; i < 1024; i++) slot_of[i] = -1;
+    for (p = 0; p < LS_PHONEME_COUNT; p++) {
+        for (s = 0; s < rig.visemes[p].count; s++) {
+            int index = rig.visemes[p].shapes[s].index;
+            if (index < 0 || index >= 1024) {
+                fprintf(stderr, "ERROR: blendshape index %d out of range\n", index);
+                exit(1);
+            }
+            if (slot_of[index] < 0) {
+                slot_of[index] = nslots;
+                shape_of[nslots++] = index;
+            }
+        }
+    }
+
+    nsteps = (int) ceil(duration / opt.interval) + 1;
+    dense = malloc((size_t) nsteps * (nslots ? nslots : 1) * sizeof(float));
+    if (opt.dominance) bake_dominance(segs, nsegs, &rig, &opt, slot_of, nslots, nsteps, dense);
+    else bake(segs, nsegs, &rig, &opt, slot_of, nslots, nsteps, dense);
+
+    curve = malloc(nsteps * sizeof(float));
+    keys = malloc(nsteps * sizeof(viseme_key));
+    viseme_track_set_init(&set, audio_duration, opt.interval, opt.tolerance);
+    for (s = 0; s < nslots; s++) {
+        for (i = 0; i < nsteps; i++) curve[i] = dense[(size_t) i * nslots + s];
+        nkeys = viseme_reduce(curve, nsteps, opt.interval, opt.tolerance, keys);
+        viseme_track_set_add(&set, shape_of[s], keys, nkeys);
+        total_keys += nkeys;
+    }
+    if (viseme_track_set_write(&set, track_file) != 0) {
+        fprintf(stderr, "ERROR: unable to write track file '%s'\n", track_file);
+        exit(1);
+    }
+    fprintf(stderr, "INFO: %d phonemes, %d blendshapes, %d samples reduced to %d keys\n",
+            nsegs, nslots, nsteps * nslots, total_keys);
+
+    viseme_track_set_free(&set);
+    free(keys);
+    free(curve);
+    free(dense);
+    free(segs);
+    if (opt.prosody) ls_prosody_free(&prosody);
+    ls_rig_free(&rig);
+    return 0;
+}
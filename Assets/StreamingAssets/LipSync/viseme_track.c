@@ -0,0 +1,112 @@
+/* Baked viseme animation tracks.
+   See viseme_track.h for the file layout. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "viseme_track.h"
+
+int viseme_reduce(const float * samples, int n, float interval, float tolerance, viseme_key * keys) {
+    unsigned char * keep;
+    int * stack;
+    int top = 0, a, b, i, worst, count = 0;
+    float err, max_err, t;
+
+    if (n <= 0) return 0;
+    if (n <= 2) {
+        for (i = 0; i < n; i++) {
+            keys[i].time = i * interval;
+            keys[i].weight = samples[i];
+        }
+        return n;
+    }
+
+    /* Douglas-Peucker on the weight error, with an explicit stack */
+    keep = calloc(n, 1);
+    stack = malloc(2 * n * sizeof(int));
+    keep[0] = keep[n - 1] = 1;
+    stack[top++] = 0;
+    stack[top++] = n - 1;
+    while (top > 0) {
+        b = stack[--top];
+        a = stack[--top];
+        max_err = tolerance;
+        worst = -1;
+        for (i = a + 1; i < b; i++) {
+            t = (float) (i - a) / (float) (b - a);
+            err = fabsf(samples[i] - (samples[a] + (samples[b] - samples[a]) * t));
+            if (err > max_err) {
+                max_err = err;
+                worst = i;
+            }
+        }
+        if (worst >= 0) {
+            keep[worst] = 1;
+            stack[top++] = a;
+            stack[top++] = worst;
+            stack[top++] = worst;
+            stack[top++] = b;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (!keep[i]) continue;
+        keys[count].time = i * interval;
+        keys[count].weight = samples[i];
+        count++;
+    }
+    free(stack);
+    free(keep);
+    return count;
+}
+
+void viseme_track_set_init(viseme_track_set * set, float duration, float interval, float tolerance) {
+    memset(set, 0, sizeof(viseme_track_set));
+    set->header.version = VISEME_TRACK_VERSION;
+    set->header.duration = duration;
+    set->header.interval = interval;
+    set->header.tolerance = tolerance;
+}
+
+void viseme_track_set_add(viseme_track_set * set, int blendshape, const viseme_key * keys, int n) {
+    viseme_track_entry * e;
+
+    if (set->header.n_tracks == set->tracks_cap) {
+        set->tracks_cap = set->tracks_cap ? set->tracks_cap * 2 : 16;
+        set->tracks = realloc(set->tracks, set->tracks_cap * sizeof(viseme_track_entry));
+    }
+    while (set->header.n_keys + n > set->keys_cap) {
+        set->keys_cap = set->keys_cap ? set->keys_cap * 2 : 1024;
+        set->keys = realloc(set->keys, set->keys_cap * sizeof(viseme_key));
+    }
+    e = &set->tracks[set->header.n_tracks++];
+    e->blendshape = (uint32_t) blendshape;
+    e->first_key = set->header.n_keys;
+    e->n_keys = (uint32_t) n;
+    memcpy(set->keys + set->header.n_keys, keys, n * sizeof(viseme_key));
+    set->header.n_keys += n;
+}
+
+int viseme_track_set_write(const viseme_track_set * set, const char * path) {
+    viseme_track_header header = set->header;
+    FILE * fp = fopen(path, "wb");
+    int res = 0;
+
+    if (!fp) {
+        fprintf(stderr, "ERROR: unable to open track file '%s'\n", path);
+        return -1;
+    }
+    memcpy(header.magic, VISEME_TRACK_MAGIC, 4);
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) res = -1;
+    if (header.n_tracks && fwrite(set->tracks, sizeof(viseme_track_entry), header.n_tracks, fp) != header.n_tracks) res = -1;
+    if (header.n_keys && fwrite(set->keys, sizeof(viseme_key), header.n_keys, fp) != header.n_keys) res = -1;
+    if (fclose(fp) != 0) res = -1;
+    return res;
+}
+
+void viseme_track_set_free(viseme_track_set * set) {
+    free(set->tracks);
+    free(set->keys);
+    memset(set, 0, sizeof(viseme_track_set));
+}
@@ -0,0 +1,67 @@
+/* Baked viseme animation tracks.
+
+   A track file holds one keyframe curve per blendshape.  Weights are
+   linearly interpolated between keys and held after the last key, so
+   playback is a binary search (or a forward cursor) and a lerp per
+   blendshape instead of re-running the rise/decay model every tick.
+
+   Layout, all values little-endian:
+
+     viseme_track_header                   32 bytes
+     viseme_track_entry[n_tracks]          12 bytes each
+     viseme_key[n_keys]                    8 bytes each, grouped by track,
+                                           in time order within a track
+*/
+
+#ifndef VISEME_TRACK_H
+#define VISEME_TRACK_H
+
+#include <stdint.h>
+
+#define VISEME_TRACK_MAGIC "CPVT"
+#define VISEME_TRACK_VERSION 1
+
+typedef struct viseme_track_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved0;
+    uint32_t n_tracks;
+    uint32_t n_keys;
+    float duration;      /* seconds of audio the track was baked for */
+    float interval;      /* bake step the keys were reduced from */
+    float tolerance;     /* maximum weight error of the reduction */
+    uint32_t reserved1;
+} viseme_track_header;
+
+typedef struct viseme_track_entry {
+    uint32_t blendshape; /* index on the character mesh */
+    uint32_t first_key;
+    uint32_t n_keys;
+} viseme_track_entry;
+
+typedef struct viseme_key {
+    float time;
+    float weight;
+} viseme_key;
+
+/* Reduces a curve sampled every `interval` seconds to keyframes so that
+   linear interpolation between them stays within `tolerance` of every
+   sample.  keys must hold n entries; returns the number of keys used. */
+int viseme_reduce(const float * samples, int n, float interval, float tolerance, viseme_key * keys);
+
+/* In-memory track set, built track by track and then written out */
+typedef struct viseme_track_set {
+    viseme_track_header header;
+    viseme_track_entry * tracks;
+    viseme_key * keys;
+    uint32_t tracks_cap;
+    uint32_t keys_cap;
+} viseme_track_set;
+
+void viseme_track_set_init(viseme_track_set * set, float duration, float interval, float tolerance);
+void viseme_track_set_add(viseme_track_set * set, int blendshape, const viseme_key * keys, int n);
+/* Returns 0 on success */
+int viseme_track_set_write(const viseme_track_set * set, const char * path);
+void viseme_track_set_free(viseme_track_set * set);
+
+#endif /* VISEME_TRACK_H */
@@ -52,6 +52,7 @@ using System;
 
 			if (resultCode != -1) {
 				string dictFile = null;
+				string infile = null;
 				result = null;
 				resultCode = -1;
 				bool isTime = false;
@@ -59,6 +60,7 @@ using System;
 				int i = 0;
 				foreach (string arg in args) {
 					if (arg == "-dict") dictFile = args[i + 1];
+					if (arg == "-infile" && i + 1 < args.Length) infile = args[i + 1];
 
 					if (arg == "-time") isTime = true;
 					i++;
@@ -108,6 +110,32 @@ using System;
 					}
 				};
 
+				// The decoders of a pool keep their models loaded between calls,
+				// ps_run loads them again for every file
+				SphinxDecoderPool pool = infile != null ? SphinxDecoderPool.Shared(args) : null;
+				if (pool != null) {
+					ThreadStart decode = () => {
+						SphinxDecoderPool.Result decoded = pool.RecognizeFile(infile);
+						if (decoded == null) {
+							Debug.LogError("[AutoSync] Unable to recognise " + infile);
+							failed = true;
+							resultCode = 1;
+						} else {
+							resCallback(isTime ? decoded.Times() : decoded.hypothesis);
+							resultCode = 0;
+						}
+						isFinished = true;
+					};
+
+					if (multiThread) {
+						Thread thread = new Thread(decode);
+						thread.Start();
+					} else {
+						decode();
+					}
+					return failed ? "FAILED" : result;
+				}
+
 				int argsCount = args.Length;
 
 				try {
@@ -169,17 +197,4 @@ using System;
 			}
 			return null;
 		}
-	}
-
-	public class PluginPathClass {
-		public string currentPath;
-		public string dllPath;
-
-		public PluginPathClass () {
-			currentPath = Environment.GetEnvironmentVariable("PATH", EnvironmentVariableTarget.Process);
-			dllPath = Environment.CurrentDirectory + Path.DirectorySeparatorChar + "Assets" + Path.DirectorySeparatorChar + "Plugins";
-			if (currentPath.Contains(dllPath) == false) {
-				Environment.SetEnvironmentVariable("PATH", currentPath + Path.PathSeparator + dllPath, EnvironmentVariableTarget.Process);
-			}
-		}
 	}
\ No newline at end of file
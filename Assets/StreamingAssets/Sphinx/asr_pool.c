@@ -0,0 +1,372 @@
+/* Pool of PocketSphinx decoders.
+   See asr_pool.h for an overview. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include "asr_pool.h"
+#include "tts_thread.h"
+#include "lipsync_audio.h"
+#include "lipsync_simd.h"
+
+typedef struct asr_clip {
+    int id;
+    short * samples;
+    long n;
+    char * path;         /* read by the worker, NULL for a buffer */
+    struct asr_clip * next;
+} asr_clip;
+
+typedef struct result_node {
+    struct result_node * next;
+    asr_result result;   /* followed by the segments and strings */
+} result_node;
+
+typedef struct asr_worker {
+    struct asr_pool * pool;
+    ps_decoder_t * ps;
+    tts_thread thread;
+    int started;
+    /* the result being built */
+    asr_segment * segs;
+    long segs_cap;
+    char * strings;
+    long strings_cap;
+} asr_worker;
+
+struct asr_pool {
+    cmd_ln_t * config;
+    int rate;
+    int frate;
+    int phones;
+    float partial;
+
+    asr_worker * workers;
+    int nworkers;
+
+    tts_mutex lock;
+    tts_cond work;       /* a clip was queued, or stop */
+    tts_cond ready;      /* a result was queued */
+    asr_clip * head, * tail;
+    int pending;
+    int next_id;
+    int stop;
+    result_node * first, * last;
+    result_node * current;   /* handed out by asr_pool_read */
+};
+
+static void * grow(void * buf, long * cap, long need, size_t size) {
+    if (need <= *cap) return buf;
+    while (*cap < need) *cap = *cap ? *cap * 2 : 256;
+    return realloc(buf, *cap * size);
+}
+
+static void free_clip(asr_clip * c) {
+    free(c->samples);
+    free(c->path);
+    free(c);
+}
+
+/* Copies the worker's segments and strings into a result and queues it */
+static void publish(asr_worker * w, int clip, int final, int error, float time,
+                    long n_segs, long n_strings) {
+    asr_pool * p = w->pool;
+    size_t segs_size = n_segs * sizeof(asr_segment);
+    result_node * node = malloc(offsetof(result_node, result) + sizeof(asr_result)
+                                + segs_size + n_strings);
+    asr_result * r = &node->result;
+
+    node->next = NULL;
+    r->clip = clip;
+    r->final = final;
+    r->error = error;
+    r->time = time;
+    r->n_segs = (uint32_t) n_segs;
+    r->phones = p->phones;
+    memcpy(r + 1, w->segs, segs_size);
+    memcpy((char *) (r + 1) + segs_size, w->strings, n_strings);
+
+    tts_mutex_lock(&p->lock);
+    if (p->last) p->last->next = node;
+    else p->first = node;
+    p->last = node;
+    tts_cond_broadcast(&p->ready);
+    tts_mutex_unlock(&p->lock);
+}
+
+static long add_string(asr_worker * w, long used, const char * s) {
+    long len = (long) strlen(s) + 1;
+    w->strings = grow(w->strings, &w->strings_cap, used + len, 1);
+    memcpy(w->strings + used, s, len);
+    return used + len;
+}
+
+/* Publishes the decoder's current best path */
+static void publish_hyp(asr_worker * w, int clip, int final, float time) {
+    asr_pool * p = w->pool;
+    logmath_t * lmath = ps_get_logmath(w->ps);
+    ps_seg_t * seg;
+    asr_segment * s;
+    const char * hyp;
+    long n = 0, used;
+    int32 score;
+    int sf, ef;
+
+    hyp = ps_get_hyp(w->ps, &score);
+    used = add_string(w, 0, hyp ? hyp : "");
+    for (seg = ps_seg_iter(w->ps); seg; seg = ps_seg_next(seg)) {
+        w->segs = grow(w->segs, &w->segs_cap, n + 1, sizeof(asr_segment));
+        s = &w->segs[n++];
+        ps_seg_frames(seg, &sf, &ef);
+        s->start = (float) sf / p->frate;
+        s->end = (float) ef / p->frate;
+        s->prob = final ? (float) logmath_exp(lmath, ps_seg_prob(seg, NULL, NULL, NULL)) : 0;
+        s->text = (uint32_t) used;
+        used = add_string(w, used, ps_seg_word(seg));
+    }
+    publish(w, clip, final, 0, time, n, used);
+}
+
+static void publish_error(asr_worker * w, int clip) {
+    long used = add_string(w, 0, "");
+    publish(w, clip, 1, 1, 0, 0, used);
+}
+
+/* Reads a file clip into samples */
+static int load(asr_pool * p, asr_clip * c) {
+    ls_audio a;
+
+    /* ls_audio_load_wav says why it fails */
+    if (ls_audio_load_wav(&a, c->path) != 0) return -1;
+    if (a.sample_rate != p->rate) {
+        fprintf(stderr, "ERROR: '%s' is at %d Hz, the decoder at %d Hz\n",
+                c->path, a.sample_rate, p->rate);
+        ls_audio_free(&a);
+        return -1;
+    }
+    c->samples = malloc((a.count > 0 ? a.count : 1) * sizeof(short));
+    ls_to_pcm16(a.samples, c->samples, (int) a.count);
+    c->n = a.count;
+    ls_audio_free(&a);
+    return 0;
+}
+
+static void decode(asr_worker * w, asr_clip * c) {
+    asr_pool * p = w->pool;
+    long i, len, step = (long) (p->partial * p->rate), next = step;
+
+    if (c->path && load(p, c) != 0) {
+        publish_error(w, c->id);
+        return;
+    }
+    if (ps_start_utt(w->ps) < 0) {
+        fprintf(stderr, "ERROR: unable to start decoding clip %d\n", c->id);
+        publish_error(w, c->id);
+        return;
+    }
+    for (i = 0; i < c->n; i += len) {
+        len = c->n - i < ASR_CHUNK ? c->n - i : ASR_CHUNK;
+        if (ps_process_raw(w->ps, c->samples + i, len, FALSE, FALSE) < 0) {
+            fprintf(stderr, "ERROR: decoding clip %d failed\n", c->id);
+            ps_end_utt(w->ps);
+            publish_error(w, c->id);
+            return;
+        }
+        if (step > 0 && i + len >= next && i + len < c->n) {
+            publish_hyp(w, c->id, 0, (float) (i + len) / p->rate);
+            next += step;
+        }
+    }
+    ps_end_utt(w->ps);
+    publish_hyp(w, c->id, 1, (float) c->n / p->rate);
+}
+
+static tts_thread_ret TTS_THREAD_CALL worker_main(void * userdata) {
+    asr_worker * w = userdata;
+    asr_pool * p = w->pool;
+    asr_clip * c;
+
+    for (;;) {
+        tts_mutex_lock(&p->lock);
+        while (!p->head && !p->stop) tts_cond_wait(&p->work, &p->lock);
+        if (p->stop) {
+            tts_mutex_unlock(&p->lock);
+            break;
+        }
+        c = p->head;
+        p->head = c->next;
+        if (!p->head) p->tail = NULL;
+        tts_mutex_unlock(&p->lock);
+
+        decode(w, c);
+        free_clip(c);
+
+        tts_mutex_lock(&p->lock);
+        p->pending--;
+        tts_mutex_unlock(&p->lock);
+    }
+    return 0;
+}
+
+asr_pool * asr_pool_new(int argc, const char ** argv, int nworkers, float partial) {
+    asr_pool * p;
+    char ** args;
+    int i;
+
+    /* the parser skips the program name */
+    args = malloc((argc + 1) * sizeof(char *));
+    args[0] = "asr_pool";
+    for (i = 0; i < argc; i++) args[i + 1] = (char *) argv[i];
+    p = calloc(1, sizeof(asr_pool));
+    p->config = cmd_ln_parse_r(NULL, ps_args(), argc + 1, args, TRUE);
+    free(args);
+    if (!p->config) {
+        fprintf(stderr, "ERROR: invalid decoder arguments\n");
+        free(p);
+        return NULL;
+    }
+    p->rate = (int) cmd_ln_float32_r(p->config, "-samprate");
+    p->frate = cmd_ln_int32_r(p->config, "-frate");
+    p->phones = cmd_ln_str_r(p->config, "-allphone") != NULL;
+    p->partial = partial > 0 ? partial : 0;
+    p->nworkers = nworkers > 0 ? nworkers : tts_cpu_count();
+    tts_mutex_init(&p->lock);
+    tts_cond_init(&p->work);
+    tts_cond_init(&p->ready);
+
+    /* the models are loaded here, once per decoder */
+    p->workers = calloc(p->nworkers, sizeof(asr_worker));
+    for (i = 0; i < p->nworkers; i++) {
+        p->workers[i].pool = p;
+        p->workers[i].ps = ps_init(p->config);
+        if (!p->workers[i].ps) {
+            fprintf(stderr, "ERROR: unable to load the models for worker %d\n", i);
+            asr_pool_delete(p);
+            return NULL;
+        }
+    }
+    for (i = 0; i < p->nworkers; i++) {
+        p->workers[i].started = tts_thread_start(&p->workers[i].thread, worker_main, &p->workers[i]);
+        if (!p->workers[i].started) {
+            fprintf(stderr, "ERROR: unable to start worker %d\n", i);
+            asr_pool_delete(p);
+            return NULL;
+        }
+    }
+    return p;
+}
+
+void asr_pool_delete(asr_pool * p) {
+    asr_clip * c;
+    result_node * node;
+    int i;
+
+    if (!p) return;
+    tts_mutex_lock(&p->lock);
+    p->stop = 1;
+    tts_cond_broadcast(&p->work);
+    tts_mutex_unlock(&p->lock);
+    for (i = 0; i < p->nworkers; i++) {
+        if (p->workers[i].started) tts_thread_join(p->workers[i].thread);
+        if (p->workers[i].ps) ps_free(p->workers[i].ps);
+        free(p->workers[i].segs);
+        free(p->workers[i].strings);
+    }
+    while ((c = p->head)) {
+        p->head = c->next;
+        free_clip(c);
+    }
+    while ((node = p->first)) {
+        p->first = node->next;
+        free(node);
+    }
+    free(p->current);
+    tts_cond_destroy(&p->ready);
+    tts_cond_destroy(&p->work);
+    tts_mutex_destroy(&p->lock);
+    cmd_ln_free_r(p->config);
+    free(p->workers);
+    free(p);
+}
+
+int asr_pool_workers(const asr_pool * p) {
+    return p->nworkers;
+}
+
+int asr_pool_sample_rate(const asr_pool * p) {
+    return p->rate;
+}
+
+static int queue(asr_pool * p, asr_clip * c) {
+    int id;
+
+    tts_mutex_lock(&p->lock);
+    /* the clip belongs to the workers once queued */
+    id = c->id = p->next_id++;
+    if (p->tail) p->tail->next = c;
+    else p->head = c;
+    p->tail = c;
+    p->pending++;
+    tts_cond_signal(&p->work);
+    tts_mutex_unlock(&p->lock);
+    return id;
+}
+
+int asr_pool_submit(asr_pool * p, const short * samples, int n) {
+    asr_clip * c = calloc(1, sizeof(asr_clip));
+
+    if (n < 0) n = 0;
+    c->samples = malloc((n > 0 ? n : 1) * sizeof(short));
+    memcpy(c->samples, samples, n * sizeof(short));
+    c->n = n;
+    return queue(p, c);
+}
+
+int asr_pool_submit_file(asr_pool * p, const char * path) {
+    asr_clip * c = calloc(1, sizeof(asr_clip));
+
+    c->path = malloc(strlen(path) + 1);
+    strcpy(c->path, path);
+    return queue(p, c);
+}
+
+int asr_pool_pending(asr_pool * p) {
+    int n;
+
+    tts_mutex_lock(&p->lock);
+    n = p->pending;
+    tts_mutex_unlock(&p->lock);
+    return n;
+}
+
+const asr_result * asr_pool_read(asr_pool * p, int timeout_ms) {
+    double deadline = tts_clock_seconds() + timeout_ms / 1000.0, left;
+    result_node * node;
+
+    asr_pool_release(p);
+    tts_mutex_lock(&p->lock);
+    while (!p->first && timeout_ms != 0) {
+        if (timeout_ms < 0) {
+            tts_cond_wait(&p->ready, &p->lock);
+            continue;
+        }
+        left = deadline - tts_clock_seconds();
+        if (left <= 0) break;
+        tts_cond_timedwait(&p->ready, &p->lock, (long) (left * 1000.0) + 1);
+    }
+    node = p->first;
+    if (node) {
+        p->first = node->next;
+        if (!p->first) p->last = NULL;
+    }
+    p->current = node;
+    tts_mutex_unlock(&p->lock);
+    return node ? &node->result : NULL;
+}
+
+void asr_pool_release(asr_pool * p) {
+    free(p->current);
+    p->current = NULL;
+}
@@ -0,0 +1,126 @@
+/* Pool of PocketSphinx decoders for the word and phone timings.
+
+   AutoSync gets its timings from ps_run, through SphinxWrapper: every
+   call parses the argument list, loads the acoustic model, the
+   dictionary and the language model or phone set, decodes one file and
+   frees it all again.  For a short clip the model loading is most of
+   the time, and one call decodes one clip on one core.
+
+   The pool parses the arguments once and creates one decoder per
+   worker thread with the models loaded.  Clips are queued as 16 bit
+   buffers at the decoder rate, or as WAV files read by the worker (see
+   lipsync_audio.h; the file must be at the decoder rate, -samprate,
+   16 kHz by default).  Any idle worker takes the next clip, so a batch
+   is decoded on all cores, and decoding a clip costs the decoding
+   only.  The public PocketSphinx API has no way to share the loaded
+   models between decoders, so each worker holds its own copy; size
+   the pool accordingly for the large language models.
+
+   Results are queued for polling, like the spurt ring (tts_ring.h):
+   nothing calls back into the caller from the workers.  With a partial
+   interval, a worker publishes the current hypothesis every interval of
+   decoded audio, then the final one at the end of the clip.  A result
+   is one block
+
+     asr_result                             24 bytes
+     asr_segment[n_segs]                    16 bytes each
+     char strings[]                         hypothesis, then the names
+
+   with the segments of the best path: phones with an -allphone search
+   (what AutoSync runs), words otherwise, including the fillers (<s>,
+   </s>, <sil>, SIL) as ps_run -time prints them.  Times are seconds
+   from the start of the clip, at the decoder's frame rate.  The
+   posterior probability of a segment is only known for final results
+   and with -bestpath yes; it is 0 otherwise.
+
+   Unity uses the pool through P/Invoke (SphinxDecoderPool.cs).  Shared
+   library build, against PocketSphinx 5prealpha:
+     gcc -O2 -shared -fPIC -I../CereVoice -I../LipSync \
+         -I<prefix>/include/pocketsphinx -I<prefix>/include/sphinxbase \
+         -o libasr_tools.so asr_pool.c ../LipSync/lipsync_audio.c \
+         ../LipSync/lipsync_rig.c ../LipSync/lipsync_phoneme.c \
+         <prefix>/lib/libpocketsphinx.a <prefix>/lib/libsphinxbase.a \
+         -lpthread -lm
+   (asr_tools.dll with MinGW on Windows), copied to Assets/Plugins/x86_x64;
+   make asr SPHINX=<prefix> in StreamingAssets does both.
+   The static libraries put the decoder in the one plugin, so nothing
+   has to be found on PATH.  asr_recognize.c is the command line driver
+   for batches.
+*/
+
+#ifndef ASR_POOL_H
+#define ASR_POOL_H
+
+#include <stdint.h>
+
+/* Functions called from Unity through P/Invoke when the pool is built
+   as the asr_tools shared library */
+#ifdef _WIN32
+#define ASR_EXPORT __declspec(dllexport)
+#else
+#define ASR_EXPORT __attribute__((visibility("default")))
+#endif
+
+#define ASR_CHUNK 2048   /* samples passed to the decoder at a time */
+
+typedef struct asr_result {
+    int32_t clip;        /* as returned by asr_pool_submit */
+    int32_t final;       /* 0 for a partial hypothesis */
+    int32_t error;       /* the clip could not be read or decoded */
+    float time;          /* seconds of the clip decoded */
+    uint32_t n_segs;
+    uint32_t phones;     /* segments are phones, else words */
+} asr_result;
+
+typedef struct asr_segment {
+    float start;         /* seconds */
+    float end;           /* seconds, start of the last frame as in ps_run */
+    float prob;          /* posterior probability, 0 if not known */
+    uint32_t text;       /* offset of the name in the strings */
+} asr_segment;
+
+static inline const asr_segment * asr_result_segments(const asr_result * r) {
+    return (const asr_segment *) (r + 1);
+}
+
+/* The hypothesis, words or phones separated by spaces */
+static inline const char * asr_result_hyp(const asr_result * r) {
+    return (const char *) (asr_result_segments(r) + r->n_segs);
+}
+
+static inline const char * asr_result_text(const asr_result * r, const asr_segment * seg) {
+    return asr_result_hyp(r) + seg->text;
+}
+
+typedef struct asr_pool asr_pool;
+
+/* Parses the decoder arguments (as for ps_run, without the program
+   name and without -infile and -time, which are ps_run's own) and
+   starts nworkers workers, each with a decoder, 0 for one per core.
+   partial is the interval of partial hypotheses in seconds of audio, 0
+   for final results only.  Returns NULL if the arguments are invalid or
+   a model cannot be loaded. */
+ASR_EXPORT asr_pool * asr_pool_new(int argc, const char ** argv, int nworkers, float partial);
+/* Stops the workers; queued clips are dropped */
+ASR_EXPORT void asr_pool_delete(asr_pool * p);
+ASR_EXPORT int asr_pool_workers(const asr_pool * p);
+/* Rate the clips must have, -samprate */
+ASR_EXPORT int asr_pool_sample_rate(const asr_pool * p);
+
+/* Queues n samples, copied.  Returns the clip id. */
+ASR_EXPORT int asr_pool_submit(asr_pool * p, const short * samples, int n);
+/* Queues a WAV file, read by the worker.  Returns the clip id; a file
+   that cannot be read or is at another rate gives an error result. */
+ASR_EXPORT int asr_pool_submit_file(asr_pool * p, const char * path);
+/* Clips queued or being decoded */
+ASR_EXPORT int asr_pool_pending(asr_pool * p);
+
+/* Waits at most timeout_ms for the next result, NULL on timeout (a
+   negative timeout waits for ever).  Results of different clips come
+   in the order they are ready; those of one clip in order, the final
+   one last.  The result stays valid until asr_pool_release, which must
+   be called before the next read. */
+ASR_EXPORT const asr_result * asr_pool_read(asr_pool * p, int timeout_ms);
+ASR_EXPORT void asr_pool_release(asr_pool * p);
+
+#endif /* ASR_POOL_H */
@@ -0,0 +1,222 @@
+/* asr_recognize - word or phone timings of many clips with the models
+   loaded once.
+
+   Manifest: one clip per line, "wav_file [output_name]", as for
+   tts_callback -b.  For each clip <output_name>.txt is written to the
+   output directory with a line "name start end prob" per segment, the
+   format of ps_run -time that AutoSync reads.  The decoder arguments
+   follow the manifest and are those of ps_run, without -infile and
+   -time.  See asr_pool.h for the build; link asr_recognize.c with the
+   same files, without -shared.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asr_pool.h"
+#include "tts_thread.h"
+
+/* some compilers may complain about this not being defined */
+extern char * strdup(const char *s);
+
+typedef struct clip {
+    const char * input;
+    char * name;
+    int id;
+    int failed;
+    float seconds;
+    double latency;       /* seconds from the start of the run to the final result */
+} clip;
+
+void usage(char * name) {
+    fprintf(stderr, "asr_recognize - decodes every clip of a manifest on a pool of PocketSphinx\n");
+    fprintf(stderr, "decoders, one per worker thread, with the models loaded once, and writes\n");
+    fprintf(stderr, "the word or phone timings of each clip (see asr_pool.h).\n\n");
+    fprintf(stderr, "Usage: %s [Options] manifest_file [decoder arguments]\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, " -h\t\t  Display help\n");
+    fprintf(stderr, " -n <n>\t\t  Number of workers (default: one per core)\n");
+    fprintf(stderr, " -o output_dir\t  Directory of the timings (default: .)\n");
+    fprintf(stderr, " -p <seconds>\t  Print partial hypotheses at this interval of audio\n");
+    exit(1);
+}
+
+static char * read_file(const char * path) {
+    FILE * fp = fopen(path, "rb");
+    char * data;
+    long n;
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = malloc(n + 1);
+    if (data && fread(data, 1, n, fp) != (size_t) n) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    if (data) data[n] = '\0';
+    return data;
+}
+
+/* Output name of an input path: no directory, no extension */
+static char * default_name(const char * input) {
+    const char * base = input, * c;
+    char * name, * dot;
+    for (c = input; *c; c++)
+        if (*c == '/' || *c == '\\') base = c + 1;
+    name = strdup(base);
+    dot = strrchr(name, '.');
+    if (dot && dot != name) *dot = '\0';
+    return name;
+}
+
+/* Splits the manifest in place */
+static int parse_manifest(char * text, clip ** clips) {
+    char * line, * next, * end, * input, * name;
+    int n = 0, cap = 16;
+
+    *clips = malloc(cap * sizeof(clip));
+    for (line = text; line && *line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        end = line + strlen(line);
+        while (end > line && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+        while (*line == ' ' || *line == '\t') line++;
+        if (*line == '\0' || *line == '#') continue;
+
+        input = line;
+        name = NULL;
+        for (end = line; *end && *end != ' ' && *end != '\t'; end++);
+        if (*end) {
+            *end++ = '\0';
+            while (*end == ' ' || *end == '\t') end++;
+            if (*end) name = end;
+        }
+        if (n == cap) {
+            cap *= 2;
+            *clips = realloc(*clips, cap * sizeof(clip));
+        }
+        memset(&(*clips)[n], 0, sizeof(clip));
+        (*clips)[n].input = input;
+        (*clips)[n].name = name ? strdup(name) : default_name(input);
+        n++;
+    }
+    return n;
+}
+
+static int write_times(const char * dir, const clip * c, const asr_result * r) {
+    const asr_segment * seg = asr_result_segments(r);
+    char * path = malloc(strlen(dir) + strlen(c->name) + 8);
+    FILE * fp;
+    uint32_t i;
+
+    sprintf(path, "%s/%s.txt", dir, c->name);
+    fp = fopen(path, "w");
+    free(path);
+    if (!fp) return -1;
+    for (i = 0; i < r->n_segs; i++, seg++)
+        fprintf(fp, "%s %.3f %.3f %f\n", asr_result_text(r, seg), seg->start, seg->end, seg->prob);
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+static int compare_latency(const void * a, const void * b) {
+    double la = *(const double *) a, lb = *(const double *) b;
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+int main(int argc, char ** argv) {
+    char * manifest = NULL, * text;
+    const char * output_dir = ".";
+    const asr_result * r;
+    asr_pool * pool;
+    clip * clips;
+    double started, loaded, wall, audio = 0, * latencies;
+    float partial = 0;
+    int i, nworkers = 0, nclips, remaining, nok = 0, failed = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) usage(argv[0]);
+        else if (strcmp(argv[i], "-n") == 0) {
+            if (++i < argc) nworkers = atoi(argv[i]);
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-o") == 0) {
+            if (++i < argc) output_dir = argv[i];
+            else usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-p") == 0) {
+            if (++i < argc) partial = (float) atof(argv[i]);
+            else usage(argv[0]);
+        }
+        else {
+            manifest = argv[i++];
+            break;
+        }
+    }
+    if (!manifest) usage(argv[0]);
+
+    text = read_file(manifest);
+    if (!text) {
+        fprintf(stderr, "ERROR: unable to read manifest '%s'\n", manifest);
+        return 1;
+    }
+    nclips = parse_manifest(text, &clips);
+
+    started = tts_clock_seconds();
+    pool = asr_pool_new(argc - i, (const char **) argv + i, nworkers, partial);
+    if (!pool) return 1;
+    loaded = tts_clock_seconds();
+    fprintf(stderr, "INFO: models loaded for %d worker(s) in %.2f s, decoding %d clip(s)\n",
+            asr_pool_workers(pool), loaded - started, nclips);
+
+    /* ids are given in order from 0 */
+    for (i = 0; i < nclips; i++) clips[i].id = asr_pool_submit_file(pool, clips[i].input);
+    for (remaining = nclips; remaining > 0; asr_pool_release(pool)) {
+        clip * c;
+
+        r = asr_pool_read(pool, -1);
+        c = &clips[r->clip];
+        if (!r->final) {
+            fprintf(stdout, "INFO: clip '%s' at %.2f s: %s\n", c->name, r->time, asr_result_hyp(r));
+            continue;
+        }
+        remaining--;
+        c->latency = tts_clock_seconds() - loaded;
+        c->seconds = r->time;
+        if (r->error || write_times(output_dir, c, r) != 0) {
+            c->failed = 1;
+            failed++;
+            fprintf(stdout, "ERROR: clip '%s' failed\n", c->name);
+            continue;
+        }
+        fprintf(stdout, "INFO: clip '%s': %.2f s audio, %u %s, done after %.1f ms\n", c->name,
+                r->time, r->n_segs, r->phones ? "phone(s)" : "word(s)", c->latency * 1000.0);
+    }
+    wall = tts_clock_seconds() - loaded;
+    asr_pool_delete(pool);
+
+    /* Aggregate report */
+    latencies = malloc((nclips + 1) * sizeof(double));
+    for (i = 0; i < nclips; i++) {
+        if (clips[i].failed) continue;
+        audio += clips[i].seconds;
+        latencies[nok++] = clips[i].latency;
+    }
+    qsort(latencies, nok, sizeof(double), compare_latency);
+    fprintf(stdout, "INFO: %d clip(s) decoded, %d failed, %.2f s audio in %.2f s\n",
+            nok, failed, audio, wall);
+    if (nok > 0) {
+        fprintf(stdout, "INFO: realtime factor %.4f (%.1fx realtime)\n",
+                audio > 0 ? wall / audio : 0, wall > 0 ? audio / wall : 0);
+        fprintf(stdout, "INFO: clip done ms: median %.1f, p95 %.1f, max %.1f\n",
+                latencies[nok / 2] * 1000.0, latencies[(nok * 95) / 100] * 1000.0,
+                latencies[nok - 1] * 1000.0);
+    }
+
+    free(latencies);
+    for (i = 0; i < nclips; i++) free(clips[i].name);
+    free(clips);
+    free(text);
+    return failed > 0;
+}